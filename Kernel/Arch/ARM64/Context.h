@@ -0,0 +1,59 @@
+/*
+ * Kernel thread context, what a thread switch preserves
+ *
+ * A switch is an ordinary function call (Switch.S): the caller already
+ * saved whatever it needs of x0-x18, so only the AAPCS64 callee-saved
+ * registers, the frame pointer, the return address & SP are kept. DAIF
+ * isn't, both sides run with IRQs masked (schedule()). FP/SIMD is never
+ * touched by the kernel and switched lazily (FPSIMD.h).
+ *
+ * A context that never ran starts at 'lr' on 'sp' with x0 = what the
+ * switch returns, see _context_switch().
+ *
+ * Also included from Switch.S.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#define CTX_X(n)        (8 * ((n) - 19))        /* x19-x28 */
+#define CTX_FP          80
+#define CTX_LR          88
+#define CTX_SP          96
+#define CTX_SIZE        112 /* Multiple of 16 */
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+typedef struct cpu_context {
+        uint64_t x19;
+        uint64_t x20;
+        uint64_t x21;
+        uint64_t x22;
+        uint64_t x23;
+        uint64_t x24;
+        uint64_t x25;
+        uint64_t x26;
+        uint64_t x27;
+        uint64_t x28;
+        uint64_t fp;    /* x29 */
+        uint64_t lr;    /* x30, where it resumes */
+        uint64_t sp;
+        uint64_t pad;
+} cpu_context;
+
+/*
+ * in Switch.S. Saves the running context in 'prev', resumes 'next' and
+ * hands it 'last' (its x0). Returns in 'prev' once another switch resumes
+ * it, with that switch's 'last'.
+ */
+void *_context_switch(cpu_context *prev, cpu_context *next, void *last);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* CONTEXT_H */
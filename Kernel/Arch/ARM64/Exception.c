@@ -4,53 +4,199 @@
  * Author: Tuna CICI
  */
 
+#include <stddef.h>
+
 #include "ARM64/Exception.h"
+#include "ARM64/FPSIMD.h"
 #include "ARM64/Machine.h"
 
 #include "LibKern/Console.h"
+#include "LibKern/RCU.h"
+#include "LibKern/Trace.h"
+
+#include "Drivers/GIC.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+#ifdef KBENCH
+#include "Bench/KBench.h"
+#endif
+
+/* Vector.S hardcodes these */
+_Static_assert(offsetof(exception_frame, x30) == FRAME_X(30), "frame");
+_Static_assert(offsetof(exception_frame, sp) == FRAME_SP, "frame");
+_Static_assert(offsetof(exception_frame, elr) == FRAME_ELR, "frame");
+_Static_assert(offsetof(exception_frame, spsr) == FRAME_SPSR, "frame");
+_Static_assert(offsetof(exception_frame, esr) == FRAME_ESR, "frame");
+_Static_assert(offsetof(exception_frame, far) == FRAME_FAR, "frame");
+_Static_assert(sizeof(exception_frame) == FRAME_SIZE, "frame");
+_Static_assert((FRAME_SIZE % 16) == 0, "SP must stay 16-byte aligned");
 
 extern uint64_t kstart;
 
+static volatile uint8_t resched_pending[MAX_CPUS] = {0};
+static uint32_t irq_depth[MAX_CPUS] = {0};
+
+/* in Vector.S */
+extern uint64_t _user_enter(uint64_t pc, uint64_t sp, uint64_t arg,
+                            uint64_t *ksp);
+extern void _user_return(uint64_t ksp, uint64_t value)
+        __attribute__((noreturn));
+
+void set_need_resched(void)
+{
+        resched_pending[cpu_id()] = 1;
+}
+
+void clear_need_resched(void)
+{
+        resched_pending[cpu_id()] = 0;
+}
+
+uint8_t need_resched(void)
+{
+        return resched_pending[cpu_id()];
+}
+
 /* TODO: Cross this bridge when you get here */
 void handle_spx_syn(exception_frame *frame)
 {        
         /* Exception Class */
-        uint8_t ec =
-                (frame->esr >> ESR_EC_OFFSET) & ((1 << (ESR_EC_SIZE + 1)) - 1);
+        uint8_t ec = esr_ec(frame->esr);
+
+        TRACE("[arm64/exception] SYN esr=0x%lx far=0x%lx elr=0x%lx",
+                frame->esr, frame->far, frame->elr);
 
         switch (ec) {
         case EC_DATA_ABORT:
-                klog("[arm64/exception] DATA_ABORT!!!\n");
+                KLOG_ERR(KLOG_ARCH, "[arm64/exception] DATA_ABORT!!!\n");
                 wfi();
         break;
         case EC_DATA_ABORT_UNCHANGED:
-                klog("[arm64/exception] DATA_ABORT!!!\n");
+                KLOG_ERR(KLOG_ARCH, "[arm64/exception] DATA_ABORT!!!\n");
                 wfi();
         break;
+#ifdef KBENCH
+        case EC_BRK_AARCH64:
+                /* Full frame round trip, see Kernel/Bench */
+                if (ESR_ISS_IMM16(frame->esr) == KBENCH_BRK_IMM) {
+                        frame->elr += 4;
+                        return;
+                }
+
+                KLOG_ERR(KLOG_ARCH, "[arm64/exception] BRK #0x%lx\n",
+                        ESR_ISS_IMM16(frame->esr));
+                wfi();
+        break;
+#endif
         default:
-                klog("[arm64/exception] SYN ESR[EC]: 0x%lx\n", ec);
+                KLOG_ERR(KLOG_ARCH, "[arm64/exception] SYN ESR[EC]: 0x%x\n", ec);
                 wfi();
         break;
         }
 }
 
-void handle_spx_irq(exception_frame *frame)
+uint64_t user_enter(uint64_t pc, uint64_t sp, uint64_t arg)
 {
-        klog("[arm64/exception] IRQ\n");
+        /* Per thread: it may be preempted at EL0 & resume elsewhere */
+        thread *t = current_thread();
+        uint64_t ret = _user_enter(pc, sp, arg, &t->user_ksp);
 
-        return;
+        t->user_ksp = 0;
+
+        return ret;
+}
+
+void user_return(uint64_t value)
+{
+        uint64_t ksp = current_thread()->user_ksp;
+
+        if (ksp) {
+                _user_return(ksp, value);
+        }
+}
+
+void handle_el0_syn(exception_frame *frame)
+{
+        /* Lazy FP/SIMD, first use since the thread was switched in */
+        if (esr_ec(frame->esr) == EC_SVE_SIMD_FP_ACCESS && !fpsimd_trap()) {
+                return;
+        }
+
+        KLOG_ERR(KLOG_ARCH, "[arm64/exception] EL0 fault ESR[EC]: 0x%x "
+                "far=0x%lx elr=0x%lx\n", esr_ec(frame->esr), frame->far,
+                frame->elr);
+
+        /* No processes to kill yet, hand control back to user_enter() */
+        user_return((uint64_t) -1);
+        wfi();
+}
+
+uint8_t handle_spx_irq(exception_frame *frame)
+{
+        uint32_t cpu = cpu_id();
+
+        TRACE("[arm64/exception] IRQ elr=0x%lx", frame->elr);
+
+        /* Outermost: may be leaving idle, or coming from EL0 (a QS) */
+        if (irq_depth[cpu]++ == 0) {
+                rcu_irq_enter();
+        }
+
+        gic_handle_irq();
+
+        if (irq_depth[cpu] == 1) {
+                rcu_irq_exit(frame_from_el0(frame));
+        }
+
+        irq_depth[cpu]--;
+
+        /*
+         * A nested IRQ returns to a handler, the outermost one preempts, and
+         * only EL0: the kernel may be in an RCU read section or hold a lock.
+         * Otherwise it stays pending until the next schedule().
+         */
+        return irq_depth[cpu] == 0 && resched_pending[cpu] &&
+                frame_from_el0(frame);
+}
+
+uint32_t in_irq(void)
+{
+        return irq_depth[cpu_id()];
+}
+
+/* The frame is complete here (x19-x28 & SP too) */
+void handle_spx_preempt(exception_frame *frame)
+{
+        TRACE("[arm64/exception] PREEMPT elr=0x%lx sp=0x%lx",
+                frame->elr, frame->sp);
+
+        /* Returns once this context is picked again */
+        sched_preempt();
+}
+
+void handle_kstack_overflow(exception_frame *frame)
+{
+        KLOG_ERR(KLOG_ARCH, "[arm64/exception] Kernel stack overflow! "
+                "sp=0x%lx far=0x%lx elr=0x%lx\n", frame->sp, frame->far,
+                frame->elr);
+
+        for (;;) {
+                wfi();
+        }
 }
 
 void handle_spx_fiq(exception_frame *frame)
 {
-        klog("[arm64/exception] FIQ\n");
+        KLOG_ERR(KLOG_ARCH, "[arm64/exception] FIQ\n");
 
         return;
 }
 
 void handle_spx_ser(exception_frame *frame)
 {
-        klog("[arm64/exception] SError\n");
+        KLOG_ERR(KLOG_ARCH, "[arm64/exception] SError\n");
 
         return;
 }
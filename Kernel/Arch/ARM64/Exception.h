@@ -1,14 +1,48 @@
 /*
  * ARM64 exception definitions
  *
+ * Also included from Vector.S, so everything C-only is guarded with
+ * __ASSEMBLER__ and the frame layout is spelled out as plain offsets.
+ *
  * Author: Tuna CICI
  */
 
-#include <stdint.h>
+#pragma once
+
+#ifndef EXCEPTION_H
+#define EXCEPTION_H
 
 /* Ref: AArch64-Registers/ESR-EL1--Exception-Syndrome-Register--EL1- */
 #define ESR_EC_OFFSET 26 /* bits */
 #define ESR_EC_SIZE 6 /* bits */
+#define ESR_ISS_IMM16(esr) ((esr) & 0xFFFF) /* SVC/HVC/BRK immediate */
+
+#define ESR_EC_SVC64 0x15 /* EC_HVC_SVC_AARCH64, for Vector.S */
+
+/*
+ * Exception frame layout (see exception_frame below)
+ *
+ * Every path allocates the same FRAME_SIZE bytes but fills only what it
+ * needs:
+ *      IRQ:    x0-x18, x29, x30, ELR & SPSR (caller-saved only, the C
+ *              handler preserves x19-x28 itself). x19-x28 & SP are added
+ *              in place when a reschedule is needed.
+ *      SVC:    x30, ELR & SPSR, SP from EL0. See Syscall.h for the ABI.
+ *      Faults: everything, including ESR & FAR (FIQ & SError too).
+ *
+ * 'sp' is SP_EL0 when the exception came from EL0, SPSR tells which.
+ */
+#define FRAME_X(n)      (8 * (n))
+#define FRAME_SP        248
+#define FRAME_ELR       256
+#define FRAME_SPSR      264
+#define FRAME_ESR       272
+#define FRAME_FAR       280
+#define FRAME_SIZE      288 /* Multiple of 16, SP alignment */
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
 
 enum {
         EC_UNKNOWN = 0b000000,
@@ -47,6 +81,11 @@ enum {
         EC_BRK_AARCH64 = 0b111100
 };
 
+static inline uint8_t esr_ec(uint64_t esr)
+{
+        return (esr >> ESR_EC_OFFSET) & ((1U << ESR_EC_SIZE) - 1);
+}
+
 typedef struct exception_frame {
         uint64_t x0;
         uint64_t x1;
@@ -79,12 +118,49 @@ typedef struct exception_frame {
         uint64_t x28;
         uint64_t x29;
         uint64_t x30;
-        uint64_t esr;
-        uint64_t far;
+        uint64_t sp;   /* Full frames only */
         uint64_t elr;
+        uint64_t spsr;
+        uint64_t esr;  /* Faults only */
+        uint64_t far;  /* Faults only */
 } exception_frame;
 
+/* SPSR.M[3:0] == EL0t */
+static inline uint8_t frame_from_el0(const exception_frame *frame)
+{
+        return (frame->spsr & 0xF) == 0;
+}
+
+/* Called from Vector.S */
 void handle_spx_syn(exception_frame *frame);
-void handle_spx_irq(exception_frame *frame);
+uint8_t handle_spx_irq(exception_frame *frame); /* !0: reschedule */
+void handle_spx_preempt(exception_frame *frame);
 void handle_spx_fiq(exception_frame *frame);
 void handle_spx_ser(exception_frame *frame);
+void handle_el0_syn(exception_frame *frame);
+void handle_kstack_overflow(exception_frame *frame); /* Never returns */
+
+/* IRQ handlers being run on this CPU, >1 when nested */
+uint32_t in_irq(void);
+
+/*
+ * Ask for a reschedule on the way out of the current IRQ. Only then does
+ * the IRQ path save x19-x28 and call handle_spx_preempt().
+ */
+void set_need_resched(void);
+void clear_need_resched(void);
+uint8_t need_resched(void);
+
+/*
+ * Run 'pc' at EL0 on the stack 'sp' with x0 = 'arg'. The kernel stack
+ * below the caller's frame serves the user code's exceptions. Returns
+ * the value given to user_return(), which a syscall (SYS_EXIT) or a
+ * fatal EL0 fault calls. user_return() only returns when this CPU is
+ * not running user_enter()'d code.
+ */
+uint64_t user_enter(uint64_t pc, uint64_t sp, uint64_t arg);
+void user_return(uint64_t value);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* EXCEPTION_H */
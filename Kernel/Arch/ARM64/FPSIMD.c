@@ -0,0 +1,139 @@
+/*
+ * Lazy FP/SIMD context management, see FPSIMD.h
+ *
+ * All of it runs with IRQs masked (exception handlers & the scheduler),
+ * so the per-CPU state needs no locking.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ARM64/FPSIMD.h"
+#include "ARM64/Machine.h"
+
+#include "LibKern/Trace.h"
+
+_Static_assert(offsetof(fpsimd_state, fpsr) == FPSIMD_FPSR, "FPSIMD.S");
+_Static_assert(offsetof(fpsimd_state, fpcr) == FPSIMD_FPCR, "FPSIMD.S");
+
+typedef struct fpsimd_cpu {
+        fpsimd_state *owner;   /* Live in the registers */
+        fpsimd_state *current; /* Thread running on this CPU */
+        uint64_t cpacr;        /* Cached CPACR_EL1 */
+        fpsimd_stats stats;
+} fpsimd_cpu;
+
+static fpsimd_cpu cpus[MAX_CPUS];
+
+/*
+ * No 'isb': the new value only matters for EL0, and the 'eret' back
+ * there is context synchronizing.
+ */
+static inline void _el0_access(fpsimd_cpu *fc, uint8_t allow)
+{
+        uint64_t cpacr = (fc->cpacr & ~(uint64_t) CPACR_FPEN_MASK) |
+                (allow ? CPACR_FPEN_NONE : CPACR_FPEN_TRAP_EL0);
+
+        if (cpacr != fc->cpacr) {
+                fc->cpacr = cpacr;
+                MSR("CPACR_EL1", cpacr);
+        }
+}
+
+void fpsimd_cpu_init(void)
+{
+        fpsimd_cpu *fc = &cpus[cpu_id()];
+
+        fc->owner = NULL;
+        fc->current = NULL;
+
+        MRS("CPACR_EL1", fc->cpacr);
+        fc->cpacr |= CPACR_FPEN_NONE; /* Forces the write below */
+
+        _el0_access(fc, 0);
+        isb();
+}
+
+void fpsimd_state_init(fpsimd_state *state)
+{
+        for (uint32_t i = 0; i < 64; i++) {
+                state->v[i] = 0;
+        }
+
+        state->fpsr = 0;
+        state->fpcr = 0; /* Round to nearest, no traps */
+}
+
+void fpsimd_switch(fpsimd_state *next)
+{
+        fpsimd_cpu *fc = &cpus[cpu_id()];
+
+        fc->current = next;
+        _el0_access(fc, next && fc->owner == next);
+}
+
+uint8_t fpsimd_trap(void)
+{
+        fpsimd_cpu *fc = &cpus[cpu_id()];
+        fpsimd_state *cur = fc->current;
+
+        fc->stats.traps++;
+
+        if (!cur) {
+                return 1;
+        }
+
+        if (fc->owner != cur) {
+                TRACE("[fpsimd] owner 0x%lx -> 0x%lx", (uint64_t) fc->owner,
+                        (uint64_t) cur);
+
+                if (fc->owner) {
+                        fpsimd_save(fc->owner);
+                        fc->stats.saves++;
+                }
+
+                fpsimd_load(cur);
+                fc->stats.loads++;
+                fc->owner = cur;
+        }
+
+        _el0_access(fc, 1);
+
+        return 0;
+}
+
+void fpsimd_flush(fpsimd_state *state)
+{
+        fpsimd_cpu *fc = &cpus[cpu_id()];
+
+        if (!state || fc->owner != state) {
+                return;
+        }
+
+        fpsimd_save(state);
+        fc->stats.saves++;
+        fc->owner = NULL;
+
+        _el0_access(fc, 0);
+}
+
+void fpsimd_release(fpsimd_state *state)
+{
+        fpsimd_cpu *fc = &cpus[cpu_id()];
+
+        if (fc->owner == state) {
+                fc->owner = NULL;
+        }
+
+        if (fc->current == state) {
+                fc->current = NULL;
+                _el0_access(fc, 0);
+        }
+}
+
+fpsimd_stats fpsimd_get_stats(void)
+{
+        return cpus[cpu_id()].stats;
+}
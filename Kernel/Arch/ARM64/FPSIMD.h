@@ -0,0 +1,81 @@
+/*
+ * Lazy FP/SIMD context management
+ *
+ * The kernel itself never touches the FP/SIMD registers (C is built with
+ * -mgeneral-regs-only, LibKern/String is integer-only). So the registers
+ * simply keep the state of the last thread that used them, the CPU's
+ * "owner", and nothing is saved or loaded on a context switch:
+ *
+ *      - fpsimd_switch() only records the incoming thread and lets EL0
+ *        access FP/SIMD if that thread is the owner (CPACR_EL1.FPEN).
+ *      - Otherwise its first FP/SIMD instruction traps (EC 0b000111).
+ *        fpsimd_trap() saves the previous owner, loads the thread's own
+ *        state and makes it the owner.
+ *
+ * Integer-only threads never trap and are never saved. Two FP users
+ * sharing a CPU cost one save & one load per hand-over, not per switch.
+ *
+ * A live state belongs to one CPU: call fpsimd_flush() on that CPU
+ * before the thread runs anywhere else.
+ *
+ * Also included from FPSIMD.S.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef FPSIMD_H
+#define FPSIMD_H
+
+/* CPACR_EL1.FPEN, bits [21:20] */
+#define CPACR_FPEN_SHIFT        20
+#define CPACR_FPEN_MASK         (0b11 << CPACR_FPEN_SHIFT)
+#define CPACR_FPEN_TRAP_EL0     (0b01 << CPACR_FPEN_SHIFT) /* EL1 only */
+#define CPACR_FPEN_NONE         (0b11 << CPACR_FPEN_SHIFT) /* No traps */
+
+/* fpsimd_state layout, for FPSIMD.S */
+#define FPSIMD_V(n)             (16 * (n))
+#define FPSIMD_FPSR             512
+#define FPSIMD_FPCR             516
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+typedef struct fpsimd_state {
+        uint64_t v[64]; /* q0-q31, low 64 bits first */
+        uint32_t fpsr;
+        uint32_t fpcr;
+} __attribute__((aligned(16))) fpsimd_state;
+
+typedef struct fpsimd_stats {
+        uint64_t traps;
+        uint64_t saves;
+        uint64_t loads;
+} fpsimd_stats;
+
+/* in FPSIMD.S, raw register transfers */
+void fpsimd_save(fpsimd_state *state);
+void fpsimd_load(const fpsimd_state *state);
+
+void fpsimd_cpu_init(void);
+void fpsimd_state_init(fpsimd_state *state);
+
+/* 'next' may be NULL (kernel-only context, FP/SIMD traps) */
+void fpsimd_switch(fpsimd_state *next);
+
+/* EL0 FP/SIMD access trap. Returns !0 if there's no context to load */
+uint8_t fpsimd_trap(void);
+
+/* Save 'state' if it's live on this CPU & drop the ownership */
+void fpsimd_flush(fpsimd_state *state);
+
+/* 'state' is going away, drop it without saving */
+void fpsimd_release(fpsimd_state *state);
+
+fpsimd_stats fpsimd_get_stats(void);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* FPSIMD_H */
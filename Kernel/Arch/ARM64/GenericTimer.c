@@ -0,0 +1,86 @@
+/*
+ * ARMv8-A Generic Timer (virtual counter & timer)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/GenericTimer.h"
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/Clockevent.h"
+#include "LibKern/Console.h"
+
+#include "Drivers/GIC.h"
+
+static clocksource arch_counter;
+static clockevent arch_timer_evt[MAX_CPUS];
+
+static uint64_t _arch_counter_read(void)
+{
+        return cntvct_read_ordered();
+}
+
+void generic_timer_init(void)
+{
+        uint64_t freq = cntfrq_read();
+
+        clocksource_init(&arch_counter, "arch_sys_counter", _arch_counter_read,
+                freq, CLOCKSOURCE_MASK(CNTVCT_BITS));
+        clocksource_register(&arch_counter);
+
+        KLOG_INFO(KLOG_TIME, "[generic_timer] %lu Hz, mult=%u shift=%u\n",
+                freq, arch_counter.mult, arch_counter.shift);
+}
+
+static void _arch_timer_set_deadline(uint64_t cycles)
+{
+        MSR("CNTV_CVAL_EL0", cycles);
+        MSR("CNTV_CTL_EL0", CNTV_CTL_ENABLE);
+        isb();
+}
+
+static void _arch_timer_stop(void)
+{
+        /* Disabling also deasserts the (level-sensitive) interrupt */
+        MSR("CNTV_CTL_EL0", 0);
+        isb();
+}
+
+void generic_timer_cpu_init(uint32_t intid)
+{
+        clockevent *ce = &arch_timer_evt[cpu_id()];
+
+        ce->name = "arch_timer_virt";
+        ce->set_deadline = _arch_timer_set_deadline;
+        ce->stop = _arch_timer_stop;
+        ce->handler = 0;
+
+        clockevent_register(ce);
+
+        /* User space may read the virtual counter, but not touch timers */
+        MSR("CNTKCTL_EL1", CNTKCTL_EL0VCTEN);
+        isb();
+
+        /* PPIs are banked, this only affects the calling CPU */
+        irq_register(intid, generic_timer_handle_irq, 0);
+        gic_irq_set_priority(intid, GIC_PRIO_HIGHEST);
+        gic_irq_enable(intid);
+}
+
+void generic_timer_handle_irq(uint32_t intid, void *data)
+{
+        uint64_t ctl;
+
+        (void) intid;
+        (void) data;
+
+        MRS("CNTV_CTL_EL0", ctl);
+
+        if (!(ctl & CNTV_CTL_ISTATUS)) {
+                return; /* Cancelled after it was signalled */
+        }
+
+        clockevent_interrupt();
+}
@@ -0,0 +1,76 @@
+/*
+ * ARMv8-A Generic Timer (virtual counter & timer)
+ *
+ * Ref: developer.arm.com/documentation/102379/latest/
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef GENERIC_TIMER_H
+#define GENERIC_TIMER_H
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#define CNTVCT_BITS 56 /* Minimum width guaranteed by the architecture */
+
+/* CNTV_CTL_EL0 */
+#define CNTV_CTL_ENABLE         (1U << 0)
+#define CNTV_CTL_IMASK          (1U << 1)
+#define CNTV_CTL_ISTATUS        (1U << 2)
+
+/* CNTKCTL_EL1 */
+#define CNTKCTL_EL0PCTEN        (1U << 0) /* EL0 reads CNTPCT_EL0 */
+#define CNTKCTL_EL0VCTEN        (1U << 1) /* EL0 reads CNTVCT_EL0 */
+#define CNTKCTL_EL0VTEN         (1U << 8) /* EL0 accesses CNTV_* */
+#define CNTKCTL_EL0PTEN         (1U << 9) /* EL0 accesses CNTP_* */
+
+/* EL1 virtual timer, PPI 11. Fixed by the QEMU virt & SBSA platforms */
+#define ARCH_TIMER_VIRT_INTID   27
+
+static inline uint64_t cntfrq_read(void)
+{
+        uint64_t freq;
+
+        MRS("CNTFRQ_EL0", freq);
+
+        return freq;
+}
+
+/*
+ * Raw virtual counter. May be read speculatively ahead of earlier
+ * instructions, which is fine for timestamps (e.g. TRACE()).
+ */
+static inline uint64_t cntvct_read(void)
+{
+        uint64_t cycles;
+
+        MRS("CNTVCT_EL0", cycles);
+
+        return cycles;
+}
+
+/* Same, but not before preceding instructions complete (benchmarks) */
+static inline uint64_t cntvct_read_ordered(void)
+{
+        isb();
+
+        return cntvct_read();
+}
+
+/* Registers CNTVCT_EL0 as the system clocksource */
+void generic_timer_init(void);
+
+/*
+ * Per-CPU setup, needs the interrupt controller to be ready:
+ *   - registers the EL1 virtual timer (CNTV) as the CPU's clockevent
+ *   - lets EL0 read CNTVCT_EL0 (for the time page), nothing else
+ *   - unmasks the timer interrupt
+ */
+void generic_timer_cpu_init(uint32_t intid);
+void generic_timer_handle_irq(uint32_t intid, void *data);
+
+#endif /* GENERIC_TIMER_H */
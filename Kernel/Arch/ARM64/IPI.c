@@ -0,0 +1,142 @@
+/*
+ * Inter-processor interrupts & cross-calls, see IPI.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Exception.h"
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+
+#include "LibKern/Console.h"
+
+#include "Drivers/GIC.h"
+
+enum ipi_slot_state {
+        SLOT_FREE,
+        SLOT_POSTED,
+        SLOT_RUNNING
+};
+
+typedef struct ipi_slot {
+        smp_fn fn;
+        void *arg;
+        uint32_t state;
+} __attribute__((aligned(64))) ipi_slot; /* Owned by 2 CPUs, no more */
+
+/* [caller][target] */
+static ipi_slot slots[MAX_CPUS][MAX_CPUS];
+
+/* Runs the calls posted to 'cpu'. Claimed first: the IRQ & a waiter race */
+static void _run_calls(uint32_t cpu)
+{
+        uint8_t ran = 0;
+
+        for (uint32_t from = 0; from < MAX_CPUS; from++) {
+                ipi_slot *slot = &slots[from][cpu];
+                uint32_t posted = SLOT_POSTED;
+
+                if (!__atomic_compare_exchange_n(&slot->state, &posted,
+                        SLOT_RUNNING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                        continue;
+                }
+
+                slot->fn(slot->arg);
+
+                __atomic_store_n(&slot->state, SLOT_FREE, __ATOMIC_RELEASE);
+                ran = 1;
+        }
+
+        if (ran) {
+                dsb_ish();
+                sev(); /* Waiting callers */
+        }
+}
+
+static void _ipi_call(uint32_t intid, void *data)
+{
+        (void) intid;
+        (void) data;
+
+        _run_calls(cpu_id());
+}
+
+static void _ipi_resched(uint32_t intid, void *data)
+{
+        (void) intid;
+        (void) data;
+
+        /* A wakeup queued onto us: preempt, or start the slice timer */
+        set_need_resched();
+}
+
+/* Meanwhile serves the calls to us, the target may be waiting for those */
+static void _slot_wait(uint32_t self, ipi_slot *slot)
+{
+        while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != SLOT_FREE) {
+                uint64_t flags = irq_save();
+
+                _run_calls(self);
+                irq_restore(flags);
+
+                wfe();
+        }
+}
+
+void ipi_init(void)
+{
+        if (irq_register(IPI_CALL, _ipi_call, 0) ||
+                irq_register(IPI_RESCHED, _ipi_resched, 0)) {
+                KLOG_ERR(KLOG_ARCH, "[ipi] SGIs already taken!\n");
+        }
+}
+
+void ipi_send(cpumask mask, uint32_t ipi)
+{
+        gic_send_sgi(ipi, mask);
+}
+
+uint8_t smp_call_mask(cpumask mask, smp_fn fn, void *arg, uint8_t wait)
+{
+        if (!fn) {
+                return 1;
+        }
+
+        uint32_t self = cpu_id();
+        cpumask online = smp_online_mask();
+        cpumask targets = mask & online & ~CPUMASK_OF(self);
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                if (!(targets & CPUMASK_OF(cpu))) {
+                        continue;
+                }
+
+                ipi_slot *slot = &slots[self][cpu];
+
+                /* Our previous call to 'cpu' (no 'wait') may still be there */
+                _slot_wait(self, slot);
+
+                slot->fn = fn;
+                slot->arg = arg;
+                __atomic_store_n(&slot->state, SLOT_POSTED, __ATOMIC_RELEASE);
+        }
+
+        if (targets) {
+                ipi_send(targets, IPI_CALL);
+        }
+
+        if (mask & CPUMASK_OF(self)) {
+                fn(arg);
+        }
+
+        for (uint32_t cpu = 0; wait && cpu < MAX_CPUS; cpu++) {
+                if (targets & CPUMASK_OF(cpu)) {
+                        _slot_wait(self, &slots[self][cpu]);
+                }
+        }
+
+        return (mask & ~online) != 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Inter-processor interrupts & cross-calls
+ *
+ * IPIs are GIC SGIs 0-15, sent to a cpumask (SMP.h) with one GIC write.
+ *
+ *      IPI_CALL:       run the posted cross-calls (smp_call_mask())
+ *      IPI_RESCHED:    kick a CPU out of WFE/WFI to look at its run queue
+ *
+ * A cross-call is posted in a slot per (caller, target) pair, so callers
+ * never contend with each other and one IPI carries every call posted to a
+ * CPU so far. The target frees the slot after running the function, which
+ * is what 'wait' waits for.
+ *
+ * Calls run on the target with IRQs masked, in IRQ context: no sleeping.
+ * A caller waiting for its targets (or for a busy slot) keeps running the
+ * calls posted to itself, so two CPUs calling each other with IRQs masked
+ * don't deadlock.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef IPI_H
+#define IPI_H
+
+#include <stdint.h>
+
+#include "ARM64/SMP.h"
+
+/* SGI INTIDs. KBENCH_SGI (15) is the benchmarks' */
+#define IPI_CALL        0
+#define IPI_RESCHED     1
+
+/* Boot CPU, after the GIC. SGIs are banked: gic_cpu_init() enables them */
+void    ipi_init(void);
+
+void    ipi_send(cpumask mask, uint32_t ipi);
+
+/*
+ * Run 'fn(arg)' on every online CPU in 'mask', inline for the calling one.
+ * With 'wait', returns after all of them did. Returns !0 if 'mask' holds
+ * CPUs that aren't online, which are skipped.
+ */
+uint8_t smp_call_mask(cpumask mask, smp_fn fn, void *arg, uint8_t wait);
+
+static inline uint8_t smp_call(uint32_t cpu, smp_fn fn, void *arg,
+                               uint8_t wait)
+{
+        return (cpu < 32) ? smp_call_mask(CPUMASK_OF(cpu), fn, arg, wait) : 1;
+}
+
+#endif /* IPI_H */
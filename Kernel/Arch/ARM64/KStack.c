@@ -0,0 +1,134 @@
+/*
+ * Per-CPU exception stacks, see KStack.h
+ *
+ * The backing memory is plain kernel .bss, the window only adds a second
+ * (page granular) mapping of it with holes for the guards. The 1 GiB block
+ * mapping the kernel itself can't have holes, so the stacks are never
+ * used through their .bss address.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/KStack.h"
+#include "ARM64/Machine.h"
+#include "ARM64/Memory.h"
+
+#include "LibKern/Console.h"
+
+_Static_assert(KSTACK_CPUS == MAX_CPUS, "one IRQ stack per CPU");
+_Static_assert(3 * KSTACK_CPUS * KSTACK_SLOT_SIZE <= ARM_TT_L2_SIZE,
+        "window must fit a single L3 table");
+
+#define SLOT_BASE(slot) (KSTACK_WINDOW + (uint64_t) (slot) * KSTACK_SLOT_SIZE)
+
+/* in Kernel/Arch/ARM64/Start.c */
+extern uint64_t k_l0_pgtbl[ENTRY_SIZE];
+
+static uint8_t irq_stacks[KSTACK_CPUS][KSTACK_SIZE]
+        __attribute__((aligned(GRANULE_SIZE)));
+static uint8_t ovf_stacks[KSTACK_CPUS][KSTACK_OVF_SIZE]
+        __attribute__((aligned(GRANULE_SIZE)));
+static uint8_t boot_stacks[KSTACK_CPUS][KSTACK_SIZE]
+        __attribute__((aligned(GRANULE_SIZE)));
+
+static uint64_t kstack_l1[ENTRY_SIZE] __attribute__((aligned(GRANULE_SIZE)));
+static uint64_t kstack_l2[ENTRY_SIZE] __attribute__((aligned(GRANULE_SIZE)));
+static uint64_t kstack_l3[ENTRY_SIZE] __attribute__((aligned(GRANULE_SIZE)));
+
+static uint64_t _table(const uint64_t *next)
+{
+        uint64_t tbl = 0;
+
+        tbl = ENTRY_VALID(tbl);
+        tbl = ENTRY_TABLE(tbl);
+
+        tbl = TBL_SET_NEXT(tbl, KVA_TO_PA(next));
+
+        tbl = TBL_SET_PXN(tbl, 0);
+        tbl = TBL_SET_XN(tbl, 0);
+        tbl = TBL_SET_AP(tbl, 0);
+        tbl = TBL_SET_NS(tbl, 0);
+
+        return tbl;
+}
+
+/* Map [top - size, top) of the window onto 'mem' */
+static void _map_stack(uint64_t top, const uint8_t *mem, uint64_t size)
+{
+        for (uint64_t off = 0; off < size; off += GRANULE_SIZE) {
+                uint64_t va = top - size + off;
+                uint64_t pg = 0;
+
+                pg = ENTRY_VALID(pg);
+                pg = ENTRY_PAGE(pg);
+
+                pg = BLK_SET_AIDX(pg, NORMAL_IDX);
+                pg = BLK_SET_NS(pg, 0);
+                pg = BLK_SET_AP(pg, AP_PRIV_RW);
+                pg = BLK_SET_SH(pg, SH_OUTER);
+                pg = BLK_SET_AF(pg, 1);
+                pg = BLK_SET_NG(pg, 0);
+
+                pg = PAGE_SET_OA(pg, KVA_TO_PA(mem + off));
+
+                pg = BLK_SET_PXN(pg, 1);
+                pg = BLK_SET_XN(pg, 1);
+
+                kstack_l3[L3_TABLE_INDEX(va)] = pg;
+        }
+}
+
+void kstack_init(void)
+{
+        for (int i = 0; i < ENTRY_SIZE; i++) {
+                kstack_l1[i] = 0x0ULL;
+                kstack_l2[i] = 0x0ULL;
+                kstack_l3[i] = 0x0ULL;
+        }
+
+        for (uint32_t cpu = 0; cpu < KSTACK_CPUS; cpu++) {
+                _map_stack(kstack_irq_top(cpu), irq_stacks[cpu],
+                        KSTACK_SIZE);
+                _map_stack(SLOT_BASE(KSTACK_OVF_SLOT + cpu + 1),
+                        ovf_stacks[cpu], KSTACK_OVF_SIZE);
+                _map_stack(kstack_boot_top(cpu), boot_stacks[cpu],
+                        KSTACK_SIZE);
+        }
+
+        kstack_l2[L2_TABLE_INDEX(KSTACK_WINDOW)] = _table(kstack_l3);
+        kstack_l1[L1_TABLE_INDEX(KSTACK_WINDOW)] = _table(kstack_l2);
+
+        /* Tables must be visible to the walker before they are linked */
+        dsb_ishst();
+
+        k_l0_pgtbl[L0_TABLE_INDEX(KSTACK_WINDOW)] = _table(kstack_l1);
+
+        /* Invalid -> valid, nothing to invalidate in the TLBs */
+        dsb_ish();
+        isb();
+
+        KLOG_INFO(KLOG_ARCH, "[kstack] %u IRQ stacks of %u KiB @ 0x%lx\n",
+                KSTACK_CPUS, KSTACK_SIZE / 1024, (uint64_t) KSTACK_WINDOW);
+}
+
+uint64_t kstack_irq_top(uint32_t cpu)
+{
+        return SLOT_BASE(KSTACK_IRQ_SLOT + cpu + 1);
+}
+
+uint64_t kstack_irq_base(uint32_t cpu)
+{
+        return kstack_irq_top(cpu) - KSTACK_SIZE;
+}
+
+uint64_t kstack_boot_top(uint32_t cpu)
+{
+        return SLOT_BASE(KSTACK_BOOT_SLOT + cpu + 1);
+}
+
+uint64_t kstack_boot_top_pa(uint32_t cpu)
+{
+        return KVA_TO_PA(boot_stacks[cpu] + KSTACK_SIZE);
+}
@@ -0,0 +1,67 @@
+/*
+ * Per-CPU exception stacks
+ *
+ * IRQ handlers don't run on the interrupted thread's kernel stack: the
+ * IRQ path (Vector.S) leaves its frame there and calls the handler on the
+ * CPU's own IRQ stack. Nested IRQs (see gic_handle_irq()) stay on it. A
+ * thread's kernel stack only has to fit its syscalls plus one frame.
+ *
+ * The stacks live in their own TTBR1 window, mapped with 4 KiB pages:
+ *
+ *      KSTACK_WINDOW + n * KSTACK_SLOT_SIZE
+ *      +---------------------+---------------------+
+ *      | guard (unmapped)    | stack               | slot n
+ *      +---------------------+---------------------+
+ *      0                  KSTACK_SIZE       KSTACK_SLOT_SIZE
+ *
+ *      slot [0, KSTACK_CPUS):                   IRQ stacks
+ *      slot [KSTACK_CPUS, 2 * KSTACK_CPUS):     overflow stacks (top page)
+ *      slot [2 * KSTACK_CPUS, 3 * KSTACK_CPUS): secondary CPU boot stacks
+ *
+ * So a valid SP in the window has bit KSTACK_SHIFT set, one that ran into
+ * a guard page has it clear. The EL1 sync vector checks exactly that and
+ * moves to the overflow stack instead of faulting on the guard forever.
+ *
+ * Also included from Vector.S.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef KSTACK_H
+#define KSTACK_H
+
+#define KSTACK_CPUS             8       /* == MAX_CPUS, power of 2 */
+
+#define KSTACK_WINDOW           0xFFFF800000000000 /* k_l0_pgtbl[256] */
+#define KSTACK_WINDOW_BIT       47      /* Set only for window addresses */
+
+#define KSTACK_SHIFT            14
+#define KSTACK_SIZE             (1 << KSTACK_SHIFT)     /* 16 KiB */
+#define KSTACK_SLOT_SHIFT       (KSTACK_SHIFT + 1)
+#define KSTACK_SLOT_SIZE        (1 << KSTACK_SLOT_SHIFT)
+
+#define KSTACK_IRQ_SLOT         0
+#define KSTACK_OVF_SLOT         KSTACK_CPUS
+#define KSTACK_OVF_SIZE         4096
+#define KSTACK_BOOT_SLOT        (2 * KSTACK_CPUS)
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+/* Maps the window, before any IRQ is enabled at the GIC */
+void kstack_init(void);
+
+/* [base, top) of 'cpu's IRQ stack */
+uint64_t kstack_irq_top(uint32_t cpu);
+uint64_t kstack_irq_base(uint32_t cpu);
+
+/* Top of 'cpu's boot stack: window address & its physical one (MMU off) */
+uint64_t kstack_boot_top(uint32_t cpu);
+uint64_t kstack_boot_top_pa(uint32_t cpu);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* KSTACK_H */
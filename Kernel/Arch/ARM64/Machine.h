@@ -8,13 +8,47 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #define GET_PARange(ID_AA64MMFR0_EL1) (((ID_AA64MMFR0_EL1) >> 0) & 0b1111)
 
+#define MAX_CPUS 8 /* Upper bound for statically sized per-CPU arrays */
+
+/* Linear CPU number. QEMU virt numbers its cores via MPIDR_EL1.Aff0 */
+static inline uint32_t cpu_id(void)
+{
+    uint64_t mpidr;
+
+    asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+
+    return (uint32_t) (mpidr & 0xFF) % MAX_CPUS;
+}
+
+/* MPIDR_EL1 affinity as Aff3.Aff2.Aff1.Aff0 (GICv3 routing layout) */
+static inline uint32_t cpu_affinity(void)
+{
+    uint64_t mpidr;
+
+    asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+
+    return (uint32_t) ((mpidr & 0xFFFFFF) | ((mpidr >> 8) & 0xFF000000));
+}
+
 static inline void wfi(void)
 {
     asm volatile("wfi" ::: "memory");
 }
 
+static inline void wfe(void)
+{
+    asm volatile("wfe" ::: "memory");
+}
+
+static inline void sev(void)
+{
+    asm volatile("sev" ::: "memory");
+}
+
 static inline void dsb_sy(void)
 {
     asm volatile("dsb sy" ::: "memory");
@@ -30,6 +64,11 @@ static inline void dsb_ishst(void)
     asm volatile("dsb ishst" ::: "memory");
 }
 
+static inline void dsb_nsh(void)
+{
+    asm volatile("dsb nsh" ::: "memory");
+}
+
 static inline void dmb(void)
 {
     asm volatile("dmb sy" ::: "memory");
@@ -90,6 +129,62 @@ static inline void fiq_disable(void)
 	asm volatile("msr daifset, #1" ::: "memory");
 }
 
+/*
+ * Save / restore the DAIF state around IRQ-sensitive sections
+ *
+ * irq_save() masks IRQs and returns the previous DAIF value, which must be
+ * handed back to irq_restore(). Nesting is fine as long as the pairs match.
+ */
+static inline uint64_t irq_save(void)
+{
+	uint64_t flags;
+
+	asm volatile("mrs %0, daif\n\tmsr daifset, #2"
+		: "=r" (flags) :: "memory");
+
+	return flags;
+}
+
+static inline void irq_restore(uint64_t flags)
+{
+	asm volatile("msr daif, %0" :: "r" (flags) : "memory");
+}
+
+static inline int irqs_disabled(void)
+{
+	uint64_t flags;
+
+	asm volatile("mrs %0, daif" : "=r" (flags));
+
+	return (flags & (1ULL << 7)) != 0; /* DAIF.I */
+}
+
+/*
+ * Memory-mapped I/O accessors
+ *
+ * Plain volatile accesses. Ordering against normal memory (e.g. DMA buffers)
+ * is the caller's job, use dmb()/dsb_sy() where needed.
+ */
+static inline uint32_t mmio_read32(uint64_t addr)
+{
+    return *(volatile uint32_t*) addr;
+}
+
+static inline void mmio_write32(uint64_t addr, uint32_t val)
+{
+    *(volatile uint32_t*) addr = val;
+}
+
+static inline uint64_t mmio_read64(uint64_t addr)
+{
+    return *(volatile uint64_t*) addr;
+}
+
+static inline void mmio_write64(uint64_t addr, uint64_t val)
+{
+    *(volatile uint64_t*) addr = val;
+}
+
 #define MRS(reg, v)  asm volatile("mrs %x0," reg : "=r"(v))
 #define MSR(reg, v)                                 \
     do {                                            \
@@ -112,3 +207,41 @@ static inline void tlbi_vmalle1()
 {
     asm("TLBI VMALLE1" ::: "memory");
 }
+
+static inline void tlbi_vmalle1is()
+{
+    asm("TLBI VMALLE1IS" ::: "memory");
+}
+
+/*
+ * By VA / ASID. The operand is TLBI_OP(asid, va): ASID in [63:48],
+ * VA[55:12] in [43:0]. '...IS' variants reach every Inner Shareable CPU.
+ */
+#define TLBI_OP(asid, va) \
+    (((uint64_t) (asid) << 48) | (((uint64_t) (va) >> 12) & 0xFFFFFFFFFFFULL))
+
+static inline void tlbi_vae1(uint64_t op)
+{
+    asm("TLBI VAE1, %0" :: "r" (op) : "memory");
+}
+
+static inline void tlbi_vae1is(uint64_t op)
+{
+    asm("TLBI VAE1IS, %0" :: "r" (op) : "memory");
+}
+
+/* Any ASID, for global (nG = 0) entries */
+static inline void tlbi_vaae1is(uint64_t op)
+{
+    asm("TLBI VAAE1IS, %0" :: "r" (op) : "memory");
+}
+
+static inline void tlbi_aside1(uint64_t op)
+{
+    asm("TLBI ASIDE1, %0" :: "r" (op) : "memory");
+}
+
+static inline void tlbi_aside1is(uint64_t op)
+{
+    asm("TLBI ASIDE1IS, %0" :: "r" (op) : "memory");
+}
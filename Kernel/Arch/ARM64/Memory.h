@@ -17,6 +17,10 @@
 #define GRANULE_SIZE 4096 /* bytes */
 #define ENTRY_SIZE 512
 
+/* Kernel/kernel.ld: VMA = ARM64_TTBR1_BASE + LMA */
+#define KERNEL_VA_OFFSET 0xFFFF000000000000ULL
+#define KVA_TO_PA(va) ((uint64_t) (va) - KERNEL_VA_OFFSET)
+
 /*
  * 4KB granule size:
  *
@@ -159,6 +163,10 @@
 #define ARM_TB_L2_OA_WIDTH       27ULL
 #define ARM_TB_L2_OA_MASK        0x0000FFFFFFE00000ULL
 
+#define ARM_TP_OA_SHIFT         12ULL
+#define ARM_TP_OA_WIDTH         36ULL
+#define ARM_TP_OA_MASK          0x0000FFFFFFFFF000ULL
+
 #define ARM_TB_HINT_SHIFT       52ULL
 #define ARM_TB_HINT_WIDTH       1ULL
 #define ARM_TB_HINT_MASK        0x0010000000000000ULL
@@ -199,7 +207,7 @@
 
 #define ENTRY_TABLE(entry) ((entry) | ARM_TE_TYPE_MASK)
 #define ENTRY_BLOCK(entry) ((entry) & ~ARM_TE_TYPE_MASK)
-#define ENTRY_PAGE(entry) TYPE_BLOCK(entry)
+#define ENTRY_PAGE(entry) ENTRY_TABLE(entry) /* L3: same type bit as tables */
 
 /* Table */
 #define TBL_SET_NEXT(tbl, next) \
@@ -243,6 +251,9 @@
 #define BLK_SET_L2_OA(blk, next) \
         (((uint64_t)(blk) & ~ARM_TB_L2_OA_MASK) | \
                 ((uint64_t)(next)))
+#define PAGE_SET_OA(pg, next) \
+        (((uint64_t)(pg) & ~ARM_TP_OA_MASK) | \
+                ((uint64_t)(next)))
 #define BLK_SET_HINT(blk, hint) \
         (((uint64_t)(blk) & ~ARM_TB_HINT_MASK) | \
                 (((uint64_t)(hint) << ARM_TB_HINT_SHIFT)))
@@ -0,0 +1,56 @@
+/*
+ * ARMv8-A PMU cycle counter (PMCCNTR_EL0)
+ *
+ * Only what the in-kernel benchmarks need: enable & read the cycle
+ * counter. No event counters, no overflow interrupts.
+ *
+ * Ref: ARM DDI 0487, D11 "The Performance Monitors Extension"
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#define PMCR_E                  (1U << 0)  /* Enable */
+#define PMCR_C                  (1U << 2)  /* Cycle counter reset */
+#define PMCR_LC                 (1U << 6)  /* 64-bit cycle counter */
+#define PMCNTEN_C               (1U << 31) /* PMCNTENSET_EL0.C */
+
+#define ID_AA64DFR0_PMUVER(dfr) (((dfr) >> 8) & 0xF)
+
+/* PMUVer 0: not implemented, 0xF: IMPLEMENTATION DEFINED (not PMUv3) */
+static inline uint8_t pmu_present(void)
+{
+        uint64_t dfr;
+
+        MRS("ID_AA64DFR0_EL1", dfr);
+
+        return ID_AA64DFR0_PMUVER(dfr) != 0 && ID_AA64DFR0_PMUVER(dfr) != 0xF;
+}
+
+static inline void pmu_cycles_enable(void)
+{
+        MSR("PMCR_EL0", PMCR_E | PMCR_C | PMCR_LC);
+        MSR("PMCNTENSET_EL0", PMCNTEN_C);
+        isb();
+}
+
+/* Not before preceding instructions complete */
+static inline uint64_t pmccntr_read(void)
+{
+        uint64_t cycles;
+
+        isb();
+        MRS("PMCCNTR_EL0", cycles);
+
+        return cycles;
+}
+
+#endif /* PMU_H */
@@ -0,0 +1,122 @@
+/*
+ * Power State Coordination Interface (PSCI) client
+ *
+ * SMC Calling Convention: function ID in w0, arguments in x1-x3, result
+ * in x0. x0-x17 may be clobbered by the callee (SMCCC v1.0).
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/PSCI.h"
+
+#include "LibKern/Console.h"
+#include "LibKern/DeviceTree.h"
+#include "LibKern/String.h"
+
+#define SMCCC_CLOBBERS "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", \
+        "x12", "x13", "x14", "x15", "x16", "x17", "memory"
+
+static uint8_t use_smc = 0;
+static uint8_t present = 0;
+static uint32_t fid_cpu_on = PSCI_CPU_ON_64;
+static uint32_t fid_cpu_off = PSCI_CPU_OFF;
+
+static uint64_t _hvc(uint64_t fid, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+        register uint64_t x0 asm("x0") = fid;
+        register uint64_t x1 asm("x1") = a1;
+        register uint64_t x2 asm("x2") = a2;
+        register uint64_t x3 asm("x3") = a3;
+
+        asm volatile("hvc #0"
+                : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3)
+                :
+                : SMCCC_CLOBBERS);
+
+        return x0;
+}
+
+static uint64_t _smc(uint64_t fid, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+        register uint64_t x0 asm("x0") = fid;
+        register uint64_t x1 asm("x1") = a1;
+        register uint64_t x2 asm("x2") = a2;
+        register uint64_t x3 asm("x3") = a3;
+
+        asm volatile("smc #0"
+                : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3)
+                :
+                : SMCCC_CLOBBERS);
+
+        return x0;
+}
+
+static uint64_t _call(uint64_t fid, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+        if (!present) {
+                return (uint64_t) PSCI_NOT_SUPPORTED;
+        }
+
+        return use_smc ? _smc(fid, a1, a2, a3) : _hvc(fid, a1, a2, a3);
+}
+
+/* Single cell function ID property, e.g. "cpu_on = <0xc4000003>" */
+static void _fid(void *dtb, const char *compat, const char *name,
+                 uint32_t *fid)
+{
+        const void *data;
+        uint32_t len;
+
+        if (!dtb_find_prop(dtb, compat, name, &data, &len) && len == 4) {
+                *fid = __builtin_bswap32(*(const uint32_t*) data);
+        }
+}
+
+uint8_t psci_init(void *dtb)
+{
+        const char *compat = "arm,psci-0.2";
+        const void *method;
+        uint32_t len;
+
+        if (dtb_find_prop(dtb, compat, "method", &method, &len)) {
+                /* PSCI 0.1: IDs are whatever the DTB says */
+                compat = "arm,psci";
+
+                if (dtb_find_prop(dtb, compat, "method", &method, &len)) {
+                        KLOG_WARN(KLOG_ARCH, "[psci] not in DTB\n");
+                        return 1;
+                }
+
+                _fid(dtb, compat, "cpu_on", &fid_cpu_on);
+                _fid(dtb, compat, "cpu_off", &fid_cpu_off);
+        }
+
+        use_smc = !strncmp((const char*) method, "smc", len);
+        present = 1;
+
+        /* PSCI_VERSION came with 0.2 */
+        uint32_t ver = compat[8] ? psci_version() : 0x1;
+
+        KLOG_INFO(KLOG_ARCH, "[psci] v%u.%u via %s\n",
+                PSCI_VERSION_MAJOR(ver), PSCI_VERSION_MINOR(ver),
+                use_smc ? "SMC" : "HVC");
+
+        return 0;
+}
+
+uint32_t psci_version(void)
+{
+        return (uint32_t) _call(PSCI_VERSION, 0, 0, 0);
+}
+
+int32_t psci_cpu_on(uint64_t mpidr, uint64_t entry, uint64_t context)
+{
+        return (int32_t) _call(fid_cpu_on, mpidr, entry, context);
+}
+
+int32_t psci_cpu_off(void)
+{
+        return (int32_t) _call(fid_cpu_off, 0, 0, 0);
+}
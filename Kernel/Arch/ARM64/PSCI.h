@@ -0,0 +1,51 @@
+/*
+ * Power State Coordination Interface (PSCI) client
+ *
+ * Only what SMP bring-up needs. The conduit (HVC or SMC) comes from the
+ * DTB's psci node ("method"), like the CPU_ON function ID does for
+ * pre-0.2 firmware. PSCI 0.2+ IDs are fixed by the spec.
+ *
+ * Reference: ARM DEN 0022D (Power State Coordination Interface)
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef PSCI_H
+#define PSCI_H
+
+#include <stdint.h>
+
+#define PSCI_VERSION            0x84000000U
+#define PSCI_CPU_OFF            0x84000002U
+#define PSCI_CPU_ON_64          0xC4000003U
+#define PSCI_AFFINITY_INFO_64   0xC4000004U
+
+/* Return codes */
+#define PSCI_SUCCESS            0
+#define PSCI_NOT_SUPPORTED      -1
+#define PSCI_INVALID_PARAMS     -2
+#define PSCI_DENIED             -3
+#define PSCI_ALREADY_ON         -4
+#define PSCI_ON_PENDING         -5
+#define PSCI_INTERNAL_FAILURE   -6
+
+#define PSCI_VERSION_MAJOR(v)   ((v) >> 16)
+#define PSCI_VERSION_MINOR(v)   ((v) & 0xFFFF)
+
+/* Reads the psci node. Returns !0 if there's none (no SMP then) */
+uint8_t psci_init(void *dtb);
+
+uint32_t psci_version(void);
+
+/*
+ * Power 'mpidr' on at the physical address 'entry', MMU off, with
+ * x0 = 'context'. Returns a PSCI_* code.
+ */
+int32_t psci_cpu_on(uint64_t mpidr, uint64_t entry, uint64_t context);
+
+/* Calling CPU only, doesn't return on success */
+int32_t psci_cpu_off(void);
+
+#endif /* PSCI_H */
@@ -0,0 +1,199 @@
+/*
+ * Secondary CPU bring-up & per-CPU data, see SMP.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Exception.h"
+#include "ARM64/Machine.h"
+#include "ARM64/Memory.h"
+#include "ARM64/FPSIMD.h"
+#include "ARM64/GenericTimer.h"
+#include "ARM64/KStack.h"
+#include "ARM64/PSCI.h"
+#include "ARM64/SMP.h"
+
+#include "Boot.h"
+
+#include "LibKern/Console.h"
+#include "LibKern/DeviceTree.h"
+#include "LibKern/RCU.h"
+#include "LibKern/Time.h"
+#include "LibKern/Timer.h"
+
+#include "Drivers/GIC.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+#define SMP_ONLINE_TIMEOUT_NS   (100 * 1000 * 1000) /* 100 ms */
+
+/* in Kernel/Arch/ARM64/Entry.S, physical address (shim) */
+extern uint8_t _secondary_entry[];
+
+static percpu cpus[MAX_CPUS];
+static boot_cpuinfo boot_info[MAX_CPUS];
+static volatile uint32_t nr_online = 1;
+static cpumask online_mask = 0;
+
+/* The CPU comes up with its caches off, push what it reads to memory */
+static void _dcache_clean(const void *addr, uint64_t size)
+{
+        uint64_t ctr;
+
+        MRS("CTR_EL0", ctr);
+
+        uint64_t line = 4ULL << ((ctr >> 16) & 0xF); /* DminLine */
+        uint64_t p = (uint64_t) addr & ~(line - 1);
+
+        for (; p < (uint64_t) addr + size; p += line) {
+                asm volatile("dc cvac, %0" :: "r" (p) : "memory");
+        }
+
+        dsb_sy();
+}
+
+void smp_boot_cpu_init(void)
+{
+        percpu *pc = &cpus[cpu_id()];
+        uint64_t mpidr;
+
+        MRS("MPIDR_EL1", mpidr);
+
+        pc->cpu = cpu_id();
+        pc->mpidr = mpidr & MPIDR_AFF_MASK;
+        pc->online = 1;
+        online_mask = CPUMASK_OF(pc->cpu);
+
+        MSR("TPIDR_EL1", (uint64_t) pc);
+}
+
+static uint8_t _cpu_up(uint64_t mpidr)
+{
+        uint32_t cpu = (uint32_t) (mpidr & 0xFF) % MAX_CPUS; /* cpu_id() */
+        percpu *pc = &cpus[cpu];
+        boot_cpuinfo *info = &boot_info[cpu];
+
+        if (pc->online) {
+                KLOG_WARN(KLOG_ARCH, "[smp] cpu%u: MPIDR 0x%lx collides\n",
+                        cpu, mpidr);
+                return 1;
+        }
+
+        pc->cpu = cpu;
+        pc->mpidr = mpidr;
+
+        info->stack_pa = kstack_boot_top_pa(cpu);
+        info->stack_va = kstack_boot_top(cpu);
+        info->entry = (uint64_t) smp_secondary_main;
+        info->arg = (uint64_t) pc;
+
+        _dcache_clean(info, sizeof(*info));
+
+        int32_t ret = psci_cpu_on(mpidr, (uint64_t) _secondary_entry,
+                KVA_TO_PA(info));
+
+        if (ret != PSCI_SUCCESS) {
+                KLOG_WARN(KLOG_ARCH, "[smp] cpu%u: CPU_ON failed: %d\n",
+                        cpu, ret);
+                return 1;
+        }
+
+        uint64_t deadline = arm64_uptime() + SMP_ONLINE_TIMEOUT_NS;
+
+        while (!__atomic_load_n(&pc->online, __ATOMIC_ACQUIRE)) {
+                if (deadline < arm64_uptime()) {
+                        KLOG_WARN(KLOG_ARCH, "[smp] cpu%u: timed out\n", cpu);
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+void smp_init(void *dtb)
+{
+        uint64_t mpidr[MAX_CPUS];
+        uint32_t count = dtb_cpus(dtb, mpidr, MAX_CPUS);
+
+        if (MAX_CPUS < count) {
+                KLOG_WARN(KLOG_ARCH, "[smp] %u CPUs, using %u\n",
+                        count, MAX_CPUS);
+                count = MAX_CPUS;
+        }
+
+        if (count <= 1 || psci_init(dtb)) {
+                KLOG_INFO(KLOG_ARCH, "[smp] Uniprocessor\n");
+                return;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                if ((mpidr[i] & MPIDR_AFF_MASK) == this_cpu()->mpidr) {
+                        continue;
+                }
+
+                if (_cpu_up(mpidr[i]) == 0) {
+                        nr_online++;
+                }
+        }
+
+        KLOG_INFO(KLOG_ARCH, "[smp] %u/%u CPUs online\n", nr_online, count);
+}
+
+/* Cross-calls & everything else come in as IRQs */
+void smp_idle(void)
+{
+        for (;;) {
+                /* A wakeup from this CPU, before it got here */
+                if (need_resched()) {
+                        schedule();
+                        continue;
+                }
+
+                /* Not holding up RCU while asleep */
+                rcu_idle_begin();
+                wfe(); /* An IRQ, or a 'sev' (RCU callbacks to run) */
+                rcu_idle_end();
+        }
+}
+
+void smp_secondary_main(percpu *pc)
+{
+        MSR("TPIDR_EL1", (uint64_t) pc);
+
+        fpsimd_cpu_init();
+        gic_cpu_init();
+        generic_timer_cpu_init(ARCH_TIMER_VIRT_INTID);
+        timer_cpu_init();
+        rcu_cpu_init();
+        sched_cpu_init();
+        thread_cpu_init();
+
+        KLOG_INFO(KLOG_ARCH, "[smp] cpu%u: online (MPIDR 0x%lx)\n",
+                pc->cpu, pc->mpidr);
+
+        /* Takes IPIs from here on */
+        __atomic_fetch_or(&online_mask, CPUMASK_OF(pc->cpu), __ATOMIC_RELEASE);
+        __atomic_store_n(&pc->online, 1, __ATOMIC_RELEASE);
+
+        irq_enable();
+
+        smp_idle();
+}
+
+uint32_t smp_cpu_count(void)
+{
+        return nr_online;
+}
+
+cpumask smp_online_mask(void)
+{
+        return __atomic_load_n(&online_mask, __ATOMIC_ACQUIRE);
+}
+
+percpu *percpu_of(uint32_t cpu)
+{
+        return (cpu < MAX_CPUS) ? &cpus[cpu] : 0;
+}
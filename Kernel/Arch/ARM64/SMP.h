@@ -0,0 +1,69 @@
+/*
+ * Secondary CPU bring-up & per-CPU data
+ *
+ * smp_init() powers on every CPU listed in the DTB through PSCI CPU_ON.
+ * Each one gets its own boot stack (KStack.h), sets up its MMU, vectors,
+ * GIC CPU interface & timer, then idles until an IRQ or IPI (IPI.h) comes.
+ *
+ * Every CPU's percpu block is reachable through TPIDR_EL1 (this_cpu()),
+ * one 'mrs' instead of an MPIDR_EL1 lookup & an array index.
+ *
+ * NOTE: irq_save() alone only protects against this CPU. State other CPUs
+ * touch as well needs a lock (ARM64/Spinlock.h).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+#define MPIDR_AFF_MASK 0xFF00FFFFFFULL /* Aff3, Aff2, Aff1 & Aff0 */
+
+typedef void (*smp_fn)(void *arg);
+
+/* Bit per CPU number, MAX_CPUS <= 32 */
+typedef uint32_t cpumask;
+
+#define CPUMASK_OF(cpu) ((cpumask) 1U << (cpu))
+
+typedef struct percpu {
+        uint32_t cpu;           /* == cpu_id() */
+        uint32_t online;
+        uint64_t mpidr;         /* MPIDR_EL1 affinity */
+        struct thread *thread;  /* Running, see current_thread() */
+        struct addr_space *space; /* In TTBR0_EL1, 0: the boot tables */
+} __attribute__((aligned(64))) percpu; /* No false sharing */
+
+static inline percpu *this_cpu(void)
+{
+        uint64_t pc;
+
+        asm volatile("mrs %0, tpidr_el1" : "=r" (pc));
+
+        return (percpu*) pc;
+}
+
+/* Boot CPU, before anything calls this_cpu() */
+void smp_boot_cpu_init(void);
+
+/* Brings up the DTB's other CPUs. Needs the GIC & the KStack window */
+void smp_init(void *dtb);
+
+/* Secondary CPU's kernel entry (boot_cpuinfo.entry), never returns */
+void smp_secondary_main(percpu *pc);
+
+/*
+ * This CPU's idle thread: sleeps, runs what's queued when asked to. Where
+ * kmain() & smp_secondary_main() end up
+ */
+void smp_idle(void) __attribute__((noreturn));
+
+uint32_t smp_cpu_count(void); /* Online */
+cpumask  smp_online_mask(void);
+percpu  *percpu_of(uint32_t cpu);
+
+#endif /* SMP_H */
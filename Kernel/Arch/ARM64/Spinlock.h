@@ -0,0 +1,407 @@
+/*
+ * Spinlocks
+ *
+ *   spinlock:  Ticket lock. One 32-bit word, FIFO fair. The default for
+ *              short, lightly contended critical sections.
+ *   mcslock:   Queued (MCS) lock. Every waiter spins on its own mcs_node,
+ *              so a release touches one remote cache line instead of all
+ *              waiters'. For paths many CPUs hammer at once.
+ *   rwlock:    Readers-writer lock. Readers share it, a waiting writer
+ *              holds off new readers (no writer starvation).
+ *
+ * None of them is recursive, not even read_lock(). Each one has _irqsave()
+ * variants, required if the lock is ever taken from an IRQ handler.
+ *
+ * Waiting is WFE based: the waiter loads the lock word with LDAXR, which
+ * arms this CPU's exclusive monitor on its cache line. The releasing store
+ * clears the monitor and that is a wake-up event, so waiters sleep in WFE
+ * instead of hammering the line. If the store lands between the LDAXR and
+ * the WFE, the event is already pending and WFE falls through.
+ *
+ * Host builds (unit tests & benchmarks) run the same algorithms with
+ * sched_yield() in place of WFE.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if __STDC_HOSTED__
+
+#include <sched.h>
+
+static inline uint16_t __spin_load16(const uint16_t *p)
+{
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t __spin_load32(const uint32_t *p)
+{
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void *__spin_loadptr(void *const *p)
+{
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void __spin_wait(void)
+{
+        sched_yield();
+}
+
+#else
+
+#include "ARM64/Machine.h"
+
+/* Acquire loads that arm the exclusive monitor for __spin_wait() */
+static inline uint16_t __spin_load16(const uint16_t *p)
+{
+        uint32_t v;
+
+        asm volatile("ldaxrh %w0, %1" : "=r" (v) : "Q" (*p) : "memory");
+
+        return (uint16_t) v;
+}
+
+static inline uint32_t __spin_load32(const uint32_t *p)
+{
+        uint32_t v;
+
+        asm volatile("ldaxr %w0, %1" : "=r" (v) : "Q" (*p) : "memory");
+
+        return v;
+}
+
+static inline void *__spin_loadptr(void *const *p)
+{
+        void *v;
+
+        asm volatile("ldaxr %0, %1" : "=r" (v) : "Q" (*p) : "memory");
+
+        return v;
+}
+
+static inline void __spin_wait(void)
+{
+        wfe();
+}
+
+#endif /* __STDC_HOSTED__ */
+
+/*
+ * Ticket lock
+ */
+
+typedef union spinlock {
+        uint32_t val;
+        struct {
+                uint16_t owner; /* Ticket being served */
+                uint16_t next;  /* Next ticket to hand out */
+        };
+} spinlock;
+
+#define SPINLOCK_INIT { .val = 0 }
+
+#define TICKET_NEXT_ONE (1U << 16)
+
+static inline void spin_lock_init(spinlock *lock)
+{
+        __atomic_store_n(&lock->val, 0, __ATOMIC_RELAXED);
+}
+
+static inline void spin_lock(spinlock *lock)
+{
+        uint32_t old = __atomic_fetch_add(&lock->val, TICKET_NEXT_ONE,
+                __ATOMIC_ACQUIRE);
+        uint16_t ticket = (uint16_t) (old >> 16);
+
+        if ((uint16_t) old == ticket) {
+                return;
+        }
+
+        while (__spin_load16(&lock->owner) != ticket) {
+                __spin_wait();
+        }
+}
+
+static inline uint8_t spin_trylock(spinlock *lock)
+{
+        uint32_t old = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+        if ((uint16_t) old != (uint16_t) (old >> 16)) {
+                return 0;
+        }
+
+        return __atomic_compare_exchange_n(&lock->val, &old,
+                old + TICKET_NEXT_ONE, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void spin_unlock(spinlock *lock)
+{
+        /* Only the owner writes 'owner', a 16-bit store can't carry */
+        __atomic_store_n(&lock->owner, (uint16_t) (lock->owner + 1),
+                __ATOMIC_RELEASE);
+}
+
+static inline uint8_t spin_is_locked(spinlock *lock)
+{
+        uint32_t val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+        return (uint16_t) val != (uint16_t) (val >> 16);
+}
+
+/*
+ * MCS lock, 'node' is the caller's (usually on its stack) and must stay
+ * valid until the matching mcs_unlock()
+ */
+
+typedef struct mcs_node {
+        struct mcs_node *next;
+        uint32_t locked;        /* Set by our predecessor when it's our turn */
+} mcs_node;
+
+typedef struct mcslock {
+        mcs_node *tail;
+} mcslock;
+
+#define MCSLOCK_INIT { .tail = NULL }
+
+static inline void mcs_lock_init(mcslock *lock)
+{
+        __atomic_store_n(&lock->tail, NULL, __ATOMIC_RELAXED);
+}
+
+static inline void mcs_lock(mcslock *lock, mcs_node *node)
+{
+        node->next = NULL;
+        node->locked = 0;
+
+        /* Release: our successor will write to 'node' */
+        mcs_node *prev = __atomic_exchange_n(&lock->tail, node,
+                __ATOMIC_ACQ_REL);
+
+        if (!prev) {
+                return;
+        }
+
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+
+        while (!__spin_load32(&node->locked)) {
+                __spin_wait();
+        }
+}
+
+static inline uint8_t mcs_trylock(mcslock *lock, mcs_node *node)
+{
+        mcs_node *expected = NULL;
+
+        node->next = NULL;
+        node->locked = 0;
+
+        return __atomic_compare_exchange_n(&lock->tail, &expected, node, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+static inline void mcs_unlock(mcslock *lock, mcs_node *node)
+{
+        mcs_node *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+        if (!next) {
+                mcs_node *expected = node;
+
+                if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL,
+                                0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                        return;
+                }
+
+                /* A successor swapped 'tail' but hasn't linked itself yet */
+                while (!(next = (mcs_node*) __spin_loadptr(
+                                (void *const*) &node->next))) {
+                        __spin_wait();
+                }
+        }
+
+        __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Readers-writer lock: [31:2] readers, [1] writer waiting, [0] writer
+ */
+
+typedef struct rwlock {
+        uint32_t val;
+} rwlock;
+
+#define RWLOCK_INIT     { .val = 0 }
+
+#define RW_WRITER       (1U << 0)
+#define RW_WAITING      (1U << 1)
+#define RW_READER       (1U << 2)
+
+static inline void rwlock_init(rwlock *lock)
+{
+        __atomic_store_n(&lock->val, 0, __ATOMIC_RELAXED);
+}
+
+static inline void read_lock(rwlock *lock)
+{
+        for (;;) {
+                uint32_t val = __spin_load32(&lock->val);
+
+                if (val & (RW_WRITER | RW_WAITING)) {
+                        __spin_wait();
+                        continue;
+                }
+
+                if (__atomic_compare_exchange_n(&lock->val, &val,
+                                val + RW_READER, 1, __ATOMIC_ACQUIRE,
+                                __ATOMIC_RELAXED)) {
+                        return;
+                }
+        }
+}
+
+static inline uint8_t read_trylock(rwlock *lock)
+{
+        uint32_t val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+        while (!(val & (RW_WRITER | RW_WAITING))) {
+                if (__atomic_compare_exchange_n(&lock->val, &val,
+                                val + RW_READER, 1, __ATOMIC_ACQUIRE,
+                                __ATOMIC_RELAXED)) {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static inline void read_unlock(rwlock *lock)
+{
+        __atomic_fetch_sub(&lock->val, RW_READER, __ATOMIC_RELEASE);
+}
+
+static inline void write_lock(rwlock *lock)
+{
+        for (;;) {
+                uint32_t val = __spin_load32(&lock->val);
+
+                /* Free (maybe other writers waiting): take it */
+                if (!(val & ~RW_WAITING)) {
+                        if (__atomic_compare_exchange_n(&lock->val, &val,
+                                        RW_WRITER, 1, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+                                return;
+                        }
+
+                        continue;
+                }
+
+                /* Taking it cleared RW_WAITING, the other writers redo it */
+                if (!(val & RW_WAITING)) {
+                        __atomic_fetch_or(&lock->val, RW_WAITING,
+                                __ATOMIC_RELAXED);
+                        continue;
+                }
+
+                __spin_wait();
+        }
+}
+
+static inline uint8_t write_trylock(rwlock *lock)
+{
+        uint32_t val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+        while (!(val & ~RW_WAITING)) {
+                if (__atomic_compare_exchange_n(&lock->val, &val, RW_WRITER,
+                                1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static inline void write_unlock(rwlock *lock)
+{
+        /* Keep RW_WAITING, set by others meanwhile */
+        __atomic_fetch_and(&lock->val, ~RW_WRITER, __ATOMIC_RELEASE);
+}
+
+/*
+ * IRQ-saving variants, IRQs stay masked while waiting & holding
+ */
+
+#if !__STDC_HOSTED__
+
+static inline uint64_t spin_lock_irqsave(spinlock *lock)
+{
+        uint64_t flags = irq_save();
+
+        spin_lock(lock);
+
+        return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock *lock, uint64_t flags)
+{
+        spin_unlock(lock);
+        irq_restore(flags);
+}
+
+static inline uint64_t mcs_lock_irqsave(mcslock *lock, mcs_node *node)
+{
+        uint64_t flags = irq_save();
+
+        mcs_lock(lock, node);
+
+        return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcslock *lock, mcs_node *node,
+        uint64_t flags)
+{
+        mcs_unlock(lock, node);
+        irq_restore(flags);
+}
+
+static inline uint64_t read_lock_irqsave(rwlock *lock)
+{
+        uint64_t flags = irq_save();
+
+        read_lock(lock);
+
+        return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock *lock, uint64_t flags)
+{
+        read_unlock(lock);
+        irq_restore(flags);
+}
+
+static inline uint64_t write_lock_irqsave(rwlock *lock)
+{
+        uint64_t flags = irq_save();
+
+        write_lock(lock);
+
+        return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock *lock, uint64_t flags)
+{
+        write_unlock(lock);
+        irq_restore(flags);
+}
+
+#endif /* !__STDC_HOSTED__ */
+
+#endif /* SPINLOCK_H */
@@ -15,6 +15,8 @@
 #include "Boot.h"
 #include "MemoryLayout.h"
 
+#include "Drivers/PL011.h"
+
 /* in Main.c */
 extern void kmain(boot_sysinfo*);
 
@@ -65,12 +67,7 @@ void _utoa(uint64_t uval, char *buff, uint8_t base)
 
 void _puts(const char *s)
 {
-        volatile uint8_t *uart0 = (uint8_t*) PL011_BASE;
-
-        while (*s != '\0') {
-                *uart0 = *s;
-                s++;
-        }
+        pl011_puts_sync(PL011_BASE, s);
 }
 
 /* TODO: Do this properly */
@@ -286,6 +283,28 @@ void _init_sctlr(void)
         asm("ISB": : :);
 }
 
+/*
+ * Secondary CPUs (see _secondary_entry in Entry.S). The boot CPU's tables
+ * are already in place, only this CPU's registers need to be set.
+ */
+void secondary_start(void)
+{
+        MSR("VBAR_EL1", vector_table);
+        isb();
+
+        _init_tcr();
+        _init_mair();
+
+        MSR("TTBR1_EL1", ((uint64_t) k_l0_pgtbl));
+        MSR("TTBR0_EL1", ((uint64_t) u_l0_pgtbl));
+        isb();
+
+        tlbi_vmalle1();
+        dsb_ish();
+
+        _init_sctlr();
+}
+
 void start(void)
 {
         uint32_t arch = 0;
@@ -297,13 +316,14 @@ void start(void)
         /* Hard-coded device/board info */
         /* TODO: Replace this with a DTB parser */
         const char      *_cpuModel  = "Cortex A-72";
-        const uint32_t  _coreCount =  2u;
+
+        /* 8N1 @ PL011_BAUD with FIFOs enabled. Kernel takes over later */
+        pl011_hw_init(PL011_BASE, PL011_CLK_HZ, PL011_BAUD);
 
         _puts("Early boot stage\n");
         _puts("Running sanity checks\n");
 
-        /* TODO: Any better way to early print? */
-        _puts("WARN: Raw printing directly to PL011 @ 0x");
+        _puts("Polled printing to PL011 @ 0x");
         _utoa(PL011_BASE, buff, 16);
         _puts(buff);
         _puts("\n");
@@ -324,11 +344,6 @@ void start(void)
         _puts(_cpuModel);
         _puts("\n");
 
-        _puts("---- SMP: ");
-        _utoa(_coreCount, buff, 10);
-        _puts(buff);
-        _puts("\n");
-
         MRS("CNTFRQ_EL0", val64);
         val64 = val64 / 1000000; /* Hz to MHz */
 
@@ -0,0 +1,263 @@
+/*
+ * TLB shootdown, see TLB.h
+ *
+ * Skipping a CPU that doesn't run the ASID races with it switching to it:
+ * the flush marks the ASID stale everywhere, then reads 'active'; the
+ * switch sets its 'active' bit, then reads 'stale'. Sequentially
+ * consistent, at least one of them sees the other, so the CPU is either
+ * flushed by us or flushes itself.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+#include "ARM64/TLB.h"
+
+#include "Memory/PageDef.h"
+
+typedef struct tlb_cpu {
+        uint64_t stale[TLB_ASIDS / 64];
+        tlb_stats stats;
+} __attribute__((aligned(64))) tlb_cpu;
+
+static cpumask active[TLB_ASIDS];
+static tlb_cpu cpus[MAX_CPUS];
+
+void tlb_batch_init(tlb_batch *batch, uint16_t asid)
+{
+        batch->asid = asid;
+        batch->all = 0;
+        batch->nr = 0;
+        batch->pages = 0;
+}
+
+void tlb_batch_add(tlb_batch *batch, uint64_t va, uint64_t size)
+{
+        if (!size || batch->all) {
+                return;
+        }
+
+        uint64_t start = va & ~(PAGE_SIZE - 1);
+        uint64_t end = PALIGN(va + size);
+
+        for (uint32_t i = 0; i < batch->nr; i++) {
+                tlb_range *r = &batch->range[i];
+                uint64_t r_end = r->va + r->pages * PAGE_SIZE;
+
+                if (end < r->va || r_end < start) {
+                        continue;
+                }
+
+                /* Touching or overlapping: grow it */
+                start = (start < r->va) ? start : r->va;
+                end = (r_end < end) ? end : r_end;
+
+                batch->pages -= r->pages;
+                r->va = start;
+                r->pages = (end - start) / PAGE_SIZE;
+                batch->pages += r->pages;
+
+                return;
+        }
+
+        if (batch->nr == TLB_BATCH_RANGES) {
+                batch->all = 1;
+                return;
+        }
+
+        batch->range[batch->nr].va = start;
+        batch->range[batch->nr].pages = (end - start) / PAGE_SIZE;
+        batch->pages += batch->range[batch->nr].pages;
+        batch->nr++;
+}
+
+static uint8_t _whole(const tlb_batch *batch)
+{
+        return batch->all || TLB_LOCAL_PAGES < batch->pages;
+}
+
+static void _flush_local(const tlb_batch *batch)
+{
+        if (_whole(batch)) {
+                tlbi_aside1(TLBI_OP(batch->asid, 0));
+        } else {
+                for (uint32_t i = 0; i < batch->nr; i++) {
+                        const tlb_range *r = &batch->range[i];
+
+                        for (uint64_t p = 0; p < r->pages; p++) {
+                                tlbi_vae1(TLBI_OP(batch->asid,
+                                        r->va + p * PAGE_SIZE));
+                        }
+                }
+        }
+
+        dsb_nsh();
+        isb();
+}
+
+static void _flush_broadcast(const tlb_batch *batch)
+{
+        uint8_t global = batch->asid == TLB_ASID_GLOBAL;
+
+        if (_whole(batch)) {
+                if (global) {
+                        tlbi_vmalle1is();
+                } else {
+                        tlbi_aside1is(TLBI_OP(batch->asid, 0));
+                }
+        } else {
+                for (uint32_t i = 0; i < batch->nr; i++) {
+                        const tlb_range *r = &batch->range[i];
+
+                        for (uint64_t p = 0; p < r->pages; p++) {
+                                uint64_t va = r->va + p * PAGE_SIZE;
+
+                                if (global) {
+                                        tlbi_vaae1is(TLBI_OP(0, va));
+                                } else {
+                                        tlbi_vae1is(TLBI_OP(batch->asid, va));
+                                }
+                        }
+                }
+        }
+
+        dsb_ish();
+        isb();
+}
+
+/* IPI_CALL, one per batch */
+static void _ipi_flush(void *arg)
+{
+        _flush_local((const tlb_batch*) arg);
+}
+
+static void _mark_stale(uint16_t asid, uint32_t self)
+{
+        uint64_t bit = 1ULL << (asid % 64);
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                if (cpu != self) {
+                        __atomic_fetch_or(&cpus[cpu].stale[asid / 64], bit,
+                                __ATOMIC_SEQ_CST);
+                }
+        }
+
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void tlb_batch_flush(tlb_batch *batch)
+{
+        uint16_t asid = batch->asid;
+
+        if ((!batch->nr && !batch->all) ||
+                (TLB_ASIDS <= asid && asid != TLB_ASID_GLOBAL)) {
+                tlb_batch_init(batch, asid);
+                return;
+        }
+
+        /* cpu_id() & our TLB stay ours */
+        uint64_t flags = irq_save();
+        uint32_t self = cpu_id();
+        tlb_stats *stats = &cpus[self].stats;
+
+        /* Page table updates reach the table walkers first */
+        dsb_ishst();
+
+        if (asid == TLB_ASID_GLOBAL) {
+                _flush_broadcast(batch);
+                stats->broadcast++;
+                goto out;
+        }
+
+        cpumask others = __atomic_load_n(&active[asid], __ATOMIC_SEQ_CST) &
+                ~CPUMASK_OF(self);
+        uint8_t ipi = TLB_BROADCAST_PAGES < batch->pages && !_whole(batch);
+
+        /* Some CPUs get skipped, see the top */
+        if (!others || ipi) {
+                _mark_stale(asid, self);
+                others = __atomic_load_n(&active[asid], __ATOMIC_SEQ_CST) &
+                        ~CPUMASK_OF(self);
+        }
+
+        if (!others) {
+                _flush_local(batch);
+                stats->local++;
+        } else if (!ipi) {
+                _flush_broadcast(batch);
+                stats->broadcast++;
+        } else {
+                smp_call_mask(others | CPUMASK_OF(self), _ipi_flush, batch, 1);
+                stats->ipi++;
+        }
+
+out:
+        irq_restore(flags);
+        tlb_batch_init(batch, asid);
+}
+
+void tlb_flush_range(uint16_t asid, uint64_t va, uint64_t size)
+{
+        tlb_batch batch;
+
+        tlb_batch_init(&batch, asid);
+        tlb_batch_add(&batch, va, size);
+        tlb_batch_flush(&batch);
+}
+
+void tlb_asid_switch(uint16_t prev, uint16_t next)
+{
+        if (prev == next) {
+                return;
+        }
+
+        uint64_t flags = irq_save();
+        uint32_t self = cpu_id();
+
+        if (prev < TLB_ASIDS) {
+                __atomic_fetch_and(&active[prev], ~CPUMASK_OF(self),
+                        __ATOMIC_RELEASE);
+        }
+
+        if (next < TLB_ASIDS) {
+                uint64_t bit = 1ULL << (next % 64);
+
+                __atomic_fetch_or(&active[next], CPUMASK_OF(self),
+                        __ATOMIC_SEQ_CST);
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+                if (__atomic_fetch_and(&cpus[self].stale[next / 64], ~bit,
+                        __ATOMIC_SEQ_CST) & bit) {
+                        tlbi_aside1(TLBI_OP(next, 0));
+                        dsb_nsh();
+                        isb();
+                        cpus[self].stats.lazy++;
+                }
+        }
+
+        irq_restore(flags);
+}
+
+cpumask tlb_asid_active(uint16_t asid)
+{
+        return (asid < TLB_ASIDS) ?
+                __atomic_load_n(&active[asid], __ATOMIC_RELAXED) : 0;
+}
+
+tlb_stats tlb_get_stats(void)
+{
+        tlb_stats sum = { 0 };
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                sum.local += cpus[cpu].stats.local;
+                sum.broadcast += cpus[cpu].stats.broadcast;
+                sum.ipi += cpus[cpu].stats.ipi;
+                sum.lazy += cpus[cpu].stats.lazy;
+        }
+
+        return sum;
+}
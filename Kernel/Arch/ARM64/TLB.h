@@ -0,0 +1,90 @@
+/*
+ * TLB shootdown: invalidating changed translations on every CPU
+ *
+ * Three ways to get an entry out of the TLBs, cheapest first:
+ *
+ *      local:      'TLBI VAE1' + 'DSB NSH', this CPU only
+ *      broadcast:  'TLBI VAE1IS' + 'DSB ISH', every CPU in the Inner
+ *                  Shareable domain, no interrupt. But every one of them
+ *                  has to process each TLBI (a DVM message)
+ *      IPI:        the CPUs that may hold the entries flush them locally,
+ *                  a whole batch per interrupt
+ *
+ * Per ASID, 'active' is the CPUs with it in TTBR0_EL1 right now
+ * (tlb_asid_switch()). Per CPU, 'stale' is the ASIDs it skipped flushes
+ * for, flushed whole when it switches to one of them again.
+ *
+ * Ranges are batched (tlb_batch), then tlb_batch_flush() picks:
+ *
+ *      1. nobody else runs the ASID: local TLBIs, everyone else marks it
+ *         stale (lazy, no IPI)
+ *      2. up to TLB_BROADCAST_PAGES: broadcast TLBIs, no IPI
+ *      3. up to TLB_LOCAL_PAGES: one IPI_CALL to the CPUs running the ASID,
+ *         each flushes every range of the batch locally, the others mark
+ *         it stale
+ *      4. more (or overflowed): one broadcast 'TLBI ASIDE1IS'
+ *
+ * Global (kernel, nG = 0) mappings are in every CPU's TLB: always
+ * broadcast.
+ *
+ * Page table updates come first, tlb_batch_flush() orders them before the
+ * TLBIs & the 'active' lookup.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdint.h>
+
+#include "ARM64/SMP.h"
+
+#define TLB_ASIDS               256     /* 8-bit ASIDs (TCR_EL1.AS = 0) */
+#define TLB_ASID_NONE           0xFFFF  /* tlb_asid_switch(): no user space */
+#define TLB_ASID_GLOBAL         0xFFFE  /* Kernel mappings, any ASID */
+
+#define TLB_BATCH_RANGES        16      /* More: the whole ASID */
+#define TLB_BROADCAST_PAGES     16      /* Up to: broadcast per page */
+#define TLB_LOCAL_PAGES         64      /* Up to: IPIs, whole ASID past it */
+
+typedef struct tlb_range {
+        uint64_t va;                    /* Page aligned */
+        uint64_t pages;
+} tlb_range;
+
+typedef struct tlb_batch {
+        uint16_t asid;
+        uint8_t all;                    /* Overflowed: every page */
+        uint32_t nr;
+        uint64_t pages;                 /* In 'range' */
+        tlb_range range[TLB_BATCH_RANGES];
+} tlb_batch;
+
+typedef struct tlb_stats {
+        uint64_t local;
+        uint64_t broadcast;
+        uint64_t ipi;                   /* Batches flushed through IPIs */
+        uint64_t lazy;                  /* Stale ASIDs flushed on a switch */
+} tlb_stats;
+
+void      tlb_batch_init(tlb_batch *batch, uint16_t asid);
+
+/* Adjacent & overlapping ranges are merged */
+void      tlb_batch_add(tlb_batch *batch, uint64_t va, uint64_t size);
+
+/* Every CPU sees the new translations afterwards, the batch is empty */
+void      tlb_batch_flush(tlb_batch *batch);
+
+/* One range, no batching */
+void      tlb_flush_range(uint16_t asid, uint64_t va, uint64_t size);
+
+/* Before this CPU loads 'next' (or TLB_ASID_NONE) into TTBR0_EL1 */
+void      tlb_asid_switch(uint16_t prev, uint16_t next);
+
+cpumask   tlb_asid_active(uint16_t asid);
+tlb_stats tlb_get_stats(void);
+
+#endif /* TLB_H */
@@ -0,0 +1,129 @@
+/*
+ * Capability lookups (see Cap/CSpace.h), average per lookup over
+ * KBENCH_BATCH of them, every slot of the space in turn
+ *
+ *      cap_lookup_1:   64-bit cptrs, root CNode of 256 slots (guard 56)
+ *      cap_lookup_2:   root of 16 (guard 54) -> CNodes of 64 slots
+ *      cap_lookup_4:   root of 16 (guard 48) -> 3 more levels of 16, past
+ *                      the unrolled levels (cspace_lookup_slow())
+ *
+ * CNodes over static memory (cnode_init()): kbench runs before the page
+ * allocator exists.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "Bench/KBench.h"
+
+#include "Cap/CSpace.h"
+
+#include "LibKern/Console.h"
+
+#define KBENCH_BATCH    100
+
+static cte one[256];
+static cte two_root[16];
+static cte two_leaf[16][64];
+static cte four[4][16];
+
+static volatile uint64_t sink;
+
+static void _bench(const char *name, const cap *root, uint64_t slots,
+                   uint64_t (*cptr_of)(uint64_t))
+{
+        kbench_stat stat;
+        uint64_t i = 0;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t run = 0; run < KBENCH_ITERS / 10; run++) {
+                uint64_t found = 0;
+                uint64_t start = kbench_cycles();
+
+                for (uint32_t n = 0; n < KBENCH_BATCH; n++) {
+                        cte *slot = cspace_lookup(root, cptr_of(i),
+                                CPTR_BITS);
+
+                        found += slot->cap.obj;
+                        i = (i + 1) % slots;
+                }
+
+                kbench_stat_add(&stat,
+                        (kbench_cycles() - start) / KBENCH_BATCH);
+                sink = found;
+        }
+
+        kbench_report(name, &stat);
+}
+
+static uint64_t _cptr_1(uint64_t i)
+{
+        return i;
+}
+
+/* Slot i % 64 of the CNode in slot i / 64 */
+static uint64_t _cptr_2(uint64_t i)
+{
+        return ((i / 64) << 6) | (i % 64);
+}
+
+/* 4 bits per level, every path ending in the same CNodes */
+static uint64_t _cptr_4(uint64_t i)
+{
+        return i & 0xFFFF;
+}
+
+void kbench_cap(void)
+{
+        cap root;
+        cap c = { .type = CAP_ENDPOINT, .rights = CAP_ALL };
+
+        /* 1 level */
+        cnode_init(&root, one, 8, 56, 0);
+
+        for (uint64_t i = 0; i < 256; i++) {
+                c.obj = i;
+                cap_insert(&one[i], &c);
+        }
+
+        _bench("cap_lookup_1", &root, 256, _cptr_1);
+
+        /* 2 levels */
+        cnode_init(&root, two_root, 4, 54, 0);
+
+        for (uint64_t i = 0; i < 16; i++) {
+                cap leaf;
+
+                cnode_init(&leaf, two_leaf[i], 6, 0, 0);
+                cap_insert(&two_root[i], &leaf);
+
+                for (uint64_t j = 0; j < 64; j++) {
+                        c.obj = j;
+                        cap_insert(&two_leaf[i][j], &c);
+                }
+        }
+
+        _bench("cap_lookup_2", &root, 16 * 64, _cptr_2);
+
+        /* 4 levels, a CNode per level (its slots all point to the next) */
+        cnode_init(&root, four[0], 4, 48, 0);
+
+        for (uint32_t l = 0; l < 4; l++) {
+                for (uint64_t i = 0; i < 16; i++) {
+                        cap next;
+
+                        if (l < 3) {
+                                cnode_init(&next, four[l + 1], 4, 0, 0);
+                        } else {
+                                next = c;
+                                next.obj = i;
+                        }
+
+                        cap_insert(&four[l][i], &next);
+                }
+        }
+
+        _bench("cap_lookup_4", &root, 1 << 16, _cptr_4);
+}
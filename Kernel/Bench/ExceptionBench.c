@@ -0,0 +1,123 @@
+/*
+ * Exception entry/exit cost, one benchmark per Vector.S path
+ *
+ *      svc_null:       EL1 SVC fast path round trip (SYS_NULL)
+ *      brk_full:       full fault frame round trip (BRK, skipped)
+ *      irq_entry:      SGI raised -> handler running (includes the GIC)
+ *      irq_exit:       handler running -> back in the interrupted code
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "Bench/KBench.h"
+
+#include "Syscall.h"
+
+#include "Drivers/GIC.h"
+
+#define _STR(x) #x
+#define STR(x) _STR(x)
+
+static volatile uint64_t irq_stamp = 0;
+
+static void _sgi_handler(uint32_t intid, void *data)
+{
+        (void) intid;
+        (void) data;
+
+        irq_stamp = kbench_cycles();
+}
+
+static void _bench_svc(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                register uint64_t x0 asm("x0") = 0;
+                register uint64_t x8 asm("x8") = SYS_NULL;
+
+                uint64_t start = kbench_cycles();
+
+                /* Syscall.h ABI: x1-x18 are clobbered */
+                asm volatile("svc #0"
+                        : "+r" (x0)
+                        : "r" (x8)
+                        : "x1", "x2", "x3", "x4", "x5", "x6", "x7",
+                          "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+                          "x16", "x17", "x18", "memory");
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report("svc_null", &stat);
+}
+
+static void _bench_brk(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                asm volatile("brk #" STR(KBENCH_BRK_IMM) ::: "memory");
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report("brk_full", &stat);
+}
+
+static void _bench_irq(void)
+{
+        kbench_stat entry;
+        kbench_stat exit;
+
+        if (irq_register(KBENCH_SGI, _sgi_handler, 0)) {
+                return;
+        }
+
+        gic_irq_enable(KBENCH_SGI);
+        kbench_stat_init(&entry);
+        kbench_stat_init(&exit);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                irq_stamp = 0;
+
+                uint64_t start = kbench_cycles();
+
+                gic_send_sgi_self(KBENCH_SGI);
+
+                while (!irq_stamp) {
+                        /* Taken right here */
+                }
+
+                uint64_t end = kbench_cycles();
+
+                kbench_stat_add(&entry, irq_stamp - start);
+                kbench_stat_add(&exit, end - irq_stamp);
+        }
+
+        irq_unregister(KBENCH_SGI);
+
+        kbench_report("irq_entry", &entry);
+        kbench_report("irq_exit", &exit);
+}
+
+void kbench_exception(void)
+{
+        if (irqs_disabled()) {
+                irq_enable();
+        }
+
+        _bench_svc();
+        _bench_brk();
+        _bench_irq();
+}
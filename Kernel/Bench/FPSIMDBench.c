@@ -0,0 +1,94 @@
+/*
+ * FP/SIMD context switch cost, eager vs lazy (see ARM64/FPSIMD.h)
+ *
+ *      fpsimd_eager:   save + load of the full state, what every switch
+ *                      would cost without the lazy scheme
+ *      fpsimd_lazy:    fpsimd_switch() between two non-owners, i.e. one
+ *                      CPACR_EL1 write, what an integer-only switch costs
+ *      fpsimd_handoff: fpsimd_trap() handing the registers over, paid once
+ *                      per switch between two FP users (plus the trap)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ARM64/FPSIMD.h"
+
+#include "Bench/KBench.h"
+
+static fpsimd_state bench_a;
+static fpsimd_state bench_b;
+
+static void _bench_eager(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                fpsimd_save(&bench_a);
+                fpsimd_load(&bench_b);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report("fpsimd_eager", &stat);
+}
+
+static void _bench_lazy(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        /* Neither one owns the registers, each switch flips FPEN */
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                fpsimd_state *next = (i & 1) ? &bench_a : NULL;
+
+                uint64_t start = kbench_cycles();
+
+                fpsimd_switch(next);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report("fpsimd_lazy", &stat);
+}
+
+static void _bench_handoff(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                fpsimd_switch((i & 1) ? &bench_a : &bench_b);
+
+                uint64_t start = kbench_cycles();
+
+                fpsimd_trap();
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report("fpsimd_handoff", &stat);
+}
+
+void kbench_fpsimd(void)
+{
+        fpsimd_state_init(&bench_a);
+        fpsimd_state_init(&bench_b);
+
+        _bench_eager();
+        _bench_lazy();
+        _bench_handoff();
+
+        /* Back to no owner, EL0 FP/SIMD traps */
+        fpsimd_switch(NULL);
+        fpsimd_release(&bench_a);
+        fpsimd_release(&bench_b);
+}
@@ -0,0 +1,121 @@
+/*
+ * Cross-call & TLB shootdown cost (see ARM64/IPI.h & ARM64/TLB.h)
+ *
+ *      call_one:       smp_call() to one other CPU, waiting for it
+ *      call_all:       smp_call_mask() to every other CPU, waiting
+ *      tlb_local:      16 pages, nobody else runs the ASID
+ *      tlb_bcast:      16 pages, another CPU runs it: TLBI ...IS
+ *      tlb_ipi:        4 x 16 pages, another CPU runs it: one IPI
+ *      tlb_asid:       256 pages: one TLBI ASIDE1IS
+ *
+ * The other CPU only claims the ASID (tlb_asid_switch()), its TTBR0_EL1
+ * stays: the TLBIs find nothing to drop, the cost is theirs & the IPI's.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+#include "ARM64/TLB.h"
+
+#include "Bench/KBench.h"
+
+#include "LibKern/Console.h"
+
+#include "Memory/PageDef.h"
+
+#define BENCH_ASID      1
+#define BENCH_VA        0x400000ULL
+
+static void _nop(void *arg)
+{
+        (void) arg;
+}
+
+static void _asid_switch(void *arg)
+{
+        uint64_t in = (uint64_t) arg;
+
+        if (in) {
+                tlb_asid_switch(TLB_ASID_NONE, BENCH_ASID);
+        } else {
+                tlb_asid_switch(BENCH_ASID, TLB_ASID_NONE);
+        }
+}
+
+static void _bench_call(const char *name, cpumask mask)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                smp_call_mask(mask, _nop, 0, 1);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report(name, &stat);
+}
+
+static void _bench_tlb(const char *name, uint32_t ranges, uint64_t pages)
+{
+        kbench_stat stat;
+        tlb_batch batch;
+
+        kbench_stat_init(&stat);
+        tlb_batch_init(&batch, BENCH_ASID);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                /* Gaps in between: no merging */
+                for (uint32_t r = 0; r < ranges; r++) {
+                        tlb_batch_add(&batch,
+                                BENCH_VA + r * 2 * pages * PAGE_SIZE,
+                                pages * PAGE_SIZE);
+                }
+
+                uint64_t start = kbench_cycles();
+
+                tlb_batch_flush(&batch);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        kbench_report(name, &stat);
+}
+
+void kbench_ipi(void)
+{
+        uint32_t self = this_cpu()->cpu;
+        cpumask others = smp_online_mask() & ~CPUMASK_OF(self);
+
+        _bench_tlb("tlb_local", 1, 16);
+
+        if (!others) {
+                KLOG_INFO(KLOG_CORE, "[kbench] ipi: uniprocessor, skipped\n");
+                return;
+        }
+
+        uint32_t other = (uint32_t) __builtin_ctz(others);
+
+        _bench_call("call_one", CPUMASK_OF(other));
+        _bench_call("call_all", others);
+
+        smp_call(other, _asid_switch, (void*) 1, 1);
+
+        _bench_tlb("tlb_bcast", 1, 16);
+        _bench_tlb("tlb_ipi", 4, 16);
+        _bench_tlb("tlb_asid", 1, 256);
+
+        smp_call(other, _asid_switch, (void*) 0, 1);
+
+        tlb_stats ts = tlb_get_stats();
+
+        KLOG_INFO(KLOG_CORE, "[kbench] tlb: %lu local, %lu broadcast, "
+                "%lu ipi, %lu lazy\n", ts.local, ts.broadcast, ts.ipi, ts.lazy);
+}
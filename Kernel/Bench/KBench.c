@@ -0,0 +1,78 @@
+/*
+ * In-kernel micro benchmark runner & statistics
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/GenericTimer.h"
+#include "ARM64/PMU.h"
+
+#include "Bench/KBench.h"
+
+#include "LibKern/Console.h"
+
+static uint8_t use_pmu = 0;
+
+uint64_t kbench_cycles(void)
+{
+        return use_pmu ? pmccntr_read() : cntvct_read_ordered();
+}
+
+void kbench_stat_init(kbench_stat *stat)
+{
+        stat->min = UINT64_MAX;
+        stat->max = 0;
+        stat->total = 0;
+        stat->n = 0;
+}
+
+void kbench_stat_add(kbench_stat *stat, uint64_t cycles)
+{
+        if (cycles < stat->min) {
+                stat->min = cycles;
+        }
+
+        if (stat->max < cycles) {
+                stat->max = cycles;
+        }
+
+        stat->total += cycles;
+        stat->n++;
+}
+
+void kbench_report(const char *name, const kbench_stat *stat)
+{
+        if (stat->n == 0) {
+                KLOG_INFO(KLOG_CORE, "[kbench] %-20s no samples\n", name);
+                return;
+        }
+
+        KLOG_INFO(KLOG_CORE, "[kbench] %-20s min %6lu avg %6lu max %6lu %s\n",
+                name, stat->min, stat->total / stat->n, stat->max,
+                use_pmu ? "cyc" : "ticks");
+}
+
+void kbench_run(void)
+{
+        use_pmu = pmu_present();
+
+        if (use_pmu) {
+                pmu_cycles_enable();
+        }
+
+        KLOG_INFO(KLOG_CORE, "[kbench] %u iterations, %s\n", KBENCH_ITERS,
+                use_pmu ? "PMCCNTR_EL0 cycles" : "CNTVCT_EL0 ticks");
+
+        kbench_exception();
+        kbench_fpsimd();
+        kbench_lock();
+        kbench_ipi();
+        kbench_sched();
+        kbench_syscall();
+        kbench_thread();
+        kbench_msg();
+        kbench_cap();
+}
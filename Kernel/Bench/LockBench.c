@@ -0,0 +1,145 @@
+/*
+ * Spinlock cost, alone and with every online CPU contending
+ * (see ARM64/Spinlock.h)
+ *
+ * One round is lock, increment a shared counter, unlock. The boot CPU
+ * times each of its rounds; in the '_all' runs every secondary runs the
+ * same rounds on the same lock meanwhile (smp_call()).
+ *
+ *      ticket_solo / mcs_solo:   uncontended fast path
+ *      ticket_all / mcs_all:     all CPUs, exclusive
+ *      rw_write_all:             all CPUs, writers only
+ *      rw_read_all:              all CPUs, readers only (shared)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+#include "ARM64/Spinlock.h"
+
+#include "Bench/KBench.h"
+
+#include "LibKern/Console.h"
+
+enum lockbench_kind {
+        LB_TICKET,
+        LB_MCS,
+        LB_RW_WRITE,
+        LB_RW_READ
+};
+
+static spinlock ticket = SPINLOCK_INIT;
+static mcslock mcs = MCSLOCK_INIT;
+static rwlock rw = RWLOCK_INIT;
+
+static volatile uint64_t shared;
+static volatile uint32_t go;
+static volatile uint32_t finished;
+
+static inline void _round(uint32_t kind)
+{
+        mcs_node node;
+
+        switch (kind) {
+        case LB_TICKET:
+                spin_lock(&ticket);
+                shared++;
+                spin_unlock(&ticket);
+        break;
+        case LB_MCS:
+                mcs_lock(&mcs, &node);
+                shared++;
+                mcs_unlock(&mcs, &node);
+        break;
+        case LB_RW_WRITE:
+                write_lock(&rw);
+                shared++;
+                write_unlock(&rw);
+        break;
+        case LB_RW_READ:
+                read_lock(&rw);
+                (void) shared;
+                read_unlock(&rw);
+        break;
+        }
+}
+
+/* Runs on the secondaries, through smp_call() (an IPI) */
+static void _worker(void *arg)
+{
+        uint32_t kind = (uint32_t) (uint64_t) arg;
+
+        while (!__atomic_load_n(&go, __ATOMIC_ACQUIRE)) {
+                wfe();
+        }
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                _round(kind);
+        }
+
+        __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+}
+
+static void _bench(const char *name, uint32_t kind, uint8_t all)
+{
+        kbench_stat stat;
+        uint32_t helpers = 0;
+
+        kbench_stat_init(&stat);
+
+        shared = 0;
+        go = 0;
+        finished = 0;
+
+        for (uint32_t cpu = 0; all && cpu < MAX_CPUS; cpu++) {
+                if (cpu == this_cpu()->cpu) {
+                        continue;
+                }
+
+                /* Fails for offline CPUs */
+                if (smp_call(cpu, _worker, (void*) (uint64_t) kind, 0) == 0) {
+                        helpers++;
+                }
+        }
+
+        __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+        dsb_ish();
+        sev();
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                _round(kind);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) != helpers) {
+                wfe(); /* IPI.c 'sev's after each call */
+        }
+
+        kbench_report(name, &stat);
+
+        if (kind != LB_RW_READ &&
+                shared != (uint64_t) (helpers + 1) * KBENCH_ITERS) {
+                KLOG_WARN(KLOG_CORE, "[kbench] %s: lost updates (%lu)\n",
+                        name, shared);
+        }
+}
+
+void kbench_lock(void)
+{
+        KLOG_INFO(KLOG_CORE, "[kbench] lock: %u CPUs in the '_all' runs\n",
+                smp_cpu_count());
+
+        _bench("ticket_solo", LB_TICKET, 0);
+        _bench("mcs_solo", LB_MCS, 0);
+        _bench("ticket_all", LB_TICKET, 1);
+        _bench("mcs_all", LB_MCS, 1);
+        _bench("rw_write_all", LB_RW_WRITE, 1);
+        _bench("rw_read_all", LB_RW_READ, 1);
+}
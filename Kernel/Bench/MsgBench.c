@@ -0,0 +1,338 @@
+/*
+ * Synchronous IPC round trips (see IPC/IPC.h), the fast path
+ *
+ *      ipc_call:       a kernel thread's ipc_call() to a server thread in
+ *                      ipc_reply_wait(), per round trip
+ *      el0_ipc_call:   the same from EL0: 'svc' SYS_IPC_CALL to a server
+ *                      looping on SYS_IPC_REPLY_WAIT at EL0, average per
+ *                      round trip over KBENCH_BATCH calls
+ *      chan_echo:      a kernel thread pushing CHAN_BATCH messages at a
+ *                      time into a channel (see IPC/Channel.h) & popping
+ *                      the server's echoes, average per message (a round
+ *                      trip, like ipc_call) over KBENCH_BATCH of them
+ *      el0_chan_wait:  SYS_CHAN_NOTIFY & SYS_CHAN_WAIT ping-pong between
+ *                      two EL0 threads, doorbells only, average per round
+ *                      trip over KBENCH_BATCH. Each side checks its SP
+ *                      survived the other one running at EL0
+ *
+ * Both sides are pinned to this CPU: every call & reply is a direct
+ * switch, every channel batch a notify, a wait & 2 switches each way.
+ * The EL0 code (Kernel/Bench/UserBench.S) runs from the alias
+ * kbench_syscall() set up. kmain() (this CPU's idle thread) schedules the
+ * threads until they exited.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Exception.h"
+#include "ARM64/SMP.h"
+
+#include "Bench/KBench.h"
+
+#include "IPC/Channel.h"
+#include "IPC/IPC.h"
+#include "IPC/Ring.h"
+
+#include "LibKern/Console.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+#define KBENCH_BATCH    1000
+#define KBENCH_RUNS     (KBENCH_ITERS / KBENCH_BATCH)
+
+#define CHAN_BATCH      32
+#define CHAN_SLOTS      64
+
+/* in Kernel/Bench/UserBench.S */
+extern void kbench_user_ipc_client(uint64_t ep_iters);
+extern void kbench_user_ipc_server(uint64_t ep);
+extern void kbench_user_chan_client(uint64_t args);
+extern void kbench_user_chan_server(uint64_t args);
+
+static uint8_t client_stack[THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t server_stack[THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t client_ustack[4096] __attribute__((aligned(16)));
+static uint8_t server_ustack[4096] __attribute__((aligned(16)));
+
+/* Both rings, with their header lines */
+static ring_msg chan_mem[2 * (sizeof(ring) / sizeof(ring_msg) + CHAN_SLOTS)];
+static ring_msg el0_chan_mem[2 * (sizeof(ring) / sizeof(ring_msg) + 1)];
+
+/* Read at EL0 through the alias: channel, iterations, a ring's 'idle' */
+static uint64_t el0_chan_args[2][3];
+
+static thread client;
+static thread server;
+static kbench_stat stat;
+
+/* A zero message ends the server */
+static void _stop(uint32_t ep)
+{
+        uint64_t mr[IPC_MRS] = { 0 };
+
+        ipc_call(ep, mr);
+}
+
+static void _server(void *arg)
+{
+        uint32_t ep = (uint32_t) (uint64_t) arg;
+        uint64_t mr[IPC_MRS];
+
+        ipc_recv(ep, mr);
+
+        while (mr[0]) {
+                ipc_reply_wait(ep, mr);
+        }
+
+        ipc_reply(mr);
+}
+
+static void _client(void *arg)
+{
+        uint32_t ep = (uint32_t) (uint64_t) arg;
+        uint64_t mr[IPC_MRS] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                ipc_call(ep, mr);
+
+                kbench_stat_add(&stat, kbench_cycles() - start);
+        }
+
+        _stop(ep);
+}
+
+/* Echoes each message back, until a zero one */
+static void _chan_server(void *arg)
+{
+        uint32_t ch = (uint32_t) (uint64_t) arg;
+        ring_msg m[CHAN_BATCH];
+        ring_cons sq;
+        ring_prod cq;
+
+        ring_cons_init(&sq, chan_ring(ch, CHAN_SQ));
+        ring_prod_init(&cq, chan_ring(ch, CHAN_CQ));
+
+        for (;;) {
+                uint32_t n = ring_pop(&sq, m, CHAN_BATCH);
+
+                if (!n) {
+                        if (ring_cons_idle(&sq)) {
+                                chan_wait(ch, CHAN_SQ);
+                        }
+
+                        continue;
+                }
+
+                /* Fits: the client has at most CHAN_BATCH in flight */
+                ring_push(&cq, m, n);
+
+                if (ring_wants_doorbell(&cq)) {
+                        chan_notify(ch, CHAN_CQ);
+                }
+
+                if (!m[n - 1].w[0]) {
+                        return;
+                }
+        }
+}
+
+/* Pushes 'n' copies of 'm', waits for their echoes */
+static void _chan_batch(uint32_t ch, ring_prod *sq, ring_cons *cq,
+                        ring_msg *m, uint32_t n)
+{
+        ring_msg out[CHAN_BATCH];
+        uint32_t got = 0;
+
+        ring_push(sq, m, n);
+
+        if (ring_wants_doorbell(sq)) {
+                chan_notify(ch, CHAN_SQ);
+        }
+
+        while (got < n) {
+                uint32_t popped = ring_pop(cq, out, n - got);
+
+                got += popped;
+
+                if (!popped && ring_cons_idle(cq)) {
+                        chan_wait(ch, CHAN_CQ);
+                }
+        }
+}
+
+static void _chan_client(void *arg)
+{
+        uint32_t ch = (uint32_t) (uint64_t) arg;
+        ring_msg m[CHAN_BATCH];
+        ring_prod sq;
+        ring_cons cq;
+
+        for (uint32_t i = 0; i < CHAN_BATCH; i++) {
+                for (uint32_t j = 0; j < IPC_MRS; j++) {
+                        m[i].w[j] = j + 1;
+                }
+        }
+
+        ring_prod_init(&sq, chan_ring(ch, CHAN_SQ));
+        ring_cons_init(&cq, chan_ring(ch, CHAN_CQ));
+
+        for (uint32_t i = 0; i < KBENCH_RUNS; i++) {
+                uint64_t start = kbench_cycles();
+
+                for (uint32_t sent = 0; sent < KBENCH_BATCH; ) {
+                        uint32_t n = KBENCH_BATCH - sent;
+
+                        n = (n < CHAN_BATCH) ? n : CHAN_BATCH;
+                        _chan_batch(ch, &sq, &cq, m, n);
+                        sent += n;
+                }
+
+                kbench_stat_add(&stat,
+                        (kbench_cycles() - start) / KBENCH_BATCH);
+        }
+
+        m[0].w[0] = 0;
+        _chan_batch(ch, &sq, &cq, m, 1);
+}
+
+static void _user_server(void *arg)
+{
+        user_enter(kbench_user_va((const void*) kbench_user_ipc_server),
+                kbench_user_va(server_ustack + sizeof(server_ustack)),
+                (uint64_t) arg);
+}
+
+static void _user_client(void *arg)
+{
+        uint64_t ep = (uint64_t) arg;
+        uint64_t pc = kbench_user_va((const void*) kbench_user_ipc_client);
+        uint64_t sp = kbench_user_va(client_ustack + sizeof(client_ustack));
+
+        for (uint32_t i = 0; i < KBENCH_RUNS; i++) {
+                uint64_t start = kbench_cycles();
+
+                if (user_enter(pc, sp, (ep << 32) | KBENCH_BATCH) != 0) {
+                        KLOG_WARN(KLOG_CORE, "[kbench] el0_ipc_call: "
+                                "failed\n");
+                        break;
+                }
+
+                kbench_stat_add(&stat,
+                        (kbench_cycles() - start) / KBENCH_BATCH);
+        }
+
+        _stop((uint32_t) ep);
+}
+
+/* 'args' for either side, its alias */
+static uint64_t _el0_chan_args(uint32_t side, uint64_t ch, uint64_t iters,
+                               uint32_t which)
+{
+        uint64_t *args = el0_chan_args[side];
+
+        args[0] = ch;
+        args[1] = iters;
+        args[2] = kbench_user_va(&chan_ring((uint32_t) ch, which)->idle);
+
+        return kbench_user_va(args);
+}
+
+static void _user_chan_server(void *arg)
+{
+        uint64_t args = _el0_chan_args(1, (uint64_t) arg,
+                KBENCH_RUNS * KBENCH_BATCH, CHAN_SQ);
+
+        if (user_enter(kbench_user_va((const void*) kbench_user_chan_server),
+                kbench_user_va(server_ustack + sizeof(server_ustack)),
+                args) != 0) {
+                KLOG_WARN(KLOG_CORE, "[kbench] el0_chan_wait: server "
+                        "failed\n");
+        }
+}
+
+static void _user_chan_client(void *arg)
+{
+        uint64_t pc = kbench_user_va((const void*) kbench_user_chan_client);
+        uint64_t sp = kbench_user_va(client_ustack + sizeof(client_ustack));
+        uint64_t args = _el0_chan_args(0, (uint64_t) arg, KBENCH_BATCH,
+                CHAN_CQ);
+
+        for (uint32_t i = 0; i < KBENCH_RUNS; i++) {
+                uint64_t start = kbench_cycles();
+
+                if (user_enter(pc, sp, args) != 0) {
+                        KLOG_WARN(KLOG_CORE, "[kbench] el0_chan_wait: "
+                                "client failed\n");
+                        break;
+                }
+
+                kbench_stat_add(&stat,
+                        (kbench_cycles() - start) / KBENCH_BATCH);
+        }
+}
+
+/* A channel for el0_chan_wait: the server is about to wait on CHAN_SQ */
+static int32_t _el0_chan_create(void)
+{
+        int32_t ch = chan_create(el0_chan_mem, 1);
+
+        if (0 <= ch) {
+                __atomic_store_n(&chan_ring((uint32_t) ch, CHAN_SQ)->idle, 1,
+                        __ATOMIC_RELAXED);
+        }
+
+        return ch;
+}
+
+/* 'arg': the endpoint or channel, for both */
+static void _run(const char *name, thread_fn server_fn, thread_fn client_fn,
+                 int32_t arg)
+{
+        cpumask self = CPUMASK_OF(this_cpu()->cpu);
+
+        if (arg < 0) {
+                KLOG_WARN(KLOG_CORE, "[kbench] %s: none left\n", name);
+                return;
+        }
+
+        kbench_stat_init(&stat);
+
+        thread_setup(&server, server_fn, (void*) (uint64_t) arg, server_stack,
+                sizeof(server_stack), SCHED_PRIO_DEFAULT);
+        thread_setup(&client, client_fn, (void*) (uint64_t) arg, client_stack,
+                sizeof(client_stack), SCHED_PRIO_DEFAULT);
+        sched_set_affinity(&server.se, self);
+        sched_set_affinity(&client.se, self);
+
+        /* The server first: waiting by the time the first call comes */
+        thread_start(&server);
+        thread_start(&client);
+
+        while (!thread_done(&server) || !thread_done(&client)) {
+                schedule();
+        }
+
+        kbench_report(name, &stat);
+}
+
+void kbench_msg(void)
+{
+        _run("ipc_call", _server, _client, ipc_endpoint_create());
+        _run("chan_echo", _chan_server, _chan_client,
+                chan_create(chan_mem, CHAN_SLOTS));
+
+        if (!kbench_user_va((const void*) kbench_user_ipc_client)) {
+                KLOG_WARN(KLOG_CORE, "[kbench] el0_ipc_call: no EL0 alias\n");
+                return;
+        }
+
+        _run("el0_ipc_call", _user_server, _user_client,
+                ipc_endpoint_create());
+        _run("el0_chan_wait", _user_chan_server, _user_chan_client,
+                _el0_chan_create());
+}
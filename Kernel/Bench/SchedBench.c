@@ -0,0 +1,188 @@
+/*
+ * Run queue throughput on 1..N CPUs (see Sched/Sched.h)
+ *
+ *      yield_<n>:      every CPU round-robins 2 entities of its own
+ *      wakeup_<n>:     every CPU wakes an entity pinned to the next one
+ *                      (its inbox) and runs the one woken onto it
+ *
+ * The boot CPU times its own operations while the other n - 1 CPUs run
+ * the same loop (smp_call()). A private sched_state: the scheduler's own
+ * queues aren't touched.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+
+#include "Bench/KBench.h"
+
+#include "LibKern/Console.h"
+
+#include "Sched/Sched.h"
+
+static sched_state ss;
+static sched_entity yielders[MAX_CPUS][2];
+static sched_entity wakees[MAX_CPUS];
+
+static volatile uint32_t go;
+static volatile uint32_t finished;
+static uint32_t consumed;
+static uint32_t total;
+
+static const char *yield_names[MAX_CPUS] = {
+        "yield_1", "yield_2", "yield_3", "yield_4",
+        "yield_5", "yield_6", "yield_7", "yield_8"
+};
+
+static const char *wakeup_names[MAX_CPUS] = {
+        "wakeup_1", "wakeup_2", "wakeup_3", "wakeup_4",
+        "wakeup_5", "wakeup_6", "wakeup_7", "wakeup_8"
+};
+
+static void _yield_loop(uint32_t cpu, kbench_stat *stat)
+{
+        sched_entity *cur = sched_pick(&ss, cpu, 0, 0);
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+                sched_entity *next = sched_pick(&ss, cpu, cur, i);
+
+                if (next != cur) {
+                        sched_finish(&ss, cpu, cur, i);
+                }
+
+                cur = next;
+
+                if (stat) {
+                        kbench_stat_add(stat, kbench_cycles() - start);
+                }
+        }
+}
+
+static void _wakeup_loop(uint32_t cpu, kbench_stat *stat)
+{
+        uint32_t woken = 0;
+
+        while (woken < KBENCH_ITERS ||
+                __atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+                uint64_t start = kbench_cycles();
+                uint8_t did_wake = 0;
+
+                if (woken < KBENCH_ITERS &&
+                        sched_wake(&ss, cpu, &wakees[cpu], 0) < SCHED_CPUS) {
+                        woken++;
+                        did_wake = 1;
+                }
+
+                sched_entity *next = sched_pick(&ss, cpu, 0, 0);
+
+                if (next) {
+                        sched_prepare_sleep(next);
+                        sched_finish(&ss, cpu, next, 0);
+                        __atomic_add_fetch(&consumed, 1, __ATOMIC_RELAXED);
+                }
+
+                if (stat && did_wake && next) {
+                        kbench_stat_add(stat, kbench_cycles() - start);
+                }
+        }
+}
+
+/* Runs on the secondaries, through smp_call() */
+static void _worker(void *arg)
+{
+        uint32_t cpu = this_cpu()->cpu;
+
+        while (!__atomic_load_n(&go, __ATOMIC_ACQUIRE)) {
+                wfe();
+        }
+
+        if (arg) {
+                _wakeup_loop(cpu, 0);
+        } else {
+                _yield_loop(cpu, 0);
+        }
+
+        __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+}
+
+/* The boot CPU & the first 'n' - 1 others */
+static void _bench(const char *name, cpumask cpus, uint8_t wakeup)
+{
+        uint32_t self = this_cpu()->cpu;
+        uint32_t n = (uint32_t) __builtin_popcount(cpus);
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+        sched_state_init(&ss);
+
+        /* 'wakees' ring through the CPUs in 'cpus' */
+        uint32_t first = (uint32_t) __builtin_ctz(cpus);
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                if (!(cpus & CPUMASK_OF(cpu))) {
+                        continue;
+                }
+
+                cpumask after = cpus & ~((CPUMASK_OF(cpu) << 1) - 1);
+                uint32_t next = after ? (uint32_t) __builtin_ctz(after) : first;
+
+                sched_cpu_online(&ss, cpu);
+                sched_entity_init(&wakees[cpu], SCHED_PRIO_DEFAULT,
+                        CPUMASK_OF(next));
+
+                for (uint32_t i = 0; i < 2; i++) {
+                        sched_entity_init(&yielders[cpu][i],
+                                SCHED_PRIO_DEFAULT, CPUMASK_OF(cpu));
+                        sched_enqueue(&ss, cpu, &yielders[cpu][i]);
+                }
+        }
+
+        go = 0;
+        finished = 0;
+        consumed = 0;
+        total = n * KBENCH_ITERS;
+
+        smp_call_mask(cpus & ~CPUMASK_OF(self), _worker,
+                (void*) (uint64_t) wakeup, 0);
+
+        __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+        dsb_ish();
+        sev();
+
+        if (wakeup) {
+                _wakeup_loop(self, &stat);
+        } else {
+                _yield_loop(self, &stat);
+        }
+
+        while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) != n - 1) {
+                wfe(); /* IPI.c 'sev's after each call */
+        }
+
+        kbench_report(name, &stat);
+}
+
+void kbench_sched(void)
+{
+        uint32_t self = this_cpu()->cpu;
+        cpumask others = smp_online_mask() & ~CPUMASK_OF(self);
+        cpumask cpus = CPUMASK_OF(self);
+
+        for (uint32_t n = 1; ; n++) {
+                _bench(yield_names[n - 1], cpus, 0);
+                _bench(wakeup_names[n - 1], cpus, 1);
+
+                if (!others) {
+                        break;
+                }
+
+                /* One more CPU */
+                cpus |= others & -others;
+                others &= others - 1;
+        }
+}
@@ -0,0 +1,120 @@
+/*
+ * Null syscall latency from EL0 (the msgsend()/msgrecv() baseline)
+ *
+ * There are no user address spaces yet, so the benchmark maps the RAM
+ * block holding the kernel a second time through TTBR0, EL0 accessible,
+ * and runs Kernel/Bench/UserBench.S from that alias. KBENCH builds only.
+ *
+ *      el0_null:       EL0 'svc' -> syscall_table[SYS_NULL] -> 'eret',
+ *                      average per call over KBENCH_BATCH calls
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Exception.h"
+#include "ARM64/Machine.h"
+#include "ARM64/Memory.h"
+
+#include "Bench/KBench.h"
+
+#include "LibKern/Console.h"
+
+#define KBENCH_BATCH    1000
+#define KBENCH_RUNS     (KBENCH_ITERS / KBENCH_BATCH)
+
+#define RAM_BLOCK       0x40000000ULL /* L1 block (1 GiB) holding the kernel */
+#define USER_ALIAS      0x80000000ULL /* Its EL0 alias, u_l1_pgtbl[2] */
+
+/* in Kernel/Arch/ARM64/Start.c */
+extern uint64_t u_l1_pgtbl[ENTRY_SIZE];
+
+/* in Kernel/Bench/UserBench.S */
+extern void kbench_user_null(uint64_t iters);
+
+static uint8_t user_stack[4096] __attribute__((aligned(16)));
+
+static uint64_t _kva_to_pa(uint64_t va)
+{
+        uint64_t par;
+
+        asm volatile("at s1e1r, %1\n\tisb\n\tmrs %0, par_el1"
+                : "=r" (par) : "r" (va) : "memory");
+
+        if (par & 1) { /* PAR_EL1.F */
+                return 0;
+        }
+
+        return (par & 0x0000FFFFFFFFF000ULL) | (va & 0xFFF);
+}
+
+uint64_t kbench_user_va(const void *kva)
+{
+        uint64_t pa = _kva_to_pa((uint64_t) kva);
+
+        if (pa < RAM_BLOCK || RAM_BLOCK + ARM_TT_L1_SIZE <= pa) {
+                return 0;
+        }
+
+        return pa - RAM_BLOCK + USER_ALIAS;
+}
+
+static void _map_user_alias(void)
+{
+        uint64_t blk = 0;
+
+        blk = ENTRY_VALID(blk);
+        blk = ENTRY_BLOCK(blk);
+
+        blk = BLK_SET_AIDX(blk, NORMAL_IDX);
+        blk = BLK_SET_NS(blk, 0);
+        blk = BLK_SET_AP(blk, AP_PRIV_RW_UNPRIV_RW);
+        blk = BLK_SET_SH(blk, SH_OUTER);
+        blk = BLK_SET_AF(blk, 1);
+        blk = BLK_SET_NG(blk, 0);
+
+        blk = BLK_SET_L1_OA(blk, RAM_BLOCK);
+
+        blk = BLK_SET_HINT(blk, 0);
+        blk = BLK_SET_PXN(blk, 1);
+        blk = BLK_SET_XN(blk, 0);
+
+        u_l1_pgtbl[L1_TABLE_INDEX(USER_ALIAS)] = blk;
+
+        dsb_ishst();
+        tlbi_vmalle1();
+        dsb_ish();
+        isb();
+}
+
+void kbench_syscall(void)
+{
+        kbench_stat stat;
+
+        _map_user_alias();
+
+        uint64_t pc = kbench_user_va((const void*) kbench_user_null);
+        uint64_t sp = kbench_user_va(user_stack + sizeof(user_stack));
+
+        if (!pc || !sp) {
+                KLOG_WARN(KLOG_CORE, "[kbench] el0_null: no EL0 alias\n");
+                return;
+        }
+
+        kbench_stat_init(&stat);
+
+        for (uint32_t i = 0; i < KBENCH_RUNS; i++) {
+                uint64_t start = kbench_cycles();
+
+                if (user_enter(pc, sp, KBENCH_BATCH) != 0) {
+                        KLOG_WARN(KLOG_CORE, "[kbench] el0_null: failed\n");
+                        return;
+                }
+
+                kbench_stat_add(&stat,
+                        (kbench_cycles() - start) / KBENCH_BATCH);
+        }
+
+        kbench_report("el0_null", &stat);
+}
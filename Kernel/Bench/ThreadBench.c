@@ -0,0 +1,122 @@
+/*
+ * Thread switch cost (see Sched/Thread.h)
+ *
+ *      switch_raw:     _context_switch() back & forth between two contexts,
+ *                      the assembly alone
+ *      yield_pingpong: two kernel threads on this CPU yield to each other,
+ *                      the whole path: schedule(), sched_pick(), the switch
+ *                      & sched_finish()
+ *
+ * Both report cycles per switch, half a round trip. The threads are pinned
+ * to this CPU, kmain() (its idle thread) schedules them until they exited.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Context.h"
+#include "ARM64/Machine.h"
+#include "ARM64/SMP.h"
+
+#include "Bench/KBench.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+static uint8_t ping_stack[THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t pong_stack[THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+static thread ping;
+static thread pong;
+static kbench_stat pingpong_stat;
+
+static cpu_context raw_main;
+static cpu_context raw_other;
+
+/* raw_other's code, never returns: abandoned when the bench is over */
+static void _raw_other(void *last)
+{
+        (void) last;
+
+        for (;;) {
+                _context_switch(&raw_other, &raw_main, 0);
+        }
+}
+
+static void _bench_raw(void)
+{
+        kbench_stat stat;
+
+        kbench_stat_init(&stat);
+
+        raw_other = (cpu_context) { 0 };
+        raw_other.lr = (uint64_t) _raw_other;
+        raw_other.sp = (uint64_t) (pong_stack + THREAD_STACK_SIZE);
+
+        uint64_t flags = irq_save();
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                _context_switch(&raw_main, &raw_other, 0);
+
+                kbench_stat_add(&stat, (kbench_cycles() - start) / 2);
+        }
+
+        irq_restore(flags);
+
+        kbench_report("switch_raw", &stat);
+}
+
+static void _ping(void *arg)
+{
+        (void) arg;
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                uint64_t start = kbench_cycles();
+
+                thread_yield(); /* To pong & back */
+
+                kbench_stat_add(&pingpong_stat,
+                        (kbench_cycles() - start) / 2);
+        }
+}
+
+static void _pong(void *arg)
+{
+        (void) arg;
+
+        for (uint32_t i = 0; i < KBENCH_ITERS; i++) {
+                thread_yield();
+        }
+}
+
+static void _bench_pingpong(void)
+{
+        cpumask self = CPUMASK_OF(this_cpu()->cpu);
+
+        kbench_stat_init(&pingpong_stat);
+
+        thread_setup(&ping, _ping, 0, ping_stack, sizeof(ping_stack),
+                SCHED_PRIO_DEFAULT);
+        thread_setup(&pong, _pong, 0, pong_stack, sizeof(pong_stack),
+                SCHED_PRIO_DEFAULT);
+        sched_set_affinity(&ping.se, self);
+        sched_set_affinity(&pong.se, self);
+
+        thread_start(&ping);
+        thread_start(&pong);
+
+        while (!thread_done(&ping) || !thread_done(&pong)) {
+                schedule();
+        }
+
+        kbench_report("yield_pingpong", &pingpong_stat);
+}
+
+void kbench_thread(void)
+{
+        _bench_raw();
+        _bench_pingpong();
+}
@@ -0,0 +1,254 @@
+/*
+ * Capability spaces, see CSpace.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "Cap/CSpace.h"
+
+#include "LibKern/String.h"
+
+#include "Memory/Page.h"
+#include "Memory/Physical.h"
+#include "Memory/Slab.h"
+
+/* By radix, 1 to CNODE_SLAB_RADIX */
+static slab_cache cnode_slabs[CNODE_SLAB_RADIX + 1];
+
+static const char *cnode_slab_names[CNODE_SLAB_RADIX + 1] = {
+        "", "cnode_1", "cnode_2", "cnode_3", "cnode_4",
+        "cnode_5", "cnode_6", "cnode_7", "cnode_8"
+};
+
+void cspace_init(void)
+{
+        for (uint32_t r = 1; r <= CNODE_SLAB_RADIX; r++) {
+                slab_cache_init(&cnode_slabs[r], cnode_slab_names[r],
+                        (uint32_t) sizeof(cte) << r);
+        }
+}
+
+int cnode_init(cap *cn, cte *slots, uint32_t radix, uint32_t guard_bits,
+               uint64_t guard)
+{
+        if (!slots || !radix || CNODE_RADIX_MAX < radix ||
+                CPTR_BITS < radix + guard_bits ||
+                (guard >> guard_bits) != 0) {
+                return CAP_EINVAL;
+        }
+
+        cn->type = CAP_CNODE;
+        cn->rights = CAP_ALL;
+        cn->radix = (uint8_t) radix;
+        cn->guard_bits = (uint8_t) guard_bits;
+        cn->flags = 0;
+        cn->guard = guard;
+        cn->obj = (uint64_t) slots;
+        cn->badge = 0;
+
+        return CAP_OK;
+}
+
+int cnode_create(cap *cn, uint32_t radix, uint32_t guard_bits,
+                 uint64_t guard)
+{
+        cte *slots;
+
+        /* What cnode_init() checks, before allocating */
+        if (!radix || CNODE_RADIX_MAX < radix ||
+                CPTR_BITS < radix + guard_bits ||
+                (guard >> guard_bits) != 0) {
+                return CAP_EINVAL;
+        }
+
+        if (radix <= CNODE_SLAB_RADIX) {
+                slots = (cte*) slab_alloc(&cnode_slabs[radix]);
+        } else {
+                void *pa = nb_alloc(sizeof(cte) << radix);
+
+                slots = pa ? (cte*) page_va((uint64_t) pa) : 0;
+
+                if (slots) {
+                        memset(slots, 0x0, sizeof(cte) << radix);
+                }
+        }
+
+        if (!slots) {
+                return CAP_ENOMEM;
+        }
+
+        int err = cnode_init(cn, slots, radix, guard_bits, guard);
+
+        cn->flags |= CAP_F_ALLOCATED;
+
+        return err;
+}
+
+void cnode_destroy(cap *cn)
+{
+        cte *slots = (cte*) cn->obj;
+
+        if (cn->type != CAP_CNODE || !(cn->flags & CAP_F_ALLOCATED)) {
+                return;
+        }
+
+        for (uint64_t i = 0; i < (1ULL << cn->radix); i++) {
+                if (slots[i].cap.type != CAP_NULL) {
+                        cap_delete(&slots[i]);
+                }
+        }
+
+        if (cn->radix <= CNODE_SLAB_RADIX) {
+                slab_free(&cnode_slabs[cn->radix], slots);
+        } else {
+                nb_free((void*) page_pa(slots));
+        }
+
+        memset(cn, 0x0, sizeof(*cn));
+}
+
+cte *cspace_lookup_slow(const cap *cn, uint64_t cptr, uint32_t depth)
+{
+        for (;;) {
+                if (cn->type != CAP_CNODE) {
+                        return 0;
+                }
+
+                cte *slot = __cspace_level(cn, cptr, &depth);
+
+                if (!slot || !depth) {
+                        return slot;
+                }
+
+                cn = &slot->cap;
+        }
+}
+
+int cap_insert(cte *slot, const cap *c)
+{
+        if (c->type == CAP_NULL) {
+                return CAP_EINVAL;
+        }
+
+        if (slot->cap.type != CAP_NULL) {
+                return CAP_EEXIST;
+        }
+
+        slot->cap = *c;
+        slot->parent = 0;
+        slot->child = 0;
+        slot->prev = 0;
+        slot->next = 0;
+
+        return CAP_OK;
+}
+
+int cap_derive(cte *dest, cte *src, uint8_t rights, uint64_t badge)
+{
+        if (src->cap.type == CAP_NULL) {
+                return CAP_ENOENT;
+        }
+
+        if (dest->cap.type != CAP_NULL) {
+                return CAP_EEXIST;
+        }
+
+        if ((rights & ~src->cap.rights) ||
+                (badge && src->cap.badge && badge != src->cap.badge)) {
+                return CAP_EPERM;
+        }
+
+        dest->cap = src->cap;
+        dest->cap.rights = rights;
+        dest->cap.badge = badge ? badge : src->cap.badge;
+
+        dest->parent = src;
+        dest->child = 0;
+        dest->prev = 0;
+        dest->next = src->child;
+
+        if (src->child) {
+                src->child->prev = dest;
+        }
+
+        src->child = dest;
+
+        return CAP_OK;
+}
+
+int cap_delete(cte *slot)
+{
+        if (slot->cap.type == CAP_NULL) {
+                return CAP_ENOENT;
+        }
+
+        cte *parent = slot->parent;
+        cap last = slot->cap;
+
+        /* Nothing else refers to its object (nested CNodes recurse) */
+        if (parent || slot->child || slot->prev || slot->next) {
+                last.type = CAP_NULL;
+        }
+
+        /* Out of its siblings */
+        if (slot->prev) {
+                slot->prev->next = slot->next;
+        } else if (parent) {
+                parent->child = slot->next;
+        }
+
+        if (slot->next) {
+                slot->next->prev = slot->prev;
+        }
+
+        /* Its children up to its parent, ahead of their new siblings */
+        cte *first = slot->child;
+
+        if (first) {
+                cte *last = first;
+
+                for (cte *c = first; c; c = c->next) {
+                        c->parent = parent;
+                        last = c;
+                }
+
+                if (parent) {
+                        last->next = parent->child;
+
+                        if (parent->child) {
+                                parent->child->prev = last;
+                        }
+
+                        parent->child = first;
+                }
+        }
+
+        memset(slot, 0x0, sizeof(*slot));
+
+        if (last.type == CAP_CNODE) {
+                cnode_destroy(&last);
+        }
+
+        return CAP_OK;
+}
+
+int64_t cap_revoke(cte *slot)
+{
+        int64_t n = 0;
+
+        /* Leaves first: every delete is one unlink */
+        while (slot->child) {
+                cte *c = slot->child;
+
+                while (c->child) {
+                        c = c->child;
+                }
+
+                cap_delete(c);
+                n++;
+        }
+
+        return n;
+}
@@ -0,0 +1,451 @@
+/*
+ * ARM Generic Interrupt Controller (GICv2 & GICv3) driver
+ *
+ * Reference: ARM IHI 0048B (GICv2 Architecture Specification)
+ *            ARM IHI 0069H (GICv3 & GICv4 Architecture Specification)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "MemoryLayout.h"
+#include "Drivers/GIC.h"
+
+#include "LibKern/Console.h"
+#include "LibKern/DeviceTree.h"
+#include "LibKern/Trace.h"
+
+/* GICv3 CPU interface system registers (generic names, any assembler) */
+#define ICC_PMR_EL1     "S3_0_C4_C6_0"
+#define ICC_IAR1_EL1    "S3_0_C12_C12_0"
+#define ICC_EOIR1_EL1   "S3_0_C12_C12_1"
+#define ICC_BPR1_EL1    "S3_0_C12_C12_3"
+#define ICC_SRE_EL1     "S3_0_C12_C12_5"
+#define ICC_IGRPEN1_EL1 "S3_0_C12_C12_7"
+#define ICC_SGI1R_EL1   "S3_0_C12_C11_5"
+
+typedef struct irq_desc {
+        irq_handler handler;
+        void *data;
+        uint64_t count;
+        uint8_t nesting; /* Run with IRQs unmasked */
+} irq_desc;
+
+static uint8_t version = 0;
+static uint64_t gicd = 0x0;
+static uint64_t gicc = 0x0;                /* v2 */
+static uint64_t gicr = 0x0;                /* v3, first redistributor */
+static uint64_t gicr_cpu[MAX_CPUS] = {0};  /* v3, per CPU RD_base */
+static uint32_t gic_lines = 0;
+
+static irq_desc irq_table[GIC_MAX_INTID];
+static gic_stats stats = {0};
+
+void gic_probe(void *dtb)
+{
+        uint64_t reg[4] = {0};
+
+        if (dtb_find_compatible(dtb, "arm,gic-v3", reg, 2) == 0) {
+                gic_init_v3(reg[0], reg[2]);
+        } else if (dtb_find_compatible(dtb, "arm,cortex-a15-gic", reg, 2) == 0) {
+                gic_init(reg[0], reg[2]);
+        } else {
+                KLOG_WARN(KLOG_IRQ, "[gic] not in DTB, assuming GICv2\n");
+                gic_init(GICD_BASE, GICC_BASE);
+        }
+
+        KLOG_INFO(KLOG_IRQ, "[gic] GICv%u, %u lines, GICD @ 0x%lx\n",
+                version, gic_lines, gicd);
+}
+
+uint8_t gic_version(void)
+{
+        return version;
+}
+
+/* Common distributor setup, 'gicd' & 'gic_lines' must be valid */
+static void _dist_init(void)
+{
+        /* Everything starts disabled, not pending and at default priority */
+        for (uint32_t i = GIC_SPI_BASE / 32; i < gic_lines / 32; i++) {
+                mmio_write32(gicd + GICD_ICENABLER(i), 0xFFFFFFFF);
+                mmio_write32(gicd + GICD_ICPENDR(i), 0xFFFFFFFF);
+        }
+
+        for (uint32_t i = GIC_SPI_BASE / 4; i < gic_lines / 4; i++) {
+                mmio_write32(gicd + GICD_IPRIORITYR(i),
+                        GIC_PRIO_DEFAULT * 0x01010101U);
+        }
+
+        /* SPIs are level-sensitive */
+        for (uint32_t i = GIC_SPI_BASE / 16; i < gic_lines / 16; i++) {
+                mmio_write32(gicd + GICD_ICFGR(i), 0);
+        }
+}
+
+void gic_init(uint64_t gicd_base, uint64_t gicc_base)
+{
+        version = 2;
+        gicd = gicd_base;
+        gicc = gicc_base;
+
+        mmio_write32(gicd + GICD_CTLR, 0);
+
+        gic_lines = GICD_TYPER_ITLINES(mmio_read32(gicd + GICD_TYPER));
+
+        _dist_init();
+
+        /* SPIs are routed to CPU0 */
+        for (uint32_t i = GIC_SPI_BASE / 4; i < gic_lines / 4; i++) {
+                mmio_write32(gicd + GICD_ITARGETSR(i), 0x01010101U);
+        }
+
+        mmio_write32(gicd + GICD_CTLR, GICD_CTLR_ENABLE);
+
+        gic_cpu_init();
+}
+
+static void _v3_wait_rwp(void)
+{
+        while (mmio_read32(gicd + GICD_CTLR) & GICD_CTLR_RWP) {
+                /* Distributor is still applying the last write */
+        }
+}
+
+void gic_init_v3(uint64_t gicd_base, uint64_t gicr_base)
+{
+        version = 3;
+        gicd = gicd_base;
+        gicr = gicr_base;
+
+        mmio_write32(gicd + GICD_CTLR, 0);
+        _v3_wait_rwp();
+
+        gic_lines = GICD_TYPER_ITLINES(mmio_read32(gicd + GICD_TYPER));
+        if (GIC_MAX_INTID < gic_lines) {
+                gic_lines = GIC_MAX_INTID;
+        }
+
+        _dist_init();
+
+        /* Everything is (Non-secure) Group 1, SPIs routed to this CPU */
+        for (uint32_t i = GIC_SPI_BASE / 32; i < gic_lines / 32; i++) {
+                mmio_write32(gicd + GICD_IGROUPR(i), 0xFFFFFFFF);
+        }
+
+        for (uint32_t i = GIC_SPI_BASE; i < gic_lines; i++) {
+                mmio_write64(gicd + GICD_IROUTER(i), cpu_affinity());
+        }
+
+        mmio_write32(gicd + GICD_CTLR, GICD_CTLR_ARE | GICD_CTLR_GRP1);
+        _v3_wait_rwp();
+
+        gic_cpu_init();
+}
+
+/* v3: find this CPU's redistributor by its affinity */
+static uint64_t _v3_find_rd(void)
+{
+        uint32_t aff = cpu_affinity();
+        uint64_t rd = gicr;
+
+        for (;;) {
+                uint64_t typer = mmio_read64(rd + GICR_TYPER);
+
+                if (GICR_TYPER_AFF(typer) == aff) {
+                        return rd;
+                }
+
+                if (typer & GICR_TYPER_LAST) {
+                        return 0;
+                }
+
+                rd += (typer & GICR_TYPER_VLPIS) ?
+                        2 * GICR_STRIDE : GICR_STRIDE;
+        }
+}
+
+void gic_cpu_init(void)
+{
+        uint32_t cpu = cpu_id();
+
+        if (version == 2) {
+                /* SGIs & PPIs are banked per CPU in the distributor */
+                mmio_write32(gicd + GICD_ICENABLER(0), 0xFFFF0000);
+                mmio_write32(gicd + GICD_ISENABLER(0), 0x0000FFFF); /* SGIs */
+
+                for (uint32_t i = 0; i < GIC_SPI_BASE / 4; i++) {
+                        mmio_write32(gicd + GICD_IPRIORITYR(i),
+                                GIC_PRIO_DEFAULT * 0x01010101U);
+                }
+
+                /* Let every priority through, no preemption groups */
+                mmio_write32(gicc + GICC_PMR, GIC_PRIO_LOWEST);
+                mmio_write32(gicc + GICC_BPR, 0);
+                mmio_write32(gicc + GICC_CTLR, GICC_CTLR_ENABLE);
+
+                return;
+        }
+
+        uint64_t rd = _v3_find_rd();
+
+        if (!rd) {
+                KLOG_ERR(KLOG_IRQ, "[gic] cpu%u: no redistributor!\n", cpu);
+                return;
+        }
+
+        gicr_cpu[cpu] = rd;
+
+        /* Wake the redistributor up */
+        uint32_t waker = mmio_read32(rd + GICR_WAKER);
+        mmio_write32(rd + GICR_WAKER, waker & ~GICR_WAKER_SLEEP);
+
+        while (mmio_read32(rd + GICR_WAKER) & GICR_WAKER_ASLEEP) {
+                /* Wait */
+        }
+
+        uint64_t sgi = rd + GICR_SGI_OFFSET;
+
+        mmio_write32(sgi + GICD_IGROUPR(0), 0xFFFFFFFF);
+        mmio_write32(sgi + GICD_ICENABLER(0), 0xFFFF0000);
+        mmio_write32(sgi + GICD_ISENABLER(0), 0x0000FFFF); /* SGIs */
+
+        for (uint32_t i = 0; i < GIC_SPI_BASE / 4; i++) {
+                mmio_write32(sgi + GICD_IPRIORITYR(i),
+                        GIC_PRIO_DEFAULT * 0x01010101U);
+        }
+
+        /* System register interface, every priority, Group 1 on */
+        uint64_t sre;
+        MRS(ICC_SRE_EL1, sre);
+        MSR(ICC_SRE_EL1, sre | 1);
+        isb();
+
+        MSR(ICC_PMR_EL1, GIC_PRIO_LOWEST);
+        MSR(ICC_BPR1_EL1, 0);
+        MSR(ICC_IGRPEN1_EL1, 1);
+        isb();
+}
+
+/* Register block holding 'intid's banked state */
+static inline uint64_t _bank(uint32_t intid)
+{
+        if (version == 3 && intid < GIC_SPI_BASE) {
+                return gicr_cpu[cpu_id()] + GICR_SGI_OFFSET;
+        }
+
+        return gicd;
+}
+
+void gic_irq_enable(uint32_t intid)
+{
+        if (gic_lines <= intid) {
+                return;
+        }
+
+        mmio_write32(_bank(intid) + GICD_ISENABLER(intid / 32),
+                1U << (intid % 32));
+}
+
+void gic_irq_disable(uint32_t intid)
+{
+        if (gic_lines <= intid) {
+                return;
+        }
+
+        mmio_write32(_bank(intid) + GICD_ICENABLER(intid / 32),
+                1U << (intid % 32));
+
+        if (version == 3 && GIC_SPI_BASE <= intid) {
+                _v3_wait_rwp();
+        }
+}
+
+void gic_irq_set_priority(uint32_t intid, uint8_t prio)
+{
+        if (gic_lines <= intid) {
+                return;
+        }
+
+        uint64_t reg = _bank(intid) + GICD_IPRIORITYR(0) + intid;
+
+        /* GICD_IPRIORITYR is byte-accessible */
+        *(volatile uint8_t*) reg = prio;
+}
+
+void gic_irq_set_affinity(uint32_t intid, uint32_t cpu)
+{
+        if (intid < GIC_SPI_BASE || gic_lines <= intid || MAX_CPUS <= cpu) {
+                return;
+        }
+
+        if (version == 3) {
+                /* QEMU virt: CPU n is Aff0 = n */
+                mmio_write64(gicd + GICD_IROUTER(intid), cpu);
+        } else {
+                *(volatile uint8_t*) (gicd + GICD_ITARGETSR(0) + intid) =
+                        (uint8_t) (1U << cpu);
+        }
+}
+
+uint32_t gic_irq_ack(void)
+{
+        uint64_t iar;
+
+        if (version == 3) {
+                MRS(ICC_IAR1_EL1, iar);
+                return (uint32_t) iar;
+        }
+
+        return mmio_read32(gicc + GICC_IAR);
+}
+
+void gic_irq_eoi(uint32_t iar)
+{
+        if (version == 3) {
+                MSR(ICC_EOIR1_EL1, iar);
+                return;
+        }
+
+        mmio_write32(gicc + GICC_EOIR, iar);
+}
+
+void gic_send_sgi_self(uint32_t intid)
+{
+        if (GIC_PPI_BASE <= intid) {
+                return;
+        }
+
+        if (version == 3) {
+                uint64_t mpidr;
+
+                asm volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+
+                /* Aff3.Aff2.Aff1 select the cluster, TargetList the Aff0 */
+                uint64_t sgi = ((uint64_t) intid << 24) |
+                        (((mpidr >> 32) & 0xFF) << 48) |
+                        (((mpidr >> 16) & 0xFF) << 32) |
+                        (((mpidr >> 8) & 0xFF) << 16) |
+                        (1ULL << (mpidr & 0xF));
+
+                MSR(ICC_SGI1R_EL1, sgi);
+                isb();
+                return;
+        }
+
+        /* TargetListFilter 0b10: the requesting CPU only */
+        dsb_ishst();
+        mmio_write32(gicd + GICD_SGIR, (2U << 24) | intid);
+}
+
+void gic_send_sgi(uint32_t intid, uint32_t cpu_mask)
+{
+        if (GIC_PPI_BASE <= intid || !cpu_mask) {
+                return;
+        }
+
+        /* The target reads what we wrote before the SGI */
+        dsb_ishst();
+
+        if (version == 3) {
+                /* QEMU virt: CPU n is Aff0 = n, one cluster */
+                uint64_t sgi = ((uint64_t) intid << 24) | (cpu_mask & 0xFFFF);
+
+                MSR(ICC_SGI1R_EL1, sgi);
+                isb();
+                return;
+        }
+
+        /* TargetListFilter 0b00: the CPU interfaces in CPUTargetList */
+        mmio_write32(gicd + GICD_SGIR, ((cpu_mask & 0xFF) << 16) | intid);
+}
+
+uint8_t irq_register(uint32_t intid, irq_handler handler, void *data)
+{
+        if (GIC_MAX_INTID <= intid || !handler) {
+                return 1;
+        }
+
+        uint64_t flags = irq_save();
+
+        irq_table[intid].data = data;
+        irq_table[intid].handler = handler;
+
+        irq_restore(flags);
+
+        return 0;
+}
+
+void irq_unregister(uint32_t intid)
+{
+        if (GIC_MAX_INTID <= intid) {
+                return;
+        }
+
+        uint64_t flags = irq_save();
+
+        irq_table[intid].handler = 0;
+        irq_table[intid].data = 0;
+        irq_table[intid].nesting = 0;
+
+        irq_restore(flags);
+}
+
+void irq_set_nesting(uint32_t intid, uint8_t on)
+{
+        if (GIC_MAX_INTID <= intid) {
+                return;
+        }
+
+        irq_table[intid].nesting = on;
+}
+
+void gic_handle_irq(void)
+{
+        uint32_t iar = gic_irq_ack();
+        uint32_t intid = GIC_INTID(iar);
+
+        /* Withdrawn before we got to it, must NOT be EOI'd */
+        if (GIC_MAX_INTID <= intid) {
+                stats.spurious++;
+                return;
+        }
+
+        TRACE("[gic] IRQ intid=%u", intid);
+
+        irq_desc *desc = &irq_table[intid];
+
+        desc->count++;
+
+        if (desc->handler) {
+                stats.handled++;
+
+                /* Only higher priority IRQs get through, see GIC.h */
+                if (desc->nesting) {
+                        irq_enable();
+                        desc->handler(intid, desc->data);
+                        irq_disable();
+                } else {
+                        desc->handler(intid, desc->data);
+                }
+        } else {
+                stats.unhandled++;
+                gic_irq_disable(intid); /* Don't storm */
+                KLOG_WARN(KLOG_IRQ, "[gic] Unhandled IRQ: %u\n", intid);
+        }
+
+        gic_irq_eoi(iar);
+}
+
+gic_stats gic_get_stats(void)
+{
+        return stats;
+}
+
+uint64_t irq_count(uint32_t intid)
+{
+        return (intid < GIC_MAX_INTID) ? irq_table[intid].count : 0;
+}
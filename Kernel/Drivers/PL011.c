@@ -0,0 +1,253 @@
+/*
+ * ARM PrimeCell UART (PL011) driver
+ *
+ * Polled until interrupts are enabled, interrupt-driven afterwards:
+ *
+ *   TX: pl011_write() pushes straight into the hardware FIFO while there is
+ *       room and queues the rest into a ring. The TX interrupt (FIFO drained
+ *       below the trigger level) refills the FIFO from the ring. Nothing is
+ *       ever dropped, a full ring makes the writer drain it synchronously.
+ *
+ *   RX: RX & RX-timeout interrupts move the FIFO contents into a ring which
+ *       is consumed by pl011_getc().
+ *
+ * Each ring has its own spinlock (IRQ-saving, the handler takes them too),
+ * so CPUs can log at once; a line still goes out in one piece.
+ *
+ * Reference: DDI0183G_UART_PL011_r1p5.pdf (see Documents/)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/RegisterSet.h"
+#include "ARM64/Spinlock.h"
+
+#include "MemoryLayout.h"
+#include "Drivers/GIC.h"
+#include "Drivers/PL011.h"
+
+#define TX_MASK (PL011_TX_BUF_SIZE - 1)
+#define RX_MASK (PL011_RX_BUF_SIZE - 1)
+
+/* Usable before pl011_init(), the Shim already configured the hardware */
+static uint64_t uart_base = PL011_BASE;
+static uint8_t irq_mode = 0;
+
+/* Free running indices, 'head - tail' is the number of queued bytes */
+static char tx_buf[PL011_TX_BUF_SIZE];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static spinlock tx_lock = SPINLOCK_INIT;
+
+static char rx_buf[PL011_RX_BUF_SIZE];
+static uint32_t rx_head = 0;
+static uint32_t rx_tail = 0;
+static spinlock rx_lock = SPINLOCK_INIT;
+
+/* Statistics */
+static uint64_t rx_dropped = 0;
+
+/* Move queued bytes into the TX FIFO until it is full. Holds 'tx_lock' */
+static void _tx_fill(void)
+{
+        while (tx_tail != tx_head) {
+                uint32_t fr = pl011_reg_read(uart_base, PL011_FR);
+
+                if (fr & PL011_FR_TXFE) {
+                        /* Whole FIFO is free, skip reading FR per byte */
+                        uint32_t burst = tx_head - tx_tail;
+
+                        if (PL011_FIFO_DEPTH < burst) {
+                                burst = PL011_FIFO_DEPTH;
+                        }
+
+                        for (; burst; burst--) {
+                                pl011_reg_write(uart_base, PL011_DR,
+                                        tx_buf[tx_tail++ & TX_MASK]);
+                        }
+                } else if (!(fr & PL011_FR_TXFF)) {
+                        pl011_reg_write(uart_base, PL011_DR,
+                                tx_buf[tx_tail++ & TX_MASK]);
+                } else {
+                        break;
+                }
+        }
+}
+
+/* Busy-wait until the ring is empty. Holds 'tx_lock' */
+static void _tx_drain(void)
+{
+        while (tx_tail != tx_head) {
+                _tx_fill();
+        }
+}
+
+static void _tx_irq_update(void)
+{
+        uint32_t imsc = pl011_reg_read(uart_base, PL011_IMSC);
+
+        if (tx_tail != tx_head) {
+                imsc |= PL011_INT_TX;
+        } else {
+                imsc &= ~PL011_INT_TX;
+        }
+
+        pl011_reg_write(uart_base, PL011_IMSC, imsc);
+}
+
+void pl011_init(uint64_t base)
+{
+        uart_base = base;
+
+        /* Shim normally did this, but don't rely on it */
+        if (!(pl011_reg_read(uart_base, PL011_CR) & PL011_CR_UARTEN)) {
+                pl011_hw_init(uart_base, PL011_CLK_HZ, PL011_BAUD);
+        }
+
+        tx_head = tx_tail = 0;
+        rx_head = rx_tail = 0;
+        irq_mode = 0;
+}
+
+void pl011_irq_enable(uint32_t intid)
+{
+        uint64_t flags = irq_save();
+
+        pl011_reg_write(uart_base, PL011_ICR, PL011_INT_ALL);
+        pl011_reg_write(uart_base, PL011_IMSC,
+                PL011_INT_RX | PL011_INT_RT);
+
+        irq_register(intid, pl011_handle_irq, 0);
+        irq_set_nesting(intid, 1); /* FIFO draining is slow, timers first */
+        gic_irq_set_priority(intid, GIC_PRIO_DEFAULT);
+        gic_irq_enable(intid);
+
+        irq_mode = 1;
+
+        irq_restore(flags);
+}
+
+void pl011_write(const char *buf, uint64_t len)
+{
+        if (!buf || !len) {
+                return;
+        }
+
+        if (!irq_mode) {
+                pl011_write_sync(uart_base, buf, len);
+                return;
+        }
+
+        uint64_t flags = spin_lock_irqsave(&tx_lock);
+
+        /* Keep ordering: only bypass the ring if it is empty */
+        if (tx_tail == tx_head) {
+                while (len && !(pl011_reg_read(uart_base, PL011_FR) &
+                                PL011_FR_TXFF)) {
+                        pl011_reg_write(uart_base, PL011_DR, *buf++);
+                        len--;
+                }
+        }
+
+        while (len) {
+                if (tx_head - tx_tail == PL011_TX_BUF_SIZE) {
+                        /* Ring is full. Make room the slow way */
+                        _tx_fill();
+                        continue;
+                }
+
+                tx_buf[tx_head++ & TX_MASK] = *buf++;
+                len--;
+        }
+
+        /*
+         * Called with IRQs masked (e.g. from an exception handler or before
+         * a wfi() that never returns)? The TX interrupt won't be taken
+         * anytime soon, so push everything out now.
+         */
+        if (flags & DAIF_IRQ) {
+                _tx_drain();
+        }
+
+        _tx_irq_update();
+
+        spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+void pl011_flush(void)
+{
+        uint64_t flags = spin_lock_irqsave(&tx_lock);
+
+        _tx_drain();
+        _tx_irq_update();
+
+        while (pl011_reg_read(uart_base, PL011_FR) & PL011_FR_BUSY);
+
+        spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+int pl011_getc(void)
+{
+        int c = -1;
+        uint64_t flags = spin_lock_irqsave(&rx_lock);
+
+        if (rx_tail != rx_head) {
+                c = (unsigned char) rx_buf[rx_tail++ & RX_MASK];
+        } else if (!irq_mode && !(pl011_reg_read(uart_base, PL011_FR) &
+                        PL011_FR_RXFE)) {
+                c = pl011_reg_read(uart_base, PL011_DR) & 0xFF;
+        }
+
+        spin_unlock_irqrestore(&rx_lock, flags);
+
+        return c;
+}
+
+void pl011_handle_irq(uint32_t intid, void *data)
+{
+        (void) intid;
+        (void) data;
+
+        uint32_t mis = pl011_reg_read(uart_base, PL011_MIS);
+
+        if (mis & (PL011_INT_RX | PL011_INT_RT | PL011_INT_ERR)) {
+                /* IRQs are on here (nestable handler) */
+                uint64_t flags = spin_lock_irqsave(&rx_lock);
+
+                while (!(pl011_reg_read(uart_base, PL011_FR) &
+                                PL011_FR_RXFE)) {
+                        uint32_t dr = pl011_reg_read(uart_base, PL011_DR);
+
+                        /* DR[11:8] carry the OE/BE/PE/FE error bits */
+                        if (dr & 0xF00) {
+                                rx_dropped++;
+                                continue;
+                        }
+
+                        if (rx_head - rx_tail == PL011_RX_BUF_SIZE) {
+                                rx_dropped++;
+                                continue;
+                        }
+
+                        rx_buf[rx_head++ & RX_MASK] = (char) dr;
+                }
+
+                spin_unlock_irqrestore(&rx_lock, flags);
+
+                pl011_reg_write(uart_base, PL011_ICR,
+                        PL011_INT_RX | PL011_INT_RT | PL011_INT_ERR);
+        }
+
+        /* A nested handler may pl011_write() into the TX ring */
+        if (mis & PL011_INT_TX) {
+                uint64_t flags = spin_lock_irqsave(&tx_lock);
+
+                _tx_fill();
+                _tx_irq_update();
+
+                spin_unlock_irqrestore(&tx_lock, flags);
+        }
+}
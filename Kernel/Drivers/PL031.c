@@ -0,0 +1,141 @@
+/*
+ * ARM PrimeCell Real Time Clock (PL031) driver
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "MemoryLayout.h"
+#include "Drivers/GIC.h"
+#include "Drivers/PL031.h"
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/Console.h"
+#include "LibKern/Time.h"
+#include "LibKern/Timer.h"
+
+static uint64_t rtc_base = PL031_BASE;
+static uint8_t anchored = 0; /* Seen at least one exact edge */
+static ktimer sync_timer;
+static pl031_stats stats = {0};
+
+static inline uint32_t _reg_read(uint32_t reg)
+{
+        return mmio_read32(rtc_base + reg);
+}
+
+static inline void _reg_write(uint32_t reg, uint32_t val)
+{
+        mmio_write32(rtc_base + reg, val);
+}
+
+uint32_t pl031_read_sec(void)
+{
+        return _reg_read(PL031_DR);
+}
+
+void pl031_init(uint64_t base)
+{
+        rtc_base = base;
+
+        if (!(_reg_read(PL031_CR) & PL031_CR_START)) {
+                _reg_write(PL031_CR, PL031_CR_START);
+        }
+
+        _reg_write(PL031_IMSC, 0);
+        _reg_write(PL031_ICR, PL031_INT_MATCH);
+
+        /* Somewhere within the current second, refined on the next edge */
+        ktime_set_real_ns((uint64_t) pl031_read_sec() * NANO_PER_SEC);
+
+        KLOG_INFO(KLOG_DRIVER, "[pl031] RTC: %u s since the epoch\n",
+                pl031_read_sec());
+}
+
+static void _sync_timer_fn(ktimer *t)
+{
+        (void) t;
+
+        pl031_sync();
+}
+
+void pl031_irq_enable(uint32_t intid)
+{
+        ktimer_init(&sync_timer, _sync_timer_fn, 0);
+
+        irq_register(intid, pl031_handle_irq, 0);
+        gic_irq_set_priority(intid, GIC_PRIO_DEFAULT);
+        gic_irq_enable(intid);
+
+        pl031_sync();
+}
+
+void pl031_sync(void)
+{
+        uint64_t flags = irq_save();
+
+        _reg_write(PL031_MR, pl031_read_sec() + 1);
+        _reg_write(PL031_ICR, PL031_INT_MATCH);
+        _reg_write(PL031_IMSC, PL031_INT_MATCH);
+
+        irq_restore(flags);
+}
+
+void pl031_handle_irq(uint32_t intid, void *data)
+{
+        (void) intid;
+        (void) data;
+
+        /* Sample the clock first, this is the edge */
+        uint64_t real_ns = ktime_get_real_ns();
+        uint32_t sec = _reg_read(PL031_MR);
+
+        if (!(_reg_read(PL031_MIS) & PL031_INT_MATCH)) {
+                return;
+        }
+
+        /* One-shot, the match stays true for the whole second */
+        _reg_write(PL031_IMSC, 0);
+        _reg_write(PL031_ICR, PL031_INT_MATCH);
+
+        int64_t err = (int64_t) ((uint64_t) sec * NANO_PER_SEC - real_ns);
+        uint64_t abs_err = (err < 0) ? -(uint64_t) err : (uint64_t) err;
+
+        stats.syncs++;
+        stats.last_error_ns = err;
+
+        if (!anchored || PL031_STEP_NS < abs_err) {
+                ktime_set_real_ns(real_ns + err);
+                stats.steps++;
+                anchored = 1;
+        } else {
+                /*
+                 * Counter drift is tiny (ppm), so the error is mostly IRQ
+                 * latency noise: move towards the RTC, never jump
+                 */
+                int64_t adj = err / 2;
+
+                if ((int64_t) PL031_SLEW_MAX_NS < adj) {
+                        adj = PL031_SLEW_MAX_NS;
+                } else if (adj < -(int64_t) PL031_SLEW_MAX_NS) {
+                        adj = -(int64_t) PL031_SLEW_MAX_NS;
+                }
+
+                ktime_set_real_ns(ktime_get_real_ns() + adj);
+        }
+
+        KLOG_DEBUG(KLOG_DRIVER, "[pl031] sync #%lu: error %ld ns\n",
+                stats.syncs, err);
+
+        uint64_t period = (uint64_t) PL031_SYNC_PERIOD_SEC * NANO_PER_SEC;
+
+        ktimer_arm(&sync_timer, ktime_get_ns() + period);
+}
+
+pl031_stats pl031_get_stats(void)
+{
+        return stats;
+}
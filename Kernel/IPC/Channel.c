@@ -0,0 +1,208 @@
+/*
+ * Asynchronous IPC channels, see Channel.h
+ *
+ * The kernel never touches the messages, only a ring's 'idle' word & its
+ * one waiter, both under the channel's lock: the doorbell & the sleep
+ * can't cross.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/Spinlock.h"
+
+#include "IPC/Channel.h"
+#include "IPC/Ring.h"
+
+#include "Memory/Grant.h"
+#include "Memory/PageTable.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+typedef struct channel {
+        spinlock lock;
+        ring *r[2];                     /* CHAN_SQ, CHAN_CQ */
+        thread *waiter[2];              /* Their consumer, asleep */
+        pgtbl *pt[2];                   /* Their consumer's space */
+} __attribute__((aligned(64))) channel;
+
+static channel channels[CHAN_MAX];
+static uint32_t nr_channels;
+static spinlock create_lock = SPINLOCK_INIT;    /* Creators only */
+
+static channel *_channel(uint32_t ch, uint32_t which)
+{
+        if (__atomic_load_n(&nr_channels, __ATOMIC_ACQUIRE) <= ch ||
+                1 < which) {
+                return 0;
+        }
+
+        return &channels[ch];
+}
+
+int32_t chan_create(void *mem, uint32_t slots)
+{
+        if (!mem || !slots || (slots & (slots - 1)) ||
+                ((uint64_t) mem & 63)) {
+                return CHAN_EINVAL;
+        }
+
+        ring *sq = (ring*) mem;
+        ring *cq = (ring*) ((uint8_t*) mem + ring_bytes(slots));
+        uint64_t flags = irq_save();
+
+        /* Set up, then published: _channel() never sees one half done */
+        spin_lock(&create_lock);
+
+        uint32_t ch = __atomic_load_n(&nr_channels, __ATOMIC_RELAXED);
+
+        if (ch < CHAN_MAX) {
+                channel *c = &channels[ch];
+
+                spin_lock_init(&c->lock);
+                ring_init(sq, slots);
+                ring_init(cq, slots);
+                c->r[CHAN_SQ] = sq;
+                c->r[CHAN_CQ] = cq;
+                c->waiter[CHAN_SQ] = 0;
+                c->waiter[CHAN_CQ] = 0;
+                c->pt[CHAN_SQ] = 0;
+                c->pt[CHAN_CQ] = 0;
+                __atomic_store_n(&nr_channels, ch + 1, __ATOMIC_RELEASE);
+        }
+
+        spin_unlock(&create_lock);
+        irq_restore(flags);
+
+        return (ch < CHAN_MAX) ? (int32_t) ch : CHAN_EINVAL;
+}
+
+ring *chan_ring(uint32_t ch, uint32_t which)
+{
+        channel *c = _channel(ch, which);
+
+        return c ? c->r[which] : 0;
+}
+
+int64_t chan_wait(uint32_t ch, uint32_t which)
+{
+        channel *c = _channel(ch, which);
+
+        if (!c) {
+                return CHAN_EINVAL;
+        }
+
+        uint64_t flags = irq_save();
+        thread *self = current_thread();
+        ring *r = c->r[which];
+
+        spin_lock(&c->lock);
+
+        /* Rang already, or pushed to since it looked */
+        if (!__atomic_load_n(&r->idle, __ATOMIC_RELAXED) || ring_count(r)) {
+                ring_wake(r);
+                spin_unlock(&c->lock);
+                irq_restore(flags);
+                return CHAN_OK;
+        }
+
+        sched_prepare_sleep(&self->se);
+        c->waiter[which] = self;
+        spin_unlock(&c->lock);
+
+        schedule(); /* chan_notify() */
+
+        irq_restore(flags);
+        return CHAN_OK;
+}
+
+int64_t chan_notify(uint32_t ch, uint32_t which)
+{
+        channel *c = _channel(ch, which);
+
+        if (!c) {
+                return CHAN_EINVAL;
+        }
+
+        uint64_t flags = irq_save();
+
+        spin_lock(&c->lock);
+
+        thread *w = c->waiter[which];
+
+        c->waiter[which] = 0;
+        ring_wake(c->r[which]);
+        spin_unlock(&c->lock);
+
+        /* Queued, not handed off: the producer may have more to push */
+        if (w) {
+                sched_wakeup(&w->se);
+        }
+
+        irq_restore(flags);
+        return CHAN_OK;
+}
+
+int64_t chan_attach(uint32_t ch, uint32_t which, pgtbl *pt)
+{
+        channel *c = _channel(ch, which);
+
+        if (!c) {
+                return CHAN_EINVAL;
+        }
+
+        __atomic_store_n(&c->pt[which], pt, __ATOMIC_RELEASE);
+
+        return CHAN_OK;
+}
+
+/* Both spaces attached & the caller in the producer's (or a kernel thread) */
+static uint8_t _spaces(channel *c, uint32_t which, pgtbl **from, pgtbl **to)
+{
+        addr_space *self = current_thread()->space;
+
+        *to = __atomic_load_n(&c->pt[which], __ATOMIC_ACQUIRE);
+        *from = __atomic_load_n(&c->pt[!which], __ATOMIC_ACQUIRE);
+
+        return *to && *from && (!self || &self->pt == *from);
+}
+
+int64_t chan_grant(uint32_t ch, uint32_t which, uint64_t va, uint64_t to_va,
+                   uint64_t pages, uint32_t flags)
+{
+        channel *c = _channel(ch, which);
+        pgtbl *from;
+        pgtbl *to;
+
+        if (!c) {
+                return CHAN_EINVAL;
+        }
+
+        if (!_spaces(c, which, &from, &to)) {
+                return CHAN_EPERM;
+        }
+
+        return vm_grant(from, va, to, to_va, pages, flags);
+}
+
+int64_t chan_revoke(uint32_t ch, uint32_t which, uint64_t to_va,
+                    uint64_t pages)
+{
+        channel *c = _channel(ch, which);
+
+        if (!c) {
+                return CHAN_EINVAL;
+        }
+
+        pgtbl *from;
+        pgtbl *to;
+
+        if (!_spaces(c, which, &from, &to)) {
+                return CHAN_EPERM;
+        }
+
+        return vm_revoke(to, to_va, pages);
+}
@@ -0,0 +1,298 @@
+/*
+ * Synchronous IPC, see IPC.h
+ *
+ * An endpoint's queues & the ipc_* fields of the threads on them belong
+ * to its lock. A thread goes on a queue already sched_prepare_sleep()'d,
+ * so whoever takes it off can wake it (or switch to it) right away, even
+ * before it's done switching away.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+#include "ARM64/Spinlock.h"
+
+#include "IPC/IPC.h"
+
+#include "LibKern/List.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+#include "Syscall.h"
+
+enum ipc_state {
+        IPC_IDLE,
+        IPC_SENDING,                    /* On 'senders' */
+        IPC_CALLING,                    /* On 'senders', then waits a reply */
+        IPC_RECEIVING,                  /* On 'receivers' */
+        IPC_REPLY_WAIT                  /* Someone's ipc_caller */
+};
+
+typedef struct ipc_endpoint {
+        spinlock lock;
+        list_node senders;
+        list_node receivers;
+} __attribute__((aligned(64))) ipc_endpoint;
+
+static ipc_endpoint endpoints[IPC_ENDPOINTS];
+static uint32_t nr_endpoints;
+static spinlock create_lock = SPINLOCK_INIT;    /* Creators only */
+
+static void _copy(uint64_t *to, const uint64_t *from)
+{
+        for (uint32_t i = 0; i < IPC_MRS; i++) {
+                to[i] = from[i];
+        }
+}
+
+static ipc_endpoint *_endpoint(uint32_t ep)
+{
+        if (__atomic_load_n(&nr_endpoints, __ATOMIC_ACQUIRE) <= ep) {
+                return 0;
+        }
+
+        return &endpoints[ep];
+}
+
+static thread *_pop(list_node *queue)
+{
+        list_node *n = list_pop(queue);
+
+        return n ? CONTAINER_OF(n, thread, ipc_node) : 0;
+}
+
+/* Lock held, IRQs masked. Onto 'queue' asleep, switch after unlocking */
+static void _block(list_node *queue, thread *self, uint64_t *mr,
+                   uint32_t state)
+{
+        self->ipc_mr = mr;
+        self->ipc_state = state;
+        sched_prepare_sleep(&self->se);
+        list_add_tail(queue, &self->ipc_node);
+}
+
+/* Set up, then published: _endpoint() never sees one half done */
+int32_t ipc_endpoint_create(void)
+{
+        uint64_t flags = irq_save();
+
+        spin_lock(&create_lock);
+
+        uint32_t ep = __atomic_load_n(&nr_endpoints, __ATOMIC_RELAXED);
+
+        if (ep < IPC_ENDPOINTS) {
+                spin_lock_init(&endpoints[ep].lock);
+                list_init(&endpoints[ep].senders);
+                list_init(&endpoints[ep].receivers);
+                __atomic_store_n(&nr_endpoints, ep + 1, __ATOMIC_RELEASE);
+        }
+
+        spin_unlock(&create_lock);
+        irq_restore(flags);
+
+        return (ep < IPC_ENDPOINTS) ? (int32_t) ep : IPC_EINVAL;
+}
+
+/* Both send & call: 'call' waits for the reply in 'mr' */
+static int64_t _send(uint32_t ep, uint64_t *mr, uint8_t call)
+{
+        ipc_endpoint *e = _endpoint(ep);
+
+        if (!e) {
+                return IPC_EINVAL;
+        }
+
+        uint64_t flags = irq_save();
+        thread *self = current_thread();
+
+        spin_lock(&e->lock);
+
+        thread *r = _pop(&e->receivers);
+
+        if (!r) {
+                _block(&e->senders, self, mr,
+                        call ? IPC_CALLING : IPC_SENDING);
+                spin_unlock(&e->lock);
+
+                schedule(); /* A receiver took it (& replied, for a call) */
+
+                irq_restore(flags);
+                return IPC_OK;
+        }
+
+        _copy(r->ipc_mr, mr);
+        r->ipc_state = IPC_IDLE;
+        r->ipc_caller = call ? self : 0;
+
+        if (call) {
+                self->ipc_mr = mr;
+                self->ipc_state = IPC_REPLY_WAIT;
+                sched_prepare_sleep(&self->se);
+        }
+
+        spin_unlock(&e->lock);
+
+        /* Fast path: its turn now, on our time slice */
+        sched_handoff(&r->se);
+
+        irq_restore(flags);
+        return IPC_OK;
+}
+
+int64_t ipc_send(uint32_t ep, uint64_t mr[IPC_MRS])
+{
+        return _send(ep, mr, 0);
+}
+
+int64_t ipc_call(uint32_t ep, uint64_t mr[IPC_MRS])
+{
+        return _send(ep, mr, 1);
+}
+
+/* Lock held: a waiting sender's message, 0 if there's none */
+static thread *_take(ipc_endpoint *e, thread *self, uint64_t *mr)
+{
+        thread *s = _pop(&e->senders);
+
+        if (!s) {
+                return 0;
+        }
+
+        _copy(mr, s->ipc_mr);
+
+        if (s->ipc_state == IPC_CALLING) {
+                s->ipc_state = IPC_REPLY_WAIT; /* Still asleep */
+                self->ipc_caller = s;
+        } else {
+                s->ipc_state = IPC_IDLE;
+                self->ipc_caller = 0;
+        }
+
+        return s;
+}
+
+/* The caller waiting for our reply, now out of IPC_REPLY_WAIT */
+static thread *_reply_to(thread *self, const uint64_t *mr)
+{
+        thread *c = self->ipc_caller;
+
+        if (c) {
+                self->ipc_caller = 0;
+                _copy(c->ipc_mr, mr);
+                c->ipc_state = IPC_IDLE;
+        }
+
+        return c;
+}
+
+int64_t ipc_recv(uint32_t ep, uint64_t mr[IPC_MRS])
+{
+        ipc_endpoint *e = _endpoint(ep);
+
+        if (!e) {
+                return IPC_EINVAL;
+        }
+
+        uint64_t flags = irq_save();
+        thread *self = current_thread();
+
+        spin_lock(&e->lock);
+
+        thread *s = _take(e, self, mr);
+
+        if (!s) {
+                _block(&e->receivers, self, mr, IPC_RECEIVING);
+        }
+
+        spin_unlock(&e->lock);
+
+        if (!s) {
+                schedule(); /* A sender filled 'mr' */
+        } else if (self->ipc_caller != s) {
+                sched_wakeup(&s->se); /* A send, it's done */
+        }
+
+        irq_restore(flags);
+        return IPC_OK;
+}
+
+int64_t ipc_reply(uint64_t mr[IPC_MRS])
+{
+        uint64_t flags = irq_save();
+        thread *c = _reply_to(current_thread(), mr);
+
+        if (c) {
+                sched_wakeup(&c->se);
+        }
+
+        irq_restore(flags);
+
+        return c ? IPC_OK : IPC_ENOCALLER;
+}
+
+int64_t ipc_reply_wait(uint32_t ep, uint64_t mr[IPC_MRS])
+{
+        ipc_endpoint *e = _endpoint(ep);
+
+        if (!e) {
+                return IPC_EINVAL;
+        }
+
+        uint64_t flags = irq_save();
+        thread *self = current_thread();
+        thread *c = _reply_to(self, mr);
+
+        spin_lock(&e->lock);
+
+        thread *s = _take(e, self, mr);
+
+        if (!s) {
+                /* Waiting before the caller runs: its next call is fast */
+                _block(&e->receivers, self, mr, IPC_RECEIVING);
+        }
+
+        spin_unlock(&e->lock);
+
+        if (s && self->ipc_caller != s) {
+                sched_wakeup(&s->se);
+        }
+
+        if (!c) {
+                if (!s) {
+                        schedule();
+                }
+        } else if (!s) {
+                sched_handoff(&c->se); /* Back to the caller, on our slice */
+        } else {
+                sched_wakeup(&c->se);  /* More work queued, keep going */
+        }
+
+        irq_restore(flags);
+        return IPC_OK;
+}
+
+int64_t ipc_syscall(uint64_t *mr, uint64_t op, uint64_t ep)
+{
+        /* Not truncated into a valid one */
+        if (IPC_ENDPOINTS <= ep && op + SYS_IPC_FIRST != SYS_IPC_REPLY) {
+                return IPC_EINVAL;
+        }
+
+        switch (op + SYS_IPC_FIRST) {
+        case SYS_IPC_SEND:
+                return ipc_send(ep, mr);
+        case SYS_IPC_RECV:
+                return ipc_recv(ep, mr);
+        case SYS_IPC_CALL:
+                return ipc_call(ep, mr);
+        case SYS_IPC_REPLY:
+                return ipc_reply(mr);
+        case SYS_IPC_REPLY_WAIT:
+                return ipc_reply_wait(ep, mr);
+        default:
+                return SYS_ENOSYS;
+        }
+}
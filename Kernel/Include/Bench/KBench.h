@@ -0,0 +1,60 @@
+/*
+ * In-kernel micro benchmarks (QEMU or real hardware)
+ *
+ * Built only with 'make kernel KBENCH=True', which adds -DKBENCH and the
+ * Kernel/Bench sources. kmain() then runs every suite once after the
+ * interrupt controller & timers are up, and logs one line per benchmark:
+ *
+ *      [kbench] svc_null            min    120 avg    131 max   2310 cyc
+ *
+ * Cycles come from PMCCNTR_EL0 when a PMUv3 is implemented, from
+ * CNTVCT_EL0 (counter ticks) otherwise; the unit is printed either way.
+ * Under QEMU TCG both are derived from the host clock, compare numbers
+ * against each other, not against real silicon.
+ *
+ * Hardware independent code is benchmarked on the host instead
+ * (see the Tests/...Bench.cpp files).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef KBENCH_H
+#define KBENCH_H
+
+#include <stdint.h>
+
+#define KBENCH_ITERS    10000
+#define KBENCH_BRK_IMM  0x4B42  /* 'KB', skipped by handle_spx_syn() */
+#define KBENCH_SGI      15      /* Self-IPI for the IRQ round trip */
+
+typedef struct kbench_stat {
+        uint64_t min;
+        uint64_t max;
+        uint64_t total;
+        uint64_t n;
+} kbench_stat;
+
+void     kbench_run(void);
+
+uint64_t kbench_cycles(void);
+void     kbench_stat_init(kbench_stat *stat);
+void     kbench_stat_add(kbench_stat *stat, uint64_t cycles);
+void     kbench_report(const char *name, const kbench_stat *stat);
+
+/* EL0 alias of kernel code or data, 0 if none. Set up by kbench_syscall() */
+uint64_t kbench_user_va(const void *kva);
+
+/* Suites */
+void     kbench_cap(void);
+void     kbench_exception(void);
+void     kbench_fpsimd(void);
+void     kbench_ipi(void);
+void     kbench_lock(void);
+void     kbench_msg(void);
+void     kbench_sched(void);
+void     kbench_syscall(void);
+void     kbench_thread(void);
+
+#endif /* KBENCH_H */
@@ -21,4 +21,15 @@ typedef struct boot_sysinfo {
         uint64_t dtb_size;
 } boot_sysinfo;
 
+/*
+ * Secondary CPUs, given to PSCI CPU_ON as the context (physical address)
+ * Entry.S reads it by offset, keep the layout.
+ */
+typedef struct boot_cpuinfo {
+        uint64_t stack_pa;      /* 0:  Top, until the MMU is on */
+        uint64_t stack_va;      /* 8:  Top, from then on */
+        uint64_t entry;         /* 16: Kernel function, called with 'arg' */
+        uint64_t arg;           /* 24 */
+} boot_cpuinfo;
+
 #endif /* BOOT_H */
\ No newline at end of file
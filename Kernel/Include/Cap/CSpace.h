@@ -0,0 +1,186 @@
+/*
+ * Capability spaces: CNodes, radix tables of capability slots
+ *
+ * A CNode is 2^radix slots. A capability pointer (cptr) is resolved like
+ * a page table walk, most significant bits first: at each CNode its
+ * 'guard_bits' next bits have to equal its 'guard', the 'radix' after
+ * them index the slot. If bits are left & the slot holds a CNode, the
+ * walk goes on in there. So a whole 64-bit cptr resolves in one or two
+ * loads of a slot, and big guards let a sparse space skip levels:
+ *
+ *      root CNode, radix 8, guard 0 of 56 bits: cptrs 0-255, 1 level
+ *      root radix 4, guard 0 of 52 bits -> CNodes of radix 8: cptr
+ *      (i << 8 | j) is slot j of the CNode in slot i, 2 levels
+ *
+ * cspace_lookup() unrolls the first 2 levels (the common layouts) and
+ * only loops past them. A lookup is shifts, masks & one cache line per
+ * level: a slot (cte) is a cache line, its capability & its links in the
+ * derivation tree.
+ *
+ * Derivation: a capability derived (cap_derive(), with at most the same
+ * rights & maybe a badge) is a child of the one it came from. cap_revoke()
+ * deletes every descendant, cap_delete() one slot, its children moving up
+ * to its parent.
+ *
+ * CNodes of up to CNODE_SLAB_RADIX come from per-size slab caches (see
+ * Memory/Slab.h), bigger ones straight from nb_alloc(). cnode_init() takes
+ * the caller's memory instead. A cnode_create()'d CNode is freed, with
+ * everything in it, when its last capability in a slot is deleted: one
+ * with no parent, no children & no siblings left.
+ *
+ * Nothing is locked: changes to a CSpace & lookups in it are serialized
+ * by its owner. Hardware independent, unit tested on the host (see
+ * Tests/CSpaceTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef CSPACE_H
+#define CSPACE_H
+
+#include <stdint.h>
+
+#define CAP_NULL        0       /* Empty slot */
+#define CAP_CNODE       1
+#define CAP_ENDPOINT    2       /* IPC/IPC.h */
+#define CAP_CHANNEL     3       /* IPC/Channel.h */
+#define CAP_FRAME       4       /* A physical page */
+
+#define CAP_READ        0x1
+#define CAP_WRITE       0x2
+#define CAP_GRANT       0x4
+#define CAP_ALL         (CAP_READ | CAP_WRITE | CAP_GRANT)
+
+#define CAP_F_ALLOCATED 0x1     /* CNODE: slots from cnode_create() */
+
+#define CAP_OK          0
+#define CAP_EINVAL      -2
+#define CAP_ENOMEM      -6
+#define CAP_EPERM       -7      /* More rights, or a second badge */
+#define CAP_EEXIST      -8      /* Slot in use */
+#define CAP_ENOENT      -9      /* Slot empty */
+
+#define CNODE_RADIX_MAX         15      /* 2 MiB of slots, nb_alloc()'s max */
+#define CNODE_SLAB_RADIX        8       /* Up to 16 KiB: slab caches */
+
+#define CPTR_BITS               64
+
+typedef struct cap {
+        uint8_t type;
+        uint8_t rights;
+        uint8_t radix;                  /* CNODE: log2 of its slots */
+        uint8_t guard_bits;             /* CNODE */
+        uint32_t flags;                 /* CAP_F_* */
+        uint64_t guard;                 /* CNODE */
+        uint64_t obj;                   /* CNODE: its slots, or the object */
+        uint64_t badge;                 /* 0: none */
+} cap;
+
+/* A slot */
+typedef struct cte {
+        cap cap;
+        struct cte *parent;             /* Derived from */
+        struct cte *child;              /* First derived from this one */
+        struct cte *prev;               /* Siblings */
+        struct cte *next;
+} __attribute__((aligned(64))) cte;
+
+/* The slab caches, after nb_init() */
+void cspace_init(void);
+
+/* CNODE 'cn''s slots over 'slots' (2^radix ctes, zeroed), CAP_EINVAL */
+int cnode_init(cap *cn, cte *slots, uint32_t radix, uint32_t guard_bits,
+               uint64_t guard);
+
+/* The same, slots allocated. CAP_ENOMEM */
+int cnode_create(cap *cn, uint32_t radix, uint32_t guard_bits,
+                 uint64_t guard);
+
+/*
+ * Deletes every capability in a cnode_create()'d CNODE, frees it. For one
+ * held outside any slot (a root), those in slots go through cap_delete()
+ */
+void cnode_destroy(cap *cn);
+
+static inline cte *cnode_slot(const cap *cn, uint64_t i)
+{
+        return &((cte*) cn->obj)[i];
+}
+
+/* cspace_lookup(), looping through any number of levels */
+cte *cspace_lookup_slow(const cap *cn, uint64_t cptr, uint32_t depth);
+
+/*
+ * One level: 'guard_bits' & 'radix' of the 'depth' left. 0 if they don't
+ * fit or the guard doesn't match
+ */
+static inline cte *__cspace_level(const cap *cn, uint64_t cptr,
+                                  uint32_t *depth)
+{
+        uint32_t g = cn->guard_bits;
+        uint32_t r = cn->radix;
+        uint32_t d = *depth;
+
+        if (d < g + r) {
+                return 0;
+        }
+
+        d -= g + r;
+
+        /* g + r <= CPTR_BITS & r >= 1: no shift by 64 */
+        if (g && ((cptr >> (d + r)) & ((1ULL << g) - 1)) != cn->guard) {
+                return 0;
+        }
+
+        *depth = d;
+
+        return cnode_slot(cn, (cptr >> d) & ((1ULL << r) - 1));
+}
+
+/*
+ * The slot for 'cptr' resolving 'depth' bits (CPTR_BITS: all of it) from
+ * the root CNODE 'cn', 0 if there's none. The slot may be empty.
+ */
+static inline cte *cspace_lookup(const cap *cn, uint64_t cptr, uint32_t depth)
+{
+        cte *slot = __cspace_level(cn, cptr, &depth);
+
+        if (!slot || !depth) {
+                return slot;
+        }
+
+        if (slot->cap.type != CAP_CNODE) {
+                return 0;
+        }
+
+        slot = __cspace_level(&slot->cap, cptr, &depth);
+
+        if (!slot || !depth) {
+                return slot;
+        }
+
+        return cspace_lookup_slow(&slot->cap, cptr, depth);
+}
+
+/* A new (underived) capability into the empty 'slot' */
+int cap_insert(cte *slot, const cap *c);
+
+/*
+ * A copy of 'src' into the empty 'dest', its child: with 'rights' (no
+ * more than 'src' has) & 'badge' (0: keep 'src''s, which can't be changed
+ * once set)
+ */
+int cap_derive(cte *dest, cte *src, uint8_t rights, uint64_t badge);
+
+/*
+ * Empties 'slot', its children become its parent's. The last capability
+ * to a cnode_create()'d CNODE destroys it (cnode_destroy())
+ */
+int cap_delete(cte *slot);
+
+/* Deletes everything derived from 'slot', returns how many */
+int64_t cap_revoke(cte *slot);
+
+#endif /* CSPACE_H */
@@ -0,0 +1,118 @@
+/*
+ * ARM Generic Interrupt Controller (GICv2 & GICv3) driver
+ *
+ * The version is picked from the Device Tree ("arm,gic-v3" or
+ * "arm,cortex-a15-gic"), GICv2 at the MemoryLayout.h addresses otherwise.
+ *
+ * Interrupts are dispatched through a table indexed by INTID. Drivers
+ * register a handler with irq_register() and the IRQ vector calls
+ * gic_handle_irq(), which costs exactly one acknowledge & one EOI:
+ * a GICC_IAR read & a GICC_EOIR write on GICv2, system registers on GICv3.
+ *
+ * Nesting is opt-in per INTID (irq_set_nesting()): such a handler runs with
+ * IRQs unmasked, and the GIC only signals IRQs of a higher priority than
+ * the running one, e.g. the timer (GIC_PRIO_HIGHEST). The handler must
+ * irq_save() around state it shares with those. IRQs are masked again
+ * before the EOI, so equal priorities never stack up.
+ *
+ * Reference: ARM IHI 0048B (GICv2 Architecture Specification)
+ *            ARM IHI 0069H (GICv3 & GICv4 Architecture Specification)
+ *
+ * Author: Tuna CICI
+ */
+
+#ifndef GIC_H
+#define GIC_H
+
+#include <stdint.h>
+
+/* Distributor registers (offsets from GICD_BASE) */
+#define GICD_CTLR               0x000
+#define GICD_TYPER              0x004
+#define GICD_IGROUPR(n)         (0x080 + 4 * (n))
+#define GICD_ISENABLER(n)       (0x100 + 4 * (n))
+#define GICD_ICENABLER(n)       (0x180 + 4 * (n))
+#define GICD_ICPENDR(n)         (0x280 + 4 * (n))
+#define GICD_IPRIORITYR(n)      (0x400 + 4 * (n))
+#define GICD_ITARGETSR(n)       (0x800 + 4 * (n))
+#define GICD_ICFGR(n)           (0xC00 + 4 * (n))
+#define GICD_SGIR               0xF00           /* v2 only */
+#define GICD_IROUTER(intid)     (0x6000 + 8 * (intid)) /* v3 only */
+
+/* CPU interface registers (offsets from GICC_BASE, v2 only) */
+#define GICC_CTLR               0x000
+#define GICC_PMR                0x004
+#define GICC_BPR                0x008
+#define GICC_IAR                0x00C
+#define GICC_EOIR               0x010
+
+/* Redistributor (v3 only): RD_base frame, then SGI_base frame */
+#define GICR_CTLR               0x0000
+#define GICR_TYPER              0x0008          /* 64-bit */
+#define GICR_WAKER              0x0014
+#define GICR_SGI_OFFSET         0x10000
+#define GICR_STRIDE             0x20000         /* 2 frames (no VLPI) */
+
+#define GICD_CTLR_ENABLE        (1U << 0)       /* v2 */
+#define GICD_CTLR_GRP1          (1U << 1)       /* v3, Group 1 (NS) */
+#define GICD_CTLR_ARE           (1U << 4)       /* v3, affinity routing */
+#define GICD_CTLR_RWP           (1U << 31)      /* v3, write pending */
+#define GICC_CTLR_ENABLE        (1U << 0)
+
+#define GICR_TYPER_VLPIS        (1ULL << 1)
+#define GICR_TYPER_LAST         (1ULL << 4)
+#define GICR_TYPER_AFF(typer)   ((uint32_t) ((typer) >> 32))
+#define GICR_WAKER_SLEEP        (1U << 1)       /* ProcessorSleep */
+#define GICR_WAKER_ASLEEP       (1U << 2)       /* ChildrenAsleep */
+
+#define GICD_TYPER_ITLINES(typer) ((((typer) & 0x1F) + 1) * 32)
+
+#define GIC_INTID_MASK          0x3FFU
+#define GIC_INTID_SPURIOUS      1023U
+#define GIC_INTID(iar)          ((iar) & GIC_INTID_MASK)
+#define GIC_MAX_INTID           1020U           /* SGIs, PPIs & SPIs */
+
+#define GIC_PPI_BASE            16U
+#define GIC_SPI_BASE            32U  /* INTIDs [0, 32) are SGIs & PPIs */
+#define GIC_PRIO_HIGHEST        0x00U
+#define GIC_PRIO_DEFAULT        0xA0U
+#define GIC_PRIO_LOWEST         0xFFU
+
+typedef void (*irq_handler)(uint32_t intid, void *data);
+
+typedef struct gic_stats {
+        uint64_t handled;
+        uint64_t spurious;   /* IAR returned 1023 */
+        uint64_t unhandled;  /* No handler registered */
+} gic_stats;
+
+/* Picks GICv2/v3 from the DTB & inits the distributor + boot CPU */
+void     gic_probe(void *dtb);
+
+void     gic_init(uint64_t gicd_base, uint64_t gicc_base);    /* v2 */
+void     gic_init_v3(uint64_t gicd_base, uint64_t gicr_base);
+void     gic_cpu_init(void); /* Banked/per-CPU state, every CPU */
+
+uint8_t  gic_version(void);
+
+void     gic_irq_enable(uint32_t intid);
+void     gic_irq_disable(uint32_t intid);
+void     gic_irq_set_priority(uint32_t intid, uint8_t prio);
+void     gic_irq_set_affinity(uint32_t intid, uint32_t cpu); /* SPIs only */
+
+uint32_t gic_irq_ack(void);
+void     gic_irq_eoi(uint32_t iar);
+
+void     gic_send_sgi_self(uint32_t intid); /* SGI 0-15 to this CPU */
+void     gic_send_sgi(uint32_t intid, uint32_t cpu_mask); /* Bit per CPU */
+
+/* Dispatch table */
+uint8_t  irq_register(uint32_t intid, irq_handler handler, void *data);
+void     irq_unregister(uint32_t intid);
+void     irq_set_nesting(uint32_t intid, uint8_t on);
+void     gic_handle_irq(void);
+
+gic_stats gic_get_stats(void);
+uint64_t  irq_count(uint32_t intid);
+
+#endif /* GIC_H */
@@ -0,0 +1,168 @@
+/*
+ * ARM PrimeCell UART (PL011) driver
+ *
+ * The polled primitives below are 'static inline' on purpose. The Shim runs
+ * before the MMU is enabled and is linked separately from the kernel image,
+ * so it can NOT call into the kernel's .text. Keeping them in the header lets
+ * both the Shim (_puts) and the kernel (Console.c) share the same code.
+ *
+ * Reference: DDI0183G_UART_PL011_r1p5.pdf (see Documents/)
+ *
+ * Author: Tuna CICI
+ */
+
+#ifndef PL011_H
+#define PL011_H
+
+#include <stdint.h>
+
+/* Registers (offsets from the base address) */
+#define PL011_DR        0x000 /* Data */
+#define PL011_RSR       0x004 /* Receive status / error clear */
+#define PL011_FR        0x018 /* Flag */
+#define PL011_IBRD      0x024 /* Integer baud rate divisor */
+#define PL011_FBRD      0x028 /* Fractional baud rate divisor */
+#define PL011_LCR_H     0x02C /* Line control */
+#define PL011_CR        0x030 /* Control */
+#define PL011_IFLS      0x034 /* Interrupt FIFO level select */
+#define PL011_IMSC      0x038 /* Interrupt mask set/clear */
+#define PL011_RIS       0x03C /* Raw interrupt status */
+#define PL011_MIS       0x040 /* Masked interrupt status */
+#define PL011_ICR       0x044 /* Interrupt clear */
+
+/* FR */
+#define PL011_FR_BUSY   (1U << 3)
+#define PL011_FR_RXFE   (1U << 4) /* RX FIFO empty */
+#define PL011_FR_TXFF   (1U << 5) /* TX FIFO full */
+#define PL011_FR_RXFF   (1U << 6) /* RX FIFO full */
+#define PL011_FR_TXFE   (1U << 7) /* TX FIFO empty */
+
+/* LCR_H */
+#define PL011_LCR_H_FEN         (1U << 4) /* FIFO enable */
+#define PL011_LCR_H_WLEN_8      (0b11U << 5)
+
+/* CR */
+#define PL011_CR_UARTEN (1U << 0)
+#define PL011_CR_TXE    (1U << 8)
+#define PL011_CR_RXE    (1U << 9)
+
+/* IFLS - FIFO trigger levels */
+#define PL011_IFLS_TX_1_8       (0b000U << 0)
+#define PL011_IFLS_TX_1_4       (0b001U << 0)
+#define PL011_IFLS_RX_1_2       (0b010U << 3)
+
+/* IMSC, RIS, MIS & ICR share the same layout */
+#define PL011_INT_RX    (1U << 4)  /* RX FIFO at/above trigger level */
+#define PL011_INT_TX    (1U << 5)  /* TX FIFO at/below trigger level */
+#define PL011_INT_RT    (1U << 6)  /* RX timeout */
+#define PL011_INT_ERR   (0xFU << 7) /* Framing, parity, break & overrun */
+#define PL011_INT_ALL   0x7FFU
+
+#define PL011_FIFO_DEPTH 32U /* r1p5 has 32-entry TX & RX FIFOs */
+#define PL011_BAUD       115200U
+
+/* Software buffers used in interrupt-driven mode (must be power of 2) */
+#define PL011_TX_BUF_SIZE 4096U
+#define PL011_RX_BUF_SIZE 256U
+
+static inline uint32_t pl011_reg_read(uint64_t base, uint32_t off)
+{
+        return *(volatile uint32_t*) (base + off);
+}
+
+static inline void pl011_reg_write(uint64_t base, uint32_t off, uint32_t val)
+{
+        *(volatile uint32_t*) (base + off) = val;
+}
+
+/*
+ * Bring the UART into a known state: 8N1, FIFOs enabled, all interrupts
+ * masked. Safe to call on an already enabled UART, pending TX is drained.
+ */
+static inline void pl011_hw_init(uint64_t base, uint32_t clk_hz, uint32_t baud)
+{
+        /* divisor = clk / (16 * baud), in 16.6 fixed point (rounded) */
+        uint32_t div = (4 * clk_hz + baud / 2) / baud;
+
+        /* Finish whatever is being transmitted, then disable */
+        while (pl011_reg_read(base, PL011_FR) & PL011_FR_BUSY);
+        pl011_reg_write(base, PL011_CR, 0);
+
+        /* Flush the FIFOs by disabling them */
+        pl011_reg_write(base, PL011_LCR_H, 0);
+
+        pl011_reg_write(base, PL011_IBRD, div >> 6);
+        pl011_reg_write(base, PL011_FBRD, div & 0x3F);
+
+        /* LCR_H must be written after IBRD/FBRD to latch the divisors */
+        pl011_reg_write(base, PL011_LCR_H,
+                PL011_LCR_H_WLEN_8 | PL011_LCR_H_FEN);
+
+        pl011_reg_write(base, PL011_IFLS,
+                PL011_IFLS_TX_1_4 | PL011_IFLS_RX_1_2);
+        pl011_reg_write(base, PL011_IMSC, 0);
+        pl011_reg_write(base, PL011_ICR, PL011_INT_ALL);
+
+        pl011_reg_write(base, PL011_CR,
+                PL011_CR_UARTEN | PL011_CR_TXE | PL011_CR_RXE);
+}
+
+/*
+ * Polled, blocking write of a whole buffer.
+ *
+ * Instead of polling FR before every single character, an empty TX FIFO
+ * (FR.TXFE) means PL011_FIFO_DEPTH characters can be pushed back-to-back.
+ * Only when the FIFO is partially filled we fall back to checking FR.TXFF.
+ */
+static inline void pl011_write_sync(uint64_t base, const char *buf,
+                                    uint64_t len)
+{
+        uint64_t i = 0;
+
+        while (i < len) {
+                uint32_t fr = pl011_reg_read(base, PL011_FR);
+
+                if (fr & PL011_FR_TXFE) {
+                        uint64_t burst = len - i;
+
+                        if (PL011_FIFO_DEPTH < burst) {
+                                burst = PL011_FIFO_DEPTH;
+                        }
+
+                        for (; burst; burst--) {
+                                pl011_reg_write(base, PL011_DR, buf[i++]);
+                        }
+                } else if (!(fr & PL011_FR_TXFF)) {
+                        pl011_reg_write(base, PL011_DR, buf[i++]);
+                }
+        }
+}
+
+static inline void pl011_puts_sync(uint64_t base, const char *s)
+{
+        uint64_t len = 0;
+
+        while (s[len] != '\0') {
+                len++;
+        }
+
+        pl011_write_sync(base, s, len);
+}
+
+/*
+ * Kernel-side driver (Kernel/Drivers/PL011.c)
+ *
+ * Until pl011_irq_enable() is called everything is polled. Afterwards writes
+ * are queued into a TX ring that is drained by the TX interrupt, and received
+ * characters are collected into an RX ring by the RX/RX-timeout interrupts.
+ */
+void     pl011_init(uint64_t base);
+void     pl011_irq_enable(uint32_t intid);
+
+void     pl011_write(const char *buf, uint64_t len);
+void     pl011_flush(void);
+int      pl011_getc(void);
+
+void     pl011_handle_irq(uint32_t intid, void *data);
+
+#endif /* PL011_H */
@@ -0,0 +1,64 @@
+/*
+ * ARM PrimeCell Real Time Clock (PL031) driver
+ *
+ * The RTC only counts whole seconds and every read is a slow device access,
+ * so it is NOT used as a clock. Instead it anchors the wall-clock offset of
+ * the monotonic clocksource (see ktime_get_real_ns()):
+ *
+ *   1. At boot: RTCDR is read once, good to within a second.
+ *   2. The match interrupt (RTCMR = RTCDR + 1) fires exactly on the next
+ *      second boundary. That edge anchors the offset precisely.
+ *   3. Every PL031_SYNC_PERIOD_SEC the edge is re-armed to measure how far
+ *      the counter drifted. Small errors are slewed in gradually, large
+ *      ones (e.g. the RTC was set) are stepped.
+ *
+ * Wall-clock reads never touch the device.
+ *
+ * Reference: DDI0224C_RTC_PL031_TRM.pdf
+ *
+ * Author: Tuna CICI
+ */
+
+#ifndef PL031_H
+#define PL031_H
+
+#include <stdint.h>
+
+/* Registers (offsets from the base address) */
+#define PL031_DR        0x000 /* Data (seconds) */
+#define PL031_MR        0x004 /* Match */
+#define PL031_LR        0x008 /* Load */
+#define PL031_CR        0x00C /* Control */
+#define PL031_IMSC      0x010 /* Interrupt mask set/clear */
+#define PL031_RIS       0x014 /* Raw interrupt status */
+#define PL031_MIS       0x018 /* Masked interrupt status */
+#define PL031_ICR       0x01C /* Interrupt clear */
+
+#define PL031_CR_START  (1U << 0)
+#define PL031_INT_MATCH (1U << 0)
+
+#define PL031_SYNC_PERIOD_SEC   64
+#define PL031_STEP_NS           100000000ULL /* >100 ms off: step */
+#define PL031_SLEW_MAX_NS       1000000ULL   /* Else at most 1 ms per sync */
+
+typedef struct pl031_stats {
+        uint64_t syncs;
+        uint64_t steps;
+        int64_t last_error_ns; /* RTC - kernel wall clock at the last edge */
+} pl031_stats;
+
+/* Samples the RTC (once) and sets the wall clock coarsely */
+void     pl031_init(uint64_t base);
+void     pl031_irq_enable(uint32_t intid);
+
+/* On demand: slow device read, whole seconds since the epoch */
+uint32_t pl031_read_sec(void);
+
+/* Arms the match interrupt for the next second boundary */
+void     pl031_sync(void);
+
+void     pl031_handle_irq(uint32_t intid, void *data);
+
+pl031_stats pl031_get_stats(void);
+
+#endif /* PL031_H */
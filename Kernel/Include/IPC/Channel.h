@@ -0,0 +1,97 @@
+/*
+ * Asynchronous IPC: channels, a submission & a completion ring
+ *
+ * A channel is two rings (see Ring.h) in memory both sides map: the
+ * client produces requests into the submission ring (CHAN_SQ) and
+ * consumes replies from the completion ring (CHAN_CQ), the server the
+ * other way around. Messages go through the rings, never through the
+ * kernel: it's only entered to sleep & to wake a sleeper.
+ *
+ *      consumer, ring empty:   ring_cons_idle(), then chan_wait() if it
+ *                              still is
+ *      producer, after a push: chan_notify() only if ring_wants_doorbell()
+ *
+ * So a busy consumer costs nothing but the ring, and a batch of any size
+ * at most one notify & one wait each way: the kernel entries are paid per
+ * batch, not per message like ipc_call().
+ *
+ * chan_wait() returns right away if the doorbell rang since the ring was
+ * found empty ('idle' is cleared again), so neither order of the two is a
+ * lost wakeup.
+ *
+ * Bulk data doesn't go through the rings either: the producer of a ring
+ * grants page ranges to its consumer's address space (see Memory/Grant.h)
+ * & sends a message saying where they are. Each ring's consumer space is
+ * chan_attach()'d by whoever set the channel up.
+ *
+ * EL0 ABI (through the syscall table, see Syscall.h):
+ *      SYS_CHAN_WAIT:          x0 channel, x1 CHAN_SQ or CHAN_CQ
+ *      SYS_CHAN_NOTIFY:        the same, the ring just pushed to
+ *      SYS_CHAN_GRANT:         x0-x1 the same, x2 VA, x3 consumer's VA,
+ *                              x4 pages, x5 GRANT_* flags
+ *      SYS_CHAN_REVOKE:        x0-x1 the same, x2 consumer's VA, x3 pages
+ *      x0 out:                 CHAN_OK, CHAN_EINVAL or CHAN_EPERM. Grants
+ *                              a GRANT_E* as well, revokes the number
+ *                              of pages revoked
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+
+#include "IPC/Ring.h"
+
+#include "Memory/PageTable.h"
+
+#define CHAN_MAX        16
+
+#define CHAN_SQ         0       /* Client to server */
+#define CHAN_CQ         1       /* Server to client */
+
+#define CHAN_OK         0
+#define CHAN_EINVAL     -2      /* No such channel or ring */
+#define CHAN_EPERM      -7      /* Not the producer's, not attached */
+
+/* Bytes of shared memory for a channel of 2 rings of 'slots' */
+static inline uint64_t chan_bytes(uint32_t slots)
+{
+        return 2 * ring_bytes(slots);
+}
+
+/*
+ * A channel over 'mem' (chan_bytes(), 64 byte aligned, 'slots' a power of
+ * 2): its number, CHAN_EINVAL if they're all taken
+ */
+int32_t chan_create(void *mem, uint32_t slots);
+
+/* 'ch''s CHAN_SQ or CHAN_CQ ring, 0 if there's no such thing */
+ring *chan_ring(uint32_t ch, uint32_t which);
+
+/* Consumer of 'which': sleeps until its doorbell, if it's still idle */
+int64_t chan_wait(uint32_t ch, uint32_t which);
+
+/* Producer of 'which': wakes its consumer, if it's waiting */
+int64_t chan_notify(uint32_t ch, uint32_t which);
+
+/* 'which''s consumer runs in 'pt', 0: kernel threads (no grants) */
+int64_t chan_attach(uint32_t ch, uint32_t which, pgtbl *pt);
+
+/*
+ * Producer of 'which': vm_grant()s 'pages' at 'va' in its space (the
+ * other ring's consumer's) to 'which''s consumer's at 'to_va'. From a
+ * thread with an address space, only the producer's own. CHAN_EPERM if
+ * either isn't attached
+ */
+int64_t chan_grant(uint32_t ch, uint32_t which, uint64_t va, uint64_t to_va,
+                   uint64_t pages, uint32_t flags);
+
+/* Producer of 'which': vm_revoke()s what it shared at 'to_va' */
+int64_t chan_revoke(uint32_t ch, uint32_t which, uint64_t to_va,
+                    uint64_t pages);
+
+#endif /* CHANNEL_H */
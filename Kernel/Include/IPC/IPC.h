@@ -0,0 +1,56 @@
+/*
+ * Synchronous IPC: endpoints, register-sized messages
+ *
+ * A message is IPC_MRS words, x0-x7 at EL0: the kernel copies them from
+ * the sender's saved registers straight into the receiver's, no buffer in
+ * between. Both sides meet at an endpoint, whoever comes first blocks on
+ * it (FIFO).
+ *
+ *      send:       blocks until a receiver took the message
+ *      recv:       blocks until a message comes
+ *      call:       send & wait for the reply, one operation. The receiver
+ *                  is the caller's only way back (an implicit reply right)
+ *      reply:      to the last caller, never blocks
+ *      reply_wait: reply & recv, one operation: what a server loops on
+ *
+ * Fast path: when the partner already waits, the sender hands its CPU &
+ * what is left of its time slice to it (sched_handoff()), no run queue
+ * in between. A call into a waiting server & its reply_wait back are two
+ * direct switches. The slow path (partner not there yet, or busy on
+ * another CPU) queues on the endpoint & goes through the scheduler.
+ *
+ * EL0 ABI ('svc #0', SYS_IPC_*, see Syscall.h):
+ *      x8:     SYS_IPC_* in, IPC_OK or an IPC_E* out
+ *      x9:     endpoint in, clobbered like x10-x18
+ *      x0-x7:  message in & out (send: preserved)
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+
+#define IPC_MRS         8       /* Message registers, x0-x7 */
+#define IPC_ENDPOINTS   64
+
+#define IPC_OK          0
+#define IPC_EINVAL      -2      /* No such endpoint */
+#define IPC_ENOCALLER   -3      /* reply: nobody to reply to */
+
+/* 'ep' for an unused endpoint, IPC_EINVAL if they're all taken */
+int32_t ipc_endpoint_create(void);
+
+int64_t ipc_send(uint32_t ep, uint64_t mr[IPC_MRS]);
+int64_t ipc_recv(uint32_t ep, uint64_t mr[IPC_MRS]);
+int64_t ipc_call(uint32_t ep, uint64_t mr[IPC_MRS]);
+int64_t ipc_reply(uint64_t mr[IPC_MRS]);
+int64_t ipc_reply_wait(uint32_t ep, uint64_t mr[IPC_MRS]);
+
+/* From Vector.S: 'op' is SYS_IPC_* - SYS_IPC_FIRST, 'mr' the frame's x0 */
+int64_t ipc_syscall(uint64_t *mr, uint64_t op, uint64_t ep);
+
+#endif /* IPC_H */
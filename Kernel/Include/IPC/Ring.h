@@ -0,0 +1,181 @@
+/*
+ * Lock-free single-producer/single-consumer message ring in shared memory
+ *
+ * One side only ever writes 'head' (the producer), the other only 'tail'
+ * (the consumer), each on its own cache line. A batch of n messages costs
+ * the producer n slot writes & one release store, the consumer one
+ * acquire load & one release store: no locks, no atomics read-modify-
+ * write, no kernel entry. Each side also keeps a private copy of the
+ * other's index (ring_prod/ring_cons, not shared), refreshed only when
+ * the ring looks full/empty, so the shared lines bounce once per batch,
+ * not once per message.
+ *
+ * Doorbell: a consumer about to sleep sets 'idle' & looks once more
+ * (ring_cons_idle()). A producer only rings (a syscall, see Channel.h)
+ * after a push that finds 'idle' set (ring_wants_doorbell()). A busy
+ * consumer is never notified. Both sides order their store before their
+ * load with a full fence: one of them sees the other's.
+ *
+ * Slots are IPC_MRS words, a synchronous IPC message (& a cache line).
+ * Header-only, so it can be built into user code. Hardware independent,
+ * unit tested on the host (see Tests/RingTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#include "IPC/IPC.h"
+
+typedef struct ring_msg {
+        uint64_t w[IPC_MRS];
+} __attribute__((aligned(64))) ring_msg;
+
+/* Layout is ABI (shared with user space) */
+typedef struct ring {
+        uint32_t head __attribute__((aligned(64)));     /* Producer's */
+        uint32_t tail __attribute__((aligned(64)));     /* Consumer's */
+        uint32_t idle __attribute__((aligned(64)));     /* Wants a doorbell */
+        uint32_t mask;                                  /* Slots - 1 */
+        ring_msg slot[] __attribute__((aligned(64)));
+} ring;
+
+/* Each side's private view */
+typedef struct ring_prod {
+        ring *r;
+        uint32_t head;
+        uint32_t tail_cache;
+} ring_prod;
+
+typedef struct ring_cons {
+        ring *r;
+        uint32_t tail;
+        uint32_t head_cache;
+} ring_cons;
+
+/* Bytes for a ring of 'slots' (a power of 2) */
+static inline uint64_t ring_bytes(uint32_t slots)
+{
+        return sizeof(ring) + (uint64_t) slots * sizeof(ring_msg);
+}
+
+static inline void ring_init(ring *r, uint32_t slots)
+{
+        r->head = 0;
+        r->tail = 0;
+        r->idle = 0;
+        r->mask = slots - 1;
+}
+
+static inline void ring_prod_init(ring_prod *p, ring *r)
+{
+        p->r = r;
+        p->head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        p->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+static inline void ring_cons_init(ring_cons *c, ring *r)
+{
+        c->r = r;
+        c->tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+        c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+}
+
+/* Up to 'n' of 'msgs', returns how many fit */
+static inline uint32_t ring_push(ring_prod *p, const ring_msg *msgs,
+                                 uint32_t n)
+{
+        ring *r = p->r;
+        uint32_t space = r->mask + 1 - (p->head - p->tail_cache);
+
+        if (space < n) {
+                p->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+                space = r->mask + 1 - (p->head - p->tail_cache);
+        }
+
+        if (space < n) {
+                n = space;
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+                r->slot[(p->head + i) & r->mask] = msgs[i];
+        }
+
+        p->head += n;
+        __atomic_store_n(&r->head, p->head, __ATOMIC_RELEASE);
+
+        return n;
+}
+
+/* Up to 'max' into 'msgs', returns how many there were */
+static inline uint32_t ring_pop(ring_cons *c, ring_msg *msgs, uint32_t max)
+{
+        ring *r = c->r;
+        uint32_t avail = c->head_cache - c->tail;
+
+        if (avail < max) {
+                c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+                avail = c->head_cache - c->tail;
+        }
+
+        if (avail < max) {
+                max = avail;
+        }
+
+        for (uint32_t i = 0; i < max; i++) {
+                msgs[i] = r->slot[(c->tail + i) & r->mask];
+        }
+
+        c->tail += max;
+        __atomic_store_n(&r->tail, c->tail, __ATOMIC_RELEASE);
+
+        return max;
+}
+
+/* Producer, after a push: is the consumer asleep (or about to be)? */
+static inline uint8_t ring_wants_doorbell(ring_prod *p)
+{
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        return __atomic_load_n(&p->r->idle, __ATOMIC_RELAXED) != 0;
+}
+
+/*
+ * Consumer, found nothing: 1 if it may sleep until the doorbell, 0 if a
+ * message came in meanwhile ('idle' is cleared again, pop it).
+ */
+static inline uint8_t ring_cons_idle(ring_cons *c)
+{
+        ring *r = c->r;
+
+        __atomic_store_n(&r->idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        c->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+        if (c->head_cache != c->tail) {
+                __atomic_store_n(&r->idle, 0, __ATOMIC_RELAXED);
+                return 0;
+        }
+
+        return 1;
+}
+
+/* The doorbell: the consumer is on its way, no more of them */
+static inline void ring_wake(ring *r)
+{
+        __atomic_store_n(&r->idle, 0, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t ring_count(const ring *r)
+{
+        return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) -
+                __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif /* RING_H */
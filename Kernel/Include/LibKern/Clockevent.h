@@ -0,0 +1,53 @@
+/*
+ * Clockevent: per-CPU one-shot timer interrupts at absolute deadlines
+ *
+ * A driver (e.g. the ARM64 generic timer) registers one device per CPU and
+ * calls clockevent_interrupt() from its IRQ handler. Deadlines are in
+ * ktime_get_ns() nanoseconds, only the earliest pending one is armed.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef CLOCKEVENT_H
+#define CLOCKEVENT_H
+
+#include <stdint.h>
+
+#define CLOCKEVENT_NONE ~0ULL /* Nothing armed */
+
+typedef struct clockevent {
+        const char *name;
+
+        /* Fire once when the clocksource reaches 'cycles' (absolute) */
+        void (*set_deadline)(uint64_t cycles);
+        void (*stop)(void);
+
+        /* Called in IRQ context when the deadline is reached */
+        void (*handler)(uint64_t now_ns);
+
+        uint64_t next_ns;
+} clockevent;
+
+/* Registers 'ce' for the calling CPU */
+void clockevent_register(clockevent *ce);
+
+clockevent *clockevent_current(void);
+
+/*
+ * Arms the calling CPU's device for 'deadline_ns', unless an earlier
+ * deadline is already pending. Returns 1 if no device is registered.
+ */
+uint8_t clockevent_program(uint64_t deadline_ns);
+
+/* Cancels whatever is pending on the calling CPU */
+void clockevent_cancel(void);
+
+/* Sets the function called on expiry (e.g. the tick/timer wheel) */
+void clockevent_set_handler(void (*handler)(uint64_t now_ns));
+
+/* For drivers: the armed deadline has been reached */
+void clockevent_interrupt(void);
+
+#endif /* CLOCKEVENT_H */
@@ -0,0 +1,107 @@
+/*
+ * Clocksource: free-running counter to nanoseconds conversion
+ *
+ * The counter frequency is read once at registration. Converting cycles to
+ * nanoseconds is then a multiply & shift with a precomputed pair:
+ *
+ *      ns = (cycles * mult) >> shift
+ *
+ * The product is taken as 128-bit (mul + umulh on AArch64), so there is no
+ * overflow for any realistic uptime and no division on the hot path.
+ *
+ * Counters narrower than 64-bit (ARMv8 only guarantees 56) wrap around. The
+ * clocksource keeps a (cycle_last, ns_last) base protected by a seqcount and
+ * deltas are taken modulo 'mask'. clocksource_update() must be called at
+ * least once per 'max_idle_ns' to fold the base forward (the timer tick does).
+ *
+ * Hardware independent, unit tested on the host (see Tests/ClocksourceTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <stdint.h>
+
+#include "LibKern/SeqCount.h"
+
+#define CLOCKSOURCE_MASK(bits) \
+        ((bits) < 64 ? ((1ULL << (bits)) - 1) : ~0ULL)
+
+typedef struct clocksource {
+        const char *name;
+        uint64_t (*read)(void);
+        uint64_t mask;
+        uint64_t freq; /* Hz */
+
+        /* cycles -> ns */
+        uint32_t mult;
+        uint32_t shift;
+
+        /* ns -> cycles (e.g. for programming timer deadlines) */
+        uint32_t ns_mult;
+        uint32_t ns_shift;
+
+        uint64_t max_idle_ns; /* Longest safe gap between two updates */
+
+        seqcount seq;
+        uint64_t cycle_last;
+        uint64_t ns_last;
+} clocksource;
+
+/*
+ * Largest 'shift' (<= 32) for which 'to / from' scaled by 2^shift still fits
+ * in 32 bits. Rounded to nearest.
+ */
+void clocksource_calc_mult_shift(uint32_t *mult, uint32_t *shift,
+                                 uint64_t from, uint64_t to);
+
+static inline uint64_t clocksource_scale(uint64_t val, uint32_t mult,
+                                         uint32_t shift)
+{
+        return (uint64_t) (((unsigned __int128) val * mult) >> shift);
+}
+
+static inline uint64_t clocksource_cyc2ns(const clocksource *cs,
+                                          uint64_t cycles)
+{
+        return clocksource_scale(cycles, cs->mult, cs->shift);
+}
+
+static inline uint64_t clocksource_ns2cyc(const clocksource *cs, uint64_t ns)
+{
+        return clocksource_scale(ns, cs->ns_mult, cs->ns_shift);
+}
+
+/* Fills in the conversion pairs. 'read' must return the raw counter */
+void clocksource_init(clocksource *cs, const char *name,
+                      uint64_t (*read)(void), uint64_t freq, uint64_t mask);
+
+/* Makes 'cs' the system clock. Time continues from the previous clock */
+void clocksource_register(clocksource *cs);
+
+/* Folds elapsed cycles into the base, call periodically (any CPU) */
+void clocksource_update(void);
+
+clocksource *clocksource_current(void);
+
+/* Nanoseconds since the counter started (0 before registration) */
+uint64_t ktime_get_ns(void);
+
+/*
+ * Wall clock: realtime = ktime_get_ns() + offset. Set from an RTC or the
+ * network, 0 (i.e. the epoch at boot) until then.
+ */
+uint64_t ktime_get_real_ns(void);
+void     ktime_set_real_ns(uint64_t real_ns);
+int64_t  ktime_get_wall_offset(void);
+
+/* Raw counter value & conversions, for tracing & benchmarking */
+uint64_t ktime_get_cycles(void);
+uint64_t ktime_cycles_to_ns(uint64_t cycles);
+uint64_t ktime_ns_to_cycles(uint64_t ns);
+
+#endif /* CLOCKSOURCE_H */
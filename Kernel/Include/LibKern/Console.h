@@ -12,6 +12,67 @@
 #include <stdint.h>
 #include <stdarg.h>
 
+#define KLOG_LINE_MAX 256 /* bytes, longer lines are truncated */
+
+/*
+ * Log levels & subsystems
+ *
+ * Calls above KLOG_LEVEL_MAX or outside KLOG_SUBSYS_MAX are removed by the
+ * compiler (the condition is a constant). Everything else can be filtered at
+ * runtime with klog_set_level() & klog_set_mask().
+ *
+ *   KLOG_INFO(KLOG_MEM, "[bootmem] %lu pages free\n", n);
+ */
+#define KLOG_LVL_ERR            0
+#define KLOG_LVL_WARN           1
+#define KLOG_LVL_INFO           2
+#define KLOG_LVL_DEBUG          3
+#define KLOG_LVL_VERBOSE        4
+
+#define KLOG_CORE       (1U << 0) /* kmain & friends */
+#define KLOG_ARCH       (1U << 1) /* exceptions, CPU setup */
+#define KLOG_IRQ        (1U << 2)
+#define KLOG_MEM        (1U << 3) /* bootmem, pmm, vmm */
+#define KLOG_DTB        (1U << 4)
+#define KLOG_DRIVER     (1U << 5)
+#define KLOG_TIME       (1U << 6)
+#define KLOG_TRACE      (1U << 7)
+#define KLOG_ALL        0xFFFFFFFFU
+
+#ifndef KLOG_LEVEL_MAX
+        #ifdef DEBUG
+                #define KLOG_LEVEL_MAX KLOG_LVL_DEBUG
+        #else
+                #define KLOG_LEVEL_MAX KLOG_LVL_INFO
+        #endif
+#endif
+
+#ifndef KLOG_SUBSYS_MAX
+        #define KLOG_SUBSYS_MAX KLOG_ALL
+#endif
+
+extern int32_t klog_level;
+extern uint32_t klog_mask;
+
+/* Compile-time check first, so that disabled calls vanish entirely */
+#define KLOG_ENABLED(lvl, sub) \
+        ((lvl) <= KLOG_LEVEL_MAX && ((sub) & KLOG_SUBSYS_MAX) && \
+        (lvl) <= klog_level && ((sub) & klog_mask))
+
+#define KLOG_AT(lvl, sub, ...)                                  \
+        do {                                                    \
+                if (KLOG_ENABLED(lvl, sub)) {                   \
+                        klog(__VA_ARGS__);                      \
+                }                                               \
+        } while (0)
+
+#define KLOG_ERR(sub, ...)      KLOG_AT(KLOG_LVL_ERR, sub, __VA_ARGS__)
+#define KLOG_WARN(sub, ...)     KLOG_AT(KLOG_LVL_WARN, sub, __VA_ARGS__)
+#define KLOG_INFO(sub, ...)     KLOG_AT(KLOG_LVL_INFO, sub, __VA_ARGS__)
+#define KLOG_DEBUG(sub, ...)    KLOG_AT(KLOG_LVL_DEBUG, sub, __VA_ARGS__)
+#define KLOG_VERBOSE(sub, ...)  KLOG_AT(KLOG_LVL_VERBOSE, sub, __VA_ARGS__)
+
+/* Unfiltered debug output */
 #ifdef DEBUG
         #define KLOG(...) klog(__VA_ARGS__)
         #define KPRINTF(...) kprintf(__VA_ARGS__)
@@ -20,6 +81,9 @@
         #define KPRINTF(fmt, ...)
 #endif
 
+void klog_set_level(uint8_t level);
+void klog_set_mask(uint32_t mask);
+
 void kprint_uint(uint64_t uval, uint8_t base);
 void kprint_int(int64_t val, uint8_t base);
 void kprint_str(const char *str);
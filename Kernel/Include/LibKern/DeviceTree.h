@@ -47,6 +47,27 @@ typedef struct fdt_prop {
 uint8_t dtb_mem_info(void* base, uint64_t *mem_start, uint64_t* mem_end);
 uint8_t dtb_cpu_count(void *base, uint64_t *cpu_count);
 
+/*
+ * First node whose 'compatible' list contains 'compat'. Up to 'count'
+ * (address, size) pairs of its 'reg' are stored in 'reg' (assumes 2 address
+ * & 2 size cells, like QEMU virt). Returns 0 on success.
+ */
+uint8_t dtb_find_compatible(void *base, const char *compat,
+                            uint64_t *reg, uint32_t count);
+
+/*
+ * Property 'prop' of the first node compatible with 'compat'. '*data' points
+ * into the blob (big-endian cells), '*len' is in bytes. Returns 0 if found.
+ */
+uint8_t dtb_find_prop(void *base, const char *compat, const char *prop,
+                      const void **data, uint32_t *len);
+
+/*
+ * MPIDR values ('reg') of the /cpus/cpu@N nodes, in DTB order. Up to 'max'
+ * are stored in 'mpidr' (may be NULL). Returns how many CPUs there are.
+ */
+uint32_t dtb_cpus(void *base, uint64_t *mpidr, uint32_t max);
+
 /* TODO: Generic */
 uint8_t dtb_init(void *base);
 uint8_t dtb_next(void *dev_name);
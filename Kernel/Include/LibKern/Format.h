@@ -0,0 +1,49 @@
+/*
+ * printf-style formatting into caller provided buffers
+ *
+ * Supported: %d %i %u %x %X %o %p %s %c %%
+ *      flags:  '-' '0' '+' ' ' '#'
+ *      width & precision: numbers or '*'
+ *      length: hh h l ll z j t
+ *
+ * Same return value semantics as C99 snprintf(): the number of characters
+ * that WOULD have been written if 'size' was big enough (excluding the NUL).
+ * The output is always NUL terminated when 'size' is not zero.
+ *
+ * Hardware independent, unit tested on the host (see Tests/FormatTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args)
+        __attribute__((format(printf, 3, 0)));
+
+/*
+ * Raw integer conversion. Digits are written backwards, ending right before
+ * 'end'. Returns a pointer to the first digit. 'end' must have room for
+ * 20 (base 10), 16 (base 16) or 22 (base 8) characters.
+ */
+char *kfmt_u64_dec(char *end, uint64_t val);
+char *kfmt_u64_hex(char *end, uint64_t val, uint8_t upper);
+char *kfmt_u64_oct(char *end, uint64_t val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORMAT_H */
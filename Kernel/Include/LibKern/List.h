@@ -0,0 +1,91 @@
+/*
+ * Intrusive, circular, doubly-linked lists
+ *
+ * Embed a 'list_node' in the object and get back to it with CONTAINER_OF().
+ * Insertion & removal are O(1) and never allocate.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef LIST_H
+#define LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONTAINER_OF(ptr, type, member) \
+        ((type*) ((uint8_t*) (ptr) - offsetof(type, member)))
+
+typedef struct list_node {
+        struct list_node *next;
+        struct list_node *prev;
+} list_node;
+
+static inline void list_init(list_node *head)
+{
+        head->next = head;
+        head->prev = head;
+}
+
+static inline uint8_t list_empty(const list_node *head)
+{
+        return head->next == head;
+}
+
+static inline void __list_insert(list_node *node, list_node *prev,
+                                 list_node *next)
+{
+        node->prev = prev;
+        node->next = next;
+        prev->next = node;
+        next->prev = node;
+}
+
+static inline void list_add(list_node *head, list_node *node)
+{
+        __list_insert(node, head, head->next);
+}
+
+static inline void list_add_tail(list_node *head, list_node *node)
+{
+        __list_insert(node, head->prev, head);
+}
+
+/* Unlinks 'node' and leaves it self-linked (so list_empty() is true) */
+static inline void list_del(list_node *node)
+{
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        list_init(node);
+}
+
+/* Moves all of 'from' to the end of 'to', 'from' becomes empty */
+static inline void list_splice_tail(list_node *to, list_node *from)
+{
+        if (list_empty(from)) {
+                return;
+        }
+
+        from->next->prev = to->prev;
+        to->prev->next = from->next;
+        from->prev->next = to;
+        to->prev = from->prev;
+
+        list_init(from);
+}
+
+static inline list_node *list_pop(list_node *head)
+{
+        if (list_empty(head)) {
+                return 0;
+        }
+
+        list_node *node = head->next;
+        list_del(node);
+
+        return node;
+}
+
+#endif /* LIST_H */
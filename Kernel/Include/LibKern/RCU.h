@@ -0,0 +1,182 @@
+/*
+ * Read-Copy-Update: lock-free readers for read-mostly data
+ *
+ * Readers wrap their accesses in rcu_read_lock()/rcu_read_unlock() and load
+ * shared pointers with rcu_dereference(). Neither costs anything but a
+ * compiler barrier: no atomics, no stores, no shared cache lines.
+ *
+ * Writers publish a new version with rcu_assign_pointer() and hand the old
+ * one to call_rcu() (or rcu_free()). It is reclaimed once every CPU went
+ * through a quiescent state (QS), a point where it can't be inside a read
+ * section, i.e. after a full grace period (GP):
+ *
+ *      - the idle loop & ksleep() (also "extended" QS: an idle CPU is left
+ *        out of new GPs altogether, until an IRQ or work wakes it)
+ *      - an IRQ taken from EL0
+ *      - rcu_quiescent(): schedule() & sched_handoff() call it, even
+ *        between kernel threads (those are never preempted)
+ *
+ * So read sections must not sleep, block, call schedule() or be preempted.
+ *
+ * GPs are numbered. A GP starts when a CPU has callbacks waiting for one
+ * and ends when the last CPU expected to report a QS ('pending') did.
+ * Callbacks queued during GP n wait for GP n + 1, per CPU in two batches:
+ * 'next' (no GP assigned yet) & 'wait' (for 'wait_gp'). They run on the
+ * CPU that queued them, from its next QS after the GP ended.
+ *
+ * The core (rcu_state) is hardware independent and takes the CPU number as
+ * an argument, unit & stress tested on the host (see Tests/RCUTest.cpp).
+ * The kernel wrappers use the global 'rcu' state and cpu_id().
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef RCU_H
+#define RCU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#define RCU_CPUS                8       /* == MAX_CPUS */
+
+/* call_rcu() functions below this are rcu_free() offsets, not code */
+#define RCU_FREE_OFFSET_MAX     4096
+
+struct rcu_head;
+typedef void (*rcu_fn)(struct rcu_head *head);
+
+/* Embedded in the object to be reclaimed */
+typedef struct rcu_head {
+        struct rcu_head *next;
+        rcu_fn fn;
+} rcu_head;
+
+typedef struct rcu_cblist {
+        rcu_head *head;
+        rcu_head **tail;
+        uint64_t len;
+} rcu_cblist;
+
+typedef struct rcu_cpu {
+        rcu_cblist next;        /* No GP assigned yet */
+        rcu_cblist wait;        /* Ready once 'wait_gp' ended */
+        uint64_t wait_gp;
+        uint64_t qs_gp;         /* Last GP we reported a QS for */
+        uint8_t irq_from_idle;  /* Kernel: IRQ left the extended QS */
+} __attribute__((aligned(64))) rcu_cpu;
+
+typedef struct rcu_state {
+        spinlock lock;          /* Starting & ending GPs */
+        uint64_t gp_seq;        /* GPs started */
+        uint64_t gp_done;       /* GPs ended, != 'gp_seq' while one runs */
+        uint64_t gp_wanted;     /* Latest GP a callback waits for */
+
+        /* Bit per CPU */
+        uint32_t online;
+        uint32_t idle;          /* In an extended QS */
+        uint32_t pending;       /* Still owe the running GP a QS */
+
+        void (*free)(void *obj); /* For rcu_free() */
+        uint64_t invoked;        /* Statistics */
+
+        rcu_cpu cpu[RCU_CPUS];
+} rcu_state;
+
+/*
+ * Core
+ */
+
+void rcu_state_init(rcu_state *rs, void (*free)(void *obj));
+
+void rcu_cpu_online(rcu_state *rs, uint32_t cpu);
+void rcu_cpu_offline(rcu_state *rs, uint32_t cpu); /* After its callbacks */
+
+/* 'cpu' is outside any read section: report & run its ready callbacks */
+void rcu_qs(rcu_state *rs, uint32_t cpu);
+
+/* Extended QS (idle): 'cpu' doesn't hold up GPs in between */
+void rcu_idle_enter(rcu_state *rs, uint32_t cpu);
+void rcu_idle_exit(rcu_state *rs, uint32_t cpu);
+
+/* Queue 'fn(head)' on 'cpu', to run after a GP */
+void rcu_call(rcu_state *rs, uint32_t cpu, rcu_head *head, rcu_fn fn);
+
+/* Queue 'rs->free(head - offset)' on 'cpu', to run after a GP */
+void rcu_call_free(rcu_state *rs, uint32_t cpu, rcu_head *head,
+                   uint64_t offset);
+
+/* Callbacks queued on 'cpu' & not run yet */
+uint64_t rcu_pending(rcu_state *rs, uint32_t cpu);
+
+/*
+ * Readers & pointer publishing
+ */
+
+#define RCU_BARRIER() asm volatile("" ::: "memory")
+
+static inline void rcu_read_lock(void)
+{
+        RCU_BARRIER();
+}
+
+static inline void rcu_read_unlock(void)
+{
+        RCU_BARRIER();
+}
+
+/* Initialises the object before making it visible */
+#define rcu_assign_pointer(p, v) \
+        __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/*
+ * A plain load: accesses through the returned pointer depend on its value
+ * (address dependency), which orders them after it on AArch64 for free
+ */
+#define rcu_dereference(p) \
+        __atomic_load_n(&(p), __ATOMIC_RELAXED)
+
+/*
+ * Kernel wrappers (this CPU, global state)
+ */
+
+#if !__STDC_HOSTED__
+
+extern rcu_state rcu;
+
+void rcu_init(void);            /* Boot CPU, before any other rcu_*() */
+void rcu_cpu_init(void);        /* Each secondary, before it idles */
+
+void rcu_quiescent(void);
+void rcu_idle_begin(void);      /* Around 'wfe' / 'wfi' */
+void rcu_idle_end(void);
+
+/* Outermost IRQ entry & exit (ARM64/Exception.c) */
+void rcu_irq_enter(void);
+void rcu_irq_exit(uint8_t from_el0);
+
+void call_rcu(rcu_head *head, rcu_fn fn);
+
+/* Waits for a full GP. Not from IRQs or read sections */
+void synchronize_rcu(void);
+
+/*
+ * Free 'ptr' after a GP, 'field' is its rcu_head. 'ptr' is an nb_alloc()
+ * block through page_va(), nb_free()'d through page_pa()
+ */
+#define rcu_free(ptr, field)                                                \
+        do {                                                                \
+                _Static_assert(offsetof(__typeof__(*(ptr)), field) <        \
+                        RCU_FREE_OFFSET_MAX, "rcu_head too far in");        \
+                __rcu_free(&(ptr)->field,                                   \
+                        offsetof(__typeof__(*(ptr)), field));               \
+        } while (0)
+
+void __rcu_free(rcu_head *head, uint64_t offset);
+
+#endif /* !__STDC_HOSTED__ */
+
+#endif /* RCU_H */
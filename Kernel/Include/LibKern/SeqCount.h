@@ -0,0 +1,63 @@
+/*
+ * Sequence counters for data that is read often & written rarely
+ *
+ * Readers never block or write shared memory. They snapshot the counter,
+ * read the data and retry if a writer was active (odd count) or finished
+ * in between. Writers must be serialized by the caller (a lock, a single
+ * owner CPU or masked IRQs).
+ *
+ *      uint32_t seq;
+ *      do {
+ *              seq = seqcount_read_begin(&sc);
+ *              ... copy the protected data ...
+ *      } while (seqcount_read_retry(&sc, seq));
+ *
+ * Hardware independent, uses the compiler's __atomic builtins only.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SEQCOUNT_H
+#define SEQCOUNT_H
+
+#include <stdint.h>
+
+typedef struct seqcount {
+        uint32_t seq;
+} seqcount;
+
+#define SEQCOUNT_INIT { .seq = 0 }
+
+static inline uint32_t seqcount_read_begin(const seqcount *sc)
+{
+        uint32_t seq;
+
+        while ((seq = __atomic_load_n(&sc->seq, __ATOMIC_ACQUIRE)) & 1) {
+                /* Writer in progress */
+        }
+
+        return seq;
+}
+
+static inline uint8_t seqcount_read_retry(const seqcount *sc, uint32_t seq)
+{
+        /* Order the data loads before re-reading the counter */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        return __atomic_load_n(&sc->seq, __ATOMIC_RELAXED) != seq;
+}
+
+static inline void seqcount_write_begin(seqcount *sc)
+{
+        __atomic_store_n(&sc->seq, sc->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqcount_write_end(seqcount *sc)
+{
+        __atomic_store_n(&sc->seq, sc->seq + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* SEQCOUNT_H */
@@ -1,6 +1,9 @@
 /*
  * String & memory functions for the kernel (for ARM64 only)
  *
+ * Integer-only (no FP/SIMD registers, see ARM64/FPSIMD.h). Implemented in
+ * String/String.c, strcmp & strncmp are still the optimized-routines ones.
+ *
  * Reference: https://github.com/ARM-software/optimized-routines/
  *
  * Copyright (c) 2019-2023, Arm Limited.
@@ -15,8 +15,12 @@
 
 #include <stdint.h>
 
+/* Nanoseconds since boot, see LibKern/Clocksource.h */
 uint64_t arm64_uptime(void);
 
+/* Sleeps in 'wfi' until the timer interrupt fires */
 void     ksleep(const uint64_t mSec);
+void     ksleep_ns(uint64_t nSec);
+void     ksleep_until(uint64_t deadline_ns);
 
 #endif /* TIME_H */
@@ -0,0 +1,110 @@
+/*
+ * Time page: syscall-free clock reads for user space (vDSO-style data)
+ *
+ * The kernel keeps one page with everything needed to turn a raw counter
+ * value into time: the clocksource's (cycle_last, ns_last) base, mask,
+ * mult/shift and the wall-clock offset. It is mapped read-only into every
+ * user address space. Together with EL0 access to CNTVCT_EL0 (CNTKCTL_EL1,
+ * see ARM64/GenericTimer.c) a user thread reads the time with a handful of
+ * loads, one counter read & a multiply:
+ *
+ *      uint64_t mono = time_page_mono_ns(tp, cntvct_read);
+ *      uint64_t real = time_page_real_ns(tp, cntvct_read);
+ *
+ * The page is updated under a seqcount, readers retry on a concurrent
+ * update. The reader side is header-only so it can be built into user code.
+ *
+ * Hardware independent, unit tested on the host (see Tests/TimePageTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef TIMEPAGE_H
+#define TIMEPAGE_H
+
+#include <stdint.h>
+
+#include "LibKern/SeqCount.h"
+
+#define TIME_PAGE_VERSION 1
+
+/* Layout is ABI, append only */
+typedef struct time_page {
+        seqcount seq;
+        uint32_t version;
+
+        uint64_t cycle_last;
+        uint64_t ns_last;
+        uint64_t mask;
+        uint32_t mult;
+        uint32_t shift;
+        uint64_t freq; /* Hz, for user-side benchmarking */
+
+        int64_t wall_offset_ns; /* realtime = monotonic + offset */
+} time_page;
+
+typedef struct time_page_snap {
+        uint64_t mono_ns;
+        int64_t wall_offset_ns;
+} time_page_snap;
+
+/* 'read_cycles' should be a static inline counter read, so it's inlined */
+static inline time_page_snap time_page_read(const time_page *tp,
+                                            uint64_t (*read_cycles)(void))
+{
+        time_page_snap snap;
+        uint64_t cycle_last;
+        uint64_t ns_last;
+        uint64_t mask;
+        uint32_t mult;
+        uint32_t shift;
+        uint32_t seq;
+
+        do {
+                seq = seqcount_read_begin(&tp->seq);
+                cycle_last = tp->cycle_last;
+                ns_last = tp->ns_last;
+                mask = tp->mask;
+                mult = tp->mult;
+                shift = tp->shift;
+                snap.wall_offset_ns = tp->wall_offset_ns;
+        } while (seqcount_read_retry(&tp->seq, seq));
+
+        uint64_t delta = (read_cycles() - cycle_last) & mask;
+
+        snap.mono_ns = ns_last +
+                (uint64_t) (((unsigned __int128) delta * mult) >> shift);
+
+        return snap;
+}
+
+static inline uint64_t time_page_mono_ns(const time_page *tp,
+                                         uint64_t (*read_cycles)(void))
+{
+        return time_page_read(tp, read_cycles).mono_ns;
+}
+
+static inline uint64_t time_page_real_ns(const time_page *tp,
+                                         uint64_t (*read_cycles)(void))
+{
+        time_page_snap snap = time_page_read(tp, read_cycles);
+
+        return snap.mono_ns + snap.wall_offset_ns;
+}
+
+/*
+ * Kernel side
+ */
+
+/* The page itself (page aligned & sized), for mapping into user space */
+const time_page *time_page_get(void);
+
+/*
+ * Re-publishes the current clocksource base & wall offset. Called by the
+ * clocksource code whenever one of them changes.
+ */
+void time_page_update(void);
+
+#endif /* TIMEPAGE_H */
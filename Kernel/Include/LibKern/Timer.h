@@ -0,0 +1,48 @@
+/*
+ * Kernel timers: per-CPU timing wheels driven by the clockevent (tickless)
+ *
+ * Each CPU owns a timing wheel (LibKern/TimerWheel.h) with a granularity of
+ * 2^TIMER_TICK_SHIFT ns. There is no periodic tick: after every change the
+ * CPU's clockevent is programmed to the wheel's next event only.
+ *
+ * A timer belongs to the CPU it was armed on. Arm & cancel it from that CPU.
+ * Callbacks run in IRQ context on the owning CPU.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#include "LibKern/TimerWheel.h"
+
+#define TIMER_TICK_SHIFT 20 /* ~1.05 ms */
+
+typedef struct ktimer {
+        tw_timer tw;
+        void (*fn)(struct ktimer *t);
+        void *data;
+        uint32_t cpu;
+} ktimer;
+
+/* Sets up the calling CPU's wheel. Needs its clockevent registered */
+void timer_cpu_init(void);
+
+void ktimer_init(ktimer *t, void (*fn)(ktimer *t), void *data);
+
+/* (Re)arms 't' for 'deadline_ns' (ktime_get_ns() time), never fires early */
+void ktimer_arm(ktimer *t, uint64_t deadline_ns);
+
+/* Returns 1 if 't' was pending */
+uint8_t ktimer_cancel(ktimer *t);
+
+static inline uint8_t ktimer_pending(const ktimer *t)
+{
+        return tw_timer_pending(&t->tw);
+}
+
+#endif /* TIMER_H */
@@ -0,0 +1,91 @@
+/*
+ * Hierarchical timing wheel
+ *
+ * TW_LEVELS wheels of TW_SLOTS slots each. Level 'k' slots are 64^k ticks
+ * wide, so a timer 'd' ticks away lands in the level where 'd' fits and is
+ * cascaded down into finer levels as its slot comes up:
+ *
+ *      level 0: [0, 64) ticks, 1 tick per slot
+ *      level 1: [64, 4096) ticks, 64 ticks per slot
+ *      ...
+ *
+ *   - Arm & cancel are O(1): compute a slot, link/unlink a list node.
+ *   - Expiry moves a whole slot to a local list and runs it in one batch.
+ *   - A 64-bit occupancy bitmap per level gives the next tick of interest
+ *     in O(TW_LEVELS), so idle stretches are skipped instead of walked tick
+ *     by tick and the hardware comparator can be programmed to exactly that
+ *     tick (tickless).
+ *
+ * The wheel knows nothing about time units or CPUs: ticks are whatever the
+ * caller feeds to tw_advance(). Not thread-safe, the owner serializes (see
+ * LibKern/Timer.h for the per-CPU kernel timers).
+ *
+ * Hardware independent, unit tested on the host (see Tests/TimerWheelTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+
+#include "LibKern/List.h"
+
+#define TW_SLOT_BITS    6
+#define TW_SLOTS        (1U << TW_SLOT_BITS)
+#define TW_SLOT_MASK    (TW_SLOTS - 1)
+#define TW_LEVELS       8 /* 48 bits worth of ticks */
+
+/* Farther timers are clamped, fits in the top level without wrapping */
+#define TW_MAX_DELTA    ((uint64_t) TW_SLOT_MASK << \
+                        (TW_SLOT_BITS * (TW_LEVELS - 1)))
+#define TW_NONE         ~0ULL
+
+typedef struct tw_timer {
+        list_node node;
+        uint64_t expires; /* tick */
+        void (*fn)(struct tw_timer *t);
+        void *data;
+} tw_timer;
+
+typedef struct timer_wheel {
+        uint64_t now; /* Every tick before 'now' has been processed */
+        uint64_t pending;
+        uint64_t occupied[TW_LEVELS]; /* Bit per non-empty slot */
+        list_node slots[TW_LEVELS][TW_SLOTS];
+} timer_wheel;
+
+void tw_init(timer_wheel *tw, uint64_t now);
+
+void tw_timer_init(tw_timer *t, void (*fn)(tw_timer *t), void *data);
+
+static inline uint8_t tw_timer_pending(const tw_timer *t)
+{
+        return !list_empty(&t->node);
+}
+
+/*
+ * (Re)arms 't' to expire at tick 'expires'. Ticks in the past expire on
+ * the next tw_advance(), more than TW_MAX_DELTA ahead are clamped.
+ */
+void tw_add(timer_wheel *tw, tw_timer *t, uint64_t expires);
+
+/* Returns 1 if 't' was pending */
+uint8_t tw_del(timer_wheel *tw, tw_timer *t);
+
+/*
+ * Runs every timer that expires at or before tick 'now'. Callbacks may
+ * arm/cancel timers (including themselves). Returns the number run.
+ */
+uint64_t tw_advance(timer_wheel *tw, uint64_t now);
+
+/*
+ * Next tick at which tw_advance() has work (an expiry or a cascade), or
+ * TW_NONE. Never later than the earliest pending expiry.
+ */
+uint64_t tw_next_event(const timer_wheel *tw);
+
+#endif /* TIMERWHEEL_H */
@@ -0,0 +1,133 @@
+/*
+ * Deferred-format binary tracing for the kernel
+ *
+ * A trace point costs one counter read and a single 64-byte (cache line)
+ * store into a per-CPU ring. Nothing is formatted at runtime: the format
+ * string, file and line are kept in a static descriptor placed in the
+ * '.trace' linker section (see Kernel/kernel.ld). The ring stores only the
+ * descriptor's id, the raw CNTVCT_EL0 value and the raw arguments.
+ *
+ * trace_dump() prints the rings as hex and Tools/trace-decode.py turns them
+ * back into text with the help of Build/kernel.elf.
+ *
+ * Usage:
+ *      TRACE("nb_alloc size=%lu addr=0x%lx", size, (uint64_t) addr);
+ *
+ * Arguments are stored as uint64_t, at most TRACE_MAX_ARGS of them. Strings
+ * can NOT be traced (only their address), the decoder prints them as such.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAX_ARGS  6
+#define TRACE_SLOTS     512 /* Per CPU, must be power of 2 */
+
+/* Slot header: [63:56] magic, [55:48] nargs, [47:32] cpu, [31:0] desc id */
+#define TRACE_MAGIC             0x54ULL /* 'T' */
+#define TRACE_HDR(id, n, cpu)   ((TRACE_MAGIC << 56) | \
+                                ((uint64_t) (n) << 48) | \
+                                ((uint64_t) (cpu) << 32) | (uint64_t) (id))
+
+/* Must stay in sync with Tools/trace-decode.py */
+typedef struct trace_desc {
+        const char *fmt;
+        const char *file;
+        uint32_t line;
+        uint32_t nargs;
+        uint64_t reserved;
+} __attribute__((aligned(32))) trace_desc;
+
+typedef struct trace_slot {
+        uint64_t hdr;
+        uint64_t cycles; /* CNTVCT_EL0 */
+        uint64_t args[TRACE_MAX_ARGS];
+} __attribute__((aligned(64))) trace_slot;
+
+typedef struct trace_ring {
+        trace_slot slots[TRACE_SLOTS];
+        uint64_t head; /* Free running, next slot to write */
+} trace_ring;
+
+void trace_init(void);
+void trace_enable(uint8_t on);
+void trace_dump(void);
+
+/*
+ * Unit tests are built for the host (hosted C) and must not depend on the
+ * section magic or on AArch64 system registers. Trace points vanish there.
+ */
+#if __STDC_HOSTED__ || defined(NO_TRACE)
+
+#define TRACE(fmt, ...) do { } while (0)
+
+#else
+
+#include "ARM64/Machine.h"
+#include "ARM64/GenericTimer.h"
+
+extern trace_ring trace_rings[MAX_CPUS];
+extern const trace_desc __trace_desc_start[];
+extern volatile uint8_t trace_on;
+
+static inline void __trace_write(const trace_desc *desc, uint32_t nargs,
+        uint64_t a0, uint64_t a1, uint64_t a2,
+        uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        uint32_t cpu = cpu_id();
+        trace_ring *ring = &trace_rings[cpu];
+
+        if (!trace_on) {
+                return;
+        }
+
+        uint64_t cycles = cntvct_read();
+
+        /* An IRQ on this CPU may trace as well, so reserve atomically */
+        uint64_t idx = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+        trace_slot *slot = &ring->slots[idx & (TRACE_SLOTS - 1)];
+
+        slot->hdr = TRACE_HDR(desc - __trace_desc_start, nargs, cpu);
+        slot->cycles = cycles;
+        slot->args[0] = a0;
+        slot->args[1] = a1;
+        slot->args[2] = a2;
+        slot->args[3] = a3;
+        slot->args[4] = a4;
+        slot->args[5] = a5;
+}
+
+#define __TRACE_NARGS(...) __TRACE_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define __TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+
+#define __TRACE_ARGS(...) __TRACE_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0)
+#define __TRACE_ARGS_(_0, a, b, c, d, e, f, ...) \
+        (uint64_t) (a), (uint64_t) (b), (uint64_t) (c), \
+        (uint64_t) (d), (uint64_t) (e), (uint64_t) (f)
+
+#define TRACE(str, ...)                                                     \
+        do {                                                                \
+                static const char __trace_fmt[]                             \
+                        __attribute__((section(".trace_fmt"))) = str;       \
+                static const trace_desc __trace_d                           \
+                        __attribute__((section(".trace_desc"), used)) = {   \
+                        .fmt = __trace_fmt,                                 \
+                        .file = __FILE__,                                   \
+                        .line = __LINE__,                                   \
+                        .nargs = __TRACE_NARGS(__VA_ARGS__),                \
+                };                                                          \
+                _Static_assert(__TRACE_NARGS(__VA_ARGS__) <= TRACE_MAX_ARGS,\
+                        "too many TRACE() arguments");                      \
+                __trace_write(&__trace_d, __TRACE_NARGS(__VA_ARGS__),       \
+                        __TRACE_ARGS(__VA_ARGS__));                         \
+        } while (0)
+
+#endif /* __STDC_HOSTED__ || NO_TRACE */
+
+#endif /* TRACE_H */
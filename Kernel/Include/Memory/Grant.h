@@ -0,0 +1,71 @@
+/*
+ * Page grants: zero-copy transfers between address spaces
+ *
+ * Bulk data (file contents, frame buffers) changes hands by moving page
+ * table entries, never the bytes: a grant costs O(pages), whatever is in
+ * them.
+ *
+ *      share:  'to' maps the same frames as 'from' (read only with
+ *              GRANT_RO), each frame gains a reference. 'to''s entries are
+ *              marked PT_SW_GRANT: the granter can vm_revoke() them
+ *      move:   the entries leave 'from' for 'to', references & all. 'from'
+ *              doesn't see them anymore once vm_grant() returns
+ *      revoke: 'to''s shared entries in a range are unmapped, their TLB
+ *              entries invalidated, and only then the references dropped
+ *
+ * A grant never adds permissions: 'to' gets what 'from' had, at most. A
+ * page shared in can't be granted on (GRANT_EPERM): its granter's revoke
+ * reaches every copy. A grant checks the whole range before changing
+ * anything: it's done entirely or not at all.
+ *
+ * Both spaces are locked (in address order) while their tables change,
+ * TLB invalidation (see ARM64/TLB.h) comes after the unlock: it may IPI.
+ *
+ * Hardware independent, unit tested on the host (see Tests/GrantTest.cpp),
+ * where there are no TLBs to invalidate.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef GRANT_H
+#define GRANT_H
+
+#include <stdint.h>
+
+#include "Memory/PageTable.h"
+
+#define GRANT_SHARE     0x0
+#define GRANT_MOVE      0x1
+#define GRANT_RO        0x2
+
+#define GRANT_OK        0
+#define GRANT_EINVAL    -2      /* Unaligned, out of range, unknown flags */
+#define GRANT_ENOENT    -4      /* A page of the source isn't mapped */
+#define GRANT_EEXIST    -5      /* A page of the destination is */
+#define GRANT_ENOMEM    -6      /* No memory for the destination's tables */
+#define GRANT_EPERM     -7      /* A page of the source was shared in */
+
+#define GRANT_CHUNK     64      /* Pages unmapped per lock hold */
+
+typedef struct grant_stats {
+        uint64_t shared;                /* Pages */
+        uint64_t moved;
+        uint64_t revoked;
+        uint64_t flushed;               /* Pages whose TLB entries went */
+} grant_stats;
+
+/* 'pages' at 'va' in 'from' to 'to_va' in 'to', GRANT_* flags */
+int64_t vm_grant(pgtbl *from, uint64_t va, pgtbl *to, uint64_t to_va,
+                 uint64_t pages, uint32_t flags);
+
+/* Unmaps what was shared into 'to' in the range, returns how many pages */
+int64_t vm_revoke(pgtbl *to, uint64_t to_va, uint64_t pages);
+
+/* Unmaps whatever is mapped in the range, returns how many pages */
+int64_t vm_unmap(pgtbl *pt, uint64_t va, uint64_t pages);
+
+grant_stats grant_get_stats(void);
+
+#endif /* GRANT_H */
@@ -0,0 +1,67 @@
+/*
+ * Physical page metadata: a reference count per page frame
+ *
+ * One entry per PAGE_SIZE frame of the memory nb_init() manages. A frame
+ * counts the page table entries pointing at it: a shared grant (see
+ * Grant.h) adds one, an unmap drops one, and whoever drops the last frees
+ * it. Frames outside that memory (the kernel image, devices) aren't
+ * counted & never freed.
+ *
+ * Hardware independent, unit tested on the host (see Tests/GrantTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <stdint.h>
+
+#include "Memory/PageDef.h"
+
+typedef struct page_meta {
+        uint32_t refs;                  /* 0: free */
+} page_meta;
+
+/*
+ * A frame's contents through the kernel's mapping of RAM (TTBR1), whatever
+ * is in TTBR0. The host has no such thing: PAs are addresses there.
+ */
+static inline void *page_va(uint64_t pa)
+{
+#if __STDC_HOSTED__
+        return (void*) pa;
+#else
+        return (void*) (pa + KERNEL_VA_OFFSET);
+#endif
+}
+
+/* page_va()'s inverse */
+static inline uint64_t page_pa(const void *va)
+{
+#if __STDC_HOSTED__
+        return (uint64_t) va;
+#else
+        return (uint64_t) va - KERNEL_VA_OFFSET;
+#endif
+}
+
+/* After nb_init() with the same range, 1 if there's no memory for it */
+int page_meta_init(uint64_t base, uint64_t size);
+
+/* 0 if 'pa' isn't managed */
+page_meta *page_meta_of(uint64_t pa);
+
+/* A zeroed frame with one reference (its PA), 0 if there is none */
+uint64_t page_alloc(void);
+
+/* New count. Unmanaged frames: always 1 */
+uint32_t page_ref(uint64_t pa);
+uint32_t page_refs(uint64_t pa);
+
+/* New count, the frame is freed at 0. Unmanaged frames: always 1 */
+uint32_t page_unref(uint64_t pa);
+
+#endif /* PAGE_H */
@@ -0,0 +1,92 @@
+/*
+ * User (TTBR0) page tables: 4 levels, 4 KiB pages
+ *
+ * An address space's translations below 2^48 (TCR_EL1.T0SZ = 16), L3 page
+ * entries only. Intermediate tables are page_alloc()'d on demand and only
+ * freed with the whole tree. Tables are reached through page_va(): they
+ * stay reachable whatever TTBR0 holds.
+ *
+ * Entries are nG (per ASID), inner shareable, normal memory, never
+ * executable at EL1. PT_SW_GRANT, one of the bits software may use, marks
+ * a page a shared grant mapped in (see Grant.h).
+ *
+ * pgtbl_map() & pgtbl_unmap() don't touch the TLBs or the frames'
+ * reference counts: that's their callers'. Callers hold 'lock'.
+ *
+ * Hardware independent, unit tested on the host (see Tests/GrantTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include <stdint.h>
+
+#include "ARM64/Memory.h"
+#include "ARM64/Spinlock.h"
+
+#define PT_VA_LIMIT     (1ULL << 48)
+
+#define PT_READ         0x1
+#define PT_WRITE        0x2
+#define PT_EXEC         0x4
+
+#define PT_SW_GRANT     (1ULL << 55)
+
+#define PT_OK           0
+#define PT_ENOMEM       -1
+#define PT_EEXIST       -2
+#define PT_EINVAL       -3
+
+typedef struct pgtbl {
+        spinlock lock;
+        uint16_t asid;                  /* Its TLB entries' */
+        uint64_t root;                  /* L0 table PA, TTBR0_EL1.BADDR */
+        uint64_t pages;                 /* Mapped */
+} pgtbl;
+
+/* PT_OK or PT_ENOMEM */
+int pgtbl_init(pgtbl *pt, uint16_t asid);
+
+/* Drops a reference to every mapped frame, frees the tables */
+void pgtbl_destroy(pgtbl *pt);
+
+/* An L3 entry for 'pa' with PT_* 'prot' */
+uint64_t pgtbl_pte(uint64_t pa, uint32_t prot);
+
+static inline uint64_t pgtbl_pte_pa(uint64_t pte)
+{
+        return pte & ARM_TP_OA_MASK;
+}
+
+static inline uint8_t pgtbl_pte_valid(uint64_t pte)
+{
+        return (pte & ARM_TE_VALID_MASK) != 0;
+}
+
+/*
+ * The L3 entry for 'va', 0 if its table doesn't exist (& 'alloc' is 0 or
+ * there is no memory for it). Entries of the same 2 MiB follow it.
+ */
+uint64_t *pgtbl_walk(pgtbl *pt, uint64_t va, uint8_t alloc);
+
+/* PT_OK, PT_EEXIST, PT_EINVAL (unaligned, too high) or PT_ENOMEM */
+int pgtbl_map(pgtbl *pt, uint64_t va, uint64_t pte);
+
+/* The entry that was there, 0 if none */
+uint64_t pgtbl_unmap(pgtbl *pt, uint64_t va);
+
+/* 0 if none */
+uint64_t pgtbl_lookup(pgtbl *pt, uint64_t va);
+
+/* 'va' & 'pages' describe a range user space can have */
+static inline uint8_t pgtbl_range_ok(uint64_t va, uint64_t pages)
+{
+        return !(va & (GRANULE_SIZE - 1)) && pages && va < PT_VA_LIMIT &&
+                pages <= (PT_VA_LIMIT - va) / GRANULE_SIZE;
+}
+
+#endif /* PAGETABLE_H */
@@ -0,0 +1,46 @@
+/*
+ * Slab allocator: fixed size objects, carved out of SLAB_SIZE blocks
+ *
+ * A cache hands out objects of one size, cache line aligned, from blocks
+ * it nb_alloc()s as it runs out. Free objects are linked through their
+ * first word: allocating & freeing are a pop & a push under the cache's
+ * lock, no search, no fragmentation between sizes. Blocks aren't given
+ * back (yet).
+ *
+ * Objects are reached through page_va() (see Page.h): valid whatever is
+ * in TTBR0. They come zeroed.
+ *
+ * Hardware independent, unit tested on the host (see Tests/CSpaceTest.cpp).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#define SLAB_SIZE       (16 * 1024)     /* Bytes per block */
+#define SLAB_ALIGN      64              /* Cache line */
+
+typedef struct slab_cache {
+        spinlock lock;
+        const char *name;
+        uint32_t size;                  /* Per object, SLAB_ALIGN multiple */
+        void *free;                     /* Free objects */
+        uint64_t slabs;                 /* Blocks */
+        uint64_t used;                  /* Objects */
+} slab_cache;
+
+/* Objects of 'size' bytes (up to SLAB_SIZE) */
+void slab_cache_init(slab_cache *c, const char *name, uint32_t size);
+
+/* 0 if there is no memory left */
+void *slab_alloc(slab_cache *c);
+void slab_free(slab_cache *c, void *obj);
+
+#endif /* SLAB_H */
@@ -19,15 +19,21 @@
 #define GIC_SIZE        0x00020000      /* 128 Kib */
 #define GIC_END         (GIC_BASE + GIC_SIZE)
 
+#define GICD_BASE       (GIC_BASE + 0x00000000)  /* Distributor */
+#define GICC_BASE       (GIC_BASE + 0x00010000)  /* CPU interface (v2) */
+
 /* ARM PrimeCell UART (PL011) */
 #define PL011_BASE      0x09000000
 #define PL011_SIZE      0x00001000      /* 4 KiB */
 #define PL011_END       (PL011_BASE + PL011_SIZE)
+#define PL011_INTID     33              /* SPI 1 */
+#define PL011_CLK_HZ    24000000        /* apb-pclk, 24 MHz */
 
 /* ARM PrimeCell RTC (PL031) */
 #define PL031_BASE      0x09010000
 #define PL031_SIZE      0x00001000      /* 4 KiB */
 #define PL031_END       (PL031_BASE + PL031_SIZE)
+#define PL031_INTID     34              /* SPI 2 */
 
 /* ARM PrimeCell GPIO (PL061) */
 #define PL061_BASE      0x09030000
@@ -0,0 +1,268 @@
+/*
+ * Scheduler: per-CPU run queues, work stealing
+ *
+ * Every CPU owns a run queue: one FIFO per priority level (0 is the most
+ * urgent) and a bitmap of the non-empty levels, so picking the next entity
+ * is a count-trailing-zeros, whatever the number queued. Its lock is only
+ * contended by thieves and never spun on by them.
+ *
+ *      yield:  the running entity goes to the tail of its level, the CPU
+ *              picks again, all on its own queue
+ *      wakeup: onto the CPU it last ran on while its cache is warm
+ *              (SCHED_CACHE_HOT_NS), otherwise onto an idle CPU if the
+ *              affinity mask allows one. A remote wakeup is pushed onto
+ *              the target's lock-free inbox (CAS), which the target drains
+ *              when it picks next
+ *      steal:  a CPU with nothing to run takes one entity from a busy
+ *              queue. spin_trylock() only: a busy victim is skipped, not
+ *              waited for. Cache-hot entities stay unless the victim has
+ *              more than one queued
+ *
+ * Priority classes, by level:
+ *
+ *      0-7:    real time, no time slice: runs until it blocks or yields,
+ *              or something more urgent wakes up
+ *      8-23:   normal, SCHED_SLICE_NS
+ *      24-31:  batch, SCHED_SLICE_BATCH_NS (fewer, longer slices)
+ *
+ * A more urgent wakeup preempts right away. An expired slice only does if
+ * something of the same level waits, otherwise it's renewed. So the slice
+ * timer is needed only while such a contender is queued, and there is no
+ * tick at all on a CPU running its only runnable entity (tickless, see
+ * sched_next_tick()).
+ *
+ * An entity that was just switched away from is still 'on_cpu' until its
+ * old CPU called sched_finish(). Until then it isn't stolen, and a wakeup
+ * queues it back on that CPU: it never runs on two CPUs at once, and no
+ * CPU ever waits for another one's switch.
+ *
+ * The core (sched_state) is hardware independent and takes the CPU number
+ * & the time as arguments, unit & stress tested on the host (see
+ * Tests/SchedTest.cpp). The kernel wrappers use the global 'sched' state,
+ * cpu_id() & ktime_get_ns(), and IPI the target of a remote wakeup.
+ *
+ * Preemption (kernel): a per-CPU slice ktimer, armed only when
+ * sched_next_tick() asks for it, and wakeups (IPI_RESCHED when remote) set
+ * need_resched. Only an IRQ taken from EL0 preempts: kernel code, RCU read
+ * sections & spinlock holders included, runs until it calls schedule().
+ * Every schedule() & sched_handoff() is an RCU quiescent state: read
+ * sections must not span one (see LibKern/RCU.h).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#include "LibKern/List.h"
+
+#define SCHED_CPUS              8       /* == MAX_CPUS */
+#define SCHED_PRIOS             32      /* Bit per level in a uint32_t */
+#define SCHED_PRIO_DEFAULT      16
+
+#define SCHED_PRIO_RT_LAST      7
+#define SCHED_PRIO_BATCH_FIRST  24
+
+#define SCHED_SLICE_NS          (10 * 1000 * 1000)      /* 10 ms */
+#define SCHED_SLICE_BATCH_NS    (40 * 1000 * 1000)      /* 40 ms */
+
+#define SCHED_AFFINITY_ALL      0xFFFFFFFFU
+#define SCHED_CACHE_HOT_NS      (500 * 1000)    /* 500 us */
+
+enum sched_entity_state {
+        SE_SLEEPING,
+        SE_RUNNABLE,                    /* Queued, or in an inbox */
+        SE_RUNNING
+};
+
+enum sched_class {
+        SCHED_CLASS_RT,
+        SCHED_CLASS_NORMAL,
+        SCHED_CLASS_BATCH
+};
+
+/* Embedded in the thread */
+typedef struct sched_entity {
+        list_node node;                 /* In its run queue level */
+        struct sched_entity *wake_next; /* In an inbox */
+        uint32_t state;
+        uint32_t prio;
+        uint32_t affinity;              /* Bit per CPU */
+        uint32_t cpu;                   /* Queued on / ran on last */
+        uint32_t on_cpu;                /* Its context is still live */
+        uint64_t last_ran;              /* ns, when it left 'cpu' */
+        uint64_t slice_ns;              /* 0: none (runs until it blocks) */
+        uint64_t slice_end;             /* ns, current slice */
+} sched_entity;
+
+typedef struct sched_stats {
+        uint64_t switches;              /* A different entity than before */
+        uint64_t preemptions;           /* Kernel: switches forced by an IRQ */
+        uint64_t handoffs;              /* Direct, see sched_direct() */
+        uint64_t ticks;                 /* Kernel: slice timer expiries */
+        uint64_t yields;
+        uint64_t wakeups;
+        uint64_t remote_wakeups;        /* Through the inbox */
+        uint64_t steals;
+        uint64_t idle;                  /* Picks that found nothing */
+} sched_stats;
+
+typedef struct run_queue {
+        spinlock lock;
+        uint32_t bitmap;                /* Bit per non-empty level */
+        uint32_t nr;                    /* Queued, not counting the running */
+        list_node level[SCHED_PRIOS];
+        sched_entity *inbox;            /* LIFO, pushed with CAS */
+        sched_stats stats;
+} __attribute__((aligned(64))) run_queue;
+
+typedef struct sched_state {
+        uint32_t online;                /* Bit per CPU */
+        uint32_t idle;                  /* Nothing to run */
+        run_queue rq[SCHED_CPUS];
+} sched_state;
+
+/*
+ * Core
+ */
+
+void sched_state_init(sched_state *ss);
+
+/* Idle until its first sched_pick() */
+void sched_cpu_online(sched_state *ss, uint32_t cpu);
+
+void sched_entity_init(sched_entity *se, uint32_t prio, uint32_t affinity);
+
+/* A new entity, onto 'cpu' (or the first allowed one) */
+void sched_enqueue(sched_state *ss, uint32_t cpu, sched_entity *se);
+
+/*
+ * Make a sleeping 'se' runnable, from 'cpu'. Returns the CPU it was queued
+ * on (!= 'cpu': the inbox, kick it), SCHED_CPUS if it was already awake.
+ */
+uint32_t sched_wake(sched_state *ss, uint32_t cpu, sched_entity *se,
+                    uint64_t now);
+
+/*
+ * Next entity to run on 'cpu', 0 if none (idle). 'prev' is the running one
+ * (or 0): still SE_RUNNING, it is requeued at the tail of its level first
+ * (yield), otherwise it's going to sleep. May return 'prev'.
+ */
+sched_entity *sched_pick(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                         uint64_t now);
+
+/*
+ * Run the sleeping 'next' on 'cpu' right away instead of 'prev' (which is
+ * requeued unless it's going to sleep), skipping the queues: a blocking
+ * IPC handing the CPU to its partner. 'next' gets what is left of the
+ * slice of 'prev'. Returns 0, nothing done, if 'next' isn't asleep, still
+ * on a CPU or not allowed on 'cpu': sched_wake() it then.
+ */
+uint8_t sched_direct(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                     sched_entity *next, uint64_t now);
+
+/* After 'cpu' switched away from 'prev' */
+void sched_finish(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                  uint64_t now);
+
+/* Takes effect when 'se' wakes up next */
+void sched_set_affinity(sched_entity *se, uint32_t affinity);
+
+static inline uint32_t sched_class_of(uint32_t prio)
+{
+        if (prio <= SCHED_PRIO_RT_LAST) {
+                return SCHED_CLASS_RT;
+        }
+
+        return (prio < SCHED_PRIO_BATCH_FIRST) ?
+                SCHED_CLASS_NORMAL : SCHED_CLASS_BATCH;
+}
+
+/* Overrides the class' slice, from its next one on. 0: none */
+void sched_set_slice(sched_entity *se, uint64_t slice_ns);
+
+/*
+ * Is the running 'cur' (0: idle) to be preempted on 'cpu' now? Something
+ * more urgent is queued, or its slice is over and something of its level
+ * waits. A slice over with nobody waiting is renewed.
+ */
+uint8_t sched_tick(sched_state *ss, uint32_t cpu, sched_entity *cur,
+                   uint64_t now);
+
+/* When the slice timer has to fire for 'cur', 0: no need (tickless) */
+uint64_t sched_next_tick(sched_state *ss, uint32_t cpu, sched_entity *cur);
+
+/* The running 'se' is about to block: then sched_pick() without requeuing */
+static inline void sched_prepare_sleep(sched_entity *se)
+{
+        __atomic_store_n(&se->state, SE_SLEEPING, __ATOMIC_RELEASE);
+}
+
+/* Queued on 'cpu' (racy, a hint) */
+uint32_t sched_nr_queued(sched_state *ss, uint32_t cpu);
+
+/*
+ * Kernel wrappers (this CPU, global state)
+ */
+
+#if !__STDC_HOSTED__
+
+extern sched_state sched;
+
+void sched_init(void);          /* Boot CPU */
+void sched_cpu_init(void);      /* Each secondary */
+
+/* sched_wake(), IPI_RESCHED to the target if it's another CPU */
+void sched_wakeup(sched_entity *se);
+
+/*
+ * Saves 'prev', resumes 'next' (0 for either: the CPU's idle context).
+ * Called with IRQs masked, returns in 'prev' once it runs again, with
+ * the entity switched away from to get there. Set by the thread layer.
+ */
+typedef sched_entity *(*sched_switch_fn)(sched_entity *prev,
+                                         sched_entity *next);
+
+void sched_set_switch(sched_switch_fn fn);
+
+/* Running on this CPU, 0: idle */
+sched_entity *sched_current(void);
+
+/*
+ * Pick & switch. The running entity is requeued (a yield) unless it went
+ * through sched_prepare_sleep(). No-op until a switch is set.
+ */
+void schedule(void);
+
+/*
+ * sched_direct() & switch, sched_wakeup() if it can't. The running one
+ * sleeps through sched_prepare_sleep(), is requeued otherwise.
+ */
+void sched_handoff(sched_entity *next);
+
+static inline void sched_yield(void)
+{
+        schedule();
+}
+
+/* A new context's first code, with what the switch returned */
+void sched_switch_tail(sched_entity *last);
+
+/* From the IRQ exit path on a reschedule: schedule() if sched_tick() */
+void sched_preempt(void);
+
+/* 'cpu''s counters, racy unless it's this CPU */
+sched_stats sched_get_stats(uint32_t cpu);
+
+/* Logs every online CPU's counters */
+void sched_report(void);
+
+#endif /* !__STDC_HOSTED__ */
+
+#endif /* SCHED_H */
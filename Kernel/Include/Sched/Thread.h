@@ -0,0 +1,105 @@
+/*
+ * Kernel threads
+ *
+ * A thread is a kernel stack, a saved context (ARM64/Context.h) and a
+ * sched_entity. Switching between two is a function call that swaps
+ * callee-saved registers & SP, plus:
+ *
+ *      TTBR0_EL1:  only when the incoming thread has an address space and
+ *                  it isn't the one loaded already. Kernel-only threads
+ *                  (space == 0) run on whatever is loaded, so switching
+ *                  between them and a user thread costs no TLB traffic
+ *      FP/SIMD:    only when the two differ, and lazily (FPSIMD.h).
+ *                  A thread allowed on other CPUs is flushed when it's
+ *                  switched away from, only one pinned to its CPU keeps
+ *                  its registers live there. So an FP thread's affinity
+ *                  changes only while it runs, or before it first does
+ *
+ * The running thread is in this CPU's percpu block, one 'mrs' of
+ * TPIDR_EL1 & one load away (current_thread()).
+ *
+ * Every CPU's idle loop (its boot stack, kmain() on the boot CPU, both
+ * ending in smp_idle()) is a thread too, never queued: the scheduler's
+ * "nothing to run" (0).
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+
+#include "ARM64/Context.h"
+#include "ARM64/FPSIMD.h"
+#include "ARM64/SMP.h"
+
+#include "LibKern/List.h"
+
+#include "Memory/PageTable.h"
+
+#include "Sched/Sched.h"
+
+#define THREAD_STACK_SIZE       (16 * 1024)
+
+#define THREAD_IDLE             (1U << 0)
+#define THREAD_DEAD             (1U << 1)
+
+typedef void (*thread_fn)(void *arg);
+
+/* What TTBR0_EL1 gets: an L0 table & its ASID */
+typedef struct addr_space {
+        pgtbl pt;                       /* TTBR0: root, asid (< TLB_ASIDS) */
+} addr_space;
+
+typedef struct thread {
+        cpu_context ctx;
+        sched_entity se;
+        addr_space *space;              /* 0: kernel only */
+        fpsimd_state *fp;               /* 0: no FP/SIMD at EL0 */
+        uint64_t user_ksp;              /* user_enter(), 0: not at EL0 */
+        thread_fn fn;
+        void *arg;
+        void *stack;                    /* Lowest address */
+        uint32_t flags;
+
+        /* IPC/IPC.c */
+        list_node ipc_node;             /* Blocked on an endpoint */
+        uint64_t *ipc_mr;               /* Message to take, or to fill */
+        struct thread *ipc_caller;      /* Waiting for our reply */
+        uint32_t ipc_state;
+} thread;
+
+/* Boot CPU: this CPU's idle thread, then threads are switched to */
+void thread_init(void);
+void thread_cpu_init(void);     /* Each secondary */
+
+/*
+ * A thread on the caller's 'stack', 16-byte aligned. Not running until
+ * thread_start(). Affinity & address space can be set up in between.
+ * Both 't' & 'stack' are the caller's: reusable once thread_done().
+ */
+void thread_setup(thread *t, thread_fn fn, void *arg, void *stack,
+                  uint64_t size, uint32_t prio);
+
+void thread_start(thread *t);
+
+/* From the thread itself, also what returning from its 'fn' does */
+void thread_exit(void) __attribute__((noreturn));
+
+/* Exited, and no CPU is still switching away from it */
+uint8_t thread_done(const thread *t);
+
+static inline thread *current_thread(void)
+{
+        return this_cpu()->thread;
+}
+
+static inline void thread_yield(void)
+{
+        sched_yield();
+}
+
+#endif /* THREAD_H */
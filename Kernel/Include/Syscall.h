@@ -0,0 +1,58 @@
+/*
+ * System call numbers & the dispatch table
+ *
+ * ABI (AArch64, 'svc #0'):
+ *      x8:     syscall number
+ *      x0-x5:  arguments
+ *      x0:     return value, SYS_ENOSYS for unknown numbers
+ *      x1-x18: clobbered (zeroed on the way back to EL0)
+ *      x19-x30, SP: preserved
+ *
+ * Vector.S bounds checks the number against SYS_MAX and calls the table
+ * entry directly, with the arguments still in place. Empty slots return
+ * SYS_ENOSYS.
+ *
+ * SYS_IPC_* don't go through the table: the message is x0-x7 both ways,
+ * Vector.S keeps them in the frame for ipc_syscall() (see IPC/IPC.h).
+ *
+ * Also included from Vector.S.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#define SYS_NULL        0  /* Does nothing, latency baseline */
+#define SYS_EXIT        1  /* Leave EL0, back to user_enter()'s caller */
+
+#define SYS_IPC_SEND            2
+#define SYS_IPC_RECV            3
+#define SYS_IPC_CALL            4
+#define SYS_IPC_REPLY           5
+#define SYS_IPC_REPLY_WAIT      6
+#define SYS_IPC_FIRST           SYS_IPC_SEND
+#define SYS_IPC_COUNT           5
+
+#define SYS_CHAN_WAIT           7  /* See IPC/Channel.h */
+#define SYS_CHAN_NOTIFY         8
+#define SYS_CHAN_GRANT          9
+#define SYS_CHAN_REVOKE         10
+
+#define SYS_MAX         64 /* Table size */
+#define SYS_ENOSYS      -1
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+typedef uint64_t (*syscall_fn)(uint64_t a0, uint64_t a1, uint64_t a2,
+                               uint64_t a3, uint64_t a4, uint64_t a5);
+
+extern const syscall_fn syscall_table[SYS_MAX];
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* SYSCALL_H */
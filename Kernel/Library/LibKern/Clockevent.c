@@ -0,0 +1,101 @@
+/*
+ * Clockevent: per-CPU one-shot timer interrupts at absolute deadlines
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "LibKern/Clockevent.h"
+#include "LibKern/Clocksource.h"
+
+static clockevent *ce_devs[MAX_CPUS] = {0};
+
+void clockevent_register(clockevent *ce)
+{
+        if (!ce || !ce->set_deadline || !ce->stop) {
+                return;
+        }
+
+        ce->next_ns = CLOCKEVENT_NONE;
+        ce->stop();
+
+        ce_devs[cpu_id()] = ce;
+}
+
+clockevent *clockevent_current(void)
+{
+        return ce_devs[cpu_id()];
+}
+
+uint8_t clockevent_program(uint64_t deadline_ns)
+{
+        uint64_t flags = irq_save();
+        clockevent *ce = ce_devs[cpu_id()];
+
+        if (!ce) {
+                irq_restore(flags);
+
+                return 1;
+        }
+
+        if (deadline_ns < ce->next_ns) {
+                uint64_t now_ns = ktime_get_ns();
+                uint64_t cycles = ktime_get_cycles();
+
+                /* Past deadlines fire right away */
+                if (now_ns < deadline_ns) {
+                        cycles += ktime_ns_to_cycles(deadline_ns - now_ns);
+                }
+
+                ce->next_ns = deadline_ns;
+                ce->set_deadline(cycles);
+        }
+
+        irq_restore(flags);
+
+        return 0;
+}
+
+void clockevent_cancel(void)
+{
+        uint64_t flags = irq_save();
+        clockevent *ce = ce_devs[cpu_id()];
+
+        if (ce) {
+                ce->next_ns = CLOCKEVENT_NONE;
+                ce->stop();
+        }
+
+        irq_restore(flags);
+}
+
+void clockevent_set_handler(void (*handler)(uint64_t now_ns))
+{
+        clockevent *ce = ce_devs[cpu_id()];
+
+        if (ce) {
+                ce->handler = handler;
+        }
+}
+
+void clockevent_interrupt(void)
+{
+        clockevent *ce = ce_devs[cpu_id()];
+
+        if (!ce) {
+                return;
+        }
+
+        /* One-shot: disarm first, the handler may program the next one */
+        ce->next_ns = CLOCKEVENT_NONE;
+        ce->stop();
+
+        uint64_t now_ns = ktime_get_ns();
+
+        if (ce->handler) {
+                ce->handler(now_ns);
+        }
+}
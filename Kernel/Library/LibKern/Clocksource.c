@@ -0,0 +1,206 @@
+/*
+ * Clocksource: free-running counter to nanoseconds conversion
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/Time.h"
+#include "LibKern/TimePage.h"
+
+static uint64_t _null_read(void)
+{
+        return 0;
+}
+
+/* Used until a real counter is registered: time stands still at 0 */
+static clocksource null_clocksource = {
+        .name = "null",
+        .read = _null_read,
+        .mask = ~0ULL,
+        .freq = 0,
+        .mult = 0,
+        .shift = 0,
+        .ns_mult = 0,
+        .ns_shift = 0,
+        .max_idle_ns = ~0ULL,
+        .seq = SEQCOUNT_INIT,
+        .cycle_last = 0,
+        .ns_last = 0
+};
+
+static clocksource *curr_cs = &null_clocksource;
+static int64_t wall_offset_ns = 0;
+
+/* Seqcount writers (base & time page), every CPU's tick is one */
+static spinlock cs_lock = SPINLOCK_INIT;
+
+/*
+ * 'to << 32' must fit in 64 bits, which holds for ns (10^9) and any sane
+ * counter frequency (< 4 GHz). Kept 64-bit on purpose: a 128-bit division
+ * would need libgcc's __udivti3, the kernel doesn't link against libgcc.
+ */
+void clocksource_calc_mult_shift(uint32_t *mult, uint32_t *shift,
+                                 uint64_t from, uint64_t to)
+{
+        uint64_t tmp = 0;
+        uint32_t sft = 32;
+
+        if (!mult || !shift || from == 0 || (to >> 32) != 0) {
+                return;
+        }
+
+        for (; 0 < sft; sft--) {
+                tmp = ((to << sft) + from / 2) / from;
+
+                if ((tmp >> 32) == 0) {
+                        break;
+                }
+        }
+
+        if (sft == 0) {
+                tmp = (to + from / 2) / from;
+        }
+
+        *mult = (uint32_t) tmp;
+        *shift = sft;
+}
+
+void clocksource_init(clocksource *cs, const char *name,
+                      uint64_t (*read)(void), uint64_t freq, uint64_t mask)
+{
+        if (!cs || !read || freq == 0) {
+                return;
+        }
+
+        cs->name = name;
+        cs->read = read;
+        cs->freq = freq;
+        cs->mask = mask;
+
+        clocksource_calc_mult_shift(&cs->mult, &cs->shift, freq, NANO_PER_SEC);
+        clocksource_calc_mult_shift(&cs->ns_mult, &cs->ns_shift,
+                NANO_PER_SEC, freq);
+
+        /* Half the wrap period, so a late update is still safe */
+        unsigned __int128 idle =
+                ((unsigned __int128) (mask >> 1) * cs->mult) >> cs->shift;
+        cs->max_idle_ns = (idle >> 64) ? ~0ULL : (uint64_t) idle;
+
+        cs->seq.seq = 0;
+        cs->cycle_last = 0;
+        cs->ns_last = 0;
+}
+
+void clocksource_register(clocksource *cs)
+{
+        if (!cs || !cs->read || cs->mult == 0) {
+                return;
+        }
+
+        spin_lock(&cs_lock);
+
+        if (curr_cs != &null_clocksource) {
+                /* Continue where the old clock left off */
+                uint64_t now_ns = ktime_get_ns();
+
+                seqcount_write_begin(&cs->seq);
+                cs->cycle_last = cs->read() & cs->mask;
+                cs->ns_last = now_ns;
+                seqcount_write_end(&cs->seq);
+        }
+
+        __atomic_store_n(&curr_cs, cs, __ATOMIC_RELEASE);
+
+        time_page_update();
+
+        spin_unlock(&cs_lock);
+}
+
+void clocksource_update(void)
+{
+        /*
+         * Another CPU folding the base right now makes ours redundant. Not
+         * spinning also keeps an IRQ from deadlocking on its own CPU's
+         * clocksource_register().
+         */
+        if (!spin_trylock(&cs_lock)) {
+                return;
+        }
+
+        clocksource *cs = __atomic_load_n(&curr_cs, __ATOMIC_ACQUIRE);
+        uint64_t now = cs->read();
+        uint64_t delta = (now - cs->cycle_last) & cs->mask;
+
+        seqcount_write_begin(&cs->seq);
+        cs->ns_last += clocksource_cyc2ns(cs, delta);
+        cs->cycle_last = now & cs->mask;
+        seqcount_write_end(&cs->seq);
+
+        time_page_update();
+
+        spin_unlock(&cs_lock);
+}
+
+clocksource *clocksource_current(void)
+{
+        return __atomic_load_n(&curr_cs, __ATOMIC_ACQUIRE);
+}
+
+uint64_t ktime_get_ns(void)
+{
+        clocksource *cs = __atomic_load_n(&curr_cs, __ATOMIC_ACQUIRE);
+        uint64_t cycle_last;
+        uint64_t ns_last;
+        uint32_t seq;
+
+        do {
+                seq = seqcount_read_begin(&cs->seq);
+                cycle_last = cs->cycle_last;
+                ns_last = cs->ns_last;
+        } while (seqcount_read_retry(&cs->seq, seq));
+
+        uint64_t delta = (cs->read() - cycle_last) & cs->mask;
+
+        return ns_last + clocksource_cyc2ns(cs, delta);
+}
+
+uint64_t ktime_get_real_ns(void)
+{
+        return ktime_get_ns() +
+                __atomic_load_n(&wall_offset_ns, __ATOMIC_RELAXED);
+}
+
+void ktime_set_real_ns(uint64_t real_ns)
+{
+        __atomic_store_n(&wall_offset_ns, (int64_t) (real_ns - ktime_get_ns()),
+                __ATOMIC_RELAXED);
+
+        spin_lock(&cs_lock);
+        time_page_update();
+        spin_unlock(&cs_lock);
+}
+
+int64_t ktime_get_wall_offset(void)
+{
+        return __atomic_load_n(&wall_offset_ns, __ATOMIC_RELAXED);
+}
+
+uint64_t ktime_get_cycles(void)
+{
+        return curr_cs->read();
+}
+
+uint64_t ktime_cycles_to_ns(uint64_t cycles)
+{
+        return clocksource_cyc2ns(curr_cs, cycles);
+}
+
+uint64_t ktime_ns_to_cycles(uint64_t ns)
+{
+        return clocksource_ns2cyc(curr_cs, ns);
+}
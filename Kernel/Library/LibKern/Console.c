@@ -1,234 +1,147 @@
 /*
  * Console printing/logging functionalities for the Kernel
  *
+ * Everything is formatted into a stack buffer with kvsnprintf() first and
+ * handed to the UART with a single write. Lines from different contexts
+ * (e.g. an IRQ handler) therefore never interleave mid-line.
+ *
  * Author: Tuna CICI
  */
 
 #include <stdint.h>
 #include <stdarg.h>
 
-#include "MemoryLayout.h"
 #include "LibKern/Console.h"
+#include "LibKern/Format.h"
 #include "LibKern/Time.h"
 
+#include "Drivers/PL011.h"
+
 static const char digits[] = "0123456789ABCDEF";
 
-static void uart_putc(const char c)
+/* Runtime filters, see KLOG_ENABLED() */
+int32_t klog_level = KLOG_LEVEL_MAX;
+uint32_t klog_mask = KLOG_ALL;
+
+void klog_set_level(uint8_t level)
 {
-        volatile uint32_t *uart = (uint32_t*) PL011_BASE;
-        *uart = c; /* TODO: This feels wrong... */
+        klog_level = level;
 }
 
+void klog_set_mask(uint32_t mask)
+{
+        klog_mask = mask;
+}
 
-/* Timestamp */
-/* Ex. [  15.123000] */
-/* TODO: What an awful code this turned out to be.. FML! */
-static void timestamp(void)
+static void console_write(const char *buf, int len)
 {
-        uint64_t uptime = 0;
-        uint32_t micro = 0;
-        uint16_t sec = 0;
-
-        /* Formatting */
-        static const uint8_t precision_sec = 4u;
-        static const uint8_t precision_micro = 6u;
-
-        uint8_t idx = 0;
-        char buffer[15] = {0};
-
-        uptime = arm64_uptime(); /* This is nanoseconds */
-        micro = uptime / NANO_PER_MICRO;
-        sec = micro / MICRO_PER_SEC;
-
-        buffer[idx++] = '\0';
-        buffer[idx++] = ' ';
-        buffer[idx++] = ']';
-
-        for (uint8_t i = 0; i < precision_micro; i++) {
-                if (micro % 10 == 0) {
-                        buffer[idx++] = '0';
-                } else {
-                        buffer[idx++] = digits[micro % 10];
-                }
-                micro /= 10;
+        /* kvsnprintf() returns the untruncated length */
+        if (KLOG_LINE_MAX <= len) {
+                len = KLOG_LINE_MAX - 1;
         }
 
-        buffer[idx++] = '.';
-
-        /* TODO: Printing '0' is disabled due to me wanting a Fancy™ output */
-        for (uint8_t i = 0; i < precision_sec; i++) {
-                if (sec % 10 == 0) {
-                        buffer[idx++] = ' ';
-                } else {
-                        buffer[idx++] = digits[sec % 10];
-                }
-                sec /= 10;
+        if (0 < len) {
+                pl011_write(buf, len);
         }
+}
 
-        buffer[idx] = '[';
-
+/* Timestamp */
+/* Ex. [  15.123000] */
+static int timestamp(char *buf, uint64_t size)
+{
+        uint64_t micro = arm64_uptime() / NANO_PER_MICRO;
 
-        for (; 0 < idx; idx--) {
-                uart_putc(buffer[idx]);
-        }
+        return ksnprintf(buf, size, "[%4lu.%06lu] ",
+                micro / MICRO_PER_SEC, micro % MICRO_PER_SEC);
 }
 
 void kprint_uint(uint64_t uval, uint8_t base)
 {
-        char buffer[64] = {0};
-        int i = 0;
-
-        do {
-                buffer[i++] = digits[uval % base];
-        } while((uval /= base) != 0);
+        char buffer[65];
+        char *end = buffer + sizeof(buffer);
+        char *start = end;
+
+        switch (base) {
+        case 10:
+                start = kfmt_u64_dec(end, uval);
+        break;
+        case 16:
+                start = kfmt_u64_hex(end, uval, 1);
+        break;
+        case 8:
+                start = kfmt_u64_oct(end, uval);
+        break;
+        default:
+                if (base < 2 || 16 < base) {
+                        return;
+                }
 
-        for (; 0 <= i; i--) {
-                uart_putc(buffer[i]);
+                do {
+                        *--start = digits[uval % base];
+                } while ((uval /= base) != 0);
+        break;
         }
+
+        pl011_write(start, end - start);
 }
 
 void kprint_int(int64_t val, uint8_t base)
 {
-        char buffer[64] = {0};
-        int i = 0;
-
-        do {
-                buffer[i++] = digits[val % base];
-        } while((val /= base) != 0);
-
         if (val < 0) {
-                buffer[i++] = '-';
-        }
-
-        for (; 0 < i; i--) {
-                uart_putc(buffer[i]);
+                pl011_write("-", 1);
+                kprint_uint(-(uint64_t) val, base);
+        } else {
+                kprint_uint((uint64_t) val, base);
         }
 }
 
 void kprint_str(const char *str)
 {
         if (str == 0) {
-                uart_putc('(');
-                uart_putc('n');
-                uart_putc('u');
-                uart_putc('l');
-                uart_putc('l');
-                uart_putc(')');
-                uart_putc('\0');
+                pl011_write("(null)", 6);
 
                 return;
         }
 
-        for (uint16_t i = 0; str[i] != '\0'; i++) {
-                uart_putc(str[i]);
+        uint64_t len = 0;
+
+        while (str[len] != '\0') {
+                len++;
         }
+
+        pl011_write(str, len);
 }
 
-void __attribute__((format(printf, 1, 2))) kprintf(const char *fmt, ...) 
+void __attribute__((format(printf, 1, 2))) kprintf(const char *fmt, ...)
 {
+        char line[KLOG_LINE_MAX];
         va_list args;
-        va_start(args, fmt);
 
         if (fmt == 0) {
                 return;
         }
 
-        for (uint16_t i = 0; fmt[i] != '\0'; i++) {
-                uint8_t isLong = 0;
-                char c = fmt[i];
-
-                if (c != '%') {
-                        uart_putc(c);
-                        continue;
-                }
-
-                c = fmt[++i];
-
-                /* TODO: Implement 'long' values */
-                if (c == 'l') {
-                        isLong = 1u;
-                        c = fmt[++i];
-                }
-
-                switch (c) {
-                case 'u':
-                        kprint_uint(va_arg(args, uint64_t), 10);
-                        break;
-                case 'd':
-                        kprint_int(va_arg(args, int64_t), 10);
-                        break;
-                case 'x':
-                case 'p':
-                        kprint_uint(va_arg(args, uint64_t), 16);
-                        break;
-                case 's':
-                       kprint_str(va_arg(args, const char*));
-                       break;
-                case 'c':
-                        uart_putc(va_arg(args, const uint32_t));
-                        break;
-                default:
-                       uart_putc('%');
-                       uart_putc(c);
-                       break;
-                }
-        }
-
+        va_start(args, fmt);
+        int len = kvsnprintf(line, sizeof(line), fmt, args);
         va_end(args);
+
+        console_write(line, len);
 }
 
 void __attribute__((format(printf, 1, 2))) klog(const char *fmt, ...)
 {
+        char line[KLOG_LINE_MAX];
         va_list args;
-        va_start(args, fmt);
 
         if (fmt == 0) {
                 return;
         }
 
-        timestamp();
-
-
-        for (uint16_t i = 0; fmt[i] != '\0'; i++) {
-                uint8_t isLong = 0;
-                char c = fmt[i];
-
-                if (c != '%') {
-                        uart_putc(c);
-                        continue;
-                }
-
-                c = fmt[++i];
-                
-                /* TODO: Implement 'long' values */
-                if (c == 'l') {
-                        isLong = 1u;
-                        c = fmt[++i];
-                }
-
-                switch (c) {
-                case 'u':
-                        kprint_uint(va_arg(args, uint64_t), 10);
-                        break;
-                case 'd':
-                        kprint_int(va_arg(args, int64_t), 10);
-                        break;
-                case 'x':
-                case 'p':
-                        kprint_uint(va_arg(args, uint64_t), 16);
-                        break;
-                case 's':
-                       kprint_str(va_arg(args, const char*));
-                       break;
-                case 'c':
-                        uart_putc(va_arg(args, const uint32_t));
-                        break;
-                default:
-                       uart_putc('%');
-                       uart_putc(c);
-                       break;
-                }
-        }
+        int len = timestamp(line, sizeof(line));
 
+        va_start(args, fmt);
+        len += kvsnprintf(line + len, sizeof(line) - len, fmt, args);
         va_end(args);
+
+        console_write(line, len);
 }
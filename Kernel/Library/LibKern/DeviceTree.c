@@ -20,19 +20,19 @@ static void _token_parse(const uint32_t token)
 {
         switch (token) {
         case FDT_BEGIN_NODE:
-                klog("[devicetree] FDT_BEGIN_NODE\n");
+                KLOG_VERBOSE(KLOG_DTB, "[devicetree] FDT_BEGIN_NODE\n");
                 break;
         case FDT_END_NODE:
-                klog("[devicetree] FDT_END_NODE\n");
+                KLOG_VERBOSE(KLOG_DTB, "[devicetree] FDT_END_NODE\n");
                 break;
         case FDT_PROP:
-                klog("[devicetree] FDT_PROP\n");
+                KLOG_VERBOSE(KLOG_DTB, "[devicetree] FDT_PROP\n");
                 break;
         case FDT_NOP:
-                klog("[devicetree] FDT_NOP\n");
+                KLOG_VERBOSE(KLOG_DTB, "[devicetree] FDT_NOP\n");
                 break;
         case FDT_END:
-                klog("[devicetree] FDT_END\n");
+                KLOG_VERBOSE(KLOG_DTB, "[devicetree] FDT_END\n");
                 break;
         default:
                 break;
@@ -84,7 +84,7 @@ uint8_t dtb_mem_info(void *base, uint64_t *mem_start, uint64_t *mem_end)
         
         uint32_t *mem_node = _find_node(hdr, "memory");
         if (!mem_node) {
-                klog("[devicetree] couldn't found any 'memory'\n");
+                KLOG_ERR(KLOG_DTB, "[devicetree] couldn't found any 'memory'\n");
         }
 
         /* Skip until the 'reg' property - TODO: Unsafe */
@@ -112,6 +112,241 @@ uint8_t dtb_mem_info(void *base, uint64_t *mem_start, uint64_t *mem_end)
         return result;
 } 
 
+static inline uint32_t _align4(uint32_t n)
+{
+        return (n + 3u) & ~3u;
+}
+
+/* Is 'compat' one of the NUL separated strings in 'list'? */
+static uint8_t _in_stringlist(const char *list, uint32_t len,
+                              const char *compat)
+{
+        uint32_t i = 0;
+
+        while (i < len) {
+                if (!strcmp(list + i, compat)) {
+                        return 1;
+                }
+
+                i += strlen(list + i) + 1;
+        }
+
+        return 0;
+}
+
+uint8_t dtb_find_compatible(void *base, const char *compat,
+                            uint64_t *reg, uint32_t count)
+{
+        if (!compat || !_dtb_valid(base)) {
+                return 1;
+        }
+
+        fdt_header *hdr = (fdt_header*) base;
+        const char *strings = (const char*) base + TO_LE(hdr->off_dt_strings);
+        uint32_t *token = (uint32_t*) (
+                (uint8_t*) base + TO_LE(hdr->off_dt_struct));
+        uint32_t *end = (uint32_t*) ((uint8_t*) token +
+                TO_LE(hdr->size_dt_struct));
+
+        uint8_t match = 0;
+        uint32_t *reg_data = 0;
+        uint32_t reg_len = 0;
+
+        while (token < end) {
+                uint32_t tag = TO_LE(*token++);
+
+                _token_parse(tag);
+
+                if (tag == FDT_BEGIN_NODE || tag == FDT_END_NODE ||
+                        tag == FDT_END) {
+                        /* Properties come before sub-nodes, node is done */
+                        if (match) {
+                                break;
+                        }
+
+                        reg_data = 0;
+                        reg_len = 0;
+                }
+
+                if (tag == FDT_BEGIN_NODE) {
+                        const char *name = (const char*) token;
+
+                        token += _align4(strlen(name) + 1) / 4;
+                } else if (tag == FDT_PROP) {
+                        fdt_prop *prop = (fdt_prop*) token;
+                        uint32_t len = TO_LE(prop->len);
+                        const char *name = strings + TO_LE(prop->nameoff);
+                        uint32_t *data = (uint32_t*) (prop + 1);
+
+                        if (!strcmp(name, "compatible")) {
+                                match = _in_stringlist((const char*) data,
+                                        len, compat);
+                        } else if (!strcmp(name, "reg")) {
+                                reg_data = data;
+                                reg_len = len;
+                        }
+
+                        token = data + _align4(len) / 4;
+                } else if (tag == FDT_END) {
+                        break;
+                }
+        }
+
+        if (!match) {
+                return 1;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                uint32_t *cell = reg_data + 4 * i;
+
+                if (!reg_data || reg_len < 16 * (i + 1)) {
+                        reg[2 * i] = reg[2 * i + 1] = 0;
+                        continue;
+                }
+
+                reg[2 * i] = ((uint64_t) TO_LE(cell[0]) << 32) +
+                        TO_LE(cell[1]);
+                reg[2 * i + 1] = ((uint64_t) TO_LE(cell[2]) << 32) +
+                        TO_LE(cell[3]);
+        }
+
+        return 0;
+}
+
+uint8_t dtb_find_prop(void *base, const char *compat, const char *prop,
+                      const void **data, uint32_t *len)
+{
+        if (!compat || !prop || !data || !len || !_dtb_valid(base)) {
+                return 1;
+        }
+
+        fdt_header *hdr = (fdt_header*) base;
+        const char *strings = (const char*) base + TO_LE(hdr->off_dt_strings);
+        uint32_t *token = (uint32_t*) (
+                (uint8_t*) base + TO_LE(hdr->off_dt_struct));
+        uint32_t *end = (uint32_t*) ((uint8_t*) token +
+                TO_LE(hdr->size_dt_struct));
+
+        uint8_t match = 0;
+        const void *found = 0;
+        uint32_t found_len = 0;
+
+        while (token < end) {
+                uint32_t tag = TO_LE(*token++);
+
+                if (tag == FDT_BEGIN_NODE || tag == FDT_END_NODE ||
+                        tag == FDT_END) {
+                        /* Properties come before sub-nodes, node is done */
+                        if (match) {
+                                break;
+                        }
+
+                        found = 0;
+                        found_len = 0;
+                }
+
+                if (tag == FDT_BEGIN_NODE) {
+                        const char *name = (const char*) token;
+
+                        token += _align4(strlen(name) + 1) / 4;
+                } else if (tag == FDT_PROP) {
+                        fdt_prop *p = (fdt_prop*) token;
+                        uint32_t plen = TO_LE(p->len);
+                        const char *name = strings + TO_LE(p->nameoff);
+                        uint32_t *pdata = (uint32_t*) (p + 1);
+
+                        if (!strcmp(name, "compatible")) {
+                                match = _in_stringlist((const char*) pdata,
+                                        plen, compat);
+                        } else if (!strcmp(name, prop)) {
+                                found = pdata;
+                                found_len = plen;
+                        }
+
+                        token = pdata + _align4(plen) / 4;
+                } else if (tag == FDT_END) {
+                        break;
+                }
+        }
+
+        if (!match || !found) {
+                return 1;
+        }
+
+        *data = found;
+        *len = found_len;
+
+        return 0;
+}
+
+uint32_t dtb_cpus(void *base, uint64_t *mpidr, uint32_t max)
+{
+        if (!_dtb_valid(base)) {
+                return 0;
+        }
+
+        fdt_header *hdr = (fdt_header*) base;
+        const char *strings = (const char*) base + TO_LE(hdr->off_dt_strings);
+        uint32_t *token = (uint32_t*) (
+                (uint8_t*) base + TO_LE(hdr->off_dt_struct));
+        uint32_t *end = (uint32_t*) ((uint8_t*) token +
+                TO_LE(hdr->size_dt_struct));
+
+        uint32_t count = 0;
+        uint8_t in_cpu = 0; /* Inside a cpu@N node, before its sub-nodes */
+
+        while (token < end) {
+                uint32_t tag = TO_LE(*token++);
+
+                if (tag == FDT_BEGIN_NODE) {
+                        const char *name = (const char*) token;
+
+                        in_cpu = _match(name, "cpu@");
+                        token += _align4(strlen(name) + 1) / 4;
+                } else if (tag == FDT_END_NODE) {
+                        in_cpu = 0;
+                } else if (tag == FDT_PROP) {
+                        fdt_prop *p = (fdt_prop*) token;
+                        uint32_t plen = TO_LE(p->len);
+                        const char *name = strings + TO_LE(p->nameoff);
+                        uint32_t *pdata = (uint32_t*) (p + 1);
+
+                        /* 'reg' is 1 or 2 cells (/cpus #address-cells) */
+                        if (in_cpu && !strcmp(name, "reg") && 4 <= plen) {
+                                uint64_t reg = TO_LE(pdata[0]);
+
+                                if (8 <= plen) {
+                                        reg = (reg << 32) + TO_LE(pdata[1]);
+                                }
+
+                                if (mpidr && count < max) {
+                                        mpidr[count] = reg;
+                                }
+
+                                count++;
+                                in_cpu = 0;
+                        }
+
+                        token = pdata + _align4(plen) / 4;
+                } else if (tag == FDT_END) {
+                        break;
+                }
+        }
+
+        return count;
+}
+
+uint8_t dtb_cpu_count(void *base, uint64_t *cpu_count)
+{
+        if (!cpu_count || !_dtb_valid(base)) {
+                return 1;
+        }
+
+        *cpu_count = dtb_cpus(base, 0, 0);
+
+        return *cpu_count == 0;
+}
+
 uint8_t dtb_init(void *base)
 {
         if (!base) {
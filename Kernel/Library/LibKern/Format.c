@@ -0,0 +1,474 @@
+/*
+ * printf-style formatting into caller provided buffers
+ *
+ * Integers are converted without the per-digit '%' & '/' loop:
+ *   - base 10: two digits per step using a 200 byte "00".."99" table, so a
+ *     64-bit value needs at most 10 divisions by the constant 100 (which the
+ *     compiler turns into a multiply-high anyway).
+ *   - base 16 & 8: shifts and masks only.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include "LibKern/Format.h"
+
+#define FMT_LEFT        (1U << 0) /* '-' */
+#define FMT_ZERO        (1U << 1) /* '0' */
+#define FMT_PLUS        (1U << 2) /* '+' */
+#define FMT_SPACE       (1U << 3) /* ' ' */
+#define FMT_ALT         (1U << 4) /* '#' */
+
+#define NUM_BUF_SIZE 24 /* Fits 2^64 - 1 in octal (22 digits) */
+
+static const char digit_pairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+/* Output sink: counts everything, stores what fits */
+typedef struct fmt_out {
+        char *buf;
+        size_t size; /* usable bytes, excluding the NUL */
+        size_t pos;
+} fmt_out;
+
+static inline void _put(fmt_out *out, char c)
+{
+        if (out->pos < out->size) {
+                out->buf[out->pos] = c;
+        }
+
+        out->pos++;
+}
+
+static void _put_n(fmt_out *out, const char *s, size_t n)
+{
+        size_t room = (out->pos < out->size) ? out->size - out->pos : 0;
+        size_t copy = (n < room) ? n : room;
+
+        for (size_t i = 0; i < copy; i++) {
+                out->buf[out->pos + i] = s[i];
+        }
+
+        out->pos += n;
+}
+
+static void _pad(fmt_out *out, char c, int n)
+{
+        for (; 0 < n; n--) {
+                _put(out, c);
+        }
+}
+
+char *kfmt_u64_dec(char *end, uint64_t val)
+{
+        while (100 <= val) {
+                uint64_t q = val / 100;
+                uint32_t r = (uint32_t) (val - q * 100);
+
+                end -= 2;
+                end[0] = digit_pairs[2 * r];
+                end[1] = digit_pairs[2 * r + 1];
+
+                val = q;
+        }
+
+        if (10 <= val) {
+                end -= 2;
+                end[0] = digit_pairs[2 * val];
+                end[1] = digit_pairs[2 * val + 1];
+        } else {
+                *--end = (char) ('0' + val);
+        }
+
+        return end;
+}
+
+char *kfmt_u64_hex(char *end, uint64_t val, uint8_t upper)
+{
+        const char *digits = upper ? hex_upper : hex_lower;
+
+        do {
+                *--end = digits[val & 0xF];
+                val >>= 4;
+        } while (val);
+
+        return end;
+}
+
+char *kfmt_u64_oct(char *end, uint64_t val)
+{
+        do {
+                *--end = (char) ('0' + (val & 0x7));
+                val >>= 3;
+        } while (val);
+
+        return end;
+}
+
+/*
+ * Emit an already converted number with sign/prefix, precision & width.
+ * Layout: [spaces][sign][prefix][zeros][digits][spaces]
+ */
+static void _put_num(fmt_out *out, const char *digits, int ndigits,
+                     const char *prefix, int nprefix,
+                     uint32_t flags, int width, int prec)
+{
+        int zeros = 0;
+
+        if (0 <= prec) {
+                if (ndigits < prec) {
+                        zeros = prec - ndigits;
+                }
+        } else if ((flags & FMT_ZERO) && !(flags & FMT_LEFT)) {
+                int used = nprefix + ndigits;
+
+                if (used < width) {
+                        zeros = width - used;
+                }
+        }
+
+        int pad = width - (nprefix + zeros + ndigits);
+
+        if (!(flags & FMT_LEFT)) {
+                _pad(out, ' ', pad);
+        }
+
+        _put_n(out, prefix, nprefix);
+        _pad(out, '0', zeros);
+        _put_n(out, digits, ndigits);
+
+        if (flags & FMT_LEFT) {
+                _pad(out, ' ', pad);
+        }
+}
+
+static void _put_str(fmt_out *out, const char *s, uint32_t flags,
+                     int width, int prec)
+{
+        size_t len = 0;
+
+        if (!s) {
+                s = "(null)";
+        }
+
+        /* Don't read past 'prec' characters, the string may not be NUL'ed */
+        while (s[len] && (prec < 0 || len < (size_t) prec)) {
+                len++;
+        }
+
+        int pad = width - (int) len;
+
+        if (!(flags & FMT_LEFT)) {
+                _pad(out, ' ', pad);
+        }
+
+        _put_n(out, s, len);
+
+        if (flags & FMT_LEFT) {
+                _pad(out, ' ', pad);
+        }
+}
+
+enum {
+        LEN_INT = 0,
+        LEN_CHAR,
+        LEN_SHORT,
+        LEN_LONG,
+        LEN_LLONG,
+        LEN_SIZE
+};
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args)
+{
+        fmt_out out = {
+                .buf = buf,
+                .size = size ? size - 1 : 0,
+                .pos = 0
+        };
+
+        if (!fmt) {
+                fmt = "(null)";
+        }
+
+        while (*fmt) {
+                /* Copy literal runs in one go */
+                const char *run = fmt;
+
+                while (*fmt && *fmt != '%') {
+                        fmt++;
+                }
+
+                if (run != fmt) {
+                        _put_n(&out, run, fmt - run);
+                }
+
+                if (!*fmt) {
+                        break;
+                }
+
+                fmt++; /* '%' */
+
+                /* Flags */
+                uint32_t flags = 0;
+
+                for (;; fmt++) {
+                        if (*fmt == '-') {
+                                flags |= FMT_LEFT;
+                        } else if (*fmt == '0') {
+                                flags |= FMT_ZERO;
+                        } else if (*fmt == '+') {
+                                flags |= FMT_PLUS;
+                        } else if (*fmt == ' ') {
+                                flags |= FMT_SPACE;
+                        } else if (*fmt == '#') {
+                                flags |= FMT_ALT;
+                        } else {
+                                break;
+                        }
+                }
+
+                /* Width */
+                int width = 0;
+
+                if (*fmt == '*') {
+                        width = va_arg(args, int);
+                        fmt++;
+
+                        if (width < 0) {
+                                flags |= FMT_LEFT;
+                                width = -width;
+                        }
+                } else {
+                        while ('0' <= *fmt && *fmt <= '9') {
+                                width = width * 10 + (*fmt++ - '0');
+                        }
+                }
+
+                /* Precision */
+                int prec = -1;
+
+                if (*fmt == '.') {
+                        fmt++;
+                        prec = 0;
+
+                        if (*fmt == '*') {
+                                prec = va_arg(args, int);
+                                fmt++;
+                        } else {
+                                while ('0' <= *fmt && *fmt <= '9') {
+                                        prec = prec * 10 + (*fmt++ - '0');
+                                }
+                        }
+                }
+
+                /* Length modifier */
+                uint8_t len = LEN_INT;
+
+                switch (*fmt) {
+                case 'h':
+                        len = LEN_SHORT;
+                        if (*++fmt == 'h') {
+                                len = LEN_CHAR;
+                                fmt++;
+                        }
+                break;
+                case 'l':
+                        len = LEN_LONG;
+                        if (*++fmt == 'l') {
+                                len = LEN_LLONG;
+                                fmt++;
+                        }
+                break;
+                case 'z':
+                case 'j':
+                case 't':
+                        len = LEN_SIZE;
+                        fmt++;
+                break;
+                default:
+                break;
+                }
+
+                char conv = *fmt;
+
+                if (!conv) {
+                        break;
+                }
+
+                fmt++;
+
+                char num[NUM_BUF_SIZE];
+                char *end = num + NUM_BUF_SIZE;
+                char *digits = end;
+                char prefix[2];
+                int nprefix = 0;
+                uint64_t uval = 0;
+
+                switch (conv) {
+                case 'd':
+                case 'i': {
+                        int64_t val = 0;
+
+                        switch (len) {
+                        case LEN_CHAR:
+                                val = (signed char) va_arg(args, int);
+                        break;
+                        case LEN_SHORT:
+                                val = (short) va_arg(args, int);
+                        break;
+                        case LEN_LONG:
+                                val = va_arg(args, long);
+                        break;
+                        case LEN_LLONG:
+                                val = va_arg(args, long long);
+                        break;
+                        case LEN_SIZE:
+                                val = va_arg(args, int64_t);
+                        break;
+                        default:
+                                val = va_arg(args, int);
+                        break;
+                        }
+
+                        /* Avoid overflow on INT64_MIN */
+                        uval = (val < 0) ? -(uint64_t) val : (uint64_t) val;
+
+                        if (val < 0) {
+                                prefix[nprefix++] = '-';
+                        } else if (flags & FMT_PLUS) {
+                                prefix[nprefix++] = '+';
+                        } else if (flags & FMT_SPACE) {
+                                prefix[nprefix++] = ' ';
+                        }
+
+                        if (uval || prec != 0) {
+                                digits = kfmt_u64_dec(end, uval);
+                        }
+
+                        _put_num(&out, digits, end - digits, prefix, nprefix,
+                                flags, width, prec);
+                }
+                break;
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                        switch (len) {
+                        case LEN_CHAR:
+                                uval = (unsigned char)
+                                        va_arg(args, unsigned int);
+                        break;
+                        case LEN_SHORT:
+                                uval = (unsigned short)
+                                        va_arg(args, unsigned int);
+                        break;
+                        case LEN_LONG:
+                                uval = va_arg(args, unsigned long);
+                        break;
+                        case LEN_LLONG:
+                                uval = va_arg(args, unsigned long long);
+                        break;
+                        case LEN_SIZE:
+                                uval = va_arg(args, uint64_t);
+                        break;
+                        default:
+                                uval = va_arg(args, unsigned int);
+                        break;
+                        }
+
+                        if (uval || prec != 0) {
+                                if (conv == 'u') {
+                                        digits = kfmt_u64_dec(end, uval);
+                                } else if (conv == 'o') {
+                                        digits = kfmt_u64_oct(end, uval);
+                                } else {
+                                        digits = kfmt_u64_hex(end, uval,
+                                                conv == 'X');
+                                }
+                        }
+
+                        if ((flags & FMT_ALT) && conv == 'o' &&
+                                (digits == end || *digits != '0') &&
+                                (prec <= end - digits)) {
+                                *--digits = '0';
+                        } else if ((flags & FMT_ALT) && uval &&
+                                (conv == 'x' || conv == 'X')) {
+                                prefix[nprefix++] = '0';
+                                prefix[nprefix++] = conv;
+                        }
+
+                        _put_num(&out, digits, end - digits, prefix, nprefix,
+                                flags, width, prec);
+                break;
+                case 'p':
+                        uval = (uint64_t) (uintptr_t) va_arg(args, void*);
+                        digits = kfmt_u64_hex(end, uval, 0);
+
+                        prefix[nprefix++] = '0';
+                        prefix[nprefix++] = 'x';
+
+                        _put_num(&out, digits, end - digits, prefix, nprefix,
+                                flags, width, prec);
+                break;
+                case 's':
+                        _put_str(&out, va_arg(args, const char*), flags,
+                                width, prec);
+                break;
+                case 'c': {
+                        char c = (char) va_arg(args, int);
+
+                        if (!(flags & FMT_LEFT)) {
+                                _pad(&out, ' ', width - 1);
+                        }
+
+                        _put(&out, c);
+
+                        if (flags & FMT_LEFT) {
+                                _pad(&out, ' ', width - 1);
+                        }
+                }
+                break;
+                case '%':
+                        _put(&out, '%');
+                break;
+                default:
+                        /* Unknown conversion, print it as is */
+                        _put(&out, '%');
+                        _put(&out, conv);
+                break;
+                }
+        }
+
+        if (size) {
+                buf[(out.pos < out.size) ? out.pos : out.size] = '\0';
+        }
+
+        return (int) out.pos;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+        va_list args;
+        va_start(args, fmt);
+
+        int ret = kvsnprintf(buf, size, fmt, args);
+
+        va_end(args);
+
+        return ret;
+}
@@ -0,0 +1,402 @@
+/*
+ * Read-Copy-Update, see RCU.h
+ *
+ * The only shared words are 'gp_seq', 'gp_done', 'idle' & 'pending'; the
+ * callback lists are per CPU and touched by their own CPU only.
+ *
+ * Idle CPUs vs. starting a GP is a store-buffering race: the GP reads
+ * 'idle' after its 'gp_seq' store, the CPU reads 'gp_seq' after its 'idle'
+ * store. Sequentially consistent, at least one of them sees the other, so
+ * either the GP leaves the CPU out or the CPU reports to it.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#include "LibKern/List.h"
+#include "LibKern/RCU.h"
+
+static void _cblist_init(rcu_cblist *list)
+{
+        list->head = NULL;
+        list->tail = &list->head;
+        list->len = 0;
+}
+
+static void _cblist_add(rcu_cblist *list, rcu_head *head)
+{
+        head->next = NULL;
+        *list->tail = head;
+        list->tail = &head->next;
+        list->len++;
+}
+
+void rcu_state_init(rcu_state *rs, void (*free)(void *obj))
+{
+        spin_lock_init(&rs->lock);
+
+        rs->gp_seq = 0;
+        rs->gp_done = 0;
+        rs->gp_wanted = 0;
+
+        rs->online = 0;
+        rs->idle = 0;
+        rs->pending = 0;
+
+        rs->free = free;
+        rs->invoked = 0;
+
+        for (uint32_t cpu = 0; cpu < RCU_CPUS; cpu++) {
+                rcu_cpu *rc = &rs->cpu[cpu];
+
+                _cblist_init(&rc->next);
+                _cblist_init(&rc->wait);
+                rc->wait_gp = 0;
+                rc->qs_gp = 0;
+                rc->irq_from_idle = 0;
+        }
+}
+
+/* Lock held */
+static void _gp_end(rcu_state *rs)
+{
+        __atomic_store_n(&rs->gp_done, rs->gp_seq, __ATOMIC_RELEASE);
+}
+
+/* Lock held. Starts GPs while one is wanted, ends those nobody holds up */
+static void _gp_advance(rcu_state *rs)
+{
+        while (rs->gp_seq == rs->gp_done && rs->gp_done < rs->gp_wanted) {
+                /* The updater's unpublishing stores come first */
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+                uint32_t idle = __atomic_load_n(&rs->idle, __ATOMIC_SEQ_CST);
+
+                /* 'pending' is complete before anyone sees the new GP */
+                __atomic_store_n(&rs->pending, rs->online & ~idle,
+                        __ATOMIC_SEQ_CST);
+                __atomic_store_n(&rs->gp_seq, rs->gp_seq + 1,
+                        __ATOMIC_SEQ_CST);
+
+                /* Went idle meanwhile, maybe without seeing the new GP */
+                idle = __atomic_load_n(&rs->idle, __ATOMIC_SEQ_CST);
+
+                if (__atomic_and_fetch(&rs->pending, ~idle, __ATOMIC_ACQ_REL)) {
+                        return;
+                }
+
+                _gp_end(rs);
+        }
+}
+
+/* 'cpu' is in a QS: clear its bit in the running GP, end it if last */
+static void _report(rcu_state *rs, uint32_t cpu)
+{
+        rcu_cpu *rc = &rs->cpu[cpu];
+        uint32_t bit = 1U << cpu;
+        uint64_t seq = __atomic_load_n(&rs->gp_seq, __ATOMIC_SEQ_CST);
+
+        if (rc->qs_gp == seq ||
+                seq == __atomic_load_n(&rs->gp_done, __ATOMIC_ACQUIRE)) {
+                return;
+        }
+
+        rc->qs_gp = seq;
+
+        /* Release: our read sections are over before the bit goes */
+        if (__atomic_fetch_and(&rs->pending, ~bit, __ATOMIC_ACQ_REL) != bit) {
+                return;
+        }
+
+        spin_lock(&rs->lock);
+        _gp_end(rs);
+        _gp_advance(rs);
+        spin_unlock(&rs->lock);
+}
+
+static void _invoke(rcu_state *rs, rcu_head *head)
+{
+        uint64_t n = 0;
+
+        while (head) {
+                rcu_head *next = head->next;
+                uint64_t fn = (uint64_t) head->fn;
+
+                if (fn < RCU_FREE_OFFSET_MAX) {
+                        rs->free((uint8_t*) head - fn);
+                } else {
+                        head->fn(head);
+                }
+
+                head = next;
+                n++;
+        }
+
+        __atomic_fetch_add(&rs->invoked, n, __ATOMIC_RELAXED);
+}
+
+/* Run the ready batch, give the next one a GP */
+static void _callbacks(rcu_state *rs, uint32_t cpu)
+{
+        rcu_cpu *rc = &rs->cpu[cpu];
+
+        if (rc->wait.len && rc->wait_gp <=
+                        __atomic_load_n(&rs->gp_done, __ATOMIC_ACQUIRE)) {
+                rcu_head *ready = rc->wait.head;
+
+                _cblist_init(&rc->wait);
+                _invoke(rs, ready);
+        }
+
+        if (rc->wait.len || !rc->next.len) {
+                return;
+        }
+
+        rc->wait = rc->next;
+        _cblist_init(&rc->next);
+
+        spin_lock(&rs->lock);
+
+        /* The running GP (if any) may have started before they were queued */
+        rc->wait_gp = rs->gp_seq + 1;
+
+        if (rs->gp_wanted < rc->wait_gp) {
+                rs->gp_wanted = rc->wait_gp;
+        }
+
+        _gp_advance(rs);
+
+        spin_unlock(&rs->lock);
+
+        /* Still in our QS, which counts for the new GP too */
+        _report(rs, cpu);
+
+        if (rc->wait_gp <= __atomic_load_n(&rs->gp_done, __ATOMIC_ACQUIRE)) {
+                rcu_head *ready = rc->wait.head;
+
+                _cblist_init(&rc->wait);
+                _invoke(rs, ready);
+        }
+}
+
+void rcu_cpu_online(rcu_state *rs, uint32_t cpu)
+{
+        spin_lock(&rs->lock);
+
+        /* Not expected by the running GP, nothing to report for it */
+        rs->cpu[cpu].qs_gp = rs->gp_seq;
+        __atomic_fetch_or(&rs->online, 1U << cpu, __ATOMIC_RELAXED);
+
+        spin_unlock(&rs->lock);
+}
+
+void rcu_cpu_offline(rcu_state *rs, uint32_t cpu)
+{
+        uint32_t bit = 1U << cpu;
+
+        spin_lock(&rs->lock);
+
+        __atomic_fetch_and(&rs->online, ~bit, __ATOMIC_RELAXED);
+
+        if (__atomic_fetch_and(&rs->pending, ~bit, __ATOMIC_ACQ_REL) == bit &&
+                rs->gp_seq != rs->gp_done) {
+                _gp_end(rs);
+                _gp_advance(rs);
+        }
+
+        spin_unlock(&rs->lock);
+}
+
+void rcu_qs(rcu_state *rs, uint32_t cpu)
+{
+        _report(rs, cpu);
+        _callbacks(rs, cpu);
+}
+
+void rcu_idle_enter(rcu_state *rs, uint32_t cpu)
+{
+        rcu_qs(rs, cpu);
+
+        __atomic_fetch_or(&rs->idle, 1U << cpu, __ATOMIC_SEQ_CST);
+
+        /* A GP that started before the store above still expects us */
+        _report(rs, cpu);
+}
+
+void rcu_idle_exit(rcu_state *rs, uint32_t cpu)
+{
+        __atomic_fetch_and(&rs->idle, ~(1U << cpu), __ATOMIC_SEQ_CST);
+
+        /* Our next read section's loads can't pass the store above */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rcu_call(rcu_state *rs, uint32_t cpu, rcu_head *head, rcu_fn fn)
+{
+        head->fn = fn;
+
+        _cblist_add(&rs->cpu[cpu].next, head);
+}
+
+void rcu_call_free(rcu_state *rs, uint32_t cpu, rcu_head *head,
+                   uint64_t offset)
+{
+        if (RCU_FREE_OFFSET_MAX <= offset || !rs->free) {
+                return;
+        }
+
+        rcu_call(rs, cpu, head, (rcu_fn) offset);
+}
+
+uint64_t rcu_pending(rcu_state *rs, uint32_t cpu)
+{
+        return rs->cpu[cpu].next.len + rs->cpu[cpu].wait.len;
+}
+
+/*
+ * Kernel wrappers
+ */
+
+#if !__STDC_HOSTED__
+
+#include "ARM64/Machine.h"
+
+#include "Memory/Page.h"
+#include "Memory/Physical.h"
+
+_Static_assert(RCU_CPUS == MAX_CPUS, "one rcu_cpu per CPU");
+
+rcu_state rcu;
+
+typedef struct rcu_sync {
+        rcu_head head;
+        uint32_t done;
+} rcu_sync;
+
+/* A GP ended: wake synchronize_rcu() & idle CPUs with callbacks */
+static void _kick(uint64_t done_before)
+{
+        if (__atomic_load_n(&rcu.gp_done, __ATOMIC_RELAXED) != done_before) {
+                dsb_ish();
+                sev();
+        }
+}
+
+/* rcu_free()'d objects are used through page_va(), like all nb_alloc()s */
+static void _nb_free(void *obj)
+{
+        nb_free((void*) page_pa(obj));
+}
+
+void rcu_init(void)
+{
+        rcu_state_init(&rcu, _nb_free);
+        rcu_cpu_online(&rcu, cpu_id());
+}
+
+void rcu_cpu_init(void)
+{
+        rcu_cpu_online(&rcu, cpu_id());
+}
+
+void rcu_quiescent(void)
+{
+        uint64_t flags = irq_save();
+        uint64_t done = __atomic_load_n(&rcu.gp_done, __ATOMIC_RELAXED);
+
+        rcu_qs(&rcu, cpu_id());
+        _kick(done);
+
+        irq_restore(flags);
+}
+
+void rcu_idle_begin(void)
+{
+        uint64_t flags = irq_save();
+        uint64_t done = __atomic_load_n(&rcu.gp_done, __ATOMIC_RELAXED);
+
+        rcu_idle_enter(&rcu, cpu_id());
+        _kick(done);
+
+        irq_restore(flags);
+}
+
+void rcu_idle_end(void)
+{
+        uint64_t flags = irq_save();
+
+        rcu_idle_exit(&rcu, cpu_id());
+
+        irq_restore(flags);
+}
+
+void rcu_irq_enter(void)
+{
+        uint32_t cpu = cpu_id();
+
+        /* Handlers may read, so the GPs from now on must wait for us */
+        if (__atomic_load_n(&rcu.idle, __ATOMIC_RELAXED) & (1U << cpu)) {
+                rcu.cpu[cpu].irq_from_idle = 1;
+                rcu_idle_exit(&rcu, cpu);
+        }
+}
+
+void rcu_irq_exit(uint8_t from_el0)
+{
+        rcu_cpu *rc = &rcu.cpu[cpu_id()];
+
+        if (rc->irq_from_idle) {
+                rc->irq_from_idle = 0;
+                rcu_idle_begin();
+        } else if (from_el0) {
+                rcu_quiescent();
+        }
+}
+
+void call_rcu(rcu_head *head, rcu_fn fn)
+{
+        uint64_t flags = irq_save();
+
+        rcu_call(&rcu, cpu_id(), head, fn);
+
+        irq_restore(flags);
+}
+
+void __rcu_free(rcu_head *head, uint64_t offset)
+{
+        uint64_t flags = irq_save();
+
+        rcu_call_free(&rcu, cpu_id(), head, offset);
+
+        irq_restore(flags);
+}
+
+static void _sync_done(rcu_head *head)
+{
+        rcu_sync *sync = CONTAINER_OF(head, rcu_sync, head);
+
+        __atomic_store_n(&sync->done, 1, __ATOMIC_RELEASE);
+}
+
+void synchronize_rcu(void)
+{
+        rcu_sync sync = { .done = 0 };
+
+        call_rcu(&sync.head, _sync_done);
+
+        for (;;) {
+                rcu_quiescent(); /* Starts the GP, runs '_sync_done' */
+
+                if (__atomic_load_n(&sync.done, __ATOMIC_ACQUIRE)) {
+                        return;
+                }
+
+                wfe(); /* _kick() from the CPU that ends the GP */
+        }
+}
+
+#endif /* !__STDC_HOSTED__ */
@@ -0,0 +1,315 @@
+/*
+ * Integer-only string & memory functions for the kernel
+ *
+ * The kernel never touches the FP/SIMD registers: they hold the lazily
+ * switched state of whichever thread used them last (see ARM64/FPSIMD.h).
+ * These replace the Advanced SIMD versions from optimized-routines, only
+ * strcmp & strncmp (integer-only already) are still taken from there.
+ *
+ * Same assumptions as before: unaligned accesses to normal memory are
+ * fine (MMU on). Loads that may run past the end of a string are kept
+ * aligned, so they never cross into the next page.
+ *
+ * Unit tested on the host (see Tests/StringTest.cpp) under k-prefixed
+ * names, libc owns the real ones there.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The kernel builds at -O0, these are hot. No loop -> memset() calls */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("O2", "no-tree-loop-distribute-patterns")
+#endif
+
+#if __STDC_HOSTED__
+#define KSTR(fn) k##fn
+#else
+#define KSTR(fn) fn
+#endif
+
+typedef uint64_t __attribute__((may_alias, aligned(1))) uword;
+
+#define WSIZE           sizeof(uint64_t)
+#define ONES            0x0101010101010101ULL
+#define HIGHS           0x8080808080808080ULL
+
+/* Non-zero iff a byte of 'x' is zero, the lowest such byte is exact */
+#define HAS_ZERO(x)     (((x) - ONES) & ~(x) & HIGHS)
+
+/* Byte index of the first zero byte, given HAS_ZERO() != 0 (little-endian) */
+static inline size_t _zero_idx(uint64_t haszero)
+{
+        return (size_t) __builtin_ctzll(haszero) / 8;
+}
+
+static inline int _aligned(const void *p)
+{
+        return ((uintptr_t) p & (WSIZE - 1)) == 0;
+}
+
+static void _copy_fwd(uint8_t *d, const uint8_t *s, size_t n)
+{
+        while (4 * WSIZE <= n) {
+                uint64_t a = ((const uword*) s)[0];
+                uint64_t b = ((const uword*) s)[1];
+                uint64_t c = ((const uword*) s)[2];
+                uint64_t e = ((const uword*) s)[3];
+
+                ((uword*) d)[0] = a;
+                ((uword*) d)[1] = b;
+                ((uword*) d)[2] = c;
+                ((uword*) d)[3] = e;
+
+                d += 4 * WSIZE;
+                s += 4 * WSIZE;
+                n -= 4 * WSIZE;
+        }
+
+        while (WSIZE <= n) {
+                *(uword*) d = *(const uword*) s;
+
+                d += WSIZE;
+                s += WSIZE;
+                n -= WSIZE;
+        }
+
+        while (n--) {
+                *d++ = *s++;
+        }
+}
+
+static void _copy_bwd(uint8_t *d, const uint8_t *s, size_t n)
+{
+        d += n;
+        s += n;
+
+        while (4 * WSIZE <= n) {
+                d -= 4 * WSIZE;
+                s -= 4 * WSIZE;
+                n -= 4 * WSIZE;
+
+                uint64_t a = ((const uword*) s)[3];
+                uint64_t b = ((const uword*) s)[2];
+                uint64_t c = ((const uword*) s)[1];
+                uint64_t e = ((const uword*) s)[0];
+
+                ((uword*) d)[3] = a;
+                ((uword*) d)[2] = b;
+                ((uword*) d)[1] = c;
+                ((uword*) d)[0] = e;
+        }
+
+        while (WSIZE <= n) {
+                d -= WSIZE;
+                s -= WSIZE;
+                n -= WSIZE;
+
+                *(uword*) d = *(const uword*) s;
+        }
+
+        while (n--) {
+                *--d = *--s;
+        }
+}
+
+void *KSTR(memmove)(void *dst, const void *src, size_t n)
+{
+        uint8_t *d = dst;
+        const uint8_t *s = src;
+
+        /* Forward is safe unless 'dst' starts inside [src, src + n) */
+        if ((uintptr_t) d - (uintptr_t) s >= n) {
+                _copy_fwd(d, s, n);
+        } else if (d != s) {
+                _copy_bwd(d, s, n);
+        }
+
+        return dst;
+}
+
+/* Overlap tolerant, like the optimized-routines version was */
+void *KSTR(memcpy)(void *__restrict dst, const void *__restrict src, size_t n)
+{
+        return KSTR(memmove)(dst, src, n);
+}
+
+void *KSTR(memset)(void *dst, int c, size_t n)
+{
+        uint8_t *d = dst;
+        uint64_t pattern = ONES * (uint8_t) c;
+
+        while (4 * WSIZE <= n) {
+                ((uword*) d)[0] = pattern;
+                ((uword*) d)[1] = pattern;
+                ((uword*) d)[2] = pattern;
+                ((uword*) d)[3] = pattern;
+
+                d += 4 * WSIZE;
+                n -= 4 * WSIZE;
+        }
+
+        while (WSIZE <= n) {
+                *(uword*) d = pattern;
+
+                d += WSIZE;
+                n -= WSIZE;
+        }
+
+        while (n--) {
+                *d++ = (uint8_t) c;
+        }
+
+        return dst;
+}
+
+int KSTR(memcmp)(const void *a, const void *b, size_t n)
+{
+        const uint8_t *p = a;
+        const uint8_t *q = b;
+
+        /* Skip equal words, the byte loop finds the difference */
+        while (WSIZE <= n && *(const uword*) p == *(const uword*) q) {
+                p += WSIZE;
+                q += WSIZE;
+                n -= WSIZE;
+        }
+
+        for (; n; n--, p++, q++) {
+                if (*p != *q) {
+                        return (int) *p - (int) *q;
+                }
+        }
+
+        return 0;
+}
+
+void *KSTR(memchr)(const void *src, int c, size_t n)
+{
+        const uint8_t *p = src;
+        uint8_t ch = (uint8_t) c;
+
+        while (n && !_aligned(p)) {
+                if (*p == ch) {
+                        return (void*) p;
+                }
+
+                p++;
+                n--;
+        }
+
+        uint64_t pattern = ONES * ch;
+
+        while (WSIZE <= n) {
+                uint64_t hit = HAS_ZERO(*(const uword*) p ^ pattern);
+
+                if (hit) {
+                        return (void*) (p + _zero_idx(hit));
+                }
+
+                p += WSIZE;
+                n -= WSIZE;
+        }
+
+        for (; n; n--, p++) {
+                if (*p == ch) {
+                        return (void*) p;
+                }
+        }
+
+        return NULL;
+}
+
+void *KSTR(memrchr)(const void *src, int c, size_t n)
+{
+        const uint8_t *p = (const uint8_t*) src + n;
+
+        while (n--) {
+                if (*--p == (uint8_t) c) {
+                        return (void*) p;
+                }
+        }
+
+        return NULL;
+}
+
+size_t KSTR(strlen)(const char *str)
+{
+        const char *p = str;
+
+        for (; !_aligned(p); p++) {
+                if (*p == '\0') {
+                        return p - str;
+                }
+        }
+
+        for (;; p += WSIZE) {
+                uint64_t zero = HAS_ZERO(*(const uword*) p);
+
+                if (zero) {
+                        return (p - str) + _zero_idx(zero);
+                }
+        }
+}
+
+size_t KSTR(strnlen)(const char *str, size_t max)
+{
+        const char *p = str;
+        size_t left = max; /* 'str + max' may wrap, e.g. max = SIZE_MAX */
+
+        for (; left && !_aligned(p); p++, left--) {
+                if (*p == '\0') {
+                        return p - str;
+                }
+        }
+
+        for (; WSIZE <= left; p += WSIZE, left -= WSIZE) {
+                uint64_t zero = HAS_ZERO(*(const uword*) p);
+
+                if (zero) {
+                        return (p - str) + _zero_idx(zero);
+                }
+        }
+
+        for (; left && *p != '\0'; p++, left--) {
+        }
+
+        return p - str;
+}
+
+char *KSTR(strcpy)(char *__restrict dst, const char *__restrict src)
+{
+        _copy_fwd((uint8_t*) dst, (const uint8_t*) src, KSTR(strlen)(src) + 1);
+
+        return dst;
+}
+
+char *KSTR(strchr)(const char *str, int c)
+{
+        for (;; str++) {
+                if (*str == (char) c) {
+                        return (char*) str;
+                }
+
+                if (*str == '\0') {
+                        return NULL;
+                }
+        }
+}
+
+char *KSTR(strrchr)(const char *str, int c)
+{
+        const char *last = NULL;
+
+        for (;; str++) {
+                if (*str == (char) c) {
+                        last = str;
+                }
+
+                if (*str == '\0') {
+                        return (char*) last;
+                }
+        }
+}
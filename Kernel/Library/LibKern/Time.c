@@ -7,43 +7,54 @@
 #include <stdint.h>
 
 #include "ARM64/Machine.h"
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/Clockevent.h"
+#include "LibKern/RCU.h"
 #include "LibKern/Time.h"
 
 uint64_t arm64_uptime(void)
 {
-        uint64_t uptime = 0; /* nanosec resolution */
-
-        volatile uint64_t CNTVCT_EL0 = 0;
-        volatile uint64_t CNTFRQ_EL0 = 0;
+        return ktime_get_ns(); /* nanosec resolution */
+}
 
-        MRS("CNTVCT_EL0", CNTVCT_EL0);
-        MRS("CNTFRQ_EL0", CNTFRQ_EL0);
+/*
+ * Sleep until ktime_get_ns() reaches 'deadline_ns'
+ *
+ * The CPU waits in 'wfi' for the clockevent interrupt. IRQs are masked
+ * around the check & 'wfi' so an interrupt arriving in between can't be
+ * lost: 'wfi' still wakes up on a pending IRQ and irq_restore() takes it.
+ * Falls back to polling until a clockevent device is registered.
+ *
+ * A sleeping CPU is idle for RCU (no read sections across ksleep()).
+ */
+void ksleep_until(uint64_t deadline_ns)
+{
+        while (ktime_get_ns() < deadline_ns) {
+                uint64_t flags = irq_save();
 
-        uptime = CNTVCT_EL0 * NANO_PER_SEC / CNTFRQ_EL0;
+                if (clockevent_program(deadline_ns) == 0 &&
+                        ktime_get_ns() < deadline_ns) {
+                        rcu_idle_begin();
+                        wfi();
+                        rcu_idle_end();
+                }
 
-        return uptime;
+                irq_restore(flags);
+        }
 }
 
-/* Block the CPU for 'msec' miliseconds */
-void __attribute__((optimize("O0"))) ksleep(const uint64_t mSec) 
+void ksleep_ns(uint64_t nSec)
 {
-        volatile uint64_t CNTVCT_EL0 = 0;
-        volatile uint64_t CNTFRQ_EL0 = 0;
+        ksleep_until(ktime_get_ns() + nSec);
+}
 
-        uint64_t entry = 0;
-        uint64_t curr = 0;
- 
+/* Sleep for 'msec' miliseconds */
+void ksleep(const uint64_t mSec)
+{
         if (mSec == 0) {
                 return;
         }
 
-        MRS("CNTVCT_EL0", CNTVCT_EL0);
-        MRS("CNTFRQ_EL0", CNTFRQ_EL0);
-
-        entry = CNTVCT_EL0 * 1000 / CNTFRQ_EL0; /* Miliseconds passed so far */
-
-        do {
-                MRS("CNTVCT_EL0", CNTVCT_EL0);
-                curr = CNTVCT_EL0 * 1000 / CNTFRQ_EL0;
-        } while ((curr - entry) < mSec);
+        ksleep_ns(mSec * (NANO_PER_SEC / MILLI_PER_SEC));
 }
@@ -0,0 +1,55 @@
+/*
+ * Time page: syscall-free clock reads for user space (vDSO-style data)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/SeqCount.h"
+#include "LibKern/TimePage.h"
+
+#include "Memory/PageDef.h"
+
+/* A page of its own, nothing else may leak to user space through it */
+static union {
+        time_page tp;
+        uint8_t raw[PAGE_SIZE];
+} time_page_data __attribute__((aligned(PAGE_SIZE)));
+
+_Static_assert(sizeof(time_page) <= PAGE_SIZE, "time_page exceeds a page");
+
+const time_page *time_page_get(void)
+{
+        return &time_page_data.tp;
+}
+
+void time_page_update(void)
+{
+        time_page *tp = &time_page_data.tp;
+        clocksource *cs = clocksource_current();
+        uint64_t cycle_last;
+        uint64_t ns_last;
+        uint32_t seq;
+
+        /* Consistent copy of the kernel's own base */
+        do {
+                seq = seqcount_read_begin(&cs->seq);
+                cycle_last = cs->cycle_last;
+                ns_last = cs->ns_last;
+        } while (seqcount_read_retry(&cs->seq, seq));
+
+        seqcount_write_begin(&tp->seq);
+
+        tp->version = TIME_PAGE_VERSION;
+        tp->cycle_last = cycle_last;
+        tp->ns_last = ns_last;
+        tp->mask = cs->mask;
+        tp->mult = cs->mult;
+        tp->shift = cs->shift;
+        tp->freq = cs->freq;
+        tp->wall_offset_ns = ktime_get_wall_offset();
+
+        seqcount_write_end(&tp->seq);
+}
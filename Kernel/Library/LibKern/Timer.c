@@ -0,0 +1,100 @@
+/*
+ * Kernel timers: per-CPU timing wheels driven by the clockevent (tickless)
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "LibKern/Clockevent.h"
+#include "LibKern/Clocksource.h"
+#include "LibKern/Console.h"
+#include "LibKern/Timer.h"
+#include "LibKern/TimerWheel.h"
+
+static timer_wheel wheels[MAX_CPUS];
+
+/* Round up, a timer must never fire before its deadline */
+static inline uint64_t _ns_to_tick(uint64_t ns)
+{
+        return (ns >> TIMER_TICK_SHIFT) +
+                ((ns & ((1ULL << TIMER_TICK_SHIFT) - 1)) != 0);
+}
+
+/* IRQs must be masked */
+static void _reprogram(timer_wheel *tw)
+{
+        uint64_t next = tw_next_event(tw);
+
+        if (next != TW_NONE) {
+                clockevent_program(next << TIMER_TICK_SHIFT);
+        }
+}
+
+static void _timer_interrupt(uint64_t now_ns)
+{
+        timer_wheel *tw = &wheels[cpu_id()];
+
+        clocksource_update();
+
+        tw_advance(tw, now_ns >> TIMER_TICK_SHIFT);
+        _reprogram(tw);
+}
+
+static void _trampoline(tw_timer *t)
+{
+        ktimer *kt = (ktimer*) t->data;
+
+        kt->fn(kt);
+}
+
+void timer_cpu_init(void)
+{
+        uint64_t flags = irq_save();
+
+        tw_init(&wheels[cpu_id()], ktime_get_ns() >> TIMER_TICK_SHIFT);
+        clockevent_set_handler(_timer_interrupt);
+
+        irq_restore(flags);
+
+        KLOG_INFO(KLOG_TIME, "[timer] cpu%u: wheel %ux%u, tick %lu ns\n",
+                cpu_id(), TW_LEVELS, TW_SLOTS, 1UL << TIMER_TICK_SHIFT);
+}
+
+void ktimer_init(ktimer *t, void (*fn)(ktimer *t), void *data)
+{
+        tw_timer_init(&t->tw, _trampoline, t);
+        t->fn = fn;
+        t->data = data;
+        t->cpu = 0;
+}
+
+void ktimer_arm(ktimer *t, uint64_t deadline_ns)
+{
+        uint64_t flags = irq_save();
+        uint32_t cpu = cpu_id();
+        timer_wheel *tw = &wheels[cpu];
+
+        if (ktimer_pending(t)) {
+                tw_del(&wheels[t->cpu], &t->tw);
+        }
+
+        t->cpu = cpu;
+        tw_add(tw, &t->tw, _ns_to_tick(deadline_ns));
+        _reprogram(tw);
+
+        irq_restore(flags);
+}
+
+uint8_t ktimer_cancel(ktimer *t)
+{
+        uint64_t flags = irq_save();
+        uint8_t was_pending = tw_del(&wheels[t->cpu], &t->tw);
+
+        /* The clockevent may fire for nothing once, that's harmless */
+        irq_restore(flags);
+
+        return was_pending;
+}
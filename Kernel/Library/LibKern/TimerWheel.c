@@ -0,0 +1,243 @@
+/*
+ * Hierarchical timing wheel
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "LibKern/List.h"
+#include "LibKern/TimerWheel.h"
+
+#define LVL_SHIFT(lvl)  ((lvl) * TW_SLOT_BITS)
+#define LVL_MASK(lvl)   ((1ULL << LVL_SHIFT(lvl)) - 1)
+
+/* Rotate right, 'n' in [0, 64) */
+static inline uint64_t _ror64(uint64_t v, uint32_t n)
+{
+        return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+static void _enqueue(timer_wheel *tw, tw_timer *t)
+{
+        uint64_t expires = t->expires;
+        uint32_t lvl = 0;
+
+        if (expires < tw->now) {
+                expires = tw->now;
+        }
+
+        /* Lowest level whose slot distance to 'now' is below TW_SLOTS */
+        while (lvl < TW_LEVELS - 1 &&
+                TW_SLOTS <= (expires >> LVL_SHIFT(lvl)) -
+                        (tw->now >> LVL_SHIFT(lvl))) {
+                lvl++;
+        }
+
+        uint32_t idx = (expires >> LVL_SHIFT(lvl)) & TW_SLOT_MASK;
+
+        list_add_tail(&tw->slots[lvl][idx], &t->node);
+        tw->occupied[lvl] |= 1ULL << idx;
+}
+
+void tw_init(timer_wheel *tw, uint64_t now)
+{
+        tw->now = now;
+        tw->pending = 0;
+
+        for (uint32_t lvl = 0; lvl < TW_LEVELS; lvl++) {
+                tw->occupied[lvl] = 0;
+
+                for (uint32_t i = 0; i < TW_SLOTS; i++) {
+                        list_init(&tw->slots[lvl][i]);
+                }
+        }
+}
+
+void tw_timer_init(tw_timer *t, void (*fn)(tw_timer *t), void *data)
+{
+        list_init(&t->node);
+        t->expires = 0;
+        t->fn = fn;
+        t->data = data;
+}
+
+static void _unlink(timer_wheel *tw, tw_timer *t)
+{
+        list_node *next = t->node.next;
+
+        list_del(&t->node);
+        tw->pending--;
+
+        /* Was it the last one in its slot? Then 'next' is the slot head */
+        if (list_empty(next)) {
+                for (uint32_t lvl = 0; lvl < TW_LEVELS; lvl++) {
+                        list_node *base = &tw->slots[lvl][0];
+
+                        if (base <= next && next < base + TW_SLOTS) {
+                                tw->occupied[lvl] &= ~(1ULL << (next - base));
+                                break;
+                        }
+                }
+        }
+}
+
+void tw_add(timer_wheel *tw, tw_timer *t, uint64_t expires)
+{
+        if (tw_timer_pending(t)) {
+                _unlink(tw, t);
+        }
+
+        /* Clamped once here, cascading must not push it out again */
+        if (tw->now < expires && TW_MAX_DELTA < expires - tw->now) {
+                expires = tw->now + TW_MAX_DELTA;
+        }
+
+        t->expires = expires;
+        tw->pending++;
+
+        _enqueue(tw, t);
+}
+
+uint8_t tw_del(timer_wheel *tw, tw_timer *t)
+{
+        if (!tw_timer_pending(t)) {
+                return 0;
+        }
+
+        _unlink(tw, t);
+
+        return 1;
+}
+
+/* Moves the timers of a level's slot down to where they belong now */
+static void _cascade(timer_wheel *tw, uint32_t lvl, uint32_t idx)
+{
+        list_node batch;
+
+        list_init(&batch);
+        list_splice_tail(&batch, &tw->slots[lvl][idx]);
+        tw->occupied[lvl] &= ~(1ULL << idx);
+
+        list_node *node;
+
+        while ((node = list_pop(&batch)) != 0) {
+                _enqueue(tw, CONTAINER_OF(node, tw_timer, node));
+        }
+}
+
+/* Runs a batch of expired timers */
+static uint64_t _run(timer_wheel *tw, list_node *batch)
+{
+        uint64_t count = 0;
+        list_node *node;
+
+        while ((node = list_pop(batch)) != 0) {
+                tw_timer *t = CONTAINER_OF(node, tw_timer, node);
+
+                tw->pending--;
+                count++;
+
+                /* Not pending anymore, so the callback may re-arm it */
+                t->fn(t);
+        }
+
+        return count;
+}
+
+uint64_t tw_next_event(const timer_wheel *tw)
+{
+        uint64_t next = TW_NONE;
+
+        if (tw->pending == 0) {
+                return next;
+        }
+
+        /* Level 0: the slot for 'now' itself may be occupied */
+        if (tw->occupied[0]) {
+                uint32_t cur = tw->now & TW_SLOT_MASK;
+                uint64_t bits = _ror64(tw->occupied[0], cur);
+
+                next = tw->now + __builtin_ctzll(bits);
+        }
+
+        /*
+         * Higher levels: the start of the next occupied slot (a cascade).
+         * The current slot only counts if 'now' is its (unprocessed) start.
+         */
+        for (uint32_t lvl = 1; lvl < TW_LEVELS; lvl++) {
+                if (!tw->occupied[lvl]) {
+                        continue;
+                }
+
+                uint64_t first = tw->now >> LVL_SHIFT(lvl);
+
+                if (tw->now & LVL_MASK(lvl)) {
+                        first++;
+                }
+
+                uint64_t bits = _ror64(tw->occupied[lvl], first & TW_SLOT_MASK);
+                uint64_t tick = (first + __builtin_ctzll(bits)) <<
+                        LVL_SHIFT(lvl);
+
+                if (tick < next) {
+                        next = tick;
+                }
+        }
+
+        return next;
+}
+
+uint64_t tw_advance(timer_wheel *tw, uint64_t now)
+{
+        uint64_t count = 0;
+
+        while (tw->now <= now) {
+                uint64_t tick = tw->now;
+
+                /* Cascade from the coarsest level whose slot starts here */
+                uint32_t top = 0;
+
+                while (top < TW_LEVELS - 1 &&
+                        (tick & LVL_MASK(top + 1)) == 0) {
+                        top++;
+                }
+
+                for (uint32_t lvl = top; 0 < lvl; lvl--) {
+                        uint32_t idx = (tick >> LVL_SHIFT(lvl)) & TW_SLOT_MASK;
+
+                        if (tw->occupied[lvl] & (1ULL << idx)) {
+                                _cascade(tw, lvl, idx);
+                        }
+                }
+
+                uint32_t idx = tick & TW_SLOT_MASK;
+                list_node batch;
+
+                list_init(&batch);
+
+                if (tw->occupied[0] & (1ULL << idx)) {
+                        list_splice_tail(&batch, &tw->slots[0][idx]);
+                        tw->occupied[0] &= ~(1ULL << idx);
+                }
+
+                /*
+                 * 'tick' is done before the callbacks run, so whatever they
+                 * arm for 'tick' or earlier lands on 'tick + 1'
+                 */
+                tw->now = tick + 1;
+                count += _run(tw, &batch);
+
+                /* Skip straight to the next tick with work */
+                uint64_t next = tw_next_event(tw);
+
+                if (next == TW_NONE || now < next) {
+                        tw->now = now + 1;
+                        break;
+                }
+
+                tw->now = next;
+        }
+
+        return count;
+}
@@ -0,0 +1,98 @@
+/*
+ * Deferred-format binary tracing for the kernel
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Machine.h"
+
+#include "LibKern/Console.h"
+#include "LibKern/Trace.h"
+
+/* in Kernel/kernel.ld */
+extern const trace_desc __trace_desc_end[];
+
+trace_ring trace_rings[MAX_CPUS] __attribute__((aligned(64)));
+volatile uint8_t trace_on = 1; /* Always-on flight recorder */
+
+void trace_init(void)
+{
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                trace_rings[cpu].head = 0;
+
+                for (uint32_t i = 0; i < TRACE_SLOTS; i++) {
+                        trace_rings[cpu].slots[i].hdr = 0;
+                }
+        }
+
+        KLOG_INFO(KLOG_TRACE, "[trace] %lu descriptors, %lu slots/cpu\n",
+                (uint64_t) (__trace_desc_end - __trace_desc_start),
+                (uint64_t) TRACE_SLOTS);
+}
+
+void trace_enable(uint8_t on)
+{
+        trace_on = on;
+}
+
+/*
+ * Dump every CPU's ring in a line-oriented hex format:
+ *
+ *      @@TRACE-BEGIN <CNTFRQ_EL0> <cpus> <slots>
+ *      @@RING <cpu> <head>
+ *      @@S <hdr> <cycles> <arg0> ... <arg5>
+ *      ...
+ *      @@TRACE-END
+ *
+ * Slots are printed oldest first. Feed the console log to
+ * Tools/trace-decode.py together with Build/kernel.elf.
+ */
+void trace_dump(void)
+{
+        uint64_t freq = cntfrq_read();
+        uint8_t was_on = trace_on;
+
+        /* Don't record while reading the rings */
+        trace_on = 0;
+
+        kprintf("@@TRACE-BEGIN %lx %lx %lx\n", freq,
+                (uint64_t) MAX_CPUS, (uint64_t) TRACE_SLOTS);
+
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+                trace_ring *ring = &trace_rings[cpu];
+                uint64_t head = ring->head;
+                uint64_t first = 0;
+
+                if (head == 0) {
+                        continue;
+                }
+
+                if (TRACE_SLOTS < head) {
+                        first = head - TRACE_SLOTS;
+                }
+
+                kprintf("@@RING %lx %lx\n", (uint64_t) cpu, head);
+
+                for (uint64_t i = first; i < head; i++) {
+                        trace_slot *slot = &ring->slots[i & (TRACE_SLOTS - 1)];
+
+                        if ((slot->hdr >> 56) != TRACE_MAGIC) {
+                                continue;
+                        }
+
+                        kprintf("@@S %lx %lx", slot->hdr, slot->cycles);
+
+                        for (uint32_t a = 0; a < TRACE_MAX_ARGS; a++) {
+                                kprintf(" %lx", slot->args[a]);
+                        }
+
+                        kprintf("\n");
+                }
+        }
+
+        kprintf("@@TRACE-END\n");
+
+        trace_on = was_on;
+}
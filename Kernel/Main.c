@@ -7,20 +7,42 @@
 #include <stdint.h>
 
 #include "ARM64/Machine.h"
+#include "ARM64/FPSIMD.h"
+#include "ARM64/GenericTimer.h"
+#include "ARM64/IPI.h"
+#include "ARM64/KStack.h"
+#include "ARM64/SMP.h"
 
 #include "Boot.h"
 #include "MemoryLayout.h"
 
+#include "Cap/CSpace.h"
+
 #include "LibKern/String.h"
 #include "LibKern/Time.h"
+#include "LibKern/Timer.h"
 #include "LibKern/Console.h"
 #include "LibKern/DeviceTree.h"
+#include "LibKern/RCU.h"
+#include "LibKern/Trace.h"
+
+#include "Drivers/GIC.h"
+#include "Drivers/PL011.h"
+#include "Drivers/PL031.h"
+
+#ifdef KBENCH
+#include "Bench/KBench.h"
+#endif
 
 #include "Memory/PageDef.h"
 #include "Memory/BootMem.h"
+#include "Memory/Page.h"
 #include "Memory/Physical.h"
 #include "Memory/Virtual.h"
 
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
 /*
  * Kernel entry.
  *
@@ -38,23 +60,35 @@ void kmain(boot_sysinfo *boot_params)
         uint64_t mem_start = 0x0;
         uint64_t mem_end = 0x0;
 
+        /* 0. Per-CPU data (TPIDR_EL1) before anyone asks for it */
+        smp_boot_cpu_init();
+        rcu_init();
+        sched_init();
+        thread_init();
+
+        /* 0. Clocksource first, klog() timestamps depend on it */
+        generic_timer_init();
+
+        /* 0. Always-on tracing (see Tools/trace-decode.py) */
+        trace_init();
+
         /* 0. Get HW Information */
         if (dtb_init((void*) DTB_START) != 0) {
-                klog("[kmain] Couldn't initialize DTB!\n");
+                KLOG_ERR(KLOG_CORE, "[kmain] Couldn't initialize DTB!\n");
                 wfi();
         }
 
         uint8_t res = dtb_mem_info((void*) DTB_START, &mem_start, &mem_end);
         if (res) {
-                klog("[kmain] Failed to get memory info from dtb: %u\n", res);
+                KLOG_ERR(KLOG_CORE, "[kmain] Failed to get memory info from dtb: %u\n", res);
                 wfi();
         }
 
         if ((mem_end - mem_start) < BM_ARENA_SIZE_BYTE) {
-                klog("[kmain] Not enough memory available to boot :(\n");
-                klog("[kmain] ---- Detected memory size: %lu MiB\n",
+                KLOG_ERR(KLOG_CORE, "[kmain] Not enough memory available to boot :(\n");
+                KLOG_ERR(KLOG_CORE, "[kmain] ---- Detected memory size: %lu MiB\n",
                         (mem_end - mem_start) / (1024 * 1024));
-                klog("[kmain] ---- Required minimum size: %u MiB\n",
+                KLOG_ERR(KLOG_CORE, "[kmain] ---- Required minimum size: %u MiB\n",
                         (BM_ARENA_SIZE_BYTE) / (1024 * 1024));
                 wfi();
         }
@@ -64,35 +98,68 @@ void kmain(boot_sysinfo *boot_params)
                 MSR("VBAR_EL1", boot_params->vector_base);
                 isb();
         } else {
-                klog("[kmain] NULL vector table is given!\n");
+                KLOG_WARN(KLOG_CORE, "[kmain] NULL vector table is given!\n");
         }
 
+        /* X. FP/SIMD is switched lazily, EL0 traps until it owns it */
+        fpsimd_cpu_init();
+
+        /* X. IRQ handlers run on per-CPU stacks, before any IRQ shows up */
+        kstack_init();
+
+        /* X. Interrupt controller & interrupt-driven console */
+        gic_probe((void*) DTB_START);
+        ipi_init();
+        pl011_init(PL011_BASE);
+        pl011_irq_enable(PL011_INTID);
+        generic_timer_cpu_init(ARCH_TIMER_VIRT_INTID);
+        timer_cpu_init();
+
+        /* X. Wall clock, anchored to the RTC */
+        pl031_init(PL031_BASE);
+        pl031_irq_enable(PL031_INTID);
+
+        KLOG_INFO(KLOG_CORE, "[kmain] GIC, PL011 & timer IRQs initialized\n");
+
+        /* X. Secondary CPUs, PSCI CPU_ON */
+        smp_init((void*) DTB_START);
+
+#ifdef KBENCH
+        kbench_run();
+#endif
+
         /* 1. Init BootMem */
-        klog("[kmain] Initializing early memory manager...\n");
+        KLOG_INFO(KLOG_CORE, "[kmain] Initializing early memory manager...\n");
 
         uint64_t bootmem_size = bootmem_init(
                 (boot_params->k_phy_base + boot_params->k_size));
 
-        klog("[kmain] Available size in bootmem: %lu MiB\n",
+        KLOG_INFO(KLOG_CORE, "[kmain] Available size in bootmem: %lu MiB\n",
                 bootmem_size / 1024 / 1024);
 
         /* 2. Init PMM */
-        klog("[kmain] Initializing physical memory manager...\n");
+        KLOG_INFO(KLOG_CORE, "[kmain] Initializing physical memory manager...\n");
 
         if (nb_init(mem_start, mem_end - mem_start)) {
-                klog("[kmain] Failed to initialize NBBS ;(\n");
+                KLOG_ERR(KLOG_CORE, "[kmain] Failed to initialize NBBS ;(\n");
                 wfi();
         }
 
-        klog("[kmain] Available size in PMM: %lu MiB\n",
+        KLOG_INFO(KLOG_CORE, "[kmain] Available size in PMM: %lu MiB\n",
                 nb_stat_total_memory() / 1024 / 1024);
 
+        /* Reference counts, for frames mapped more than once (grants) */
+        if (page_meta_init(mem_start, mem_end - mem_start)) {
+                KLOG_ERR(KLOG_CORE, "[kmain] No memory for page metadata\n");
+                wfi();
+        }
+
+        cspace_init();
+
         /* 3. Init Kernel Page Tables & Enable MMU */
 
-        /* X. Do something weird */
-        klog("[kmain] imma just sleep\n");
-        for(;;) {
-                klog("[kmain] Zzz..\n");
-                ksleep(5000);
-        }
+        /* X. This CPU's idle thread from here on, threads run meanwhile */
+        KLOG_INFO(KLOG_CORE, "[kmain] imma just sleep\n");
+        sched_report();
+        smp_idle();
 }
@@ -85,8 +85,12 @@ void* bootmem_alloc(uint32_t size)
 
 void bootmem_klog_map(void) 
 {
+        if (!KLOG_ENABLED(KLOG_LVL_VERBOSE, KLOG_MEM)) {
+                return;
+        }
+
         for (uint32_t i = 0; i < BM_MAP_SIZE; i++) {
-                KLOG("[bootmem] map[%u]: 0x%x\n", i, map[i]);
+                klog("[bootmem] map[%u]: 0x%x\n", i, map[i]);
         }
 }
 
@@ -0,0 +1,239 @@
+/*
+ * Page grants, see Grant.h
+ *
+ * Ranges are walked once per L3 table (2 MiB), not once per page.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Memory.h"
+#include "ARM64/Spinlock.h"
+
+#include "Memory/Grant.h"
+#include "Memory/Page.h"
+#include "Memory/PageDef.h"
+#include "Memory/PageTable.h"
+
+#if !__STDC_HOSTED__
+#include "ARM64/TLB.h"
+#endif
+
+static grant_stats stats;
+
+/* The L3 entry for 'va', 'prev' the one for the page before (or 0) */
+static uint64_t *_step(pgtbl *pt, uint64_t va, uint64_t *prev, uint8_t alloc)
+{
+        if (prev && (va & ARM_TT_L2_OFFMASK)) {
+                return prev + 1;
+        }
+
+        return pgtbl_walk(pt, va, alloc);
+}
+
+static void _lock2(pgtbl *a, pgtbl *b)
+{
+        if (a == b) {
+                spin_lock(&a->lock);
+        } else if (a < b) {
+                spin_lock(&a->lock);
+                spin_lock(&b->lock);
+        } else {
+                spin_lock(&b->lock);
+                spin_lock(&a->lock);
+        }
+}
+
+static void _unlock2(pgtbl *a, pgtbl *b)
+{
+        spin_unlock(&a->lock);
+
+        if (a != b) {
+                spin_unlock(&b->lock);
+        }
+}
+
+/* After the tables changed, with no lock held */
+static void _flush(pgtbl *pt, uint64_t va, uint64_t pages)
+{
+        __atomic_add_fetch(&stats.flushed, pages, __ATOMIC_RELAXED);
+
+#if !__STDC_HOSTED__
+        tlb_flush_range(pt->asid, va, pages * PAGE_SIZE);
+#else
+        (void) pt; (void) va;
+#endif
+}
+
+/* Lock held: every source page granted, every destination one free */
+static int64_t _check(pgtbl *from, uint64_t va, pgtbl *to, uint64_t to_va,
+                      uint64_t pages)
+{
+        uint64_t *s = 0;
+        uint64_t *d = 0;
+
+        for (uint64_t i = 0; i < pages; i++) {
+                s = _step(from, va + i * PAGE_SIZE, s, 0);
+
+                if (!s || !pgtbl_pte_valid(*s)) {
+                        return GRANT_ENOENT;
+                }
+
+                if (*s & PT_SW_GRANT) {
+                        return GRANT_EPERM;
+                }
+
+                /* Tables of the destination made now: no failing later */
+                d = _step(to, to_va + i * PAGE_SIZE, d, 1);
+
+                if (!d) {
+                        return GRANT_ENOMEM;
+                }
+
+                if (pgtbl_pte_valid(*d)) {
+                        return GRANT_EEXIST;
+                }
+        }
+
+        return GRANT_OK;
+}
+
+int64_t vm_grant(pgtbl *from, uint64_t va, pgtbl *to, uint64_t to_va,
+                 uint64_t pages, uint32_t flags)
+{
+        if (!pgtbl_range_ok(va, pages) || !pgtbl_range_ok(to_va, pages) ||
+                (flags & ~(uint32_t) (GRANT_MOVE | GRANT_RO))) {
+                return GRANT_EINVAL;
+        }
+
+        _lock2(from, to);
+
+        int64_t err = _check(from, va, to, to_va, pages);
+
+        if (err != GRANT_OK) {
+                _unlock2(from, to);
+                return err;
+        }
+
+        uint64_t *s = 0;
+        uint64_t *d = 0;
+
+        for (uint64_t i = 0; i < pages; i++) {
+                s = _step(from, va + i * PAGE_SIZE, s, 0);
+                d = _step(to, to_va + i * PAGE_SIZE, d, 0);
+
+                uint64_t pte = *s;
+
+                if (flags & GRANT_MOVE) {
+                        *s = 0;
+                } else {
+                        page_ref(pgtbl_pte_pa(pte));
+                        pte |= PT_SW_GRANT;
+                }
+
+                /* Only ever less: 'from''s RO pages stay RO */
+                if (flags & GRANT_RO) {
+                        pte = BLK_SET_AP(pte, AP_PRIV_R_UNPRIV_R);
+                }
+
+                *d = pte;
+        }
+
+        to->pages += pages;
+
+        if (flags & GRANT_MOVE) {
+                from->pages -= pages;
+        }
+
+        _unlock2(from, to);
+
+        if (flags & GRANT_MOVE) {
+                _flush(from, va, pages);
+                __atomic_add_fetch(&stats.moved, pages, __ATOMIC_RELAXED);
+        } else {
+                __atomic_add_fetch(&stats.shared, pages, __ATOMIC_RELAXED);
+        }
+
+        return GRANT_OK;
+}
+
+/*
+ * Unmaps the range's entries with all of 'must' set, GRANT_CHUNK at a
+ * time: TLBs invalidated before the frames' references go
+ */
+static int64_t _drop(pgtbl *pt, uint64_t va, uint64_t pages, uint64_t must)
+{
+        uint64_t pa[GRANT_CHUNK];
+        int64_t dropped = 0;
+
+        if (!pgtbl_range_ok(va, pages)) {
+                return GRANT_EINVAL;
+        }
+
+        while (pages) {
+                uint64_t start = va;
+                uint64_t *e = 0;
+                uint32_t n = 0;
+
+                spin_lock(&pt->lock);
+
+                while (pages && n < GRANT_CHUNK) {
+                        e = _step(pt, va, e, 0);
+
+                        if (e && pgtbl_pte_valid(*e) &&
+                                (*e & must) == must) {
+                                pa[n++] = pgtbl_pte_pa(*e);
+                                *e = 0;
+                        }
+
+                        va += PAGE_SIZE;
+                        pages--;
+                }
+
+                pt->pages -= n;
+                spin_unlock(&pt->lock);
+
+                if (!n) {
+                        continue;
+                }
+
+                _flush(pt, start, (va - start) / PAGE_SIZE);
+
+                for (uint32_t i = 0; i < n; i++) {
+                        page_unref(pa[i]);
+                }
+
+                dropped += n;
+        }
+
+        return dropped;
+}
+
+int64_t vm_revoke(pgtbl *to, uint64_t to_va, uint64_t pages)
+{
+        int64_t n = _drop(to, to_va, pages, PT_SW_GRANT);
+
+        if (0 < n) {
+                __atomic_add_fetch(&stats.revoked, n, __ATOMIC_RELAXED);
+        }
+
+        return n;
+}
+
+int64_t vm_unmap(pgtbl *pt, uint64_t va, uint64_t pages)
+{
+        return _drop(pt, va, pages, 0);
+}
+
+grant_stats grant_get_stats(void)
+{
+        grant_stats s;
+
+        s.shared = __atomic_load_n(&stats.shared, __ATOMIC_RELAXED);
+        s.moved = __atomic_load_n(&stats.moved, __ATOMIC_RELAXED);
+        s.revoked = __atomic_load_n(&stats.revoked, __ATOMIC_RELAXED);
+        s.flushed = __atomic_load_n(&stats.flushed, __ATOMIC_RELAXED);
+
+        return s;
+}
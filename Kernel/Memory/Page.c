@@ -0,0 +1,102 @@
+/*
+ * Physical page metadata, see Page.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "LibKern/String.h"
+
+#include "Memory/BootMem.h"
+#include "Memory/Page.h"
+#include "Memory/PageDef.h"
+#include "Memory/Physical.h"
+
+static page_meta *meta = 0;
+static uint64_t meta_base = 0;
+static uint64_t meta_pages = 0;
+
+int page_meta_init(uint64_t base, uint64_t size)
+{
+        uint64_t pages = size / PAGE_SIZE;
+        page_meta *m = (page_meta*) bootmem_alloc(pages * sizeof(page_meta));
+
+        if (!pages || !m) {
+                return 1;
+        }
+
+        memset(m, 0x0, pages * sizeof(page_meta));
+
+        meta = m;
+        meta_base = base;
+        meta_pages = pages;
+
+        return 0;
+}
+
+page_meta *page_meta_of(uint64_t pa)
+{
+        uint64_t n = (pa - meta_base) / PAGE_SIZE;
+
+        if (!meta || pa < meta_base || meta_pages <= n) {
+                return 0;
+        }
+
+        return &meta[n];
+}
+
+uint64_t page_alloc(void)
+{
+        void *p = nb_alloc(PAGE_SIZE);
+
+        if (!p) {
+                return 0;
+        }
+
+        page_meta *m = page_meta_of((uint64_t) p);
+
+        if (m) {
+                __atomic_store_n(&m->refs, 1, __ATOMIC_RELAXED);
+        }
+
+        memset(page_va((uint64_t) p), 0x0, PAGE_SIZE);
+
+        return (uint64_t) p;
+}
+
+uint32_t page_ref(uint64_t pa)
+{
+        page_meta *m = page_meta_of(pa);
+
+        if (!m) {
+                return 1;
+        }
+
+        return __atomic_add_fetch(&m->refs, 1, __ATOMIC_RELAXED);
+}
+
+uint32_t page_refs(uint64_t pa)
+{
+        page_meta *m = page_meta_of(pa);
+
+        return m ? __atomic_load_n(&m->refs, __ATOMIC_RELAXED) : 1;
+}
+
+uint32_t page_unref(uint64_t pa)
+{
+        page_meta *m = page_meta_of(pa);
+
+        if (!m) {
+                return 1;
+        }
+
+        /* Everything done with the frame before, by any of its users */
+        uint32_t refs = __atomic_sub_fetch(&m->refs, 1, __ATOMIC_ACQ_REL);
+
+        if (!refs) {
+                nb_free((void*) (pa & ~(uint64_t) (PAGE_SIZE - 1)));
+        }
+
+        return refs;
+}
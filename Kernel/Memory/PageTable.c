@@ -0,0 +1,181 @@
+/*
+ * User page tables, see PageTable.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Memory.h"
+#include "ARM64/Spinlock.h"
+
+#include "Memory/Page.h"
+#include "Memory/PageDef.h"
+#include "Memory/PageTable.h"
+
+static uint64_t *_table(uint64_t desc)
+{
+        return (uint64_t*) page_va(desc & ARM_TT_NEXT_MASK);
+}
+
+/* The next level's table, 0 if there's none (or no memory) */
+static uint64_t *_next(uint64_t *entry, uint8_t alloc)
+{
+        if (TABLE_DESC_VALID(*entry)) {
+                return _table(*entry);
+        }
+
+        if (!alloc) {
+                return 0;
+        }
+
+        uint64_t pa = page_alloc();
+
+        if (!pa) {
+                return 0;
+        }
+
+        uint64_t tbl = 0;
+
+        tbl = ENTRY_VALID(tbl);
+        tbl = ENTRY_TABLE(tbl);
+        tbl = TBL_SET_NEXT(tbl, pa);
+
+        *entry = tbl;
+
+        return _table(tbl);
+}
+
+int pgtbl_init(pgtbl *pt, uint16_t asid)
+{
+        uint64_t root = page_alloc();
+
+        if (!root) {
+                return PT_ENOMEM;
+        }
+
+        spin_lock_init(&pt->lock);
+        pt->asid = asid;
+        pt->root = root;
+        pt->pages = 0;
+
+        return PT_OK;
+}
+
+/* Drops 'table''s frames (level 3) or subtables, then itself */
+static void _destroy(uint64_t pa, uint32_t level)
+{
+        uint64_t *t = (uint64_t*) page_va(pa);
+
+        for (uint32_t i = 0; i < ENTRY_SIZE; i++) {
+                if (!TABLE_DESC_VALID(t[i])) {
+                        continue;
+                }
+
+                if (level == 3) {
+                        page_unref(pgtbl_pte_pa(t[i]));
+                } else {
+                        _destroy(t[i] & ARM_TT_NEXT_MASK, level + 1);
+                }
+        }
+
+        page_unref(pa);
+}
+
+void pgtbl_destroy(pgtbl *pt)
+{
+        _destroy(pt->root, 0);
+
+        pt->root = 0;
+        pt->pages = 0;
+}
+
+uint64_t pgtbl_pte(uint64_t pa, uint32_t prot)
+{
+        uint64_t pg = 0;
+
+        pg = ENTRY_VALID(pg);
+        pg = ENTRY_PAGE(pg);
+
+        pg = BLK_SET_AIDX(pg, NORMAL_IDX);
+        pg = BLK_SET_NS(pg, 0);
+        pg = BLK_SET_AP(pg, (prot & PT_WRITE) ?
+                AP_PRIV_RW_UNPRIV_RW : AP_PRIV_R_UNPRIV_R);
+        pg = BLK_SET_SH(pg, SH_INNER);
+        pg = BLK_SET_AF(pg, 1);
+        pg = BLK_SET_NG(pg, 1);
+
+        pg = PAGE_SET_OA(pg, pa & ARM_TP_OA_MASK);
+
+        pg = BLK_SET_PXN(pg, 1);
+        pg = BLK_SET_XN(pg, (prot & PT_EXEC) ? 0 : 1);
+
+        return pg;
+}
+
+uint64_t *pgtbl_walk(pgtbl *pt, uint64_t va, uint8_t alloc)
+{
+        if (PT_VA_LIMIT <= va) {
+                return 0;
+        }
+
+        uint64_t *l1 = _next(&_table(pt->root)[L0_TABLE_INDEX(va)], alloc);
+
+        if (!l1) {
+                return 0;
+        }
+
+        uint64_t *l2 = _next(&l1[L1_TABLE_INDEX(va)], alloc);
+
+        if (!l2) {
+                return 0;
+        }
+
+        uint64_t *l3 = _next(&l2[L2_TABLE_INDEX(va)], alloc);
+
+        return l3 ? &l3[L3_TABLE_INDEX(va)] : 0;
+}
+
+int pgtbl_map(pgtbl *pt, uint64_t va, uint64_t pte)
+{
+        if (!pgtbl_range_ok(va, 1)) {
+                return PT_EINVAL;
+        }
+
+        uint64_t *e = pgtbl_walk(pt, va, 1);
+
+        if (!e) {
+                return PT_ENOMEM;
+        }
+
+        if (pgtbl_pte_valid(*e)) {
+                return PT_EEXIST;
+        }
+
+        *e = pte;
+        pt->pages++;
+
+        return PT_OK;
+}
+
+uint64_t pgtbl_unmap(pgtbl *pt, uint64_t va)
+{
+        uint64_t *e = pgtbl_walk(pt, va, 0);
+        uint64_t old = e ? *e : 0;
+
+        if (!pgtbl_pte_valid(old)) {
+                return 0;
+        }
+
+        *e = 0;
+        pt->pages--;
+
+        return old;
+}
+
+uint64_t pgtbl_lookup(pgtbl *pt, uint64_t va)
+{
+        uint64_t *e = pgtbl_walk(pt, va, 0);
+
+        return (e && pgtbl_pte_valid(*e)) ? *e : 0;
+}
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #include "LibKern/String.h"
+#include "LibKern/Trace.h"
 
 #include "Memory/PageDef.h"
 #include "Memory/BootMem.h"
@@ -171,6 +172,10 @@ void* nb_alloc(uint64_t size)
                                 nb_index[leaf] = i;
 
                                 FAD(&nb_stat_alloc_blocks[nb_depth - level], 1);
+
+                                TRACE("[nbbs] alloc size=%lu node=%u addr=0x%lx",
+                                        size, i,
+                                        nb_base_address + leaf * NB_MIN_SIZE);
                                 
                                 return (void*)
                                         (nb_base_address + leaf * NB_MIN_SIZE);
@@ -265,6 +270,9 @@ void nb_free(void *addr)
         }
 
         uint32_t n = ((uint64_t) addr - nb_base_address) / NB_MIN_SIZE;
+
+        TRACE("[nbbs] free addr=0x%lx node=%u", (uint64_t) addr, nb_index[n]);
+
         __nb_freenode(nb_index[n], nb_base_level);
 
         FAD(&nb_release_count, 1);
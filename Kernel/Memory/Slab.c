@@ -0,0 +1,86 @@
+/*
+ * Slab allocator, see Slab.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#include "LibKern/String.h"
+
+#include "Memory/Page.h"
+#include "Memory/Physical.h"
+#include "Memory/Slab.h"
+
+void slab_cache_init(slab_cache *c, const char *name, uint32_t size)
+{
+        spin_lock_init(&c->lock);
+        c->name = name;
+        c->size = (size + SLAB_ALIGN - 1) & ~(uint32_t) (SLAB_ALIGN - 1);
+        c->free = 0;
+        c->slabs = 0;
+        c->used = 0;
+}
+
+/* Lock held: a new block's objects onto the free list */
+static uint8_t _grow(slab_cache *c)
+{
+        void *pa = nb_alloc(SLAB_SIZE);
+
+        if (!pa) {
+                return 0;
+        }
+
+        uint8_t *base = (uint8_t*) page_va((uint64_t) pa);
+
+        for (uint32_t off = 0; off + c->size <= SLAB_SIZE; off += c->size) {
+                *(void**) (base + off) = c->free;
+                c->free = base + off;
+        }
+
+        c->slabs++;
+
+        return 1;
+}
+
+void *slab_alloc(slab_cache *c)
+{
+        if (!c->size || SLAB_SIZE < c->size) {
+                return 0;
+        }
+
+        spin_lock(&c->lock);
+
+        if (!c->free && !_grow(c)) {
+                spin_unlock(&c->lock);
+                return 0;
+        }
+
+        void *obj = c->free;
+
+        c->free = *(void**) obj;
+        c->used++;
+
+        spin_unlock(&c->lock);
+
+        memset(obj, 0x0, c->size);
+
+        return obj;
+}
+
+void slab_free(slab_cache *c, void *obj)
+{
+        if (!obj) {
+                return;
+        }
+
+        spin_lock(&c->lock);
+
+        *(void**) obj = c->free;
+        c->free = obj;
+        c->used--;
+
+        spin_unlock(&c->lock);
+}
@@ -0,0 +1,706 @@
+/*
+ * Scheduler: per-CPU run queues, work stealing, see Sched.h
+ *
+ * A run queue's levels, bitmap & stats belong to its CPU under its lock,
+ * thieves only ever trylock it. 'nr' is written under the lock but read
+ * without, as a hint for thieves. The inbox is the only thing other CPUs
+ * write without the lock: they push, the owner takes the whole list.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Spinlock.h"
+
+#include "LibKern/List.h"
+
+#include "Sched/Sched.h"
+
+#define BIT(cpu) (1U << (cpu))
+
+void sched_state_init(sched_state *ss)
+{
+        ss->online = 0;
+        ss->idle = 0;
+
+        for (uint32_t cpu = 0; cpu < SCHED_CPUS; cpu++) {
+                run_queue *rq = &ss->rq[cpu];
+
+                spin_lock_init(&rq->lock);
+                rq->bitmap = 0;
+                rq->nr = 0;
+                rq->inbox = 0;
+                rq->stats = (sched_stats) { 0 };
+
+                for (uint32_t prio = 0; prio < SCHED_PRIOS; prio++) {
+                        list_init(&rq->level[prio]);
+                }
+        }
+}
+
+void sched_cpu_online(sched_state *ss, uint32_t cpu)
+{
+        /* Nothing picked yet: a wakeup may go there */
+        __atomic_fetch_or(&ss->idle, BIT(cpu), __ATOMIC_RELAXED);
+        __atomic_fetch_or(&ss->online, BIT(cpu), __ATOMIC_RELEASE);
+}
+
+void sched_entity_init(sched_entity *se, uint32_t prio, uint32_t affinity)
+{
+        list_init(&se->node);
+        se->wake_next = 0;
+        se->state = SE_SLEEPING;
+        se->prio = (prio < SCHED_PRIOS) ? prio : SCHED_PRIOS - 1;
+        se->affinity = affinity;
+        se->cpu = 0;
+        se->on_cpu = 0;
+        se->last_ran = 0;
+        se->slice_end = 0;
+
+        switch (sched_class_of(se->prio)) {
+        case SCHED_CLASS_RT:
+                se->slice_ns = 0;
+                break;
+        case SCHED_CLASS_NORMAL:
+                se->slice_ns = SCHED_SLICE_NS;
+                break;
+        default:
+                se->slice_ns = SCHED_SLICE_BATCH_NS;
+                break;
+        }
+}
+
+void sched_set_affinity(sched_entity *se, uint32_t affinity)
+{
+        __atomic_store_n(&se->affinity, affinity, __ATOMIC_RELAXED);
+}
+
+void sched_set_slice(sched_entity *se, uint64_t slice_ns)
+{
+        __atomic_store_n(&se->slice_ns, slice_ns, __ATOMIC_RELAXED);
+}
+
+uint32_t sched_nr_queued(sched_state *ss, uint32_t cpu)
+{
+        return __atomic_load_n(&ss->rq[cpu].nr, __ATOMIC_RELAXED);
+}
+
+/* Lock held */
+static void _rq_add(run_queue *rq, sched_entity *se)
+{
+        list_add_tail(&rq->level[se->prio], &se->node);
+        rq->bitmap |= 1U << se->prio;
+        __atomic_store_n(&rq->nr, rq->nr + 1, __ATOMIC_RELAXED);
+}
+
+/* Lock held */
+static void _rq_del(run_queue *rq, sched_entity *se)
+{
+        list_del(&se->node);
+
+        if (list_empty(&rq->level[se->prio])) {
+                rq->bitmap &= ~(1U << se->prio);
+        }
+
+        __atomic_store_n(&rq->nr, rq->nr - 1, __ATOMIC_RELAXED);
+}
+
+/* Lock held. The inbox is LIFO, queue it back in wakeup order */
+static void _rq_drain(run_queue *rq, uint32_t cpu)
+{
+        sched_entity *se = __atomic_exchange_n(&rq->inbox, 0,
+                __ATOMIC_ACQUIRE);
+        sched_entity *fifo = 0;
+
+        while (se) {
+                sched_entity *next = se->wake_next;
+
+                se->wake_next = fifo;
+                fifo = se;
+                se = next;
+        }
+
+        for (se = fifo; se; se = se->wake_next) {
+                se->cpu = cpu;
+                _rq_add(rq, se);
+        }
+}
+
+static void _push(sched_state *ss, uint32_t target, sched_entity *se)
+{
+        run_queue *rq = &ss->rq[target];
+        sched_entity *head = __atomic_load_n(&rq->inbox, __ATOMIC_RELAXED);
+
+        do {
+                se->wake_next = head;
+        } while (!__atomic_compare_exchange_n(&rq->inbox, &head, se, 1,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Onto 'target', from 'cpu' */
+static void _queue(sched_state *ss, uint32_t cpu, uint32_t target,
+                   sched_entity *se)
+{
+        if (target != cpu) {
+                _push(ss, target, se);
+                return;
+        }
+
+        run_queue *rq = &ss->rq[cpu];
+
+        spin_lock(&rq->lock);
+        se->cpu = cpu;
+        _rq_add(rq, se);
+        spin_unlock(&rq->lock);
+}
+
+static uint8_t _on_cpu(const sched_entity *se)
+{
+        return __atomic_load_n(&se->on_cpu, __ATOMIC_ACQUIRE);
+}
+
+static uint8_t _cache_hot(const sched_entity *se, uint64_t now)
+{
+        return now < se->last_ran + SCHED_CACHE_HOT_NS;
+}
+
+static uint32_t _lowest(uint32_t mask)
+{
+        return (uint32_t) __builtin_ctz(mask);
+}
+
+/* Last CPU while warm, else an idle one: the last, the waker, any */
+static uint32_t _select_cpu(sched_state *ss, uint32_t cpu, sched_entity *se,
+                            uint64_t now)
+{
+        /* Only its own CPU may run it before sched_finish() */
+        if (_on_cpu(se)) {
+                return se->cpu;
+        }
+
+        uint32_t online = __atomic_load_n(&ss->online, __ATOMIC_ACQUIRE);
+        uint32_t allowed = __atomic_load_n(&se->affinity, __ATOMIC_RELAXED) &
+                online;
+
+        if (!allowed) {
+                allowed = online; /* Rather than never running it */
+        }
+
+        uint32_t last = se->cpu;
+        uint32_t idle = __atomic_load_n(&ss->idle, __ATOMIC_RELAXED) & allowed;
+
+        if ((allowed & BIT(last)) && (_cache_hot(se, now) || !idle ||
+                (idle & BIT(last)))) {
+                return last;
+        }
+
+        if (idle & BIT(cpu)) {
+                return cpu;
+        }
+
+        if (idle) {
+                return _lowest(idle);
+        }
+
+        return (allowed & BIT(cpu)) ? cpu : _lowest(allowed);
+}
+
+void sched_enqueue(sched_state *ss, uint32_t cpu, sched_entity *se)
+{
+        uint32_t allowed = se->affinity &
+                __atomic_load_n(&ss->online, __ATOMIC_ACQUIRE);
+        uint32_t target = (!allowed || (allowed & BIT(cpu))) ?
+                cpu : _lowest(allowed);
+
+        se->state = SE_RUNNABLE;
+        se->cpu = target;
+
+        __atomic_fetch_and(&ss->idle, ~BIT(target), __ATOMIC_RELAXED);
+
+        _queue(ss, cpu, target, se);
+}
+
+uint32_t sched_wake(sched_state *ss, uint32_t cpu, sched_entity *se,
+                    uint64_t now)
+{
+        uint32_t sleeping = SE_SLEEPING;
+
+        if (!__atomic_compare_exchange_n(&se->state, &sleeping, SE_RUNNABLE,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return SCHED_CPUS;
+        }
+
+        uint32_t target = _select_cpu(ss, cpu, se, now);
+        sched_stats *stats = &ss->rq[cpu].stats;
+
+        /* It has work now, the next wakeup looks elsewhere */
+        __atomic_fetch_and(&ss->idle, ~BIT(target), __ATOMIC_RELAXED);
+
+        stats->wakeups++;
+
+        if (target != cpu) {
+                stats->remote_wakeups++;
+        }
+
+        _queue(ss, cpu, target, se);
+
+        return target;
+}
+
+/* Victim's lock held. Cold first, a hot one only off a crowded queue */
+static sched_entity *_steal_from(run_queue *rq, uint32_t cpu, uint64_t now)
+{
+        sched_entity *hot = 0;
+        uint32_t bitmap = rq->bitmap;
+
+        while (bitmap) {
+                uint32_t prio = _lowest(bitmap);
+                list_node *head = &rq->level[prio];
+
+                bitmap &= bitmap - 1;
+
+                for (list_node *n = head->next; n != head; n = n->next) {
+                        sched_entity *se = CONTAINER_OF(n, sched_entity, node);
+
+                        if (!(__atomic_load_n(&se->affinity,
+                                __ATOMIC_RELAXED) & BIT(cpu)) || _on_cpu(se)) {
+                                continue;
+                        }
+
+                        if (!_cache_hot(se, now)) {
+                                _rq_del(rq, se);
+                                return se;
+                        }
+
+                        if (!hot) {
+                                hot = se;
+                        }
+                }
+
+                /* Nothing cold at a more urgent level: don't go lower */
+                if (hot) {
+                        break;
+                }
+        }
+
+        if (hot && 1 < rq->nr) {
+                _rq_del(rq, hot);
+                return hot;
+        }
+
+        return 0;
+}
+
+static sched_entity *_steal(sched_state *ss, uint32_t cpu, uint64_t now)
+{
+        uint32_t online = __atomic_load_n(&ss->online, __ATOMIC_ACQUIRE);
+
+        for (uint32_t i = 1; i < SCHED_CPUS; i++) {
+                uint32_t victim = (cpu + i) % SCHED_CPUS;
+                run_queue *rq = &ss->rq[victim];
+
+                if (!(online & BIT(victim)) ||
+                        !__atomic_load_n(&rq->nr, __ATOMIC_RELAXED)) {
+                        continue;
+                }
+
+                if (!spin_trylock(&rq->lock)) {
+                        continue; /* Busy, try the next one */
+                }
+
+                sched_entity *se = _steal_from(rq, cpu, now);
+
+                spin_unlock(&rq->lock);
+
+                if (se) {
+                        ss->rq[cpu].stats.steals++;
+                        return se;
+                }
+        }
+
+        return 0;
+}
+
+sched_entity *sched_pick(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                         uint64_t now)
+{
+        run_queue *rq = &ss->rq[cpu];
+        sched_entity *next = 0;
+
+        spin_lock(&rq->lock);
+
+        _rq_drain(rq, cpu);
+
+        if (prev && __atomic_load_n(&prev->state, __ATOMIC_ACQUIRE) ==
+                        SE_RUNNING) {
+                prev->state = SE_RUNNABLE;
+                _rq_add(rq, prev);
+                rq->stats.yields++;
+        }
+
+        if (rq->bitmap) {
+                list_node *head = &rq->level[_lowest(rq->bitmap)];
+
+                next = CONTAINER_OF(head->next, sched_entity, node);
+                _rq_del(rq, next);
+        }
+
+        spin_unlock(&rq->lock);
+
+        if (!next) {
+                next = _steal(ss, cpu, now);
+        }
+
+        if (!next) {
+                __atomic_fetch_or(&ss->idle, BIT(cpu), __ATOMIC_RELAXED);
+                rq->stats.idle++;
+                return 0;
+        }
+
+        if (__atomic_load_n(&ss->idle, __ATOMIC_RELAXED) & BIT(cpu)) {
+                __atomic_fetch_and(&ss->idle, ~BIT(cpu), __ATOMIC_RELAXED);
+        }
+
+        if (next != prev) {
+                rq->stats.switches++;
+        }
+
+        uint64_t slice = __atomic_load_n(&next->slice_ns, __ATOMIC_RELAXED);
+
+        next->slice_end = slice ? now + slice : 0;
+        next->cpu = cpu;
+        next->on_cpu = 1;
+        __atomic_store_n(&next->state, SE_RUNNING, __ATOMIC_RELEASE);
+
+        return next;
+}
+
+uint8_t sched_direct(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                     sched_entity *next, uint64_t now)
+{
+        run_queue *rq = &ss->rq[cpu];
+        uint32_t sleeping = SE_SLEEPING;
+
+        if (!(__atomic_load_n(&next->affinity, __ATOMIC_RELAXED) & BIT(cpu)) ||
+                _on_cpu(next)) {
+                return 0;
+        }
+
+        /* Whoever makes it leave SE_SLEEPING owns it */
+        if (!__atomic_compare_exchange_n(&next->state, &sleeping, SE_RUNNING,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return 0;
+        }
+
+        spin_lock(&rq->lock);
+
+        if (prev && __atomic_load_n(&prev->state, __ATOMIC_ACQUIRE) ==
+                        SE_RUNNING) {
+                prev->state = SE_RUNNABLE;
+                _rq_add(rq, prev);
+        }
+
+        rq->stats.switches++;
+        rq->stats.handoffs++;
+
+        spin_unlock(&rq->lock);
+
+        if (prev && prev->slice_end) {
+                next->slice_end = prev->slice_end; /* Donated */
+        } else {
+                uint64_t slice = __atomic_load_n(&next->slice_ns,
+                        __ATOMIC_RELAXED);
+
+                next->slice_end = slice ? now + slice : 0;
+        }
+
+        next->cpu = cpu;
+        __atomic_store_n(&next->on_cpu, 1, __ATOMIC_RELEASE);
+
+        return 1;
+}
+
+uint8_t sched_tick(sched_state *ss, uint32_t cpu, sched_entity *cur,
+                   uint64_t now)
+{
+        run_queue *rq = &ss->rq[cpu];
+        uint8_t preempt = 0;
+
+        spin_lock(&rq->lock);
+
+        _rq_drain(rq, cpu);
+
+        uint32_t best = rq->bitmap ? _lowest(rq->bitmap) : SCHED_PRIOS;
+
+        if (!cur) {
+                preempt = best < SCHED_PRIOS; /* Idle, with work now */
+        } else if (best < cur->prio) {
+                preempt = 1;
+        } else if (cur->slice_end && cur->slice_end <= now) {
+                if (best == cur->prio) {
+                        preempt = 1;
+                } else {
+                        uint64_t slice = __atomic_load_n(&cur->slice_ns,
+                                __ATOMIC_RELAXED);
+
+                        cur->slice_end = slice ? now + slice : 0;
+                }
+        }
+
+        spin_unlock(&rq->lock);
+
+        return preempt;
+}
+
+uint64_t sched_next_tick(sched_state *ss, uint32_t cpu, sched_entity *cur)
+{
+        run_queue *rq = &ss->rq[cpu];
+        uint64_t deadline = 0;
+
+        if (!cur || !cur->slice_end) {
+                return 0;
+        }
+
+        /* Less urgent ones wait anyway, more urgent ones preempted already */
+        spin_lock(&rq->lock);
+
+        if (rq->bitmap & (1U << cur->prio)) {
+                deadline = cur->slice_end;
+        }
+
+        spin_unlock(&rq->lock);
+
+        return deadline;
+}
+
+void sched_finish(sched_state *ss, uint32_t cpu, sched_entity *prev,
+                  uint64_t now)
+{
+        (void) ss;
+        (void) cpu;
+
+        prev->last_ran = now;
+
+        /* Its context is saved: others may run it from here on */
+        __atomic_store_n(&prev->on_cpu, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Kernel wrappers
+ */
+
+#if !__STDC_HOSTED__
+
+#include "ARM64/Exception.h"
+#include "ARM64/Machine.h"
+#include "ARM64/IPI.h"
+#include "ARM64/SMP.h"
+
+#include "LibKern/Clocksource.h"
+#include "LibKern/Console.h"
+#include "LibKern/RCU.h"
+#include "LibKern/Timer.h"
+
+_Static_assert(SCHED_CPUS == MAX_CPUS, "one run queue per CPU");
+
+/* Only ever touched by its own CPU, IRQs masked */
+typedef struct sched_cpu {
+        sched_entity *curr;
+        ktimer slice;
+} __attribute__((aligned(64))) sched_cpu;
+
+sched_state sched;
+
+static sched_cpu cpus[MAX_CPUS];
+static sched_switch_fn switch_fn;
+
+static void _slice_expired(ktimer *t);
+
+static void _cpu_init(uint32_t cpu)
+{
+        cpus[cpu].curr = 0;
+        ktimer_init(&cpus[cpu].slice, _slice_expired, 0);
+        sched_cpu_online(&sched, cpu);
+}
+
+void sched_init(void)
+{
+        sched_state_init(&sched);
+        _cpu_init(cpu_id());
+}
+
+void sched_cpu_init(void)
+{
+        _cpu_init(cpu_id());
+}
+
+void sched_set_switch(sched_switch_fn fn)
+{
+        __atomic_store_n(&switch_fn, fn, __ATOMIC_RELEASE);
+}
+
+sched_entity *sched_current(void)
+{
+        uint64_t flags = irq_save();
+        sched_entity *se = cpus[cpu_id()].curr;
+
+        irq_restore(flags);
+
+        return se;
+}
+
+/* IRQs masked. Tickless: no timer unless a contender waits */
+static void _rearm(uint32_t cpu)
+{
+        sched_cpu *sc = &cpus[cpu];
+        uint64_t deadline = sched_next_tick(&sched, cpu, sc->curr);
+
+        if (deadline) {
+                ktimer_arm(&sc->slice, deadline);
+        } else if (ktimer_pending(&sc->slice)) {
+                ktimer_cancel(&sc->slice);
+        }
+}
+
+/* IRQ context, on the owning CPU */
+static void _slice_expired(ktimer *t)
+{
+        uint32_t cpu = cpu_id();
+
+        (void) t;
+
+        sched.rq[cpu].stats.ticks++;
+
+        if (sched_tick(&sched, cpu, cpus[cpu].curr, ktime_get_ns())) {
+                set_need_resched();
+        } else {
+                _rearm(cpu); /* Renewed */
+        }
+}
+
+void sched_wakeup(sched_entity *se)
+{
+        uint64_t flags = irq_save();
+        uint32_t cpu = cpu_id();
+        uint32_t target = sched_wake(&sched, cpu, se, ktime_get_ns());
+
+        if (target == cpu) {
+                set_need_resched(); /* May preempt, or start the slice */
+        }
+
+        irq_restore(flags);
+
+        if (target < SCHED_CPUS && target != cpu) {
+                ipi_send(CPUMASK_OF(target), IPI_RESCHED);
+        }
+}
+
+void sched_switch_tail(sched_entity *last)
+{
+        uint32_t cpu = cpu_id();
+
+        if (last) {
+                sched_finish(&sched, cpu, last, ktime_get_ns());
+        }
+
+        _rearm(cpu);
+}
+
+void schedule(void)
+{
+        sched_switch_fn fn = __atomic_load_n(&switch_fn, __ATOMIC_ACQUIRE);
+
+        if (!fn) {
+                return;
+        }
+
+        uint64_t flags = irq_save();
+        uint32_t cpu = cpu_id();
+        sched_cpu *sc = &cpus[cpu];
+        sched_entity *prev = sc->curr;
+
+        rcu_quiescent(); /* No read section spans a switch */
+        clear_need_resched();
+
+        sched_entity *next = sched_pick(&sched, cpu, prev, ktime_get_ns());
+
+        if (next != prev) {
+                sc->curr = next;
+
+                /* Back in 'prev', maybe on another CPU */
+                sched_switch_tail(fn(prev, next));
+        } else {
+                _rearm(cpu);
+        }
+
+        irq_restore(flags);
+}
+
+void sched_handoff(sched_entity *next)
+{
+        sched_switch_fn fn = __atomic_load_n(&switch_fn, __ATOMIC_ACQUIRE);
+        uint64_t flags = irq_save();
+        uint32_t cpu = cpu_id();
+        sched_cpu *sc = &cpus[cpu];
+        sched_entity *prev = sc->curr;
+
+        if (!fn || !prev ||
+                !sched_direct(&sched, cpu, prev, next, ktime_get_ns())) {
+                irq_restore(flags);
+                sched_wakeup(next);
+
+                /* Blocking (maybe woken already): it still has to switch */
+                if (prev && __atomic_load_n(&prev->state, __ATOMIC_ACQUIRE) !=
+                                SE_RUNNING) {
+                        schedule();
+                }
+
+                return;
+        }
+
+        rcu_quiescent();
+
+        sc->curr = next;
+        sched_switch_tail(fn(prev, next));
+
+        irq_restore(flags);
+}
+
+void sched_preempt(void)
+{
+        uint32_t cpu = cpu_id();
+
+        if (!sched_tick(&sched, cpu, cpus[cpu].curr, ktime_get_ns())) {
+                clear_need_resched();
+                _rearm(cpu); /* A contender may have shown up */
+                return;
+        }
+
+        sched.rq[cpu].stats.preemptions++;
+        schedule();
+}
+
+sched_stats sched_get_stats(uint32_t cpu)
+{
+        return sched.rq[cpu].stats;
+}
+
+void sched_report(void)
+{
+        uint32_t online = __atomic_load_n(&sched.online, __ATOMIC_ACQUIRE);
+
+        for (uint32_t cpu = 0; cpu < SCHED_CPUS; cpu++) {
+                if (!(online & BIT(cpu))) {
+                        continue;
+                }
+
+                sched_stats st = sched_get_stats(cpu);
+
+                KLOG_DEBUG(KLOG_CORE, "[sched] cpu%u: %lu switches, %lu "
+                        "preemptions, %lu ticks, %lu steals\n", cpu,
+                        st.switches, st.preemptions, st.ticks, st.steals);
+        }
+}
+
+#endif /* !__STDC_HOSTED__ */
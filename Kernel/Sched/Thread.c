@@ -0,0 +1,161 @@
+/*
+ * Kernel threads, see Thread.h
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Context.h"
+#include "ARM64/FPSIMD.h"
+#include "ARM64/Machine.h"
+#include "ARM64/SMP.h"
+#include "ARM64/TLB.h"
+
+#include "LibKern/List.h"
+
+#include "Sched/Sched.h"
+#include "Sched/Thread.h"
+
+/* Only ever touched by its own CPU, IRQs masked */
+typedef struct thread_cpu {
+        thread idle;
+} __attribute__((aligned(64))) thread_cpu;
+
+static thread_cpu cpus[MAX_CPUS];
+
+/* IRQs masked. Lazy: kernel-only threads keep what's loaded */
+static void _space_switch(percpu *pc, addr_space *next)
+{
+        addr_space *prev = pc->space;
+
+        if (!next || next == prev) {
+                return;
+        }
+
+        tlb_asid_switch(prev ? prev->pt.asid : TLB_ASID_NONE, next->pt.asid);
+        MSR("TTBR0_EL1", next->pt.root | ((uint64_t) next->pt.asid << 48));
+        isb();
+
+        pc->space = next;
+}
+
+/* Running in the thread switched to, with the one switched away from */
+static sched_entity *_switched_from(thread *last)
+{
+        return (last->flags & THREAD_IDLE) ? 0 : &last->se;
+}
+
+/* sched_switch_fn */
+static sched_entity *_switch(sched_entity *prev, sched_entity *next)
+{
+        percpu *pc = this_cpu();
+        thread *p = pc->thread;
+        thread *n = next ? CONTAINER_OF(next, thread, se) :
+                &cpus[pc->cpu].idle;
+
+        (void) prev;
+
+        _space_switch(pc, n->space);
+
+        /* Its registers may be live here, and it may run elsewhere next */
+        if (p->fp && __atomic_load_n(&p->se.affinity, __ATOMIC_RELAXED) !=
+                CPUMASK_OF(pc->cpu)) {
+                fpsimd_flush(p->fp);
+        }
+
+        if (p->fp != n->fp) {
+                fpsimd_switch(n->fp);
+        }
+
+        pc->thread = n;
+
+        return _switched_from(_context_switch(&p->ctx, &n->ctx, p));
+}
+
+/* A new thread's first code (its ctx.lr), IRQs still masked */
+static void __attribute__((noreturn)) _thread_entry(thread *last)
+{
+        sched_switch_tail(_switched_from(last));
+        irq_enable();
+
+        thread *t = current_thread();
+
+        t->fn(t->arg);
+        thread_exit();
+}
+
+void thread_cpu_init(void)
+{
+        percpu *pc = this_cpu();
+        thread *idle = &cpus[pc->cpu].idle;
+
+        idle->flags = THREAD_IDLE;
+        idle->space = 0;
+        idle->fp = 0;
+        idle->user_ksp = 0;
+        idle->ipc_caller = 0;
+
+        pc->space = 0;
+        pc->thread = idle;
+}
+
+void thread_init(void)
+{
+        thread_cpu_init();
+        sched_set_switch(_switch);
+}
+
+void thread_setup(thread *t, thread_fn fn, void *arg, void *stack,
+                  uint64_t size, uint32_t prio)
+{
+        uint64_t top = ((uint64_t) stack + size) & ~0xFULL;
+
+        t->ctx = (cpu_context) { 0 };
+        t->ctx.lr = (uint64_t) _thread_entry;
+        t->ctx.sp = top;
+
+        sched_entity_init(&t->se, prio, SCHED_AFFINITY_ALL);
+
+        t->space = 0;
+        t->fp = 0;
+        t->user_ksp = 0;
+        t->fn = fn;
+        t->arg = arg;
+        t->stack = stack;
+        t->flags = 0;
+
+        list_init(&t->ipc_node);
+        t->ipc_mr = 0;
+        t->ipc_caller = 0;
+        t->ipc_state = 0;
+}
+
+void thread_start(thread *t)
+{
+        sched_wakeup(&t->se);
+}
+
+void thread_exit(void)
+{
+        thread *t = current_thread();
+
+        irq_disable();
+
+        /* Live only here, if anywhere (see _switch()) */
+        fpsimd_release(t->fp);
+
+        __atomic_fetch_or(&t->flags, THREAD_DEAD, __ATOMIC_RELEASE);
+        sched_prepare_sleep(&t->se);
+        schedule();
+
+        for (;;) {
+                wfi(); /* Never picked again */
+        }
+}
+
+uint8_t thread_done(const thread *t)
+{
+        return (__atomic_load_n(&t->flags, __ATOMIC_ACQUIRE) & THREAD_DEAD) &&
+                !__atomic_load_n(&t->se.on_cpu, __ATOMIC_ACQUIRE);
+}
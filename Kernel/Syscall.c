@@ -0,0 +1,89 @@
+/*
+ * System call table
+ *
+ * Entries are called straight from Vector.S, see Syscall.h for the ABI.
+ *
+ * Author: Tuna CICI
+ */
+
+#include <stdint.h>
+
+#include "ARM64/Exception.h"
+
+#include "IPC/Channel.h"
+
+#include "Syscall.h"
+
+static uint64_t sys_null(uint64_t a0, uint64_t a1, uint64_t a2,
+                         uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        (void) a0; (void) a1; (void) a2; (void) a3; (void) a4; (void) a5;
+
+        return 0;
+}
+
+static uint64_t sys_exit(uint64_t a0, uint64_t a1, uint64_t a2,
+                         uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        (void) a1; (void) a2; (void) a3; (void) a4; (void) a5;
+
+        user_return(a0);
+
+        return SYS_ENOSYS; /* Not called from EL0 */
+}
+
+static uint64_t sys_chan_wait(uint64_t a0, uint64_t a1, uint64_t a2,
+                              uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        (void) a2; (void) a3; (void) a4; (void) a5;
+
+        if (CHAN_MAX <= a0 || CHAN_CQ < a1) {
+                return (uint64_t) CHAN_EINVAL; /* Not truncated into one */
+        }
+
+        return (uint64_t) chan_wait((uint32_t) a0, (uint32_t) a1);
+}
+
+static uint64_t sys_chan_notify(uint64_t a0, uint64_t a1, uint64_t a2,
+                                uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        (void) a2; (void) a3; (void) a4; (void) a5;
+
+        if (CHAN_MAX <= a0 || CHAN_CQ < a1) {
+                return (uint64_t) CHAN_EINVAL;
+        }
+
+        return (uint64_t) chan_notify((uint32_t) a0, (uint32_t) a1);
+}
+
+static uint64_t sys_chan_grant(uint64_t a0, uint64_t a1, uint64_t a2,
+                               uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        if (CHAN_MAX <= a0 || CHAN_CQ < a1 || (a5 >> 32)) {
+                return (uint64_t) CHAN_EINVAL;
+        }
+
+        return (uint64_t) chan_grant((uint32_t) a0, (uint32_t) a1, a2, a3, a4,
+                (uint32_t) a5);
+}
+
+static uint64_t sys_chan_revoke(uint64_t a0, uint64_t a1, uint64_t a2,
+                                uint64_t a3, uint64_t a4, uint64_t a5)
+{
+        (void) a4; (void) a5;
+
+        if (CHAN_MAX <= a0 || CHAN_CQ < a1) {
+                return (uint64_t) CHAN_EINVAL;
+        }
+
+        return (uint64_t) chan_revoke((uint32_t) a0, (uint32_t) a1, a2, a3);
+}
+
+const syscall_fn syscall_table[SYS_MAX] = {
+        [SYS_NULL] = sys_null,
+        [SYS_EXIT] = sys_exit,
+        [SYS_CHAN_WAIT] = sys_chan_wait,
+        [SYS_CHAN_NOTIFY] = sys_chan_notify,
+        [SYS_CHAN_GRANT] = sys_chan_grant,
+        [SYS_CHAN_REVOKE] = sys_chan_revoke,
+};
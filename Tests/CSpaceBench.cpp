@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+extern "C" {
+        #include "Cap/CSpace.h"
+}
+
+/*
+ * Capability lookup, ns per lookup, every slot of the space in turn. Not
+ * a pass/fail test.
+ *
+ *      linear:     a scan of 256 (object, cptr) pairs, the baseline
+ *      1 level:    root CNode of 256 slots, guard 56
+ *      2 levels:   root of 16, guard 54 -> CNodes of 64
+ *      4 levels:   root of 16, guard 48 -> 3 levels of 16 (past the
+ *                  unrolled levels, cspace_lookup_slow())
+ *
+ * A lookup is a shift & mask per level, whatever the number of slots.
+ * The in-kernel version is Kernel/Bench/CapBench.c
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_LOOKUPS   20000000
+
+static cte one[256];
+static cte two_root[16];
+static cte two_leaf[16][64];
+static cte four[4][16];
+
+static volatile uint64_t sink;
+
+template <typename F>
+static double ns_per_lookup(uint64_t slots, F lookup)
+{
+        uint64_t found = 0;
+        uint64_t i = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint64_t n = 0; n < BENCH_LOOKUPS; n++) {
+                found += lookup(i);
+                i = (i + 1 == slots) ? 0 : i + 1;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        sink = found;
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                BENCH_LOOKUPS;
+}
+
+static cap endpoint(uint64_t obj)
+{
+        cap c = {};
+
+        c.type = CAP_ENDPOINT;
+        c.rights = CAP_ALL;
+        c.obj = obj;
+
+        return c;
+}
+
+TEST(CSpaceBench, lookup)
+{
+        static uint64_t linear[256][2];
+        cap r1, r2, r4;
+
+        for (uint64_t i = 0; i < 256; i++) {
+                linear[i][0] = i * 7919;   /* Scattered cptrs */
+                linear[i][1] = i;
+        }
+
+        cnode_init(&r1, one, 8, 56, 0);
+
+        for (uint64_t i = 0; i < 256; i++) {
+                cap c = endpoint(i);
+                cap_insert(&one[i], &c);
+        }
+
+        cnode_init(&r2, two_root, 4, 54, 0);
+
+        for (uint64_t i = 0; i < 16; i++) {
+                cap leaf;
+
+                cnode_init(&leaf, two_leaf[i], 6, 0, 0);
+                cap_insert(&two_root[i], &leaf);
+
+                for (uint64_t j = 0; j < 64; j++) {
+                        cap c = endpoint(j);
+                        cap_insert(&two_leaf[i][j], &c);
+                }
+        }
+
+        cnode_init(&r4, four[0], 4, 48, 0);
+
+        for (uint32_t l = 0; l < 4; l++) {
+                for (uint64_t i = 0; i < 16; i++) {
+                        cap next = endpoint(i);
+
+                        if (l < 3) {
+                                cnode_init(&next, four[l + 1], 4, 0, 0);
+                        }
+
+                        cap_insert(&four[l][i], &next);
+                }
+        }
+
+        double lin = ns_per_lookup(256, [](uint64_t i) {
+                uint64_t cptr = i * 7919;
+
+                for (auto &e : linear) {
+                        if (e[0] == cptr) {
+                                return e[1];
+                        }
+                }
+
+                return (uint64_t) 0;
+        });
+
+        double l1 = ns_per_lookup(256, [&r1](uint64_t i) {
+                return cspace_lookup(&r1, i, CPTR_BITS)->cap.obj;
+        });
+
+        double l2 = ns_per_lookup(16 * 64, [&r2](uint64_t i) {
+                return cspace_lookup(&r2, i, CPTR_BITS)->cap.obj;
+        });
+
+        double l4 = ns_per_lookup(1 << 16, [&r4](uint64_t i) {
+                return cspace_lookup(&r4, i, CPTR_BITS)->cap.obj;
+        });
+
+        std::printf("linear (256): %6.2f ns | 1 level: %5.2f ns | "
+                "2 levels: %5.2f ns | 4 levels: %5.2f ns\n",
+                lin, l1, l2, l4);
+}
@@ -0,0 +1,330 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "MemArena.h"
+
+extern "C" {
+        #include "Cap/CSpace.h"
+        #include "Memory/Physical.h"
+        #include "Memory/Slab.h"
+}
+
+/* A fresh allocator & slab caches for each test */
+class CSpace : public MemArena {
+protected:
+        void SetUp() override
+        {
+                ASSERT_NO_FATAL_FAILURE(MemArena::SetUp());
+                cspace_init();
+        }
+};
+
+static cap endpoint(uint64_t obj)
+{
+        cap c = {};
+
+        c.type = CAP_ENDPOINT;
+        c.rights = CAP_ALL;
+        c.obj = obj;
+
+        return c;
+}
+
+TEST_F(CSpace, layout)
+{
+        EXPECT_EQ(sizeof(cte), 64u);
+        EXPECT_EQ(alignof(cte), 64u);
+        EXPECT_EQ(sizeof(cap), 32u);
+}
+
+TEST_F(CSpace, slab)
+{
+        slab_cache c;
+        void *objs[600];
+
+        slab_cache_init(&c, "test", 100);
+        EXPECT_EQ(c.size, 128u);
+
+        /* Aligned, zeroed, distinct, across blocks */
+        for (int i = 0; i < 600; i++) {
+                objs[i] = slab_alloc(&c);
+                ASSERT_NE(objs[i], nullptr);
+                EXPECT_EQ((uint64_t) objs[i] % SLAB_ALIGN, 0u);
+                EXPECT_EQ(*(uint64_t*) objs[i], 0u);
+                std::fill_n((uint8_t*) objs[i], 128, 0xAA);
+        }
+
+        std::sort(objs, objs + 600);
+        EXPECT_EQ(std::adjacent_find(objs, objs + 600), objs + 600);
+        EXPECT_EQ(c.used, 600u);
+        EXPECT_EQ(c.slabs, (600 + 127) / 128u);
+
+        /* LIFO reuse */
+        slab_free(&c, objs[7]);
+        EXPECT_EQ(slab_alloc(&c), objs[7]);
+        EXPECT_EQ(*(uint64_t*) objs[7], 0u);
+
+        slab_cache big;
+
+        slab_cache_init(&big, "too big", SLAB_SIZE + 1);
+        EXPECT_EQ(slab_alloc(&big), nullptr);
+}
+
+TEST_F(CSpace, one_level)
+{
+        static cte slots[256];
+        cap root;
+
+        EXPECT_EQ(CAP_EINVAL, cnode_init(&root, slots, 0, 56, 0));
+        EXPECT_EQ(CAP_EINVAL, cnode_init(&root, slots, 8, 57, 0));
+        EXPECT_EQ(CAP_EINVAL, cnode_init(&root, slots, 8, 4, 0x10));
+        ASSERT_EQ(CAP_OK, cnode_init(&root, slots, 8, 56, 0));
+
+        for (uint64_t i = 0; i < 256; i++) {
+                cap c = endpoint(i);
+                ASSERT_EQ(CAP_OK, cap_insert(&slots[i], &c));
+        }
+
+        for (uint64_t i = 0; i < 256; i++) {
+                EXPECT_EQ(cspace_lookup(&root, i, CPTR_BITS), &slots[i]);
+        }
+
+        /* Guard mismatch, too few bits */
+        EXPECT_EQ(cspace_lookup(&root, 0x100, CPTR_BITS), nullptr);
+        EXPECT_EQ(cspace_lookup(&root, 1ULL << 63, CPTR_BITS), nullptr);
+        EXPECT_EQ(cspace_lookup(&root, 5, 63), nullptr);
+
+        cap c = endpoint(0);
+        EXPECT_EQ(CAP_EEXIST, cap_insert(&slots[3], &c));
+}
+
+TEST_F(CSpace, guards_and_depth)
+{
+        static cte slots[16];
+        cap root;
+
+        /* 'cptr' top 8 bits 0xA5, then 4 of index: a 12-bit space */
+        ASSERT_EQ(CAP_OK, cnode_init(&root, slots, 4, 8, 0xA5));
+
+        EXPECT_EQ(cspace_lookup(&root, 0xA53, 12), &slots[3]);
+        EXPECT_EQ(cspace_lookup(&root, 0xA43, 12), nullptr);
+
+        /* Bits above 'depth' don't matter */
+        EXPECT_EQ(cspace_lookup(&root, 0xFFFFA53, 12), &slots[3]);
+        EXPECT_EQ(cspace_lookup(&root, 0xA53, 13), nullptr);
+}
+
+TEST_F(CSpace, two_levels_and_deeper)
+{
+        static cte root_slots[16];
+        static cte leaf_slots[4][64];
+        static cte deep[6][2];
+        cap root;
+
+        /* 4 bits of root, 6 of leaf, 54 of guard */
+        ASSERT_EQ(CAP_OK, cnode_init(&root, root_slots, 4, 54, 0));
+
+        for (uint64_t i = 0; i < 4; i++) {
+                cap leaf;
+
+                ASSERT_EQ(CAP_OK, cnode_init(&leaf, leaf_slots[i], 6, 0, 0));
+                ASSERT_EQ(CAP_OK, cap_insert(&root_slots[i], &leaf));
+
+                for (uint64_t j = 0; j < 64; j++) {
+                        cap c = endpoint(i * 64 + j);
+                        ASSERT_EQ(CAP_OK, cap_insert(&leaf_slots[i][j], &c));
+                }
+        }
+
+        for (uint64_t i = 0; i < 4; i++) {
+                for (uint64_t j = 0; j < 64; j++) {
+                        cte *s = cspace_lookup(&root, (i << 6) | j, CPTR_BITS);
+
+                        ASSERT_NE(s, nullptr);
+                        EXPECT_EQ(s->cap.obj, i * 64 + j);
+                }
+        }
+
+        /* An empty root slot, bits left: no CNode to go on in */
+        EXPECT_EQ(cspace_lookup(&root, (5 << 6) | 1, CPTR_BITS), nullptr);
+
+        /* Stopping at the CNode's own slot */
+        EXPECT_EQ(cspace_lookup(&root, 2, 58), &root_slots[2]);
+
+        /* 1 bit per level from the 3rd on: past the unrolled ones */
+        cap third;
+
+        ASSERT_EQ(CAP_OK, cnode_init(&third, deep[0], 1, 0, 0));
+        ASSERT_EQ(CAP_OK, cap_delete(&leaf_slots[3][5]));
+        ASSERT_EQ(CAP_OK, cap_insert(&leaf_slots[3][5], &third));
+
+        for (int l = 0; l < 5; l++) {
+                cap next;
+
+                ASSERT_EQ(CAP_OK, cnode_init(&next, deep[l + 1], 1, 0, 0));
+                ASSERT_EQ(CAP_OK, cap_insert(&deep[l][1], &next));
+        }
+
+        cap end = endpoint(42);
+        ASSERT_EQ(CAP_OK, cap_insert(&deep[5][0], &end));
+
+        /* The same root, 6 bits less guard: 3, 5, then 1 1 1 1 1 0 */
+        cap root6;
+        uint64_t cptr = (((3ULL << 6) | 5) << 6) | 0x3E;
+
+        ASSERT_EQ(CAP_OK, cnode_init(&root6, root_slots, 4, 48, 0));
+
+        EXPECT_EQ(cspace_lookup(&root6, cptr, CPTR_BITS), &deep[5][0]);
+        EXPECT_EQ(cspace_lookup_slow(&root6, cptr, CPTR_BITS), &deep[5][0]);
+        EXPECT_EQ(cspace_lookup(&root6, cptr | 0x1, CPTR_BITS), &deep[5][1]);
+        EXPECT_EQ(cspace_lookup(&root6, cptr & ~0x20ULL, CPTR_BITS), nullptr);
+}
+
+TEST_F(CSpace, derive_rights_and_badges)
+{
+        static cte slots[8];
+        cap c = endpoint(7);
+
+        ASSERT_EQ(CAP_OK, cap_insert(&slots[0], &c));
+
+        EXPECT_EQ(CAP_ENOENT, cap_derive(&slots[1], &slots[5], CAP_READ, 0));
+        ASSERT_EQ(CAP_OK, cap_derive(&slots[1], &slots[0], CAP_READ, 0x99));
+        EXPECT_EQ(CAP_EEXIST, cap_derive(&slots[1], &slots[0], CAP_READ, 0));
+
+        EXPECT_EQ(slots[1].cap.obj, 7u);
+        EXPECT_EQ(slots[1].cap.rights, CAP_READ);
+        EXPECT_EQ(slots[1].cap.badge, 0x99u);
+        EXPECT_EQ(slots[1].parent, &slots[0]);
+
+        /* Never more rights, never another badge */
+        EXPECT_EQ(CAP_EPERM, cap_derive(&slots[2], &slots[1], CAP_WRITE, 0));
+        EXPECT_EQ(CAP_EPERM, cap_derive(&slots[2], &slots[1], CAP_READ, 0x5));
+        ASSERT_EQ(CAP_OK, cap_derive(&slots[2], &slots[1], CAP_READ, 0));
+        EXPECT_EQ(slots[2].cap.badge, 0x99u);
+        EXPECT_EQ(slots[2].cap.type, CAP_ENDPOINT);
+}
+
+TEST_F(CSpace, delete_and_revoke)
+{
+        static cte s[8];
+        cap c = endpoint(1);
+
+        /* 0 -> {1 -> {3, 4}, 2} */
+        ASSERT_EQ(CAP_OK, cap_insert(&s[0], &c));
+        ASSERT_EQ(CAP_OK, cap_derive(&s[1], &s[0], CAP_ALL, 0));
+        ASSERT_EQ(CAP_OK, cap_derive(&s[2], &s[0], CAP_ALL, 0));
+        ASSERT_EQ(CAP_OK, cap_derive(&s[3], &s[1], CAP_READ, 0));
+        ASSERT_EQ(CAP_OK, cap_derive(&s[4], &s[1], CAP_READ, 0));
+
+        /* 1's children move up: 0 -> {3, 4, 2} */
+        EXPECT_EQ(CAP_OK, cap_delete(&s[1]));
+        EXPECT_EQ(s[1].cap.type, CAP_NULL);
+        EXPECT_EQ(CAP_ENOENT, cap_delete(&s[1]));
+        EXPECT_EQ(s[3].parent, &s[0]);
+        EXPECT_EQ(s[4].parent, &s[0]);
+
+        int children = 0;
+
+        for (cte *k = s[0].child; k; k = k->next) {
+                EXPECT_EQ(k->parent, &s[0]);
+                EXPECT_TRUE(k == &s[2] || k == &s[3] || k == &s[4]);
+                EXPECT_TRUE(!k->next || k->next->prev == k);
+                children++;
+        }
+
+        EXPECT_EQ(children, 3);
+
+        /* Grandchildren too */
+        ASSERT_EQ(CAP_OK, cap_derive(&s[5], &s[3], CAP_READ, 0));
+        ASSERT_EQ(CAP_OK, cap_derive(&s[6], &s[5], CAP_READ, 0));
+
+        EXPECT_EQ(cap_revoke(&s[0]), 5);
+        EXPECT_EQ(s[0].child, nullptr);
+        EXPECT_EQ(s[0].cap.type, CAP_ENDPOINT);
+
+        for (int i = 1; i < 8; i++) {
+                EXPECT_EQ(s[i].cap.type, CAP_NULL);
+        }
+}
+
+TEST_F(CSpace, create_from_slabs)
+{
+        cap small, big;
+
+        EXPECT_EQ(CAP_EINVAL, cnode_create(&small, 16, 0, 0));
+        EXPECT_EQ(CAP_EINVAL, cnode_create(&small, 4, 8, 0x100));
+        ASSERT_EQ(CAP_OK, cnode_create(&small, 4, 60, 0));
+        ASSERT_EQ(CAP_OK, cnode_create(&big, 10, 54, 0));
+
+        EXPECT_EQ(small.obj % 64, 0u);
+        EXPECT_EQ(big.obj % 64, 0u);
+
+        uint64_t used = nb_stat_used_memory();
+
+        /* Deleting inside: derived caps elsewhere survive */
+        cap c = endpoint(3);
+        ASSERT_EQ(CAP_OK, cap_insert(cnode_slot(&small, 1), &c));
+        ASSERT_EQ(CAP_OK, cap_derive(cnode_slot(&big, 1000),
+                cnode_slot(&small, 1), CAP_READ, 0));
+
+        EXPECT_EQ(cspace_lookup(&big, 1000, CPTR_BITS)->cap.obj, 3u);
+
+        cnode_destroy(&small);
+        EXPECT_EQ(small.type, CAP_NULL);
+        EXPECT_EQ(cnode_slot(&big, 1000)->parent, nullptr);
+
+        /* The slab block stays, the big one goes */
+        cnode_destroy(&big);
+        EXPECT_EQ(nb_stat_used_memory(), used - (64 << 10));
+}
+
+TEST_F(CSpace, last_cap_frees_nested_cnodes)
+{
+        cap root, mid, leaf;
+        uint64_t used = nb_stat_used_memory();
+
+        /* Radix 9 & up: whole buddy blocks, seen in the stats */
+        ASSERT_EQ(CAP_OK, cnode_create(&root, 9, 0, 0));
+        ASSERT_EQ(CAP_OK, cnode_create(&mid, 9, 0, 0));
+        ASSERT_EQ(CAP_OK, cnode_create(&leaf, 10, 0, 0));
+
+        uint64_t all = nb_stat_used_memory();
+
+        ASSERT_EQ(CAP_OK, cap_insert(cnode_slot(&mid, 7), &leaf));
+        ASSERT_EQ(CAP_OK, cap_insert(cnode_slot(&root, 1), &mid));
+        ASSERT_EQ(CAP_OK, cap_derive(cnode_slot(&root, 2),
+                cnode_slot(&root, 1), CAP_ALL, 0));
+
+        /* A copy is left: nothing freed */
+        ASSERT_EQ(CAP_OK, cap_delete(cnode_slot(&root, 1)));
+        EXPECT_EQ(nb_stat_used_memory(), all);
+        EXPECT_EQ(cnode_slot(&root, 2)->parent, nullptr);
+
+        /* The last one: 'mid' & the 'leaf' in it */
+        ASSERT_EQ(CAP_OK, cap_delete(cnode_slot(&root, 2)));
+        EXPECT_EQ(nb_stat_used_memory(), used + (32 << 10));
+
+        cnode_destroy(&root);
+        EXPECT_EQ(nb_stat_used_memory(), used);
+}
+
+TEST_F(CSpace, caller_memory_is_never_freed)
+{
+        static cte slots[4];
+        cap cn;
+
+        ASSERT_EQ(CAP_OK, cnode_init(&cn, slots, 2, 0, 0));
+
+        cte holder[1] = {};
+        ASSERT_EQ(CAP_OK, cap_insert(&holder[0], &cn));
+
+        uint64_t used = nb_stat_used_memory();
+
+        ASSERT_EQ(CAP_OK, cap_delete(&holder[0]));
+        EXPECT_EQ(nb_stat_used_memory(), used);
+
+        cnode_destroy(&cn);
+        EXPECT_EQ(cn.type, CAP_CNODE);
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+
+extern "C" {
+        #include "LibKern/Clocksource.h"
+        #include "LibKern/Time.h"
+}
+
+static uint64_t fake_cycles = 0;
+
+static uint64_t fake_read(void)
+{
+        return fake_cycles;
+}
+
+/* Exact reference, rounded down */
+static uint64_t ref_ns(uint64_t cycles, uint64_t freq)
+{
+        return (uint64_t) ((unsigned __int128) cycles * NANO_PER_SEC / freq);
+}
+
+TEST(Clocksource, mult_shift_exact)
+{
+        uint32_t mult = 0;
+        uint32_t shift = 0;
+
+        /* 62.5 MHz (QEMU virt): exactly 16 ns per cycle */
+        clocksource_calc_mult_shift(&mult, &shift, 62500000, NANO_PER_SEC);
+        EXPECT_EQ((uint64_t) mult, 16ULL << shift);
+        EXPECT_EQ(clocksource_scale(1, mult, shift), 16u);
+
+        /* 1 GHz: identity */
+        clocksource_calc_mult_shift(&mult, &shift, NANO_PER_SEC, NANO_PER_SEC);
+        EXPECT_EQ(clocksource_scale(123456789, mult, shift), 123456789u);
+}
+
+TEST(Clocksource, conversion_accuracy)
+{
+        const uint64_t freqs[] = { 62500000, 24000000, 19200000, 54000000,
+                                   1000000000, 25000000, 100000000 };
+
+        for (uint64_t freq : freqs) {
+                clocksource cs;
+                clocksource_init(&cs, "fake", fake_read, freq, ~0ULL);
+
+                ASSERT_NE(cs.mult, 0u) << freq;
+
+                /* Within 1 ppm + 1 ns up to 10 years of uptime */
+                for (uint64_t secs = 1; secs < 10ULL * 365 * 24 * 3600;
+                        secs *= 7) {
+                        uint64_t cycles = secs * freq + 12345;
+                        uint64_t exp = ref_ns(cycles, freq);
+                        uint64_t got = clocksource_cyc2ns(&cs, cycles);
+                        uint64_t err = (got > exp) ? got - exp : exp - got;
+
+                        EXPECT_LE(err, exp / 1000000 + 1)
+                                << "freq " << freq << " secs " << secs;
+                }
+
+                /* ns -> cycles -> ns round trip */
+                uint64_t ns = 5ULL * NANO_PER_SEC;
+                uint64_t back = clocksource_cyc2ns(&cs,
+                        clocksource_ns2cyc(&cs, ns));
+                EXPECT_NEAR((double) back, (double) ns,
+                        (double) NANO_PER_SEC / freq + ns / 1000000.0);
+        }
+}
+
+TEST(Clocksource, no_overflow)
+{
+        clocksource cs;
+        clocksource_init(&cs, "fake", fake_read, 62500000, ~0ULL);
+
+        /* The old 'cycles * 10^9 / freq' overflowed after ~5 minutes here */
+        uint64_t cycles = 62500000ULL * 3600 * 24 * 365; /* 1 year */
+        EXPECT_EQ(clocksource_cyc2ns(&cs, cycles),
+                3600ULL * 24 * 365 * NANO_PER_SEC);
+}
+
+TEST(Clocksource, ktime_and_wrap)
+{
+        /* Before registration time stands still */
+        if (clocksource_current()->freq == 0) {
+                EXPECT_EQ(ktime_get_ns(), 0u);
+        }
+
+        /* Stays registered after the test, so not on the stack */
+        static clocksource cs;
+        clocksource_init(&cs, "fake", fake_read, 62500000,
+                CLOCKSOURCE_MASK(16));
+        EXPECT_EQ(cs.mask, 0xFFFFu);
+        EXPECT_EQ(cs.max_idle_ns, 0x7FFFu * 16);
+
+        fake_cycles = 0;
+        clocksource_register(&cs);
+        EXPECT_EQ(clocksource_current(), &cs);
+
+        fake_cycles = 100;
+        EXPECT_EQ(ktime_get_ns(), 1600u);
+        EXPECT_EQ(ktime_get_cycles(), 100u);
+        EXPECT_EQ(ktime_cycles_to_ns(100), 1600u);
+        EXPECT_EQ(ktime_ns_to_cycles(1600), 100u);
+
+        /* Walk 10 wrap periods, updating often enough */
+        uint64_t total = 100;
+        uint64_t prev = ktime_get_ns();
+
+        for (int i = 0; i < 40; i++) {
+                fake_cycles = (fake_cycles + 0x4000) & 0xFFFF;
+                total += 0x4000;
+                clocksource_update();
+
+                uint64_t now = ktime_get_ns();
+                EXPECT_GT(now, prev);
+                EXPECT_EQ(now, total * 16);
+                prev = now;
+        }
+
+        /* Switching clocks keeps time continuous */
+        static clocksource other;
+        clocksource_init(&other, "other", fake_read, 1000000000, ~0ULL);
+        clocksource_register(&other);
+        EXPECT_EQ(ktime_get_ns(), total * 16);
+
+        fake_cycles += 1000;
+        EXPECT_EQ(ktime_get_ns(), total * 16 + 1000);
+}
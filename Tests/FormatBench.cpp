@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+extern "C" {
+        #include "LibKern/Format.h"
+}
+
+/*
+ * Throughput of ksnprintf() vs. the host libc snprintf() on typical klog()
+ * lines. Not a pass/fail test, results are printed as ns per call.
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_ITERS 1000000
+
+template <typename F>
+static double ns_per_op(F fn)
+{
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < BENCH_ITERS; i++) {
+                fn(i);
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                BENCH_ITERS;
+}
+
+static volatile int sink;
+
+#define BENCH_FMT(name, fmt, ...)                                              \
+        TEST(FormatBench, name)                                                \
+        {                                                                      \
+                char buf[256];                                                 \
+                double k = ns_per_op([&](uint64_t i) {                         \
+                        sink = ksnprintf(buf, sizeof(buf), fmt, __VA_ARGS__);  \
+                });                                                            \
+                double c = ns_per_op([&](uint64_t i) {                         \
+                        sink = snprintf(buf, sizeof(buf), fmt, __VA_ARGS__);   \
+                });                                                            \
+                std::printf("%-12s ksnprintf: %7.2f ns | snprintf: %7.2f ns\n",\
+                        #name, k, c);                                          \
+        }
+
+BENCH_FMT(dec_u64, "%lu", i * 0x9E3779B97F4A7C15UL)
+BENCH_FMT(dec_small, "%d", (int) (i & 0xFFF))
+BENCH_FMT(hex_u64, "0x%016lx", i * 0x9E3779B97F4A7C15UL)
+BENCH_FMT(timestamp, "[%4lu.%06lu] ", i / 1000000, i % 1000000)
+BENCH_FMT(klog_line, "[mem/physical] nb_alloc size=%lu addr=0x%lx (%s)\n",
+        i & 0xFFFF, (i << 12) | 0x40000000UL, "ok")
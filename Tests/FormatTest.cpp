@@ -0,0 +1,188 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+
+extern "C" {
+        #include "LibKern/Format.h"
+}
+
+/* Both kernel & libc formatters must produce the same string & length */
+#define EXPECT_SAME(fmt, ...)                                                  \
+        do {                                                                   \
+                char kbuf[256];                                                \
+                char cbuf[256];                                                \
+                int kret = ksnprintf(kbuf, sizeof(kbuf), fmt, ##__VA_ARGS__);  \
+                int cret = snprintf(cbuf, sizeof(cbuf), fmt, ##__VA_ARGS__);   \
+                EXPECT_STREQ(kbuf, cbuf) << "fmt: " << fmt;                    \
+                EXPECT_EQ(kret, cret) << "fmt: " << fmt;                       \
+        } while (0)
+
+TEST(Format, literal)
+{
+        EXPECT_SAME("");
+        EXPECT_SAME("hello");
+        EXPECT_SAME("100%%");
+        EXPECT_SAME("%%%%");
+}
+
+TEST(Format, decimal)
+{
+        EXPECT_SAME("%d", 0);
+        EXPECT_SAME("%d", 7);
+        EXPECT_SAME("%d", -7);
+        EXPECT_SAME("%i", 1234567890);
+        EXPECT_SAME("%d", INT_MAX);
+        EXPECT_SAME("%d", INT_MIN);
+        EXPECT_SAME("%u", UINT_MAX);
+        EXPECT_SAME("%ld", LONG_MIN);
+        EXPECT_SAME("%ld", LONG_MAX);
+        EXPECT_SAME("%lu", ULONG_MAX);
+        EXPECT_SAME("%lld", LLONG_MIN);
+        EXPECT_SAME("%llu", ULLONG_MAX);
+
+        /* Every digit pair boundary */
+        for (uint64_t v = 1; v && v < UINT64_MAX / 10; v *= 10) {
+                EXPECT_SAME("%lu %lu %lu", v - 1, v, v + 1);
+        }
+}
+
+TEST(Format, length)
+{
+        EXPECT_SAME("%hhd", 0x1FF);
+        EXPECT_SAME("%hhu", 0x1FF);
+        EXPECT_SAME("%hd", 0x1FFFF);
+        EXPECT_SAME("%hu", 0x1FFFF);
+        EXPECT_SAME("%hhx", -1);
+        EXPECT_SAME("%zu", (size_t) 123456789012ULL);
+        EXPECT_SAME("%zx", (size_t) 0xDEADBEEFCAFEULL);
+        EXPECT_SAME("%jd", (intmax_t) -42);
+        EXPECT_SAME("%td", (ptrdiff_t) -42);
+
+        /* A 32-bit conversion must not swallow 64 bits */
+        EXPECT_SAME("%x %d", 0xAABBCCDDU, 5);
+}
+
+TEST(Format, hex_oct)
+{
+        EXPECT_SAME("%x", 0U);
+        EXPECT_SAME("%x", 0xdeadbeefU);
+        EXPECT_SAME("%X", 0xdeadbeefU);
+        EXPECT_SAME("%lx", 0xFFFF000040000000UL);
+        EXPECT_SAME("%#x", 0U);
+        EXPECT_SAME("%#x", 0x1FU);
+        EXPECT_SAME("%#X", 0x1FU);
+        EXPECT_SAME("%o", 0U);
+        EXPECT_SAME("%o", 8U);
+        EXPECT_SAME("%lo", ULONG_MAX);
+        EXPECT_SAME("%#o", 0U);
+        EXPECT_SAME("%#o", 8U);
+        EXPECT_SAME("%#.5o", 8U);
+}
+
+TEST(Format, flags_width)
+{
+        EXPECT_SAME("[%5d]", 42);
+        EXPECT_SAME("[%-5d]", 42);
+        EXPECT_SAME("[%05d]", 42);
+        EXPECT_SAME("[%05d]", -42);
+        EXPECT_SAME("[%+d]", 42);
+        EXPECT_SAME("[%+d]", -42);
+        EXPECT_SAME("[% d]", 42);
+        EXPECT_SAME("[%+ d]", 42);
+        EXPECT_SAME("[%-05d]", 42);
+        EXPECT_SAME("[%#010x]", 0xBEEFU);
+        EXPECT_SAME("[%-#10x]", 0xBEEFU);
+        EXPECT_SAME("[%016lx]", 0x40000000UL);
+        EXPECT_SAME("[%*d]", 6, 42);
+        EXPECT_SAME("[%*d]", -6, 42);
+        EXPECT_SAME("[%1d]", 12345);
+}
+
+TEST(Format, precision)
+{
+        EXPECT_SAME("[%.0d]", 0);
+        EXPECT_SAME("[%.0x]", 0U);
+        EXPECT_SAME("[%5.0d]", 0);
+        EXPECT_SAME("[%.3d]", 7);
+        EXPECT_SAME("[%.3d]", -7);
+        EXPECT_SAME("[%8.3d]", -7);
+        EXPECT_SAME("[%-8.3d]", -7);
+        EXPECT_SAME("[%08.3d]", 7); /* '0' ignored with precision */
+        EXPECT_SAME("[%.*d]", 4, 7);
+        EXPECT_SAME("[%.*d]", -1, 7);
+        EXPECT_SAME("[%4lu.%06lu]", 15UL, 123UL);
+}
+
+TEST(Format, string_char)
+{
+        EXPECT_SAME("%s", "kernel");
+        EXPECT_SAME("[%10s]", "kernel");
+        EXPECT_SAME("[%-10s]", "kernel");
+        EXPECT_SAME("[%.3s]", "kernel");
+        EXPECT_SAME("[%*.*s]", 8, 2, "kernel");
+        EXPECT_SAME("%c%c%c", 'a', 'b', 'c');
+        EXPECT_SAME("[%3c]", 'x');
+        EXPECT_SAME("[%-3c]", 'x');
+
+        /* Unterminated input is fine when precision bounds it */
+        const char raw[3] = { 'a', 'b', 'c' };
+        EXPECT_SAME("%.3s", raw);
+
+        char buf[16];
+        EXPECT_EQ(ksnprintf(buf, sizeof(buf), "%s", (const char*) nullptr), 6);
+        EXPECT_STREQ(buf, "(null)");
+}
+
+TEST(Format, pointer)
+{
+        int x = 0;
+
+        EXPECT_SAME("%p", (void*) &x);
+        EXPECT_SAME("%p", (void*) 0xFFFF000040080000UL);
+        EXPECT_SAME("[%20p]", (void*) 0x1234UL);
+        EXPECT_SAME("[%-20p]", (void*) 0x1234UL);
+}
+
+TEST(Format, truncation)
+{
+        char buf[8];
+
+        std::memset(buf, 'Z', sizeof(buf));
+        EXPECT_EQ(ksnprintf(buf, sizeof(buf), "0123456789"), 10);
+        EXPECT_STREQ(buf, "0123456");
+
+        std::memset(buf, 'Z', sizeof(buf));
+        EXPECT_EQ(ksnprintf(buf, 4, "%d", -123456), 7);
+        EXPECT_STREQ(buf, "-12");
+        EXPECT_EQ(buf[4], 'Z');
+
+        std::memset(buf, 'Z', sizeof(buf));
+        EXPECT_EQ(ksnprintf(buf, 1, "abc"), 3);
+        EXPECT_EQ(buf[0], '\0');
+        EXPECT_EQ(buf[1], 'Z');
+
+        /* size 0: nothing is written, length is still reported */
+        std::memset(buf, 'Z', sizeof(buf));
+        EXPECT_EQ(ksnprintf(buf, 0, "%s-%d", "abc", 42), 6);
+        EXPECT_EQ(buf[0], 'Z');
+        EXPECT_EQ(ksnprintf(nullptr, 0, "%08x", 1U), 8);
+}
+
+TEST(Format, raw_digits)
+{
+        char buf[32];
+        char *end = buf + sizeof(buf);
+
+        EXPECT_EQ(std::string(kfmt_u64_dec(end, 0), end), "0");
+        EXPECT_EQ(std::string(kfmt_u64_dec(end, 99), end), "99");
+        EXPECT_EQ(std::string(kfmt_u64_dec(end, 100), end), "100");
+        EXPECT_EQ(std::string(kfmt_u64_dec(end, UINT64_MAX), end),
+                "18446744073709551615");
+        EXPECT_EQ(std::string(kfmt_u64_hex(end, 0xABCDEF, 0), end), "abcdef");
+        EXPECT_EQ(std::string(kfmt_u64_hex(end, 0xABCDEF, 1), end), "ABCDEF");
+        EXPECT_EQ(std::string(kfmt_u64_oct(end, UINT64_MAX), end),
+                "1777777777777777777777");
+}
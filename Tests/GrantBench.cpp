@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "MemArena.h"
+
+extern "C" {
+        #include "Memory/Grant.h"
+        #include "Memory/Page.h"
+        #include "Memory/PageDef.h"
+        #include "Memory/PageTable.h"
+        #include "Memory/Physical.h"
+}
+
+/*
+ * Handing a buffer to another address space, by size, ns per transfer.
+ * Not a pass/fail test.
+ *
+ *      copy:   memcpy() of the whole buffer, what a message through the
+ *              kernel costs at least (twice, in & out, in reality)
+ *      share:  vm_grant() GRANT_SHARE, then vm_revoke() it
+ *      move:   vm_grant() GRANT_MOVE there, then back
+ *
+ * A copy grows with the bytes, a grant with the pages: one 8 byte entry
+ * per 4 KiB page against 64 cache lines copied. TLB invalidation isn't in it
+ * (there's none on the host).
+ *
+ * Build & run with: make bench
+ */
+
+#define ARENA_SIZE      (64 * 1024 * 1024)
+#define BENCH_BYTES     (256ULL * 1024 * 1024)  /* Per size */
+
+#define SRC_VA          0x10000000ULL
+#define DST_VA          0x20000000ULL
+
+static pgtbl a, b;
+static uint8_t *copy_from;
+static uint8_t *copy_to;
+
+static void setup(uint64_t max_pages)
+{
+        ASSERT_NO_FATAL_FAILURE(mem_arena_init(ARENA_SIZE));
+
+        pgtbl_init(&a, 1);
+        pgtbl_init(&b, 2);
+
+        for (uint64_t i = 0; i < max_pages; i++) {
+                pgtbl_map(&a, SRC_VA + i * PAGE_SIZE,
+                        pgtbl_pte(page_alloc(), PT_READ | PT_WRITE));
+        }
+
+        copy_from = static_cast<uint8_t*>(
+                std::aligned_alloc(PAGE_SIZE, max_pages * PAGE_SIZE));
+        copy_to = static_cast<uint8_t*>(
+                std::aligned_alloc(PAGE_SIZE, max_pages * PAGE_SIZE));
+        std::memset(copy_from, 1, max_pages * PAGE_SIZE);
+        std::memset(copy_to, 0, max_pages * PAGE_SIZE);
+}
+
+template <typename F>
+static double ns_per(uint64_t pages, F fn)
+{
+        uint64_t iters = BENCH_BYTES / (pages * PAGE_SIZE);
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint64_t i = 0; i < iters; i++) {
+                fn();
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                iters;
+}
+
+TEST(GrantBench, copy_vs_grant)
+{
+        const uint64_t max_pages = 1024;
+
+        ASSERT_NO_FATAL_FAILURE(setup(max_pages));
+
+        for (uint64_t pages = 1; pages <= max_pages; pages *= 4) {
+                double copy = ns_per(pages, [pages] {
+                        std::memcpy(copy_to, copy_from, pages * PAGE_SIZE);
+                        asm volatile("" : : "r" (copy_to) : "memory");
+                });
+
+                double share = ns_per(pages, [pages] {
+                        vm_grant(&a, SRC_VA, &b, DST_VA, pages, GRANT_SHARE);
+                        vm_revoke(&b, DST_VA, pages);
+                });
+
+                double move = ns_per(pages, [pages] {
+                        vm_grant(&a, SRC_VA, &b, DST_VA, pages, GRANT_MOVE);
+                        vm_grant(&b, DST_VA, &a, SRC_VA, pages, GRANT_MOVE);
+                });
+
+                std::printf("%5lu pages: copy %10.1f ns | share+revoke "
+                        "%9.1f ns | move+back %9.1f ns\n",
+                        (unsigned long) pages, copy, share, move);
+        }
+
+        EXPECT_EQ(a.pages, max_pages);
+        EXPECT_EQ(b.pages, 0u);
+}
@@ -0,0 +1,259 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+
+#include "MemArena.h"
+
+extern "C" {
+        #include "Memory/Grant.h"
+        #include "Memory/Page.h"
+        #include "Memory/PageDef.h"
+        #include "Memory/PageTable.h"
+        #include "Memory/Physical.h"
+}
+
+#define L3_SPAN         (512ULL * PAGE_SIZE)    /* 2 MiB */
+
+/* A fresh allocator & page metadata for each test */
+class Grant : public MemArena {};
+
+/* 'pages' fresh frames at 'va', each filled with its index */
+static void populate(pgtbl *pt, uint64_t va, uint64_t pages, uint32_t prot)
+{
+        for (uint64_t i = 0; i < pages; i++) {
+                uint64_t pa = page_alloc();
+
+                ASSERT_NE(pa, 0u);
+                *(uint64_t*) page_va(pa) = i;
+                ASSERT_EQ(PT_OK, pgtbl_map(pt, va + i * PAGE_SIZE,
+                        pgtbl_pte(pa, prot)));
+        }
+}
+
+static uint64_t pa_at(pgtbl *pt, uint64_t va)
+{
+        return pgtbl_pte_pa(pgtbl_lookup(pt, va));
+}
+
+static uint64_t ap_of(uint64_t pte)
+{
+        return (pte & ARM_TB_AP_MASK) >> ARM_TB_AP_SHIFT;
+}
+
+TEST_F(Grant, map_lookup_unmap)
+{
+        pgtbl pt;
+        ASSERT_EQ(PT_OK, pgtbl_init(&pt, 1));
+
+        uint64_t pa = page_alloc();
+        uint64_t pte = pgtbl_pte(pa, PT_READ | PT_WRITE);
+
+        EXPECT_EQ(PT_EINVAL, pgtbl_map(&pt, 0x1001, pte));
+        EXPECT_EQ(PT_EINVAL, pgtbl_map(&pt, PT_VA_LIMIT, pte));
+
+        EXPECT_EQ(PT_OK, pgtbl_map(&pt, 0x400000, pte));
+        EXPECT_EQ(PT_EEXIST, pgtbl_map(&pt, 0x400000, pte));
+        EXPECT_EQ(pa_at(&pt, 0x400000), pa);
+        EXPECT_EQ(ap_of(pgtbl_lookup(&pt, 0x400000)),
+                (uint64_t) AP_PRIV_RW_UNPRIV_RW);
+        EXPECT_NE(pgtbl_lookup(&pt, 0x400000) & ARM_TB_NG_MASK, 0u);
+        EXPECT_EQ(pgtbl_lookup(&pt, 0x401000), 0u);
+        EXPECT_EQ(pt.pages, 1u);
+
+        EXPECT_EQ(pgtbl_unmap(&pt, 0x400000), pte);
+        EXPECT_EQ(pgtbl_unmap(&pt, 0x400000), 0u);
+        EXPECT_EQ(pt.pages, 0u);
+
+        page_unref(pa);
+        pgtbl_destroy(&pt);
+}
+
+TEST_F(Grant, share_then_revoke)
+{
+        pgtbl a, b;
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+        populate(&a, 0x10000000, 8, PT_READ | PT_WRITE);
+
+        grant_stats before = grant_get_stats();
+
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, 0x10000000, &b, 0x20000000, 8,
+                GRANT_SHARE));
+
+        for (uint64_t i = 0; i < 8; i++) {
+                uint64_t pa = pa_at(&a, 0x10000000 + i * PAGE_SIZE);
+                uint64_t pte = pgtbl_lookup(&b, 0x20000000 + i * PAGE_SIZE);
+
+                /* Same frame, not a copy */
+                EXPECT_EQ(pgtbl_pte_pa(pte), pa);
+                EXPECT_NE(pte & PT_SW_GRANT, 0u);
+                EXPECT_EQ(page_refs(pa), 2u);
+                EXPECT_EQ(*(uint64_t*) page_va(pa), i);
+        }
+
+        EXPECT_EQ(b.pages, 8u);
+
+        /* Only the shared pages, & the source keeps its own */
+        populate(&b, 0x20008000, 1, PT_READ);
+        EXPECT_EQ(vm_revoke(&b, 0x20000000, 16), 8);
+        EXPECT_EQ(b.pages, 1u);
+        EXPECT_EQ(a.pages, 8u);
+        EXPECT_EQ(page_refs(pa_at(&a, 0x10000000)), 1u);
+        EXPECT_EQ(pgtbl_lookup(&b, 0x20000000), 0u);
+
+        grant_stats after = grant_get_stats();
+
+        EXPECT_EQ(after.shared - before.shared, 8u);
+        EXPECT_EQ(after.revoked - before.revoked, 8u);
+        EXPECT_GE(after.flushed - before.flushed, 8u);
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+}
+
+TEST_F(Grant, move)
+{
+        pgtbl a, b;
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+        populate(&a, 0x10000000, 4, PT_READ | PT_WRITE);
+
+        uint64_t pa = pa_at(&a, 0x10000000);
+
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, 0x10000000, &b, 0x30000000, 4,
+                GRANT_MOVE));
+
+        EXPECT_EQ(pgtbl_lookup(&a, 0x10000000), 0u);
+        EXPECT_EQ(a.pages, 0u);
+        EXPECT_EQ(b.pages, 4u);
+        EXPECT_EQ(pa_at(&b, 0x30000000), pa);
+        EXPECT_EQ(page_refs(pa), 1u);
+
+        /* Owned now: not revocable, & can be granted on */
+        EXPECT_EQ(pgtbl_lookup(&b, 0x30000000) & PT_SW_GRANT, 0u);
+        EXPECT_EQ(vm_revoke(&b, 0x30000000, 4), 0);
+        EXPECT_EQ(GRANT_OK, vm_grant(&b, 0x30000000, &a, 0x10000000, 4,
+                GRANT_SHARE));
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+}
+
+TEST_F(Grant, never_adds_permissions)
+{
+        pgtbl a, b;
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+        populate(&a, 0x10000000, 1, PT_READ | PT_WRITE);
+        populate(&a, 0x10001000, 1, PT_READ);
+
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, 0x10000000, &b, 0x20000000, 2,
+                GRANT_RO));
+        EXPECT_EQ(ap_of(pgtbl_lookup(&b, 0x20000000)),
+                (uint64_t) AP_PRIV_R_UNPRIV_R);
+        EXPECT_EQ(ap_of(pgtbl_lookup(&b, 0x20001000)),
+                (uint64_t) AP_PRIV_R_UNPRIV_R);
+
+        /* Without GRANT_RO: what the source had */
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, 0x10000000, &b, 0x40000000, 2, 0));
+        EXPECT_EQ(ap_of(pgtbl_lookup(&b, 0x40000000)),
+                (uint64_t) AP_PRIV_RW_UNPRIV_RW);
+        EXPECT_EQ(ap_of(pgtbl_lookup(&b, 0x40001000)),
+                (uint64_t) AP_PRIV_R_UNPRIV_R);
+
+        /* Shared in: not granted on, not even back */
+        EXPECT_EQ(GRANT_EPERM, vm_grant(&b, 0x40000000, &a, 0x50000000, 1,
+                GRANT_MOVE));
+        EXPECT_EQ(GRANT_EINVAL, vm_grant(&a, 0x10000000, &b, 0x60000000, 1,
+                0x80));
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+}
+
+TEST_F(Grant, all_or_nothing)
+{
+        pgtbl a, b;
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+        populate(&a, 0x10000000, 3, PT_READ | PT_WRITE);
+        populate(&a, 0x10004000, 1, PT_READ | PT_WRITE);  /* A hole at 3 */
+        populate(&b, 0x20002000, 1, PT_READ);
+
+        EXPECT_EQ(GRANT_ENOENT, vm_grant(&a, 0x10000000, &b, 0x30000000, 5,
+                GRANT_MOVE));
+        EXPECT_EQ(GRANT_EEXIST, vm_grant(&a, 0x10000000, &b, 0x20000000, 3,
+                GRANT_SHARE));
+        EXPECT_EQ(GRANT_EINVAL, vm_grant(&a, 0x10000800, &b, 0x20000000, 1,
+                GRANT_SHARE));
+        EXPECT_EQ(GRANT_EINVAL, vm_grant(&a, 0x10000000, &b,
+                PT_VA_LIMIT - PAGE_SIZE, 2, GRANT_SHARE));
+
+        /* Nothing happened */
+        EXPECT_EQ(a.pages, 4u);
+        EXPECT_EQ(b.pages, 1u);
+        EXPECT_EQ(pgtbl_lookup(&b, 0x30000000), 0u);
+        EXPECT_EQ(pgtbl_lookup(&b, 0x20000000), 0u);
+        EXPECT_EQ(page_refs(pa_at(&a, 0x10000000)), 1u);
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+}
+
+/* Ranges straddling L3 tables (2 MiB) on both sides, at different offsets */
+TEST_F(Grant, across_tables)
+{
+        const uint64_t pages = 1100;
+        const uint64_t from = 0x10000000 + L3_SPAN - 5 * PAGE_SIZE;
+        const uint64_t to = 0x7F0000000000ULL + L3_SPAN - 300 * PAGE_SIZE;
+        pgtbl a, b;
+
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+        populate(&a, from, pages, PT_READ | PT_WRITE);
+
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, from, &b, to, pages, GRANT_SHARE));
+
+        for (uint64_t i = 0; i < pages; i++) {
+                uint64_t pa = pa_at(&b, to + i * PAGE_SIZE);
+
+                ASSERT_EQ(pa, pa_at(&a, from + i * PAGE_SIZE));
+                ASSERT_EQ(*(uint64_t*) page_va(pa), i);
+        }
+
+        EXPECT_EQ(vm_revoke(&b, to, pages), (int64_t) pages);
+        EXPECT_EQ(b.pages, 0u);
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+}
+
+/* The last reference frees the frame, whoever holds it */
+TEST_F(Grant, last_reference_frees)
+{
+        pgtbl a, b;
+        ASSERT_EQ(PT_OK, pgtbl_init(&a, 1));
+        ASSERT_EQ(PT_OK, pgtbl_init(&b, 2));
+
+        uint64_t tables = nb_stat_used_memory();
+
+        populate(&a, 0x10000000, 16, PT_READ | PT_WRITE);
+        ASSERT_EQ(GRANT_OK, vm_grant(&a, 0x10000000, &b, 0x10000000, 16,
+                GRANT_SHARE));
+
+        /* b's tables, a's frames */
+        uint64_t used = nb_stat_used_memory();
+
+        /* The owner lets go first: b still has them */
+        EXPECT_EQ(vm_unmap(&a, 0x10000000, 16), 16);
+        EXPECT_EQ(nb_stat_used_memory(), used);
+        EXPECT_EQ(page_refs(pa_at(&b, 0x10000000)), 1u);
+
+        EXPECT_EQ(vm_revoke(&b, 0x10000000, 16), 16);
+        EXPECT_EQ(nb_stat_used_memory(), used - 16 * PAGE_SIZE);
+        EXPECT_LT(tables, nb_stat_used_memory());
+
+        pgtbl_destroy(&a);
+        pgtbl_destroy(&b);
+        EXPECT_EQ(nb_stat_used_memory(), tables - 2 * PAGE_SIZE);
+}
@@ -0,0 +1,70 @@
+/*
+ * Host memory for the tests of code on top of the physical allocator
+ *
+ * mem_arena_init() gives each test a fresh bootmem, buddy allocator and
+ * page metadata over host memory, host addresses playing PAs (page_va()
+ * is the identity on the host). Fatal on failure: call it through
+ * ASSERT_NO_FATAL_FAILURE(), or derive the test's fixture from MemArena,
+ * whose SetUp() does.
+ *
+ * Author: Tuna CICI
+ */
+
+#pragma once
+
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" {
+        #include "Memory/BootMem.h"
+        #include "Memory/Page.h"
+        #include "Memory/PageDef.h"
+        #include "Memory/Physical.h"
+}
+
+#define MEM_ARENA_SIZE  (16 * 1024 * 1024)
+#define MEM_ARENA_ALIGN (2 * 1024 * 1024)       /* An L2 block */
+
+/* Reused from one test to the next, grown when asked for more */
+static inline void mem_arena_init(uint64_t size = MEM_ARENA_SIZE)
+{
+        static uint8_t *bootmem_arena = nullptr;
+        static uint8_t *arena = nullptr;
+        static uint64_t arena_size = 0;
+
+        if (!bootmem_arena) {
+                bootmem_arena = static_cast<uint8_t*>(
+                        std::aligned_alloc(PAGE_SIZE, BM_ARENA_SIZE_BYTE));
+                ASSERT_NE(bootmem_arena, nullptr);
+        }
+
+        if (arena_size < size) {
+                std::free(arena);
+                arena = static_cast<uint8_t*>(
+                        std::aligned_alloc(MEM_ARENA_ALIGN, size));
+                ASSERT_NE(arena, nullptr);
+                arena_size = size;
+        }
+
+        std::fill_n(bootmem_arena, BM_ARENA_SIZE_BYTE, 0x0);
+        bootmem_init((uint64_t) bootmem_arena);
+
+        ASSERT_EQ(0, nb_init((uint64_t) arena, size));
+        ASSERT_EQ(0, page_meta_init((uint64_t) arena, size));
+}
+
+class MemArena : public ::testing::Test {
+protected:
+        void SetUp() override
+        {
+                ASSERT_NO_FATAL_FAILURE(mem_arena_init());
+        }
+};
+
+#endif /* MEM_ARENA_H */
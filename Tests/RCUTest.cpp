@@ -0,0 +1,339 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+extern "C" {
+        #include "LibKern/RCU.h"
+}
+
+static uint64_t invoked = 0;
+
+static void count_cb(rcu_head *head)
+{
+        (void) head;
+        invoked++;
+}
+
+static void *last_freed = nullptr;
+
+static void record_free(void *obj)
+{
+        last_freed = obj;
+}
+
+TEST(RCU, single_cpu_runs_at_next_qs)
+{
+        static rcu_state rs;
+        rcu_head h;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &h, count_cb);
+        EXPECT_EQ(rcu_pending(&rs, 0), 1u);
+        EXPECT_EQ(invoked, 0u);
+
+        /* Nobody else to wait for */
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+        EXPECT_EQ(rcu_pending(&rs, 0), 0u);
+        EXPECT_EQ(rs.gp_done, rs.gp_seq);
+}
+
+TEST(RCU, gp_waits_for_every_cpu)
+{
+        static rcu_state rs;
+        rcu_head h;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+        rcu_cpu_online(&rs, 1);
+        rcu_cpu_online(&rs, 2);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &h, count_cb);
+
+        rcu_qs(&rs, 0);
+        rcu_qs(&rs, 0);
+        rcu_qs(&rs, 1);
+        EXPECT_EQ(invoked, 0u); /* cpu2 may still be reading */
+
+        rcu_qs(&rs, 2);
+        EXPECT_EQ(invoked, 0u); /* Runs on the CPU that queued it */
+
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+}
+
+TEST(RCU, queued_during_gp_waits_for_the_next)
+{
+        static rcu_state rs;
+        rcu_head a;
+        rcu_head b;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+        rcu_cpu_online(&rs, 1);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &a, count_cb);
+        rcu_qs(&rs, 0);                 /* GP 1 starts, cpu0 reported */
+
+        rcu_call(&rs, 1, &b, count_cb);
+        rcu_qs(&rs, 1);                 /* Ends GP 1, 'b' needs GP 2 */
+        EXPECT_EQ(rs.gp_done, 1u);
+        EXPECT_EQ(rs.gp_seq, 2u);
+        EXPECT_EQ(rcu_pending(&rs, 1), 1u);
+
+        rcu_qs(&rs, 1);
+        EXPECT_EQ(rcu_pending(&rs, 1), 1u); /* cpu0 hasn't been through GP 2 */
+
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);         /* 'a' */
+
+        rcu_qs(&rs, 1);
+        EXPECT_EQ(invoked, 2u);         /* 'b' */
+}
+
+TEST(RCU, idle_cpus_dont_hold_up_gps)
+{
+        static rcu_state rs;
+        rcu_head h;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+        rcu_cpu_online(&rs, 1);
+
+        rcu_idle_enter(&rs, 1);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &h, count_cb);
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+
+        /* Awake again: the next GP waits for it */
+        rcu_idle_exit(&rs, 1);
+
+        rcu_call(&rs, 0, &h, count_cb);
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+
+        rcu_qs(&rs, 1);
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 2u);
+}
+
+TEST(RCU, going_idle_reports_the_running_gp)
+{
+        static rcu_state rs;
+        rcu_head h;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+        rcu_cpu_online(&rs, 1);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &h, count_cb);
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(rs.pending, 1u << 1);
+
+        rcu_idle_enter(&rs, 1);
+        EXPECT_EQ(rs.pending, 0u);
+        EXPECT_EQ(rs.gp_done, rs.gp_seq);
+
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+}
+
+TEST(RCU, offline_cpu_ends_gp)
+{
+        static rcu_state rs;
+        rcu_head h;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+        rcu_cpu_online(&rs, 3);
+
+        invoked = 0;
+        rcu_call(&rs, 0, &h, count_cb);
+        rcu_qs(&rs, 0);
+        EXPECT_NE(rs.gp_done, rs.gp_seq);
+
+        rcu_cpu_offline(&rs, 3);
+        EXPECT_EQ(rs.gp_done, rs.gp_seq);
+
+        rcu_qs(&rs, 0);
+        EXPECT_EQ(invoked, 1u);
+}
+
+TEST(RCU, call_free_passes_the_object)
+{
+        struct obj {
+                uint64_t key;
+                uint64_t value;
+                rcu_head rh;
+        };
+
+        static rcu_state rs;
+        obj o;
+
+        rcu_state_init(&rs, record_free);
+        rcu_cpu_online(&rs, 0);
+
+        last_freed = nullptr;
+        rcu_call_free(&rs, 0, &o.rh, offsetof(obj, rh));
+        rcu_qs(&rs, 0);
+
+        EXPECT_EQ(last_freed, (void*) &o);
+        EXPECT_EQ(rs.invoked, 1u);
+}
+
+/*
+ * Stress: threads play CPUs. Readers walk the current version, writers
+ * replace it and rcu_call_free() the old one, which poisons it instead of
+ * freeing (so a premature "free" is seen, not undefined). Every thread
+ * passes through QS & idle periods. No reader may see a poisoned version.
+ */
+
+#define STRESS_CPUS     4
+#define STRESS_ITERS    20000
+#define LIVE            0x4C495645ULL   /* 'LIVE' */
+#define DEAD            0xDEADDEADULL
+
+struct version {
+        uint64_t magic;
+        uint64_t payload[7];
+        rcu_head rh;
+};
+
+static rcu_state stress_rs;
+static version *current;
+static std::mutex graveyard_lock;
+static std::vector<version*> graveyard;
+
+static void poison(void *obj)
+{
+        version *v = (version*) obj;
+
+        __atomic_store_n(&v->magic, DEAD, __ATOMIC_RELAXED);
+
+        std::lock_guard<std::mutex> guard(graveyard_lock);
+        graveyard.push_back(v);
+}
+
+static version *new_version(uint64_t seed)
+{
+        version *v = new version;
+
+        v->magic = LIVE;
+
+        for (uint64_t &p : v->payload) {
+                p = seed;
+        }
+
+        return v;
+}
+
+TEST(RCU, stress_readers_never_see_freed)
+{
+        static spinlock writer_lock = SPINLOCK_INIT;
+        std::atomic<uint64_t> bad(0);
+        std::atomic<uint64_t> replaced(0);
+        std::vector<std::thread> threads;
+
+        rcu_state_init(&stress_rs, poison);
+        graveyard.clear();
+        current = new_version(0);
+
+        for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                rcu_cpu_online(&stress_rs, cpu);
+        }
+
+        for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                threads.emplace_back([cpu, &bad, &replaced] {
+                        std::mt19937 rng(cpu);
+
+                        for (uint64_t i = 0; i < STRESS_ITERS; i++) {
+                                uint32_t r = rng() % 64;
+
+                                if (r == 0) {
+                                        version *next = new_version(i);
+
+                                        spin_lock(&writer_lock);
+                                        version *old = current;
+                                        rcu_assign_pointer(current, next);
+                                        spin_unlock(&writer_lock);
+
+                                        rcu_call_free(&stress_rs, cpu,
+                                                &old->rh,
+                                                offsetof(version, rh));
+                                        replaced++;
+                                } else {
+                                        rcu_read_lock();
+
+                                        version *v = rcu_dereference(current);
+
+                                        if (r == 1) {
+                                                std::this_thread::yield();
+                                        }
+
+                                        uint64_t seed = v->payload[0];
+
+                                        for (uint64_t p : v->payload) {
+                                                if (p != seed) {
+                                                        bad++;
+                                                }
+                                        }
+
+                                        if (__atomic_load_n(&v->magic,
+                                                __ATOMIC_RELAXED) != LIVE) {
+                                                bad++;
+                                        }
+
+                                        rcu_read_unlock();
+                                }
+
+                                if (r == 2) {
+                                        rcu_idle_enter(&stress_rs, cpu);
+                                        std::this_thread::yield();
+                                        rcu_idle_exit(&stress_rs, cpu);
+                                } else if ((i & 7) == 0) {
+                                        rcu_qs(&stress_rs, cpu);
+                                }
+                        }
+                });
+        }
+
+        for (auto &th : threads) {
+                th.join();
+        }
+
+        /* Drain: everyone quiescent now */
+        for (int round = 0; round < 16; round++) {
+                for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                        rcu_qs(&stress_rs, cpu);
+                }
+        }
+
+        EXPECT_EQ(bad.load(), 0u);
+        EXPECT_GT(replaced.load(), 0u);
+        EXPECT_EQ(graveyard.size(), replaced.load());
+        EXPECT_EQ(stress_rs.invoked, replaced.load());
+
+        for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                EXPECT_EQ(rcu_pending(&stress_rs, cpu), 0u);
+        }
+
+        for (version *v : graveyard) {
+                delete v;
+        }
+
+        delete current;
+}
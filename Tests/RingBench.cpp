@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+extern "C" {
+        #include "IPC/Ring.h"
+}
+
+/*
+ * SPSC ring throughput between 2 threads, ns per message & doorbells per
+ * message, by batch size. Not a pass/fail test.
+ *
+ * The consumer spins (yields) on a doorbell flag where the kernel would
+ * put it to sleep: a doorbell stands for the notify & wait syscalls a
+ * channel pays. Bigger batches should need fewer of them per message.
+ * The in-kernel version, against ipc_call(), is Kernel/Bench/MsgBench.c
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_MSGS      2000000
+#define BENCH_SLOTS     256
+
+static double bench(uint32_t batch, double *doorbells)
+{
+        ring *r = (ring*) std::aligned_alloc(64, ring_bytes(BENCH_SLOTS));
+        std::atomic<uint32_t> bell(0);
+        uint64_t rings = 0;
+
+        ring_init(r, BENCH_SLOTS);
+
+        auto start = std::chrono::steady_clock::now();
+
+        std::thread consumer([r, batch, &bell] {
+                ring_cons c;
+                ring_msg out[BENCH_SLOTS];
+                uint64_t got = 0;
+
+                ring_cons_init(&c, r);
+
+                while (got < BENCH_MSGS) {
+                        uint32_t n = ring_pop(&c, out, batch);
+
+                        got += n;
+
+                        if (n || !ring_cons_idle(&c)) {
+                                continue;
+                        }
+
+                        while (!bell.exchange(0)) {
+                                std::this_thread::yield();
+                        }
+                }
+        });
+
+        ring_prod p;
+        ring_msg in[BENCH_SLOTS] = {};
+        uint64_t sent = 0;
+
+        ring_prod_init(&p, r);
+
+        while (sent < BENCH_MSGS) {
+                uint32_t n = ring_push(&p, in, batch);
+
+                sent += n;
+
+                if (n && ring_wants_doorbell(&p)) {
+                        ring_wake(r);
+                        bell = 1;
+                        rings++;
+                }
+
+                if (!n) {
+                        std::this_thread::yield();
+                }
+        }
+
+        consumer.join();
+
+        auto end = std::chrono::steady_clock::now();
+
+        std::free(r);
+        *doorbells = (double) rings / BENCH_MSGS;
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                BENCH_MSGS;
+}
+
+TEST(RingBench, throughput)
+{
+        for (uint32_t batch = 1; batch <= 64; batch *= 4) {
+                double doorbells;
+                double ns = bench(batch, &doorbells);
+
+                std::printf("batch %2u: %7.1f ns/msg, %.4f doorbells/msg\n",
+                        batch, ns, doorbells);
+        }
+
+        std::printf("%u hardware threads on this host\n",
+                std::thread::hardware_concurrency());
+}
@@ -0,0 +1,215 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+
+extern "C" {
+        #include "IPC/Ring.h"
+}
+
+static ring *ring_new(uint32_t slots)
+{
+        ring *r = (ring*) std::aligned_alloc(64, ring_bytes(slots));
+
+        ring_init(r, slots);
+        return r;
+}
+
+static ring_msg msg(uint64_t v)
+{
+        ring_msg m;
+
+        for (uint32_t i = 0; i < IPC_MRS; i++) {
+                m.w[i] = v + i;
+        }
+
+        return m;
+}
+
+TEST(Ring, layout)
+{
+        /* Producer & consumer indices never share a line */
+        EXPECT_EQ(offsetof(ring, head), 0u);
+        EXPECT_EQ(offsetof(ring, tail), 64u);
+        EXPECT_EQ(offsetof(ring, idle), 128u);
+        EXPECT_EQ(offsetof(ring, slot) % 64, 0u);
+        EXPECT_EQ(sizeof(ring_msg), 64u);
+        EXPECT_EQ(ring_bytes(4), sizeof(ring) + 4 * 64);
+}
+
+TEST(Ring, push_pop_in_order)
+{
+        ring *r = ring_new(8);
+        ring_prod p;
+        ring_cons c;
+        ring_msg in[3] = { msg(10), msg(20), msg(30) };
+        ring_msg out[8];
+
+        ring_prod_init(&p, r);
+        ring_cons_init(&c, r);
+
+        EXPECT_EQ(ring_pop(&c, out, 8), 0u);
+        EXPECT_EQ(ring_push(&p, in, 3), 3u);
+        EXPECT_EQ(ring_count(r), 3u);
+
+        EXPECT_EQ(ring_pop(&c, out, 2), 2u);
+        EXPECT_EQ(out[0].w[0], 10u);
+        EXPECT_EQ(out[1].w[7], 27u);
+
+        EXPECT_EQ(ring_pop(&c, out, 8), 1u);
+        EXPECT_EQ(out[0].w[0], 30u);
+        EXPECT_EQ(ring_count(r), 0u);
+
+        std::free(r);
+}
+
+TEST(Ring, full_and_wraparound)
+{
+        ring *r = ring_new(4);
+        ring_prod p;
+        ring_cons c;
+        ring_msg in[6];
+        ring_msg out[4];
+        uint64_t next = 0;
+        uint64_t expect = 0;
+
+        ring_prod_init(&p, r);
+        ring_cons_init(&c, r);
+
+        /* Indices run far past the slot count, and past 2^32 - wrap */
+        r->head = r->tail = 0xFFFFFFF0U;
+        ring_prod_init(&p, r);
+        ring_cons_init(&c, r);
+
+        for (uint32_t round = 0; round < 100; round++) {
+                for (uint32_t i = 0; i < 6; i++) {
+                        in[i] = msg(next + i);
+                }
+
+                uint32_t n = ring_push(&p, in, 6);
+
+                EXPECT_EQ(n, 4u); /* Only what fits */
+                EXPECT_EQ(ring_push(&p, in, 1), 0u);
+                next += n;
+
+                EXPECT_EQ(ring_pop(&c, out, 4), 4u);
+
+                for (uint32_t i = 0; i < 4; i++) {
+                        EXPECT_EQ(out[i].w[0], expect++);
+                }
+        }
+
+        std::free(r);
+}
+
+TEST(Ring, doorbell_only_when_idle)
+{
+        ring *r = ring_new(4);
+        ring_prod p;
+        ring_cons c;
+        ring_msg m = msg(1);
+        ring_msg out;
+
+        ring_prod_init(&p, r);
+        ring_cons_init(&c, r);
+
+        /* A busy consumer is never rung */
+        ring_push(&p, &m, 1);
+        EXPECT_FALSE(ring_wants_doorbell(&p));
+
+        /* Not idle while there's something to pop */
+        EXPECT_FALSE(ring_cons_idle(&c));
+        EXPECT_EQ(r->idle, 0u);
+        EXPECT_EQ(ring_pop(&c, &out, 1), 1u);
+
+        /* Empty: idle, the next push rings, once */
+        EXPECT_TRUE(ring_cons_idle(&c));
+        ring_push(&p, &m, 1);
+        EXPECT_TRUE(ring_wants_doorbell(&p));
+        ring_wake(r);
+        ring_push(&p, &m, 1);
+        EXPECT_FALSE(ring_wants_doorbell(&p));
+
+        std::free(r);
+}
+
+/*
+ * A producer & a consumer thread, the consumer "sleeping" (spinning on
+ * its doorbell) whenever it goes idle: no message lost, none reordered,
+ * and no missed doorbell (that would hang).
+ */
+TEST(Ring, spsc_stress)
+{
+        const uint64_t total = 1000000;
+        ring *r = ring_new(64);
+        std::atomic<uint32_t> doorbell(0);
+        std::atomic<uint64_t> rings(0);
+        uint64_t errors = 0;
+
+        std::thread consumer([&] {
+                ring_cons c;
+                ring_msg out[16];
+                uint64_t expect = 0;
+
+                ring_cons_init(&c, r);
+
+                while (expect < total) {
+                        uint32_t n = ring_pop(&c, out, 16);
+
+                        for (uint32_t i = 0; i < n; i++) {
+                                errors += out[i].w[0] != expect;
+                                errors += out[i].w[7] != expect + 7;
+                                expect++;
+                        }
+
+                        if (n || !ring_cons_idle(&c)) {
+                                continue;
+                        }
+
+                        /* chan_wait(): sleep until rung */
+                        while (!doorbell.exchange(0)) {
+                                std::this_thread::yield();
+                        }
+                }
+        });
+
+        ring_prod p;
+        ring_msg in[16];
+        uint64_t next = 0;
+
+        ring_prod_init(&p, r);
+
+        while (next < total) {
+                uint32_t want = (uint32_t) (next % 16) + 1;
+
+                for (uint32_t i = 0; i < want; i++) {
+                        in[i] = msg(next + i);
+                }
+
+                uint32_t n = ring_push(&p, in, want);
+
+                next += n;
+
+                /* chan_notify() */
+                if (n && ring_wants_doorbell(&p)) {
+                        ring_wake(r);
+                        doorbell = 1;
+                        rings++;
+                }
+
+                if (!n) {
+                        std::this_thread::yield();
+                }
+        }
+
+        consumer.join();
+
+        EXPECT_EQ(errors, 0u);
+        EXPECT_EQ(ring_count(r), 0u);
+        std::printf("%lu doorbells for %lu messages\n",
+                (unsigned long) rings.load(), (unsigned long) total);
+
+        std::free(r);
+}
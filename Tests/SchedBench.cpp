@@ -0,0 +1,164 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+extern "C" {
+        #include "Sched/Sched.h"
+}
+
+/*
+ * Run queue throughput with 1..8 threads playing CPUs, ns per operation
+ * (all threads together). Not a pass/fail test.
+ *
+ *      yield:  every CPU round-robins 2 entities of its own
+ *      wakeup: every CPU wakes an entity pinned to the next CPU (through
+ *              its inbox) and runs & puts to sleep the one woken onto it
+ *
+ * Per-CPU queues mean yields never touch another CPU's lines: the cost
+ * should stay flat as threads are added (as long as the host has cores).
+ * The in-kernel version is Kernel/Bench/SchedBench.c
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_OPS       200000
+
+static sched_state ss;
+
+static void setup(int nthreads)
+{
+        sched_state_init(&ss);
+
+        for (int cpu = 0; cpu < nthreads; cpu++) {
+                sched_cpu_online(&ss, cpu);
+        }
+}
+
+template <typename F>
+static double ns_per_op(int nthreads, uint64_t each, F fn)
+{
+        std::vector<std::thread> threads;
+        std::atomic<bool> go(false);
+
+        for (int t = 0; t < nthreads; t++) {
+                threads.emplace_back([&go, t, each, fn] {
+                        while (!go) {
+                                std::this_thread::yield();
+                        }
+
+                        fn((uint32_t) t, each);
+                });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+
+        for (auto &th : threads) {
+                th.join();
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                (each * nthreads);
+}
+
+static double bench_yield(int nthreads)
+{
+        static sched_entity se[SCHED_CPUS][2];
+
+        setup(nthreads);
+
+        for (int cpu = 0; cpu < nthreads; cpu++) {
+                for (sched_entity &e : se[cpu]) {
+                        sched_entity_init(&e, SCHED_PRIO_DEFAULT, 1U << cpu);
+                        sched_enqueue(&ss, cpu, &e);
+                }
+        }
+
+        return ns_per_op(nthreads, BENCH_OPS / nthreads,
+                [](uint32_t cpu, uint64_t n) {
+                        sched_entity *cur = sched_pick(&ss, cpu, nullptr, 0);
+
+                        for (uint64_t i = 0; i < n; i++) {
+                                sched_entity *next = sched_pick(&ss, cpu,
+                                        cur, i);
+
+                                if (next != cur) {
+                                        sched_finish(&ss, cpu, cur, i);
+                                }
+
+                                cur = next;
+                        }
+                });
+}
+
+static std::atomic<uint64_t> consumed;
+
+static double bench_wakeup(int nthreads)
+{
+        static sched_entity se[SCHED_CPUS];
+        uint64_t each = BENCH_OPS / nthreads;
+        uint64_t total = each * nthreads;
+
+        setup(nthreads);
+        consumed = 0;
+
+        for (int cpu = 0; cpu < nthreads; cpu++) {
+                sched_entity_init(&se[cpu], SCHED_PRIO_DEFAULT,
+                        1U << ((cpu + 1) % nthreads));
+        }
+
+        return ns_per_op(nthreads, each, [total](uint32_t cpu, uint64_t n) {
+                uint64_t woken = 0;
+
+                while (woken < n || consumed < total) {
+                        uint8_t busy = 0;
+
+                        if (woken < n && sched_wake(&ss, cpu, &se[cpu],
+                                0) < SCHED_CPUS) {
+                                woken++;
+                                busy = 1;
+                        }
+
+                        sched_entity *next = sched_pick(&ss, cpu, nullptr,
+                                0);
+
+                        if (next) {
+                                sched_prepare_sleep(next);
+                                sched_finish(&ss, cpu, next, 0);
+                                consumed++;
+                                busy = 1;
+                        }
+
+                        if (!busy) {
+                                std::this_thread::yield();
+                        }
+                }
+        });
+}
+
+TEST(SchedBench, throughput)
+{
+        std::printf("%-8s", "yield");
+
+        for (int n = 1; n <= 8; n *= 2) {
+                std::printf(" | %d thr: %7.1f ns", n, bench_yield(n));
+        }
+
+        std::printf("\n%-8s", "wakeup");
+
+        for (int n = 1; n <= 8; n *= 2) {
+                std::printf(" | %d thr: %7.1f ns", n, bench_wakeup(n));
+        }
+
+        std::printf("\n%u hardware threads on this host\n",
+                std::thread::hardware_concurrency());
+
+        EXPECT_EQ(consumed.load(), (uint64_t) (BENCH_OPS / 8) * 8);
+}
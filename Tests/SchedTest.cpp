@@ -0,0 +1,488 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+extern "C" {
+        #include "Sched/Sched.h"
+}
+
+#define HOT     SCHED_CACHE_HOT_NS
+#define COLD    (10 * SCHED_CACHE_HOT_NS)
+
+static void online(sched_state *ss, uint32_t cpus)
+{
+        sched_state_init(ss);
+
+        for (uint32_t cpu = 0; cpu < cpus; cpu++) {
+                sched_cpu_online(ss, cpu);
+        }
+}
+
+TEST(Sched, picks_most_urgent_level_first)
+{
+        static sched_state ss;
+        sched_entity low, mid, high;
+
+        online(&ss, 1);
+        sched_entity_init(&low, 20, SCHED_AFFINITY_ALL);
+        sched_entity_init(&mid, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&high, 1, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &low);
+        sched_enqueue(&ss, 0, &high);
+        sched_enqueue(&ss, 0, &mid);
+        EXPECT_EQ(ss.rq[0].bitmap, (1U << 1) | (1U << 16) | (1U << 20));
+
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, 0), &high);
+        sched_prepare_sleep(&high);
+        EXPECT_EQ(sched_pick(&ss, 0, &high, 0), &mid);
+        sched_prepare_sleep(&mid);
+        EXPECT_EQ(sched_pick(&ss, 0, &mid, 0), &low);
+        sched_prepare_sleep(&low);
+        EXPECT_EQ(sched_pick(&ss, 0, &low, 0), nullptr);
+
+        EXPECT_EQ(ss.rq[0].bitmap, 0u);
+        EXPECT_EQ(ss.idle, 1u);
+}
+
+TEST(Sched, yield_round_robins_a_level)
+{
+        static sched_state ss;
+        sched_entity a, b, c;
+
+        online(&ss, 1);
+        sched_entity_init(&a, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&b, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&c, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &a);
+        sched_enqueue(&ss, 0, &b);
+        sched_enqueue(&ss, 0, &c);
+
+        sched_entity *cur = sched_pick(&ss, 0, nullptr, 0);
+        sched_entity *order[6];
+
+        for (sched_entity *&o : order) {
+                o = cur;
+                sched_entity *next = sched_pick(&ss, 0, cur, 0);
+
+                if (next != cur) {
+                        sched_finish(&ss, 0, cur, 0);
+                }
+
+                cur = next;
+        }
+
+        sched_entity *expect[6] = { &a, &b, &c, &a, &b, &c };
+
+        for (int i = 0; i < 6; i++) {
+                EXPECT_EQ(order[i], expect[i]);
+        }
+
+        /* Alone on its level: yielding keeps running it */
+        sched_entity lone;
+        static sched_state ss2;
+
+        online(&ss2, 1);
+        sched_entity_init(&lone, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_enqueue(&ss2, 0, &lone);
+
+        EXPECT_EQ(sched_pick(&ss2, 0, nullptr, 0), &lone);
+        EXPECT_EQ(sched_pick(&ss2, 0, &lone, 0), &lone);
+        EXPECT_EQ(lone.state, (uint32_t) SE_RUNNING);
+}
+
+TEST(Sched, remote_wakeup_goes_through_the_inbox)
+{
+        static sched_state ss;
+        sched_entity se;
+
+        online(&ss, 2);
+        sched_entity_init(&se, SCHED_PRIO_DEFAULT, 1U << 1);
+
+        /* Woken by cpu0, only allowed on cpu1 */
+        EXPECT_EQ(sched_wake(&ss, 0, &se, 0), 1u);
+        EXPECT_EQ(ss.rq[1].inbox, &se);
+        EXPECT_EQ(ss.rq[0].stats.remote_wakeups, 1u);
+
+        /* Already awake */
+        EXPECT_EQ(sched_wake(&ss, 0, &se, 0), (uint32_t) SCHED_CPUS);
+
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, 0), &se);
+        EXPECT_EQ(ss.rq[1].inbox, nullptr);
+        EXPECT_EQ(se.cpu, 1u);
+}
+
+TEST(Sched, inbox_keeps_wakeup_order)
+{
+        static sched_state ss;
+        sched_entity se[4];
+
+        online(&ss, 2);
+
+        for (sched_entity &e : se) {
+                sched_entity_init(&e, SCHED_PRIO_DEFAULT, 1U << 1);
+                sched_wake(&ss, 0, &e, 0);
+        }
+
+        sched_entity *prev = nullptr;
+
+        for (sched_entity &e : se) {
+                if (prev) {
+                        sched_prepare_sleep(prev);
+                }
+
+                prev = sched_pick(&ss, 1, prev, 0);
+                EXPECT_EQ(prev, &e);
+        }
+}
+
+TEST(Sched, wakeup_prefers_the_warm_cpu)
+{
+        static sched_state ss;
+        sched_entity se, busy, running[2];
+
+        online(&ss, 4);
+        EXPECT_EQ(ss.idle, 0xFu); /* Until their first pick */
+
+        sched_entity_init(&se, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&busy, SCHED_PRIO_DEFAULT, 1U << 2);
+
+        for (uint32_t cpu = 0; cpu < 2; cpu++) {
+                sched_entity_init(&running[cpu], SCHED_PRIO_DEFAULT,
+                        1U << cpu);
+                sched_enqueue(&ss, cpu, &running[cpu]);
+                EXPECT_EQ(sched_pick(&ss, cpu, nullptr, COLD), &running[cpu]);
+        }
+
+        /* 'se' last ran on cpu2, which is busy now; cpu3 is idle */
+        sched_enqueue(&ss, 2, &busy);
+        se.cpu = 2;
+        se.last_ran = COLD;
+        EXPECT_EQ(sched_pick(&ss, 3, nullptr, COLD), nullptr);
+        EXPECT_EQ(ss.idle, 1U << 3);
+
+        EXPECT_EQ(sched_wake(&ss, 0, &se, COLD + HOT / 2), 2u);
+
+        /* Once cold, the idle CPU gets it */
+        sched_entity_init(&se, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        se.cpu = 2;
+        se.last_ran = 0;
+        EXPECT_EQ(sched_wake(&ss, 0, &se, COLD), 3u);
+        EXPECT_EQ(ss.idle, 0u);
+}
+
+TEST(Sched, idle_cpu_steals_cold_work)
+{
+        static sched_state ss;
+        sched_entity a, b;
+
+        online(&ss, 2);
+        sched_entity_init(&a, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&b, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &a);
+        sched_enqueue(&ss, 0, &b);
+
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, COLD), &a);
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD), &b);
+        EXPECT_EQ(ss.rq[1].stats.steals, 1u);
+        EXPECT_EQ(b.cpu, 1u);
+        EXPECT_EQ(sched_nr_queued(&ss, 0), 0u);
+}
+
+TEST(Sched, steal_respects_affinity_and_warmth)
+{
+        static sched_state ss;
+        sched_entity pinned, hot;
+
+        online(&ss, 2);
+        sched_entity_init(&pinned, SCHED_PRIO_DEFAULT, 1U << 0);
+        sched_entity_init(&hot, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &pinned);
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD), nullptr);
+
+        /* Ran on cpu0 just now, alone on the queue: stays */
+        hot.last_ran = COLD;
+        sched_enqueue(&ss, 0, &hot);
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, COLD), &pinned);
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD + 1), nullptr);
+
+        /* Crowded: even a hot one moves */
+        sched_entity more;
+
+        sched_entity_init(&more, SCHED_PRIO_DEFAULT, 1U << 0);
+        sched_enqueue(&ss, 0, &more);
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD + 1), &hot);
+}
+
+TEST(Sched, busy_victim_is_skipped_not_waited_for)
+{
+        static sched_state ss;
+        sched_entity se;
+
+        online(&ss, 2);
+        sched_entity_init(&se, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_enqueue(&ss, 0, &se);
+
+        spin_lock(&ss.rq[0].lock);
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD), nullptr);
+        spin_unlock(&ss.rq[0].lock);
+
+        EXPECT_EQ(sched_pick(&ss, 1, nullptr, COLD), &se);
+}
+
+TEST(Sched, priority_classes_set_the_slice)
+{
+        sched_entity rt, normal, batch;
+
+        sched_entity_init(&rt, SCHED_PRIO_RT_LAST, SCHED_AFFINITY_ALL);
+        sched_entity_init(&normal, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&batch, SCHED_PRIO_BATCH_FIRST, SCHED_AFFINITY_ALL);
+
+        EXPECT_EQ(sched_class_of(rt.prio), (uint32_t) SCHED_CLASS_RT);
+        EXPECT_EQ(sched_class_of(normal.prio), (uint32_t) SCHED_CLASS_NORMAL);
+        EXPECT_EQ(sched_class_of(batch.prio), (uint32_t) SCHED_CLASS_BATCH);
+
+        EXPECT_EQ(rt.slice_ns, 0u);
+        EXPECT_EQ(normal.slice_ns, (uint64_t) SCHED_SLICE_NS);
+        EXPECT_EQ(batch.slice_ns, (uint64_t) SCHED_SLICE_BATCH_NS);
+}
+
+TEST(Sched, expired_slice_preempts_only_for_its_level)
+{
+        static sched_state ss;
+        sched_entity a, b, low;
+
+        online(&ss, 1);
+        sched_entity_init(&a, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&b, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&low, SCHED_PRIO_BATCH_FIRST, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &a);
+        sched_enqueue(&ss, 0, &low);
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, 0), &a);
+        EXPECT_EQ(a.slice_end, (uint64_t) SCHED_SLICE_NS);
+
+        /* Only a less urgent one waits: tickless, an expiry renews */
+        EXPECT_EQ(sched_next_tick(&ss, 0, &a), 0u);
+        EXPECT_EQ(sched_tick(&ss, 0, &a, SCHED_SLICE_NS), 0);
+        EXPECT_EQ(a.slice_end, (uint64_t) 2 * SCHED_SLICE_NS);
+
+        /* A contender of its level: the slice timer matters now */
+        sched_enqueue(&ss, 0, &b);
+        EXPECT_EQ(sched_next_tick(&ss, 0, &a), (uint64_t) 2 * SCHED_SLICE_NS);
+        EXPECT_EQ(sched_tick(&ss, 0, &a, SCHED_SLICE_NS), 0);
+        EXPECT_EQ(sched_tick(&ss, 0, &a, 2 * SCHED_SLICE_NS), 1);
+
+        EXPECT_EQ(sched_pick(&ss, 0, &a, 2 * SCHED_SLICE_NS), &b);
+        EXPECT_EQ(ss.rq[0].stats.switches, 2u);
+}
+
+TEST(Sched, more_urgent_wakeup_preempts_at_once)
+{
+        static sched_state ss;
+        sched_entity normal, rt;
+
+        online(&ss, 2);
+        sched_entity_init(&normal, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&rt, 0, 1U << 0);
+
+        sched_enqueue(&ss, 0, &normal);
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, 0), &normal);
+        EXPECT_EQ(sched_tick(&ss, 0, &normal, 1), 0);
+
+        /* Through the inbox, the tick drains it */
+        EXPECT_EQ(sched_wake(&ss, 1, &rt, 1), 0u);
+        EXPECT_EQ(sched_tick(&ss, 0, &normal, 2), 1);
+        EXPECT_EQ(sched_pick(&ss, 0, &normal, 2), &rt);
+
+        /* No slice: never ticks, even with its level crowded */
+        sched_entity rt2;
+
+        sched_entity_init(&rt2, 0, 1U << 0);
+        sched_enqueue(&ss, 0, &rt2);
+        EXPECT_EQ(rt.slice_end, 0u);
+        EXPECT_EQ(sched_next_tick(&ss, 0, &rt), 0u);
+        EXPECT_EQ(sched_tick(&ss, 0, &rt, 10 * SCHED_SLICE_BATCH_NS), 0);
+
+        /* Idle with work */
+        sched_entity work;
+
+        sched_entity_init(&work, SCHED_PRIO_DEFAULT, 1U << 1);
+        EXPECT_EQ(sched_tick(&ss, 1, nullptr, 3), 0);
+        sched_enqueue(&ss, 1, &work);
+        EXPECT_EQ(sched_tick(&ss, 1, nullptr, 3), 1);
+}
+
+TEST(Sched, set_slice_overrides_the_class)
+{
+        static sched_state ss;
+        sched_entity se;
+
+        online(&ss, 1);
+        sched_entity_init(&se, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_set_slice(&se, 1000);
+        sched_enqueue(&ss, 0, &se);
+
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, 5), &se);
+        EXPECT_EQ(se.slice_end, 1005u);
+
+        /* Alone: yielding renews it */
+        EXPECT_EQ(sched_pick(&ss, 0, &se, 2000), &se);
+        EXPECT_EQ(se.slice_end, 3000u);
+
+        sched_set_slice(&se, 0);
+        EXPECT_EQ(sched_tick(&ss, 0, &se, 3000), 0);
+        EXPECT_EQ(se.slice_end, 0u);
+}
+
+TEST(Sched, direct_handoff_skips_the_queues)
+{
+        static sched_state ss;
+        sched_entity client, server, other;
+
+        online(&ss, 2);
+        sched_entity_init(&client, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&server, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+        sched_entity_init(&other, SCHED_PRIO_DEFAULT, SCHED_AFFINITY_ALL);
+
+        sched_enqueue(&ss, 0, &client);
+        sched_enqueue(&ss, 0, &other);
+        EXPECT_EQ(sched_pick(&ss, 0, nullptr, 100), &client);
+
+        /* The client blocks in a call, the sleeping server gets its slice */
+        sched_prepare_sleep(&client);
+        EXPECT_EQ(sched_direct(&ss, 0, &client, &server, 200), 1);
+        EXPECT_EQ(server.state, (uint32_t) SE_RUNNING);
+        EXPECT_EQ(server.slice_end, 100u + SCHED_SLICE_NS);
+        EXPECT_EQ(sched_nr_queued(&ss, 0), 1u); /* Only 'other' */
+        EXPECT_EQ(ss.rq[0].stats.handoffs, 1u);
+
+        /* Still switching away from the client: no */
+        EXPECT_EQ(sched_direct(&ss, 0, &server, &client, 300), 0);
+        sched_finish(&ss, 0, &client, 300);
+
+        /* A send: the server stays runnable, queued behind 'other' */
+        EXPECT_EQ(sched_direct(&ss, 0, &server, &client, 300), 1);
+        EXPECT_EQ(sched_nr_queued(&ss, 0), 2u);
+        sched_finish(&ss, 0, &server, 300);
+
+        /* Awake already, or not allowed here */
+        EXPECT_EQ(sched_direct(&ss, 0, &client, &server, 400), 0);
+        sched_prepare_sleep(&client);
+        sched_set_affinity(&client, 1U << 1);
+        EXPECT_EQ(sched_direct(&ss, 0, nullptr, &client, 400), 0);
+        EXPECT_EQ(client.state, (uint32_t) SE_SLEEPING);
+}
+
+/*
+ * Stress: threads play CPUs, each yields, puts its entity to sleep & wakes
+ * random sleepers, idle ones steal. An entity must never run on two CPUs
+ * at once, and none may get lost.
+ */
+
+#define STRESS_CPUS     4
+#define STRESS_TASKS    16
+#define STRESS_ITERS    20000
+
+TEST(Sched, stress_never_runs_twice)
+{
+        static sched_state ss;
+        static sched_entity se[STRESS_TASKS];
+        static std::atomic<uint32_t> running[STRESS_TASKS];
+        std::atomic<uint64_t> bad(0);
+        std::atomic<uint64_t> clock(0);
+        std::vector<std::thread> threads;
+
+        online(&ss, STRESS_CPUS);
+
+        for (uint32_t i = 0; i < STRESS_TASKS; i++) {
+                sched_entity_init(&se[i], i % 4 + SCHED_PRIO_DEFAULT,
+                        (i % 5 == 0) ? 1U << (i % STRESS_CPUS) :
+                        SCHED_AFFINITY_ALL);
+                sched_enqueue(&ss, i % STRESS_CPUS, &se[i]);
+                running[i] = 0;
+        }
+
+        for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                threads.emplace_back([cpu, &bad, &clock] {
+                        std::mt19937 rng(cpu);
+                        sched_entity *cur = nullptr;
+
+                        for (uint32_t i = 0; i < STRESS_ITERS; i++) {
+                                uint64_t now = clock.fetch_add(100);
+                                uint32_t r = rng() % 8;
+
+                                if (cur && r == 0) {
+                                        sched_prepare_sleep(cur);
+                                }
+
+                                if (r == 1) {
+                                        sched_wake(&ss, cpu,
+                                                &se[rng() % STRESS_TASKS],
+                                                now);
+                                }
+
+                                sched_entity *next = sched_pick(&ss, cpu,
+                                        cur, now);
+
+                                if (next != cur) {
+                                        if (cur) {
+                                                /* Still switching away */
+                                                if (r == 2) {
+                                                        std::this_thread::yield();
+                                                }
+
+                                                running[cur - se]--;
+                                                sched_finish(&ss, cpu, cur,
+                                                        now);
+                                        }
+
+                                        if (next &&
+                                                running[next - se]++ != 0) {
+                                                bad++;
+                                        }
+                                }
+
+                                cur = next;
+                        }
+
+                        if (cur) {
+                                running[cur - se]--;
+                                sched_prepare_sleep(cur);
+                                sched_finish(&ss, cpu, cur, 0);
+                        }
+                });
+        }
+
+        for (auto &th : threads) {
+                th.join();
+        }
+
+        EXPECT_EQ(bad.load(), 0u);
+
+        /* Every entity is accounted for: queued, in an inbox or asleep */
+        uint32_t queued = 0;
+        uint32_t sleeping = 0;
+
+        for (uint32_t cpu = 0; cpu < STRESS_CPUS; cpu++) {
+                queued += ss.rq[cpu].nr;
+
+                for (sched_entity *e = ss.rq[cpu].inbox; e; e = e->wake_next) {
+                        queued++;
+                }
+        }
+
+        for (sched_entity &e : se) {
+                EXPECT_EQ(e.on_cpu, 0u);
+                sleeping += e.state == SE_SLEEPING;
+        }
+
+        EXPECT_EQ(queued + sleeping, (uint32_t) STRESS_TASKS);
+}
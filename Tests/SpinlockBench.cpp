@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+extern "C" {
+        #include "ARM64/Spinlock.h"
+}
+
+/*
+ * Lock contention: 1..8 threads each acquire the lock, update a shared
+ * counter and release it. Not a pass/fail test, results are printed as
+ * ns per acquisition (all threads together).
+ *
+ * With more threads than host cores the waiters get preempted, and a FIFO
+ * handover (ticket & MCS alike) then waits for the next thread in line to
+ * be scheduled. The in-kernel version, with one waiter per CPU sleeping in
+ * WFE, is Kernel/Bench/LockBench.c
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_ACQUIRES  200000
+
+static spinlock ticket = SPINLOCK_INIT;
+static mcslock mcs = MCSLOCK_INIT;
+static rwlock rw = RWLOCK_INIT;
+
+static volatile uint64_t shared;
+
+struct bench_ticket {
+        static void run(uint64_t n)
+        {
+                for (uint64_t i = 0; i < n; i++) {
+                        spin_lock(&ticket);
+                        shared = shared + 1;
+                        spin_unlock(&ticket);
+                }
+        }
+};
+
+struct bench_mcs {
+        static void run(uint64_t n)
+        {
+                for (uint64_t i = 0; i < n; i++) {
+                        mcs_node node;
+
+                        mcs_lock(&mcs, &node);
+                        shared = shared + 1;
+                        mcs_unlock(&mcs, &node);
+                }
+        }
+};
+
+struct bench_rw_write {
+        static void run(uint64_t n)
+        {
+                for (uint64_t i = 0; i < n; i++) {
+                        write_lock(&rw);
+                        shared = shared + 1;
+                        write_unlock(&rw);
+                }
+        }
+};
+
+/* 1 in 16 a write, the typical lookup-table pattern */
+struct bench_rw_mostly_read {
+        static void run(uint64_t n)
+        {
+                for (uint64_t i = 0; i < n; i++) {
+                        if ((i & 15) == 0) {
+                                write_lock(&rw);
+                                shared = shared + 1;
+                                write_unlock(&rw);
+                        } else {
+                                read_lock(&rw);
+                                (void) shared;
+                                read_unlock(&rw);
+                        }
+                }
+        }
+};
+
+template <typename B>
+static double ns_per_acquire(int nthreads)
+{
+        std::vector<std::thread> threads;
+        std::atomic<bool> go(false);
+        uint64_t each = BENCH_ACQUIRES / nthreads;
+
+        for (int t = 0; t < nthreads; t++) {
+                threads.emplace_back([&go, each] {
+                        while (!go) {
+                                std::this_thread::yield();
+                        }
+
+                        B::run(each);
+                });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+
+        for (auto &th : threads) {
+                th.join();
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() /
+                (each * nthreads);
+}
+
+template <typename B>
+static void bench(const char *name)
+{
+        std::printf("%-16s", name);
+
+        for (int n = 1; n <= 8; n *= 2) {
+                std::printf(" | %d thr: %7.1f ns", n, ns_per_acquire<B>(n));
+        }
+
+        std::printf("\n");
+}
+
+TEST(SpinlockBench, contention)
+{
+        shared = 0;
+
+        bench<bench_ticket>("ticket");
+        bench<bench_mcs>("mcs");
+        bench<bench_rw_write>("rwlock_write");
+        bench<bench_rw_mostly_read>("rwlock_15r_1w");
+
+        EXPECT_FALSE(spin_is_locked(&ticket));
+        EXPECT_EQ(mcs.tail, nullptr);
+        EXPECT_EQ(rw.val, 0u);
+
+        std::printf("%u hardware threads on this host\n",
+                std::thread::hardware_concurrency());
+}
@@ -0,0 +1,206 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+extern "C" {
+        #include "ARM64/Spinlock.h"
+}
+
+#define TEST_THREADS    4
+#define TEST_ITERS      20000
+
+/* Non-atomic read-modify-write, loses updates without mutual exclusion */
+static void bump(volatile uint64_t *counter)
+{
+        uint64_t v = *counter;
+
+        std::this_thread::yield();
+        *counter = v + 1;
+}
+
+template <typename F>
+static void run_threads(F fn)
+{
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < TEST_THREADS; t++) {
+                threads.emplace_back(fn, t);
+        }
+
+        for (auto &th : threads) {
+                th.join();
+        }
+}
+
+TEST(Spinlock, ticket_mutual_exclusion)
+{
+        static spinlock lock = SPINLOCK_INIT;
+        static volatile uint64_t counter = 0;
+
+        run_threads([](int) {
+                for (int i = 0; i < TEST_ITERS / 10; i++) {
+                        spin_lock(&lock);
+                        bump(&counter);
+                        spin_unlock(&lock);
+                }
+        });
+
+        EXPECT_EQ(counter, (uint64_t) TEST_THREADS * (TEST_ITERS / 10));
+        EXPECT_FALSE(spin_is_locked(&lock));
+}
+
+TEST(Spinlock, ticket_trylock)
+{
+        spinlock lock;
+
+        spin_lock_init(&lock);
+
+        EXPECT_TRUE(spin_trylock(&lock));
+        EXPECT_TRUE(spin_is_locked(&lock));
+        EXPECT_FALSE(spin_trylock(&lock));
+
+        spin_unlock(&lock);
+        EXPECT_FALSE(spin_is_locked(&lock));
+        EXPECT_TRUE(spin_trylock(&lock));
+        spin_unlock(&lock);
+}
+
+TEST(Spinlock, ticket_wraps)
+{
+        spinlock lock;
+
+        /* 16-bit tickets about to wrap, 'next' must not carry into 'owner' */
+        lock.owner = 0xFFFE;
+        lock.next = 0xFFFE;
+
+        for (int i = 0; i < 4; i++) {
+                spin_lock(&lock);
+                EXPECT_TRUE(spin_is_locked(&lock));
+                EXPECT_FALSE(spin_trylock(&lock));
+                spin_unlock(&lock);
+                EXPECT_FALSE(spin_is_locked(&lock));
+        }
+
+        EXPECT_EQ(lock.owner, 2);
+        EXPECT_EQ(lock.next, 2);
+}
+
+TEST(Spinlock, mcs_mutual_exclusion)
+{
+        static mcslock lock = MCSLOCK_INIT;
+        static volatile uint64_t counter = 0;
+
+        run_threads([](int) {
+                for (int i = 0; i < TEST_ITERS / 10; i++) {
+                        mcs_node node;
+
+                        mcs_lock(&lock, &node);
+                        bump(&counter);
+                        mcs_unlock(&lock, &node);
+                }
+        });
+
+        EXPECT_EQ(counter, (uint64_t) TEST_THREADS * (TEST_ITERS / 10));
+        EXPECT_EQ(lock.tail, nullptr);
+}
+
+TEST(Spinlock, mcs_trylock)
+{
+        mcslock lock;
+        mcs_node a;
+        mcs_node b;
+
+        mcs_lock_init(&lock);
+
+        EXPECT_TRUE(mcs_trylock(&lock, &a));
+        EXPECT_FALSE(mcs_trylock(&lock, &b));
+
+        mcs_unlock(&lock, &a);
+        EXPECT_EQ(lock.tail, nullptr);
+        EXPECT_TRUE(mcs_trylock(&lock, &b));
+        mcs_unlock(&lock, &b);
+}
+
+TEST(Spinlock, rwlock_readers_share)
+{
+        rwlock lock;
+
+        rwlock_init(&lock);
+
+        read_lock(&lock);
+        EXPECT_TRUE(read_trylock(&lock));
+        EXPECT_FALSE(write_trylock(&lock));
+
+        read_unlock(&lock);
+        read_unlock(&lock);
+
+        EXPECT_TRUE(write_trylock(&lock));
+        EXPECT_FALSE(read_trylock(&lock));
+        EXPECT_FALSE(write_trylock(&lock));
+        write_unlock(&lock);
+
+        EXPECT_EQ(lock.val, 0u);
+}
+
+TEST(Spinlock, rwlock_waiting_writer_blocks_readers)
+{
+        static rwlock lock = RWLOCK_INIT;
+        static std::atomic<bool> writer_done(false);
+
+        read_lock(&lock);
+
+        std::thread writer([] {
+                write_lock(&lock);
+                writer_done = true;
+                write_unlock(&lock);
+        });
+
+        /* Writer announced itself: no new readers */
+        while (!(__atomic_load_n(&lock.val, __ATOMIC_ACQUIRE) & RW_WAITING)) {
+                std::this_thread::yield();
+        }
+
+        EXPECT_FALSE(read_trylock(&lock));
+        EXPECT_FALSE(writer_done);
+
+        read_unlock(&lock);
+        writer.join();
+
+        EXPECT_TRUE(writer_done);
+        EXPECT_TRUE(read_trylock(&lock));
+        read_unlock(&lock);
+}
+
+TEST(Spinlock, rwlock_consistency)
+{
+        static rwlock lock = RWLOCK_INIT;
+        static volatile uint64_t a = 0;
+        static volatile uint64_t b = 0;
+        static std::atomic<uint64_t> torn(0);
+
+        /* Thread 0 writes a == b, the others read and check */
+        run_threads([](int t) {
+                for (int i = 0; i < TEST_ITERS; i++) {
+                        if (t == 0 && (i % 4) == 0) {
+                                write_lock(&lock);
+                                a = a + 1;
+                                std::this_thread::yield();
+                                b = b + 1;
+                                write_unlock(&lock);
+                        } else {
+                                read_lock(&lock);
+                                if (a != b) {
+                                        torn++;
+                                }
+                                read_unlock(&lock);
+                        }
+                }
+        });
+
+        EXPECT_EQ(torn, 0u);
+        EXPECT_EQ(a, (uint64_t) TEST_ITERS / 4);
+        EXPECT_EQ(lock.val, 0u);
+}
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+
+/* Kernel versions, k-prefixed on the host (see LibKern/String/String.c) */
+extern "C" {
+        void *kmemcpy(void *dst, const void *src, size_t n);
+        void *kmemmove(void *dst, const void *src, size_t n);
+        void *kmemset(void *dst, int c, size_t n);
+        void *kmemchr(const void *src, int c, size_t n);
+        void *kmemrchr(const void *src, int c, size_t n);
+        int kmemcmp(const void *a, const void *b, size_t n);
+        char *kstrcpy(char *dst, const char *src);
+        char *kstrchr(const char *str, int c);
+        char *kstrrchr(const char *str, int c);
+        size_t kstrlen(const char *str);
+        size_t kstrnlen(const char *str, size_t max);
+}
+
+#define BUF 160
+
+static void fill(uint8_t *buf, size_t n, uint8_t seed)
+{
+        for (size_t i = 0; i < n; i++) {
+                buf[i] = (uint8_t) (seed + i * 7);
+        }
+}
+
+static int sign(int x)
+{
+        return (0 < x) - (x < 0);
+}
+
+TEST(String, memcpy_all_alignments)
+{
+        uint8_t src[BUF], dst[BUF], ref[BUF];
+
+        for (size_t so = 0; so < 8; so++)
+        for (size_t d_o = 0; d_o < 8; d_o++)
+        for (size_t n = 0; n < 100; n++) {
+                fill(src, BUF, 1);
+                memset(dst, 0xEE, BUF);
+                memset(ref, 0xEE, BUF);
+
+                memcpy(ref + d_o, src + so, n);
+                EXPECT_EQ(kmemcpy(dst + d_o, src + so, n), dst + d_o);
+                ASSERT_EQ(memcmp(dst, ref, BUF), 0) << so << " " << d_o << " " << n;
+        }
+}
+
+TEST(String, memmove_overlap)
+{
+        uint8_t buf[BUF], ref[BUF];
+
+        for (size_t from = 0; from < 40; from++)
+        for (size_t to = 0; to < 40; to++)
+        for (size_t n = 0; n < 80; n += 3) {
+                fill(buf, BUF, 3);
+                fill(ref, BUF, 3);
+
+                memmove(ref + to, ref + from, n);
+                kmemmove(buf + to, buf + from, n);
+                ASSERT_EQ(memcmp(buf, ref, BUF), 0) << from << " " << to << " " << n;
+        }
+}
+
+TEST(String, memset)
+{
+        uint8_t buf[BUF], ref[BUF];
+
+        for (size_t off = 0; off < 8; off++)
+        for (size_t n = 0; n < 100; n++) {
+                memset(buf, 0, BUF);
+                memset(ref, 0, BUF);
+
+                memset(ref + off, 0x1A5, n);
+                EXPECT_EQ(kmemset(buf + off, 0x1A5, n), buf + off);
+                ASSERT_EQ(memcmp(buf, ref, BUF), 0) << off << " " << n;
+        }
+}
+
+TEST(String, memcmp)
+{
+        uint8_t a[BUF], b[BUF];
+
+        fill(a, BUF, 5);
+        fill(b, BUF, 5);
+        EXPECT_EQ(kmemcmp(a, b, BUF), 0);
+        EXPECT_EQ(kmemcmp(a, b, 0), 0);
+
+        for (size_t i = 0; i < 64; i++) {
+                fill(b, BUF, 5);
+                b[i] = (uint8_t) (a[i] + 1);
+
+                EXPECT_EQ(sign(kmemcmp(a, b, 64)), sign(memcmp(a, b, 64)));
+                EXPECT_EQ(sign(kmemcmp(b, a, 64)), sign(memcmp(b, a, 64)));
+                EXPECT_EQ(kmemcmp(a, b, i), 0); /* Difference not reached */
+        }
+
+        /* Unsigned bytes */
+        a[0] = 0x80;
+        b[0] = 0x01;
+        EXPECT_GT(kmemcmp(a, b, 1), 0);
+}
+
+TEST(String, memchr_memrchr)
+{
+        uint8_t buf[BUF];
+
+        for (size_t off = 0; off < 8; off++)
+        for (size_t n = 0; n < 70; n++)
+        for (size_t at = 0; at <= n; at += 5) {
+                memset(buf, 'a', BUF);
+
+                if (at < n) {
+                        buf[off + at] = 'x';
+                }
+
+                EXPECT_EQ(kmemchr(buf + off, 'x', n), memchr(buf + off, 'x', n));
+                EXPECT_EQ(kmemrchr(buf + off, 'x', n),
+                        memrchr(buf + off, 'x', n));
+        }
+
+        /* 'c' is converted to unsigned char */
+        buf[3] = 0xFF;
+        EXPECT_EQ(kmemchr(buf, -1, BUF), buf + 3);
+}
+
+TEST(String, strlen_strnlen)
+{
+        char buf[BUF];
+
+        for (size_t off = 0; off < 8; off++)
+        for (size_t len = 0; len < 70; len++) {
+                memset(buf, 'a', BUF);
+                buf[off + len] = '\0';
+
+                ASSERT_EQ(kstrlen(buf + off), len);
+                ASSERT_EQ(kstrnlen(buf + off, SIZE_MAX), len);
+
+                for (size_t max = 0; max < 80; max += 7) {
+                        ASSERT_EQ(kstrnlen(buf + off, max),
+                                strnlen(buf + off, max)) << off << " " << len;
+                }
+        }
+}
+
+TEST(String, strcpy_strchr_strrchr)
+{
+        char dst[BUF];
+        const char *s = "/soc/pl011@9000000/clock";
+
+        EXPECT_EQ(kstrcpy(dst, s), dst);
+        EXPECT_STREQ(dst, s);
+
+        EXPECT_EQ(kstrchr(s, '/'), s);
+        EXPECT_EQ(kstrchr(s, '@'), strchr(s, '@'));
+        EXPECT_EQ(kstrchr(s, '\0'), s + strlen(s));
+        EXPECT_EQ(kstrchr(s, '#'), nullptr);
+
+        EXPECT_EQ(kstrrchr(s, '/'), strrchr(s, '/'));
+        EXPECT_EQ(kstrrchr(s, '\0'), s + strlen(s));
+        EXPECT_EQ(kstrrchr(s, '#'), nullptr);
+}
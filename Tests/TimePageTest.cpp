@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+extern "C" {
+        #include "LibKern/Clocksource.h"
+        #include "LibKern/TimePage.h"
+        #include "LibKern/Time.h"
+        #include "Memory/PageDef.h"
+}
+
+static std::atomic<uint64_t> fake_cycles{0};
+
+static inline uint64_t fake_read(void)
+{
+        return fake_cycles.load(std::memory_order_relaxed);
+}
+
+static clocksource fake_cs;
+
+static void fake_register(uint64_t freq, uint64_t mask)
+{
+        fake_cycles = 0;
+        clocksource_init(&fake_cs, "fake", fake_read, freq, mask);
+        clocksource_register(&fake_cs);
+}
+
+TEST(TimePage, layout)
+{
+        const time_page *tp = time_page_get();
+
+        EXPECT_EQ((uint64_t) tp % PAGE_SIZE, 0u);
+        EXPECT_LE(sizeof(time_page), PAGE_SIZE);
+}
+
+TEST(TimePage, matches_kernel_clock)
+{
+        fake_register(62500000, CLOCKSOURCE_MASK(56));
+        const time_page *tp = time_page_get();
+
+        EXPECT_EQ(tp->version, (uint32_t) TIME_PAGE_VERSION);
+        EXPECT_EQ(tp->freq, 62500000u);
+
+        uint64_t base = ktime_get_ns();
+
+        fake_cycles += 62500000; /* 1 second */
+        EXPECT_EQ(time_page_mono_ns(tp, fake_read), ktime_get_ns());
+        EXPECT_EQ(time_page_mono_ns(tp, fake_read) - base, NANO_PER_SEC);
+
+        /* Wall clock */
+        uint64_t epoch = 1760000000ULL * NANO_PER_SEC;
+
+        ktime_set_real_ns(epoch);
+        EXPECT_EQ(time_page_real_ns(tp, fake_read), epoch);
+        EXPECT_EQ(ktime_get_real_ns(), epoch);
+
+        fake_cycles += 625; /* 10 us */
+        EXPECT_EQ(time_page_real_ns(tp, fake_read), epoch + 10000);
+        EXPECT_EQ(time_page_mono_ns(tp, fake_read), ktime_get_ns());
+
+        /* Base folding is published as well */
+        clocksource_update();
+        EXPECT_EQ(tp->cycle_last, fake_cycles.load());
+        EXPECT_EQ(time_page_mono_ns(tp, fake_read), ktime_get_ns());
+}
+
+TEST(TimePage, wrap)
+{
+        fake_register(1000000000, CLOCKSOURCE_MASK(20));
+        const time_page *tp = time_page_get();
+        uint64_t total = 0;
+
+        for (int i = 0; i < 100; i++) {
+                fake_cycles = (fake_cycles + 300000) & 0xFFFFF;
+                total += 300000;
+                clocksource_update();
+
+                EXPECT_EQ(time_page_mono_ns(tp, fake_read), total);
+        }
+}
+
+/* Readers must never see a torn base while the kernel updates the page */
+TEST(TimePage, concurrent_updates)
+{
+        fake_register(1000000000, CLOCKSOURCE_MASK(56));
+        const time_page *tp = time_page_get();
+        std::atomic<bool> stop{false};
+
+        std::thread writer([&] {
+                while (!stop.load()) {
+                        fake_cycles += 7;
+                        clocksource_update();
+                }
+        });
+
+        uint64_t prev = 0;
+        uint64_t reads = 0;
+        auto end = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(200);
+
+        while (std::chrono::steady_clock::now() < end) {
+                uint64_t now = time_page_mono_ns(tp, fake_read);
+
+                /* 1 GHz: ns == cycles, and time never goes backwards */
+                ASSERT_GE(now, prev);
+                ASSERT_LE(now, fake_cycles.load());
+                prev = now;
+                reads++;
+        }
+
+        stop = true;
+        writer.join();
+
+        EXPECT_GT(reads, 0u);
+}
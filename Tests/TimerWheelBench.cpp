@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+extern "C" {
+        #include "LibKern/TimerWheel.h"
+}
+
+/*
+ * Arm / cancel / expire rates of the timing wheel with many concurrent
+ * timers. Not a pass/fail test, results are printed as ns per operation.
+ *
+ * Build & run with: make bench
+ */
+
+#define BENCH_TIMERS 1000000
+
+static uint64_t expired = 0;
+
+static void on_expire(tw_timer *t)
+{
+        (void) t;
+        expired++;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+        return std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(TimerWheelBench, arm_cancel_expire)
+{
+        std::mt19937_64 rng(42);
+        std::vector<tw_timer> timers(BENCH_TIMERS);
+        std::vector<uint64_t> deltas(BENCH_TIMERS);
+        static timer_wheel tw;
+
+        /* IPC-like timeouts: mostly 1..4096 ticks, some up to ~16M */
+        for (auto &d : deltas) {
+                d = 1 + (rng() & ((rng() % 8) ? 0xFFF : 0xFFFFFF));
+        }
+
+        tw_init(&tw, 0);
+
+        for (auto &t : timers) {
+                tw_timer_init(&t, on_expire, nullptr);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < BENCH_TIMERS; i++) {
+                tw_add(&tw, &timers[i], deltas[i]);
+        }
+        double arm = elapsed_ns(start) / BENCH_TIMERS;
+
+        /* Cancel half (the common case for timeouts) */
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < BENCH_TIMERS; i += 2) {
+                tw_del(&tw, &timers[i]);
+        }
+        double cancel = elapsed_ns(start) / (BENCH_TIMERS / 2);
+
+        /* Expire the rest, tickless: jump from event to event */
+        expired = 0;
+        uint64_t advances = 0;
+
+        start = std::chrono::steady_clock::now();
+        while (tw.pending) {
+                tw_advance(&tw, tw_next_event(&tw));
+                advances++;
+        }
+        double expire = elapsed_ns(start) / (BENCH_TIMERS / 2);
+
+        EXPECT_EQ(expired, BENCH_TIMERS / 2u);
+
+        std::printf("%u timers | arm: %6.2f ns | cancel: %6.2f ns | "
+                "expire: %6.2f ns (%lu advances)\n", BENCH_TIMERS, arm,
+                cancel, expire, (unsigned long) advances);
+}
@@ -0,0 +1,226 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+extern "C" {
+        #include "LibKern/TimerWheel.h"
+}
+
+/* Virtual clock: 'fired_at' records the advance() target that ran it */
+struct test_timer {
+        tw_timer t;
+        uint64_t expires;
+        uint64_t fired_at;
+        uint32_t fired;
+        uint8_t cancelled;
+};
+
+static uint64_t vclock = 0;
+
+static void on_expire(tw_timer *t)
+{
+        test_timer *tt = static_cast<test_timer*>(t->data);
+
+        tt->fired++;
+        tt->fired_at = vclock;
+}
+
+TEST(TimerWheel, init)
+{
+        timer_wheel tw;
+        tw_init(&tw, 1000);
+
+        EXPECT_EQ(tw.now, 1000u);
+        EXPECT_EQ(tw.pending, 0u);
+        EXPECT_EQ(tw_next_event(&tw), TW_NONE);
+        EXPECT_EQ(tw_advance(&tw, 5000), 0u);
+}
+
+TEST(TimerWheel, single)
+{
+        timer_wheel tw;
+        test_timer tt = {};
+
+        tw_init(&tw, 0);
+        tw_timer_init(&tt.t, on_expire, &tt);
+        EXPECT_FALSE(tw_timer_pending(&tt.t));
+
+        tw_add(&tw, &tt.t, 10);
+        EXPECT_TRUE(tw_timer_pending(&tt.t));
+        EXPECT_EQ(tw_next_event(&tw), 10u);
+
+        vclock = 9;
+        EXPECT_EQ(tw_advance(&tw, vclock), 0u);
+
+        vclock = 10;
+        EXPECT_EQ(tw_advance(&tw, vclock), 1u);
+        EXPECT_EQ(tt.fired, 1u);
+        EXPECT_FALSE(tw_timer_pending(&tt.t));
+        EXPECT_EQ(tw_next_event(&tw), TW_NONE);
+
+        /* In the past: runs on the next advance */
+        tw_add(&tw, &tt.t, 3);
+        EXPECT_EQ(tw_next_event(&tw), 11u);
+        vclock = 11;
+        EXPECT_EQ(tw_advance(&tw, vclock), 1u);
+        EXPECT_EQ(tt.fired, 2u);
+}
+
+TEST(TimerWheel, cancel_and_rearm)
+{
+        timer_wheel tw;
+        test_timer a = {}, b = {};
+
+        tw_init(&tw, 0);
+        tw_timer_init(&a.t, on_expire, &a);
+        tw_timer_init(&b.t, on_expire, &b);
+
+        tw_add(&tw, &a.t, 100000);
+        tw_add(&tw, &b.t, 100000);
+        EXPECT_EQ(tw.pending, 2u);
+
+        EXPECT_EQ(tw_del(&tw, &a.t), 1u);
+        EXPECT_EQ(tw_del(&tw, &a.t), 0u);
+        EXPECT_EQ(tw.pending, 1u);
+
+        /* Re-arming moves it */
+        tw_add(&tw, &b.t, 50);
+        tw_add(&tw, &b.t, 70);
+        EXPECT_EQ(tw.pending, 1u);
+
+        vclock = 1000000;
+        EXPECT_EQ(tw_advance(&tw, vclock), 1u);
+        EXPECT_EQ(a.fired, 0u);
+        EXPECT_EQ(b.fired, 1u);
+        EXPECT_EQ(tw.pending, 0u);
+
+        for (uint32_t lvl = 0; lvl < TW_LEVELS; lvl++) {
+                EXPECT_EQ(tw.occupied[lvl], 0u) << lvl;
+        }
+}
+
+/* A periodic timer re-arming itself from its callback */
+static timer_wheel periodic_tw;
+
+static void on_periodic(tw_timer *t)
+{
+        test_timer *tt = static_cast<test_timer*>(t->data);
+
+        tt->fired++;
+        tw_add(&periodic_tw, t, t->expires + 1000);
+}
+
+TEST(TimerWheel, periodic)
+{
+        test_timer tt = {};
+
+        tw_init(&periodic_tw, 0);
+        tw_timer_init(&tt.t, on_periodic, &tt);
+        tw_add(&periodic_tw, &tt.t, 1000);
+
+        /* One big jump still runs every period (catch-up) */
+        EXPECT_EQ(tw_advance(&periodic_tw, 1000000), 1000u);
+        EXPECT_EQ(tt.fired, 1000u);
+        /* May be an earlier cascade point, but never later */
+        EXPECT_GT(tw_next_event(&periodic_tw), 1000000u);
+        EXPECT_LE(tw_next_event(&periodic_tw), 1001000u);
+
+        for (uint64_t now = 1000001; now <= 2000000; now += 777) {
+                tw_advance(&periodic_tw, now);
+        }
+
+        EXPECT_EQ(tt.fired, 2000u);
+}
+
+TEST(TimerWheel, far_future_clamped)
+{
+        timer_wheel tw;
+        test_timer tt = {};
+
+        tw_init(&tw, 5);
+        tw_timer_init(&tt.t, on_expire, &tt);
+        tw_add(&tw, &tt.t, ~0ULL - 10);
+
+        EXPECT_LE(tw_next_event(&tw), 5 + TW_MAX_DELTA);
+
+        vclock = 5 + TW_MAX_DELTA;
+        EXPECT_EQ(tw_advance(&tw, vclock), 1u);
+        EXPECT_EQ(tt.fired, 1u);
+}
+
+/*
+ * Randomized against a trivial reference: every timer must run exactly once,
+ * in the first advance() whose target reaches its expiry.
+ */
+TEST(TimerWheel, random_against_reference)
+{
+        std::mt19937_64 rng(0xC0FFEE);
+        const uint32_t count = 20000;
+
+        std::vector<test_timer> timers(count);
+        timer_wheel tw;
+        uint64_t start = rng() & 0xFFFFFFFF;
+
+        tw_init(&tw, start);
+        vclock = start;
+
+        for (uint32_t i = 0; i < count; i++) {
+                test_timer &tt = timers[i];
+                /* Mix of near, mid & far timers, spanning several levels */
+                uint32_t range_bits = 4 + (rng() % 28);
+                uint64_t delta = rng() & ((1ULL << range_bits) - 1);
+
+                tw_timer_init(&tt.t, on_expire, &tt);
+                tt.expires = start + delta;
+                tw_add(&tw, &tt.t, tt.expires);
+        }
+
+        /* Cancel 10% */
+        for (uint32_t i = 0; i < count / 10; i++) {
+                test_timer &tt = timers[rng() % count];
+
+                tw_del(&tw, &tt.t);
+                tt.cancelled = 1;
+        }
+
+        uint64_t prev = vclock - 1; /* 'start' itself is not processed yet */
+
+        while (tw.pending) {
+                uint64_t next = tw_next_event(&tw);
+
+                /* Next event never comes after the earliest pending expiry */
+                uint64_t earliest = TW_NONE;
+
+                for (auto &tt : timers) {
+                        if (tw_timer_pending(&tt.t)) {
+                                earliest = std::min(earliest, tt.expires);
+                        }
+                }
+
+                ASSERT_LE(next, std::max(earliest, tw.now));
+
+                /* Random step, sometimes exactly onto the next event */
+                uint64_t step = (rng() % 4 == 0) ?
+                        std::max(next, vclock + 1) - vclock :
+                        1 + (rng() & ((1ULL << (rng() % 26)) - 1));
+
+                vclock += step;
+                tw_advance(&tw, vclock);
+
+                for (auto &tt : timers) {
+                        if (tt.fired && tt.fired_at == vclock) {
+                                EXPECT_LE(tt.expires, vclock);
+                                EXPECT_GT(tt.expires, prev);
+                        }
+                }
+
+                prev = vclock;
+        }
+
+        for (auto &tt : timers) {
+                EXPECT_EQ(tt.fired, tt.cancelled ? 0u : 1u);
+        }
+}
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+
+#
+# Decoder for the kernel's binary trace rings (Kernel/Include/LibKern/Trace.h)
+#
+# Takes the kernel ELF (for the trace descriptors & format strings) and a
+# console log that contains the output of trace_dump(). Prints one line per
+# event, ordered by timestamp across all CPUs.
+#
+# Usage: Tools/trace-decode.py Build/kernel.elf console.log
+#
+# No external dependencies, the ELF is parsed by hand.
+#
+# Author: Tuna CICI
+#
+
+import re
+import struct
+import sys
+
+# Must stay in sync with 'trace_desc' & TRACE_HDR() in LibKern/Trace.h
+DESC_SIZE = 32
+TRACE_MAGIC = 0x54
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 2:
+            sys.exit(f"{path}: not an ELF64 file")
+
+        (e_shoff,) = struct.unpack_from("<Q", self.data, 0x28)
+        e_shentsize, e_shnum = struct.unpack_from("<HH", self.data, 0x3A)
+
+        self.sections = []
+        for i in range(e_shnum):
+            off = e_shoff + i * e_shentsize
+            (_, sh_type, _, sh_addr, sh_offset,
+             sh_size, sh_link, _, _, sh_entsize) = struct.unpack_from(
+                "<IIQQQQIIQQ", self.data, off)
+            self.sections.append((sh_type, sh_addr, sh_offset, sh_size,
+                                  sh_link, sh_entsize))
+
+        self.symbols = {}
+        for sh_type, _, sh_offset, sh_size, sh_link, sh_entsize in self.sections:
+            if sh_type != 2:  # SHT_SYMTAB
+                continue
+
+            strtab = self.sections[sh_link]
+            for off in range(sh_offset, sh_offset + sh_size, sh_entsize):
+                st_name, _, _, _, st_value, _ = struct.unpack_from(
+                    "<IBBHQQ", self.data, off)
+                self.symbols[self._cstr(strtab[2] + st_name)] = st_value
+
+    def _cstr(self, off):
+        end = self.data.index(b"\0", off)
+        return self.data[off:end].decode(errors="replace")
+
+    def read(self, addr, size):
+        for sh_type, sh_addr, sh_offset, sh_size, _, _ in self.sections:
+            if sh_type == 1 and sh_addr <= addr < sh_addr + sh_size:  # PROGBITS
+                off = sh_offset + addr - sh_addr
+                return self.data[off:off + size]
+
+        return None
+
+    def string(self, addr):
+        for sh_type, sh_addr, sh_offset, sh_size, _, _ in self.sections:
+            if sh_type == 1 and sh_addr <= addr < sh_addr + sh_size:
+                return self._cstr(sh_offset + addr - sh_addr)
+
+        return f"<bad string @ 0x{addr:x}>"
+
+    def descriptors(self):
+        start = self.symbols.get("__trace_desc_start")
+        end = self.symbols.get("__trace_desc_end")
+
+        if start is None or end is None:
+            sys.exit("kernel ELF has no __trace_desc_start/__trace_desc_end")
+
+        descs = []
+        for addr in range(start, end, DESC_SIZE):
+            raw = self.read(addr, DESC_SIZE)
+            fmt, file, line, nargs, _ = struct.unpack("<QQIIQ", raw)
+            descs.append((self.string(fmt), self.string(file), line, nargs))
+
+        return descs
+
+
+# printf -> Python %-formatting. Length modifiers are meaningless here, all
+# arguments were recorded as 64-bit values.
+CONV = re.compile(r"%([-+ 0#]*)(\d*)(?:hh|h|ll|l|z|j|t)?([diuxXpcs%])")
+
+
+def render(fmt, args):
+    out = []
+    pos = 0
+    argi = 0
+
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+
+        flags, width, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+
+        val = args[argi] if argi < len(args) else 0
+        argi += 1
+
+        if conv in "di":
+            val = val - (1 << 64) if val & (1 << 63) else val
+            out.append(f"%{flags}{width}d" % val)
+        elif conv in "uxX":
+            out.append(f"%{flags}{width}{conv.replace('u', 'd')}" % val)
+        elif conv == "p" or conv == "s":
+            out.append(f"0x{val:x}")
+        elif conv == "c":
+            out.append(chr(val & 0xFF))
+
+    out.append(fmt[pos:])
+
+    return "".join(out).rstrip("\n")
+
+
+def parse_log(path):
+    freq = None
+    events = []
+    cpu = 0
+
+    with open(path, "rb") as f:
+        # Early console output may contain stray NULs, ignore them
+        text = f.read().replace(b"\0", b"").decode(errors="replace")
+
+    for line in text.splitlines():
+        line = line[line.find("@@"):] if "@@" in line else ""
+        fields = line.split()
+
+        if not fields:
+            continue
+
+        if fields[0] == "@@TRACE-BEGIN":
+            freq = int(fields[1], 16)
+        elif fields[0] == "@@RING":
+            cpu = int(fields[1], 16)
+        elif fields[0] == "@@S" and len(fields) >= 3:
+            words = [int(w, 16) for w in fields[1:]]
+            events.append((cpu, words[0], words[1], words[2:]))
+
+    if freq is None:
+        sys.exit(f"{path}: no @@TRACE-BEGIN found, was trace_dump() called?")
+
+    return freq, events
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(f"usage: {sys.argv[0]} <kernel.elf> <console.log>")
+
+    descs = Elf(sys.argv[1]).descriptors()
+    freq, events = parse_log(sys.argv[2])
+
+    for cpu, hdr, cycles, args in sorted(events, key=lambda e: e[2]):
+        if (hdr >> 56) != TRACE_MAGIC:
+            continue
+
+        desc_id = hdr & 0xFFFFFFFF
+        nargs = (hdr >> 48) & 0xFF
+
+        if len(descs) <= desc_id:
+            print(f"[cpu{cpu}] <unknown descriptor {desc_id}>")
+            continue
+
+        fmt, file, line, _ = descs[desc_id]
+        secs = cycles / freq
+
+        print(f"[{secs:12.6f}] cpu{cpu} {file}:{line}: "
+              f"{render(fmt, args[:nargs])}")
+
+
+if __name__ == "__main__":
+    main()